@@ -8,7 +8,7 @@ URL: http://www.gitorious.org/+maemo-tools-developers/maemo-tools/sp-rtrace
 Source: %{name}-%{version}.tar.gz
 BuildRoot: %{_tmppath}/%{name}-%{version}-%{release}-build
 BuildRequires: autoconf, automake, libtool, doxygen, gcc-c++
-BuildRequires: binutils-devel, glib2-devel
+BuildRequires: binutils-devel, glib2-devel, zlib-devel
 
 %description
  This package provides tools for tracing allocation and deallocation of
@@ -39,6 +39,7 @@ rm -rf %{buildroot}
 %{_bindir}/sp-rtrace-pagemap
 %{_bindir}/sp-rtrace
 %{_bindir}/sp-rtrace-resolve
+%{_bindir}/sp-rtrace-query
 %{_bindir}/rtrace-rename
 %{_bindir}/rtrace-sort
 %{_bindir}/rtrace-stats
@@ -50,6 +51,7 @@ rm -rf %{buildroot}
 %{_mandir}/man1/sp-rtrace-postproc.1.gz
 %{_mandir}/man1/sp-rtrace-pagemap.1.gz
 %{_mandir}/man1/sp-rtrace-resolve.1.gz
+%{_mandir}/man1/sp-rtrace-query.1.gz
 %{_mandir}/man1/rtrace-rename.1.gz
 %{_mandir}/man1/rtrace-sort.1.gz
 %{_mandir}/man1/rtrace-stats.1.gz
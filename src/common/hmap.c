@@ -0,0 +1,189 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "hmap.h"
+#include "utils.h"
+
+/* the minimum number of hash table slots */
+#define HMAP_MIN_SIZE     16
+
+/**
+ * Calculates the scrambled hash value of a record.
+ *
+ * @param[in] hm    the hash table.
+ * @param[in] rec   the record.
+ * @return          the hash value.
+ */
+static unsigned long long calc_hash(hmap_t* hm, void* rec)
+{
+	return hmap_mix((unsigned long)hm->do_calc_hash(rec));
+}
+
+/**
+ * Stores record into the first free slot of its probe sequence.
+ *
+ * The table must not contain matching record.
+ * @param[in] hm    the hash table.
+ * @param[in] rec   the record.
+ * @param[in] hash  the record hash value.
+ */
+static void insert_slot(hmap_t* hm, void* rec, unsigned long long hash)
+{
+	size_t mask = hm->size - 1;
+	size_t index = hash & mask;
+	while (hm->slots[index].rec) {
+		index = (index + 1) & mask;
+	}
+	hm->slots[index].rec = rec;
+	hm->slots[index].hash = hash;
+}
+
+/**
+ * Doubles the number of hash table slots.
+ *
+ * @param[in] hm    the hash table.
+ */
+static void grow(hmap_t* hm)
+{
+	hmap_slot_t* slots = hm->slots;
+	size_t size = hm->size, i;
+
+	hm->size <<= 1;
+	hm->slots = (hmap_slot_t*)calloc_a(hm->size, sizeof(hmap_slot_t));
+	for (i = 0; i < size; i++) {
+		if (slots[i].rec) insert_slot(hm, slots[i].rec, slots[i].hash);
+	}
+	free(slots);
+}
+
+/**
+ * Locates slot of the record matching the specified data.
+ *
+ * @param[in] hm    the hash table.
+ * @param[in] data  the data template to match.
+ * @param[in] hash  the data hash value.
+ * @return          the slot index or hm->size if the record was not found.
+ */
+static size_t find_slot(hmap_t* hm, void* data, unsigned long long hash)
+{
+	size_t mask = hm->size - 1;
+	size_t index = hash & mask;
+	while (hm->slots[index].rec) {
+		if (hm->slots[index].hash == hash && !hm->do_compare(hm->slots[index].rec, data)) return index;
+		index = (index + 1) & mask;
+	}
+	return hm->size;
+}
+
+/*
+ * Public API implementation
+ */
+
+int hmap_init(hmap_t* hm, size_t size, op_unary_t do_calc_hash, op_binary_t do_compare)
+{
+	hm->size = HMAP_MIN_SIZE;
+	while (hm->size < size) hm->size <<= 1;
+	hm->slots = (hmap_slot_t*)calloc_a(hm->size, sizeof(hmap_slot_t));
+	hm->count = 0;
+	hm->do_compare = do_compare;
+	hm->do_calc_hash = do_calc_hash;
+	return 0;
+}
+
+void hmap_free(hmap_t* hm, op_unary_t free_rec)
+{
+	if (free_rec) hmap_foreach(hm, free_rec);
+	free(hm->slots);
+	hm->slots = NULL;
+	hm->size = 0;
+	hm->count = 0;
+}
+
+void* hmap_find(hmap_t* hm, void* data)
+{
+	size_t index = find_slot(hm, data, calc_hash(hm, data));
+	return index == hm->size ? NULL : hm->slots[index].rec;
+}
+
+void* hmap_store(hmap_t* hm, void* rec)
+{
+	unsigned long long hash = calc_hash(hm, rec);
+	size_t index = find_slot(hm, rec, hash);
+	if (index != hm->size) {
+		void* old_rec = hm->slots[index].rec;
+		hm->slots[index].rec = rec;
+		return old_rec;
+	}
+	if ((hm->count + 1) * 4 > hm->size * 3) grow(hm);
+	insert_slot(hm, rec, hash);
+	hm->count++;
+	return NULL;
+}
+
+int hmap_remove(hmap_t* hm, void* rec)
+{
+	size_t mask = hm->size - 1;
+	size_t index = calc_hash(hm, rec) & mask;
+	while (hm->slots[index].rec != rec) {
+		if (!hm->slots[index].rec) return -ENOENT;
+		index = (index + 1) & mask;
+	}
+	/* Shift the following records of the probe sequence back, so the
+	 * lookups don't stop at the released slot. A record can be moved
+	 * into the released slot only if its home slot is not located
+	 * (cyclically) between the released slot and the record itself. */
+	size_t next = index;
+	while (true) {
+		next = (next + 1) & mask;
+		if (!hm->slots[next].rec) break;
+		size_t home = hm->slots[next].hash & mask;
+		if (((next - home) & mask) >= ((next - index) & mask)) {
+			hm->slots[index] = hm->slots[next];
+			index = next;
+		}
+	}
+	hm->slots[index].rec = NULL;
+	hm->count--;
+	return 0;
+}
+
+void hmap_foreach(hmap_t* hm, op_unary_t do_what)
+{
+	size_t i;
+	for (i = 0; i < hm->size; i++) {
+		if (hm->slots[i].rec) do_what(hm->slots[i].rec);
+	}
+}
+
+void hmap_foreach2(hmap_t* hm, op_binary_t do_what, void* data)
+{
+	size_t i;
+	for (i = 0; i < hm->size; i++) {
+		if (hm->slots[i].rec) do_what(hm->slots[i].rec, data);
+	}
+}
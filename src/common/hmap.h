@@ -0,0 +1,168 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+#ifndef HMAP_H
+#define HMAP_H
+
+#include <stddef.h>
+
+#include "data_ops.h"
+
+/**
+ * @file hmap.h
+ *
+ * Open addressing hash table implementation.
+ *
+ * Unlike htable_t the records are not linked into bucket lists,
+ * the table stores record references together with their hash
+ * values in a single array, which is doubled when it gets 3/4 full.
+ * The hash values returned by the hash function are scrambled with
+ * hmap_mix(), so simple hash functions (for example returning the
+ * resource address) can be used.
+ * The table doesn't manage the resources used by its records - the
+ * user is responsible for allocating/freeing them.
+ */
+
+/**
+ * The hash table slot.
+ */
+typedef struct hmap_slot_t {
+	/* the record, NULL for empty slots */
+	void* rec;
+	/* the scrambled record hash value */
+	unsigned long long hash;
+} hmap_slot_t;
+
+/**
+ * The hash table.
+ */
+typedef struct hmap_t {
+	/* the hash table slots */
+	hmap_slot_t* slots;
+	/* the number of slots (power of two) */
+	size_t size;
+	/* the number of stored records */
+	size_t count;
+
+	/* the record comparison function */
+	op_binary_t do_compare;
+	/* the hash value calculation function */
+	op_unary_t do_calc_hash;
+} hmap_t;
+
+/**
+ * Scrambles 64-bit value.
+ *
+ * This is the 64-bit finalizer of the MurmurHash3 hash function.
+ * Every input bit affects every output bit, so it can be also used
+ * to combine multiple values into a single hash value.
+ * @param[in] value  the value to scramble.
+ * @return           the scrambled value.
+ */
+static inline unsigned long long hmap_mix(unsigned long long value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+	return value;
+}
+
+/**
+ * Initializes hash table.
+ *
+ * @param[in] hm            the hash table to initialize.
+ * @param[in] size          the initial number of slots (rounded up to power of two).
+ * @param[in] do_calc_hash  the hash function.
+ * @param[in] do_compare    the comparison function.
+ * @return                  0 - success.
+ */
+int hmap_init(hmap_t* hm, size_t size, op_unary_t do_calc_hash, op_binary_t do_compare);
+
+/**
+ * Frees the hash table.
+ *
+ * If the free_rec function is specified, it's called for each
+ * stored record to release resources used by the record itself.
+ * @param[in] hm        the hash table.
+ * @param[in] free_rec  the record freeing function. Can be NULL.
+ * @return
+ */
+void hmap_free(hmap_t* hm, op_unary_t free_rec);
+
+/**
+ * Finds a record matching the specified data.
+ *
+ * @param[in] hm    the hash table.
+ * @param[in] data  the data template to match.
+ * @return          the located record or NULL.
+ */
+void* hmap_find(hmap_t* hm, void* data);
+
+/**
+ * Stores record into hash table.
+ *
+ * If hash table already contains matching record,
+ * it is replaced and the old record returned.
+ * @param[in] hm    the hash table.
+ * @param[in] rec   the record to store.
+ * @return          the old record (if such existed) or NULL.
+ */
+void* hmap_store(hmap_t* hm, void* rec);
+
+/**
+ * Removes the specified record from the hash table.
+ *
+ * The record is located by its address, so it can be removed even if
+ * other records in the table compare equal to it. The record hash
+ * value must not change while the record is stored in the table.
+ * Note that the record itself is not freed.
+ * @param[in] hm    the hash table.
+ * @param[in] rec   the record to remove.
+ * @return          0 - success, -ENOENT - the record was not found.
+ */
+int hmap_remove(hmap_t* hm, void* rec);
+
+/**
+ * Calls a function for all records in table.
+ *
+ * The table must not be modified by the called function.
+ * @param[in] hm       the hash table.
+ * @param[in] do_what  the function to call.
+ * @return
+ */
+void hmap_foreach(hmap_t* hm, op_unary_t do_what);
+
+/**
+ * Calls a function for all records in table.
+ *
+ * The table must not be modified by the called function.
+ * @param[in] hm       the hash table.
+ * @param[in] do_what  the function to call.
+ * @param[in] data     the second argument for do_what function.
+ * @return
+ */
+void hmap_foreach2(hmap_t* hm, op_binary_t do_what, void* data);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "log_writer.h"
+#include "header.h"
+
+void log_write_header(sp_rtrace_formatter_t* formatter, char* arch, char* process, int pid,
+		time_t timestamp, int backtrace_depth, char* origin, unsigned int filter)
+{
+	/* prepare version and timestamp strings */
+	char stimestamp[64], spid[16], btdepth[16];
+	sprintf(spid, "%d", pid);
+	struct tm* tm = localtime(&timestamp);
+	sprintf(stimestamp, "%d.%d.%d %02d:%02d:%02d", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
+	sprintf(btdepth, "%d", backtrace_depth);
+
+	sp_rtrace_header_t header =  {
+			.fields = {
+					NULL,                                      // HEADER_VERSION
+					arch,                                      // HEADER_ARCH
+					stimestamp,                                // HEADER_TIMESTAMP
+					process,                                   // HEADER_PROCESS
+					spid,                                      // HEADER_PID
+					NULL,                                      // HEADER_FILTER
+					backtrace_depth == -1 ? NULL : btdepth,    // HEADER_BACKTRACE_DEPTH
+					origin,                                    // HEADER_ORIGIN
+			},
+	};
+	header_set_filter(&header, filter);
+	TRY(sp_rtrace_format_header(formatter, &header));
+	/* clear the header filter to free the header filter field */
+	header_set_filter(&header, 0);
+}
+
+void log_write_heap_info(sp_rtrace_formatter_t* formatter, const rd_hinfo_t* hinfo)
+{
+	TRY(sp_rtrace_format_comment(formatter, "## heap status information:\n"));
+	TRY(sp_rtrace_format_comment(formatter, "##   heap bottom 0x%lx\n", hinfo->heap_bottom));
+	TRY(sp_rtrace_format_comment(formatter, "##   heap top 0x%lx\n", hinfo->heap_top));
+	TRY(sp_rtrace_format_comment(formatter, "##   lowest block 0x%lx\n", hinfo->lowest_block));
+	TRY(sp_rtrace_format_comment(formatter, "##   highest block 0x%lx\n", hinfo->highest_block));
+	TRY(sp_rtrace_format_comment(formatter, "##   non-mapped space allocated from system %d\n", hinfo->arena));
+	TRY(sp_rtrace_format_comment(formatter, "##   count of free chunks %d\n", hinfo->ordblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   count of freed fastbin blocks %d\n", hinfo->smblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   count of mapped regions %d\n", hinfo->hblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   space in mapped regions %d\n", hinfo->hblkhd));
+	TRY(sp_rtrace_format_comment(formatter, "##   maximum total allocated space %d\n", hinfo->usmblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   space available in freed fastbin blocks %d\n", hinfo->fsmblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   total allocated space, both normal and mmapped %d\n", hinfo->uordblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   total free space %d\n", hinfo->fordblks));
+	TRY(sp_rtrace_format_comment(formatter, "##   space ideally releasable via malloc_trim %d\n", hinfo->keepcost));
+}
+
+void log_write_module_info(sp_rtrace_formatter_t* formatter, unsigned int id, const char* name,
+		int vmajor, int vminor)
+{
+	TRY(sp_rtrace_format_comment(formatter, "## tracing module: [%x] %s (%d.%d)\n", id, name, vmajor, vminor));
+}
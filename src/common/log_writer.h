@@ -0,0 +1,88 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file log_writer.h
+ *
+ * Text log environment writing functionality shared by the post-processor
+ * and the trace database query tool.
+ */
+#ifndef LOG_WRITER_H_
+#define LOG_WRITER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rtrace_data.h"
+#include "library/sp_rtrace_formatter.h"
+
+/* exits if the formatter fails to write the output data */
+#define TRY(x) {\
+	int rc = x;\
+	if (rc < 0) {\
+		fprintf(stderr, "Error while writing output data (%s)\n", strerror(-rc));\
+		exit (-1);\
+	}\
+}
+
+/**
+ * Writes text log header.
+ *
+ * @param[in] formatter        the log formatter.
+ * @param[in] arch             the target architecture.
+ * @param[in] process          the process name.
+ * @param[in] pid              the process identifier.
+ * @param[in] timestamp        the trace start time.
+ * @param[in] backtrace_depth  the backtrace depth (-1 if not set).
+ * @param[in] origin           the trace origin.
+ * @param[in] filter           the header filter mask (see filter_mask_t structure).
+ * @return
+ */
+void log_write_header(sp_rtrace_formatter_t* formatter, char* arch, char* process, int pid,
+		time_t timestamp, int backtrace_depth, char* origin, unsigned int filter);
+
+/**
+ * Writes heap status information comments.
+ *
+ * @param[in] formatter  the log formatter.
+ * @param[in] hinfo      the heap status information.
+ * @return
+ */
+void log_write_heap_info(sp_rtrace_formatter_t* formatter, const rd_hinfo_t* hinfo);
+
+/**
+ * Writes tracing module information comment.
+ *
+ * @param[in] formatter  the log formatter.
+ * @param[in] id         the module identifier.
+ * @param[in] name       the module name.
+ * @param[in] vmajor     the module version number (major).
+ * @param[in] vminor     the module version number (minor).
+ * @return
+ */
+void log_write_module_info(sp_rtrace_formatter_t* formatter, unsigned int id, const char* name,
+		int vmajor, int vminor);
+
+#endif /* LOG_WRITER_H_ */
@@ -0,0 +1,206 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "utils.h"
+
+/* the object alignment */
+#define POOL_ALIGN            8
+
+/* the chunk header size, keeping the chunk data aligned */
+#define POOL_CHUNK_HEADER     ((sizeof(pool_chunk_t) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+
+/* the string arena chunk size */
+#define STRPOOL_CHUNK_SIZE    (64 * 1024)
+
+/* the initial string index size */
+#define STRPOOL_HASH_SIZE     (1 << 12)
+
+/* the number of string index records per chunk */
+#define STRPOOL_ENTRY_COUNT   1024
+
+/**
+ * Allocates new memory chunk and links it to the chunk list.
+ *
+ * @param[in,out] chunks  the chunk list.
+ * @param[in] size        the chunk data size.
+ * @return                the chunk data.
+ */
+static char* chunk_alloc(pool_chunk_t** chunks, size_t size)
+{
+	pool_chunk_t* chunk = (pool_chunk_t*)malloc_a(POOL_CHUNK_HEADER + size);
+	chunk->next = *chunks;
+	*chunks = chunk;
+	return (char*)chunk + POOL_CHUNK_HEADER;
+}
+
+/**
+ * Frees the chunk list.
+ *
+ * @param[in] chunks  the chunk list.
+ */
+static void chunks_free(pool_chunk_t* chunks)
+{
+	while (chunks) {
+		pool_chunk_t* next = chunks->next;
+		free(chunks);
+		chunks = next;
+	}
+}
+
+/**
+ * The string index record.
+ */
+typedef struct strpool_entry_t {
+	/* the string key, used for lookups */
+	const char* key;
+	/* the string length */
+	size_t len;
+	/* the string stored in the arena */
+	char* str;
+} strpool_entry_t;
+
+/**
+ * Compares two string index records.
+ */
+static long strpool_entry_compare(const strpool_entry_t* entry1, const strpool_entry_t* entry2)
+{
+	if (entry1->len != entry2->len) return entry1->len < entry2->len ? -1 : 1;
+	return memcmp(entry1->key, entry2->key, entry1->len);
+}
+
+/**
+ * Calculates hash value for the string index record.
+ */
+static long strpool_entry_hash(const strpool_entry_t* entry)
+{
+	unsigned int hash = 2166136261u;
+	size_t i;
+	for (i = 0; i < entry->len; i++) {
+		hash = (hash ^ (unsigned char)entry->key[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Public API implementation
+ */
+
+void pool_init(pool_t* pool, size_t size, size_t count)
+{
+	if (size < sizeof(void*)) size = sizeof(void*);
+	pool->size = (size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+	pool->chunk_size = pool->size * count;
+	pool->chunks = NULL;
+	pool->head = NULL;
+	pool->tail = NULL;
+	pool->free_list = NULL;
+}
+
+void* pool_alloc(pool_t* pool)
+{
+	void* obj = pool->free_list;
+	if (obj) {
+		pool->free_list = *(void**)obj;
+		return obj;
+	}
+	if (pool->head == pool->tail) {
+		pool->head = chunk_alloc(&pool->chunks, pool->chunk_size);
+		pool->tail = pool->head + pool->chunk_size;
+	}
+	obj = pool->head;
+	pool->head += pool->size;
+	return obj;
+}
+
+void pool_release(pool_t* pool, void* obj)
+{
+	*(void**)obj = pool->free_list;
+	pool->free_list = obj;
+}
+
+void pool_free(pool_t* pool)
+{
+	chunks_free(pool->chunks);
+	pool->chunks = NULL;
+	pool->head = NULL;
+	pool->tail = NULL;
+	pool->free_list = NULL;
+}
+
+
+void strpool_init(strpool_t* pool)
+{
+	pool->chunks = NULL;
+	pool->head = NULL;
+	pool->tail = NULL;
+	hmap_init(&pool->index, STRPOOL_HASH_SIZE, (op_unary_t)strpool_entry_hash, (op_binary_t)strpool_entry_compare);
+	pool_init(&pool->entries, sizeof(strpool_entry_t), STRPOOL_ENTRY_COUNT);
+}
+
+char* strpool_add(strpool_t* pool, const char* str, size_t len)
+{
+	strpool_entry_t template = {.key = str, .len = len};
+	strpool_entry_t* entry = (strpool_entry_t*)hmap_find(&pool->index, &template);
+	if (entry) return entry->str;
+
+	char* data;
+	if ((size_t)(pool->tail - pool->head) > len) {
+		data = pool->head;
+		pool->head += len + 1;
+	}
+	else if (len >= STRPOOL_CHUNK_SIZE / 4) {
+		/* long strings get their own chunks, so the current chunk
+		 * can still be used for the following strings */
+		data = chunk_alloc(&pool->chunks, len + 1);
+	}
+	else {
+		data = chunk_alloc(&pool->chunks, STRPOOL_CHUNK_SIZE);
+		pool->head = data + len + 1;
+		pool->tail = data + STRPOOL_CHUNK_SIZE;
+	}
+	memcpy(data, str, len);
+	data[len] = '\0';
+
+	entry = (strpool_entry_t*)pool_alloc(&pool->entries);
+	entry->key = data;
+	entry->len = len;
+	entry->str = data;
+	hmap_store(&pool->index, entry);
+	return data;
+}
+
+void strpool_free(strpool_t* pool)
+{
+	/* the index records are freed together with the entry pool */
+	hmap_free(&pool->index, NULL);
+	pool_free(&pool->entries);
+	chunks_free(pool->chunks);
+	pool->chunks = NULL;
+	pool->head = NULL;
+	pool->tail = NULL;
+}
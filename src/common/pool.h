@@ -0,0 +1,147 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#include "hmap.h"
+
+/**
+ * @file pool.h
+ *
+ * Chunked object pool and string arena implementation.
+ *
+ * The objects are allocated sequentially from large memory chunks,
+ * so objects allocated one after another are placed next to each
+ * other in memory. The released objects are kept in a free list and
+ * reused by the following allocations. All objects are released at
+ * once by freeing the chunks.
+ */
+
+/**
+ * Memory chunk header.
+ *
+ * The chunk data follows the header.
+ */
+typedef struct pool_chunk_t {
+	/* the next chunk */
+	struct pool_chunk_t* next;
+} pool_chunk_t;
+
+/**
+ * Fixed size object pool.
+ */
+typedef struct pool_t {
+	/* the object size */
+	size_t size;
+	/* the chunk data size */
+	size_t chunk_size;
+	/* the allocated chunks */
+	pool_chunk_t* chunks;
+	/* the unused area of the last chunk */
+	char* head;
+	char* tail;
+	/* the released objects */
+	void* free_list;
+} pool_t;
+
+/**
+ * Initializes object pool.
+ *
+ * @param[in] pool    the pool to initialize.
+ * @param[in] size    the object size.
+ * @param[in] count   the number of objects per chunk.
+ */
+void pool_init(pool_t* pool, size_t size, size_t count);
+
+/**
+ * Allocates object from the pool.
+ *
+ * The object memory is not initialized.
+ * @param[in] pool   the pool.
+ * @return           the allocated object.
+ */
+void* pool_alloc(pool_t* pool);
+
+/**
+ * Returns object to the pool.
+ *
+ * @param[in] pool   the pool.
+ * @param[in] obj    the object allocated from the pool.
+ */
+void pool_release(pool_t* pool, void* obj);
+
+/**
+ * Frees the pool together with all objects allocated from it.
+ *
+ * @param[in] pool   the pool.
+ */
+void pool_free(pool_t* pool);
+
+
+/**
+ * String arena.
+ *
+ * Stores single copy of every string added to the arena.
+ */
+typedef struct strpool_t {
+	/* the string data chunks */
+	pool_chunk_t* chunks;
+	/* the unused area of the last chunk */
+	char* head;
+	char* tail;
+	/* the string index */
+	hmap_t index;
+	/* the string index records */
+	pool_t entries;
+} strpool_t;
+
+/**
+ * Initializes string arena.
+ *
+ * @param[in] pool   the arena to initialize.
+ */
+void strpool_init(strpool_t* pool);
+
+/**
+ * Adds string to the arena.
+ *
+ * If the arena already contains matching string, the stored
+ * string is returned instead of creating a new copy.
+ * @param[in] pool   the arena.
+ * @param[in] str    the string to add (not necessary zero terminated).
+ * @param[in] len    the string length.
+ * @return           the zero terminated string stored in the arena.
+ */
+char* strpool_add(strpool_t* pool, const char* str, size_t len);
+
+/**
+ * Frees the arena together with all strings stored in it.
+ *
+ * @param[in] pool   the arena.
+ */
+void strpool_free(strpool_t* pool);
+
+#endif
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "resolve_utils.h"
 #include "utils.h"
@@ -37,6 +38,7 @@
 	typedef Elf32_Off    Elf_Off_t;
 	typedef Elf32_Shdr   Elf_Shdr_t;
 	typedef Elf32_Addr   Elf_Addr_t;
+	typedef Elf32_Nhdr   Elf_Nhdr_t;
 
 	#define ELF_ST_TYPE(x)		ELF32_ST_TYPE(x)
 #else
@@ -46,6 +48,7 @@
 	typedef Elf64_Off    Elf_Off_t;
 	typedef Elf64_Shdr   Elf_Shdr_t;
 	typedef Elf64_Addr   Elf_Addr_t;
+	typedef Elf64_Nhdr   Elf_Nhdr_t;
 
 	#define ELF_ST_TYPE(x)		ELF64_ST_TYPE(x)
 
@@ -104,3 +107,83 @@ int rs_mmap_is_absolute(const char* path)
 
 	return is_absolute;
 }
+
+/* the build-id note name */
+#define BUILD_ID_NOTE_NAME     "GNU"
+
+/* the note field alignment */
+#define NOTE_ALIGN(size)       (((size) + 3) & ~3)
+
+/**
+ * Searches note segment for build-id note.
+ *
+ * @param[in] notes      the note segment data.
+ * @param[in] size       the note segment size.
+ * @param[out] build_id  the build-id in hexadecimal format.
+ * @param[in] out_size   the build_id buffer size.
+ * @return               0 - success, -ENOENT - build-id note not found.
+ */
+static int find_build_id_note(const char* notes, size_t size, char* build_id, size_t out_size)
+{
+	const char* ptr = notes;
+	while (ptr + sizeof(Elf_Nhdr_t) <= notes + size) {
+		const Elf_Nhdr_t* nhdr = (const Elf_Nhdr_t*)ptr;
+		const char* name = ptr + sizeof(Elf_Nhdr_t);
+		const unsigned char* desc = (const unsigned char*)name + NOTE_ALIGN(nhdr->n_namesz);
+		ptr = (const char*)desc + NOTE_ALIGN(nhdr->n_descsz);
+		if (ptr > notes + size) break;
+
+		if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == sizeof(BUILD_ID_NOTE_NAME) &&
+				!memcmp(name, BUILD_ID_NOTE_NAME, sizeof(BUILD_ID_NOTE_NAME)) &&
+				nhdr->n_descsz * 2 < out_size) {
+			unsigned int i;
+			for (i = 0; i < nhdr->n_descsz; i++) {
+				sprintf(build_id + i * 2, "%02x", desc[i]);
+			}
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+int rs_read_build_id(const char* path, unsigned long offset, pointer_t from, char* build_id, size_t size, pointer_t* bias)
+{
+	FILE *file;
+	Elf_Ehdr_t elf_header;
+	Elf_Phdr_t *program_header;
+	int i, rc = -ENOENT;
+
+	if (!(file = fopen(path, "r"))) return -errno;
+
+	if (fread(&elf_header, sizeof(elf_header), 1, file) != 1 || memcmp(elf_header.e_ident, ELFMAG, SELFMAG) ||
+			elf_header.e_phentsize != sizeof(Elf_Phdr_t)) {
+		fclose(file);
+		return -EINVAL;
+	}
+	program_header = (Elf_Phdr_t*)malloc_a(sizeof(Elf_Phdr_t) * elf_header.e_phnum);
+	if (fseek(file, elf_header.e_phoff, SEEK_SET) == -1 ||
+			fread(program_header, sizeof(Elf_Phdr_t), elf_header.e_phnum, file) != elf_header.e_phnum) {
+		free(program_header);
+		fclose(file);
+		return -EINVAL;
+	}
+
+	long page_mask = ~(sysconf(_SC_PAGESIZE) - 1);
+	for (i = 0; i < elf_header.e_phnum; i++) {
+		Elf_Phdr_t* phdr = &program_header[i];
+		if (phdr->p_type == PT_LOAD && bias && (phdr->p_offset & page_mask) == offset) {
+			*bias = from - (phdr->p_vaddr & page_mask);
+		}
+		if (phdr->p_type == PT_NOTE && rc != 0 && phdr->p_filesz) {
+			char* notes = (char*)malloc_a(phdr->p_filesz);
+			if (fseek(file, phdr->p_offset, SEEK_SET) == 0 && fread(notes, phdr->p_filesz, 1, file) == 1) {
+				rc = find_build_id_note(notes, phdr->p_filesz, build_id, size);
+			}
+			free(notes);
+		}
+	}
+
+	free(program_header);
+	fclose(file);
+	return rc;
+}
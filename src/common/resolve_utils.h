@@ -23,7 +23,25 @@
 #ifndef RESOLVE_UTILS_H_
 #define RESOLVE_UTILS_H_
 
+#include <stddef.h>
+
+#include "library/sp_rtrace_defs.h"
 
 int rs_mmap_is_absolute(const char* path);
 
+/**
+ * Reads build-id and load bias of a memory mapped ELF file.
+ *
+ * The load bias is calculated from the loadable segment containing
+ * the specified file offset.
+ * @param[in] path       the ELF file path.
+ * @param[in] offset     the file offset of the memory mapping.
+ * @param[in] from       the memory mapping start address.
+ * @param[out] build_id  the build-id in hexadecimal format.
+ * @param[in] size       the build_id buffer size.
+ * @param[out] bias      the load bias (can be NULL).
+ * @return               0 - success, -errno - failure.
+ */
+int rs_read_build_id(const char* path, unsigned long offset, pointer_t from, char* build_id, size_t size, pointer_t* bias);
+
 #endif /* RESOLVE_UTILS_H_ */
@@ -54,6 +54,7 @@ void rd_minfo_free(rd_minfo_t* minfo)
 void rd_mmap_free(rd_mmap_t* mmap)
 {
 	if (mmap->data.module) free(mmap->data.module);
+	if (mmap->data.build_id) free(mmap->data.build_id);
 	free(mmap);
 }
 
@@ -71,10 +72,11 @@ void rd_resource_free(rd_resource_t* resource)
 	free(resource);
 }
 
-void rd_fcall_free(rd_fcall_t* call)
+void rd_fcall_free(rd_t* rd, rd_fcall_t* call)
 {
-	if (call->data.name) free(call->data.name);
-	free(call);
+	/* the function name is stored in the trace data name arena */
+	if (call->args) rd_fargs_free(call->args);
+	pool_release(&rd->call_pool, call);
 }
 
 void rd_ftrace_free(rd_ftrace_t* trace)
@@ -89,9 +91,9 @@ void rd_ftrace_free(rd_ftrace_t* trace)
 		}
 		free(trace->data.resolved_names);
 	}
-	/* Free the function call references, but don't touch
-	 * the function calls themselves. */
-	dlist_free(&trace->calls, (op_unary_t)free);
+	/* The function call references are allocated from the trace data
+	 * reference pool, so just reset the list. */
+	dlist_free(&trace->calls, NULL);
 	free(trace);
 }
 
@@ -131,8 +133,11 @@ void rd_attachment_free(rd_attachment_t* attachment)
  * Utility functions used internally by the records
  */
 
-/* the hash table size for backtrace and resource indices */
-#define HASH_SIZE      (1 << 16)
+/* the initial backtrace table size */
+#define HASH_SIZE      (1 << 12)
+
+/* the number of records per function call and reference pool chunk */
+#define POOL_CHUNK_COUNT   4096
 
 
 /*
@@ -159,21 +164,19 @@ static long bt_compare(const rd_ftrace_t* bt1, const rd_ftrace_t* bt2)
 /**
  * Calculates hash value for the backtrace.
  *
- * TODO: find better hash function.
+ * The hash value is calculated once and cached in the backtrace
+ * record, so the record can be located in the backtrace table even
+ * after its frames were trimmed.
  * @param[in] bt     the backtrace.
  * @return           the hash value.
  */
 static long bt_hash(rd_ftrace_t* bt)
 {
-	unsigned long hash = 0, i;
-	for (i = 0; i < bt->data.nframes; i++) {
-		unsigned long value = (unsigned long)bt->data.frames[i];
-		while (value) {
-			hash ^= value & ((1 << 16) - 1);
-			value >>= 3;
-		}
+	if (!bt->hash_valid) {
+		bt->hash = rd_ftrace_calc_hash(bt->data.frames, bt->data.nframes);
+		bt->hash_valid = true;
 	}
-	return hash;
+	return bt->hash;
 }
 
 /*
@@ -181,6 +184,28 @@ static long bt_hash(rd_ftrace_t* bt)
  */
 
 
+/**
+ * Frees function call arguments.
+ *
+ * @param[in] call   the function call.
+ * @return
+ */
+static long free_fcall_args(rd_fcall_t* call)
+{
+	if (call->args) rd_fargs_free(call->args);
+	return 0;
+}
+
+long rd_ftrace_calc_hash(const pointer_t* frames, unsigned long nframes)
+{
+	unsigned long long hash = nframes;
+	unsigned long i;
+	for (i = 0; i < nframes; i++) {
+		hash = hmap_mix(hash ^ frames[i]);
+	}
+	return (long)hash;
+}
+
 rd_t* rd_create()
 {
 	/* allocate the structure itself */
@@ -191,9 +216,12 @@ rd_t* rd_create()
 	dlist_init(&rd->minfo);
 	dlist_init(&rd->comments);
 	dlist_init(&rd->resources);
-	htable_init(&rd->ftraces, HASH_SIZE, (op_unary_t)bt_hash, (op_binary_t)bt_compare);
+	hmap_init(&rd->ftraces, HASH_SIZE, (op_unary_t)bt_hash, (op_binary_t)bt_compare);
 	dlist_init(&rd->mmaps);
 	dlist_init(&rd->files);
+	pool_init(&rd->call_pool, sizeof(rd_fcall_t), POOL_CHUNK_COUNT);
+	pool_init(&rd->ref_pool, sizeof(ref_node_t), POOL_CHUNK_COUNT);
+	strpool_init(&rd->names);
 	/* initialize single records */
 	rd->hshake = NULL;
 	rd->pinfo = NULL;
@@ -207,8 +235,14 @@ rd_t* rd_create()
 void rd_free(rd_t* data)
 {
 	/* frees the containers itself */
-	htable_free(&data->ftraces, (op_unary_t)rd_ftrace_free);
-	dlist_free(&data->calls, (op_unary_t)rd_fcall_free);
+	hmap_free(&data->ftraces, (op_unary_t)rd_ftrace_free);
+	/* the function call records, references and names are released
+	 * together with their pools, only the arguments must be freed */
+	dlist_foreach(&data->calls, (op_unary_t)free_fcall_args);
+	dlist_free(&data->calls, NULL);
+	pool_free(&data->call_pool);
+	pool_free(&data->ref_pool);
+	strpool_free(&data->names);
 	dlist_free(&data->contexts, (op_unary_t)rd_context_free);
 	dlist_free(&data->minfo, (op_unary_t)rd_minfo_free);
 	dlist_free(&data->comments, (op_unary_t)rd_comment_free);
@@ -250,26 +284,51 @@ void rd_fcall_remove(rd_t* rd, rd_fcall_t* call)
 	if (call->trace) {
 		if (call->ref) {
 			dlist_remove(&call->trace->calls, call->ref);
-			free(call->ref);
+			pool_release(&rd->ref_pool, call->ref);
 		}
 		call->trace->ref_count--;
 		if (!call->trace->ref_count) {
-			dlist_remove(call->trace->node.bucket, call->trace);
+			hmap_remove(&rd->ftraces, call->trace);
 			rd_ftrace_free(call->trace);
 		}
 	}
-	rd_fcall_free(call);
+	rd_fcall_free(rd, call);
+}
+
+rd_fcall_t* rd_fcall_create(rd_t* rd)
+{
+	rd_fcall_t* call = (rd_fcall_t*)pool_alloc(&rd->call_pool);
+	call->node.next = NULL;
+	call->node.prev = NULL;
+	call->trace = NULL;
+	call->ref = NULL;
+	call->args = NULL;
+	return call;
+}
+
+ref_node_t* rd_fcall_create_ref(rd_t* rd, rd_fcall_t* call)
+{
+	ref_node_t* node = (ref_node_t*)pool_alloc(&rd->ref_pool);
+	node->node.next = NULL;
+	node->node.prev = NULL;
+	node->ref = call;
+	return node;
+}
+
+char* rd_fcall_name(rd_t* rd, const char* name, size_t len)
+{
+	return strpool_add(&rd->names, name, len);
 }
 
 void rd_fcall_set_ftrace(rd_t* rd, rd_fcall_t* call, rd_ftrace_t* trace)
 {
 	/* Check if a matching backtrace has already been stored into
 	 * backtrace table. */
-	rd_ftrace_t* xtrace = (rd_ftrace_t*)htable_find(&rd->ftraces, (htable_node_t*)trace);
+	rd_ftrace_t* xtrace = (rd_ftrace_t*)hmap_find(&rd->ftraces, trace);
 	if (!xtrace) {
 		/* unregistered backtrace. store it */
-		htable_store(&rd->ftraces, (htable_node_t*)trace);
-	} else {
+		hmap_store(&rd->ftraces, trace);
+	} else if (xtrace != trace) {
 		/* registered backtrace. Use the one from backtrace table and
 		 * free the created backtrace. */
 		rd_ftrace_free(trace);
@@ -277,8 +336,7 @@ void rd_fcall_set_ftrace(rd_t* rd, rd_fcall_t* call, rd_ftrace_t* trace)
 	}
 	trace->ref_count++;
 	call->trace = trace;
-	ref_node_t* node =(ref_node_t*)dlist_create_node(sizeof(ref_node_t));
-	node->ref = call;
+	ref_node_t* node = rd_fcall_create_ref(rd, call);
 	call->ref = node;
 	dlist_add(&trace->calls, node);
 }
@@ -288,10 +346,10 @@ void rd_fcalls_set_ftrace(rd_t* rd, dlist_t* calls, rd_ftrace_t* trace)
 {
 	/* Check if a matching backtrace has already been stored into
 	 * backtrace table. */
-	rd_ftrace_t* xtrace = (rd_ftrace_t*)htable_find(&rd->ftraces, (htable_node_t*)trace);
+	rd_ftrace_t* xtrace = (rd_ftrace_t*)hmap_find(&rd->ftraces, trace);
 	if (!xtrace) {
 		/* unregistered backtrace. store it */
-		htable_store(&rd->ftraces, (htable_node_t*)trace);
+		hmap_store(&rd->ftraces, trace);
 	} else {
 		/* registered backtrace. Use the one from backtrace table and
 		 * free the created backtrace. */
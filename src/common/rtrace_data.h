@@ -38,8 +38,9 @@
 #include <stdbool.h>
 #include <sys/time.h>
 
-#include "htable.h"
+#include "hmap.h"
 #include "dlist.h"
+#include "pool.h"
 #include "sp_rtrace_proto.h"
 #include "library/sp_rtrace_defs.h"
 
@@ -220,13 +221,17 @@ typedef struct rd_fcall_t {
 
 #define RD_FCALL_RESOURCE(x) (((rd_fcall_t*)x)->res_type_flag == SP_RTRACE_FCALL_RFIELD_REF ? ((rd_fcall_t*)x)->res_type : NULL)
 
+struct rd_t;
+
 /**
  * Frees function call data.
  *
+ * The function call record is returned to the trace data call pool.
+ * @param[in] rd     the resource trace data.
  * @param[in] call   the data to free.
  * @return
  */
-void rd_fcall_free(rd_fcall_t* call);
+void rd_fcall_free(struct rd_t* rd, rd_fcall_t* call);
 
 
 /**
@@ -237,8 +242,10 @@ void rd_fcall_free(rd_fcall_t* call);
  * Used to store BT packet.
  */
 typedef struct rd_ftrace_t {
-	/* hash table support */
-	htable_node_t node;
+	/* the backtrace hash value */
+	long hash;
+	/* true if the hash value has been calculated */
+	bool hash_valid;
 
 	/* the reference counter */
 	int ref_count;
@@ -261,6 +268,19 @@ typedef struct rd_ftrace_t {
  */
 void rd_ftrace_free(rd_ftrace_t* trace);
 
+/**
+ * Calculates backtrace hash value.
+ *
+ * The backtrace table uses the same value for its records, so
+ * it can be calculated in advance and stored into the hash field
+ * of the backtrace record (or lookup template) together with the
+ * hash_valid flag.
+ * @param[in] frames   the backtrace frames.
+ * @param[in] nframes  the number of frames.
+ * @return             the hash value.
+ */
+long rd_ftrace_calc_hash(const pointer_t* frames, unsigned long nframes);
+
 /**
  * The function arguments record.
  *
@@ -365,7 +385,7 @@ typedef struct rd_t {
 	/* context registry */
 	dlist_t contexts;
 	/* function call backtraces */
-	htable_t ftraces;
+	hmap_t ftraces;
 	/* memory mapping information */
 	dlist_t mmaps;
 	/* handshake record */
@@ -384,6 +404,12 @@ typedef struct rd_t {
 	unsigned int filter;
 	/* list of attached files */
 	dlist_t files;
+	/* function call record storage */
+	pool_t call_pool;
+	/* backtrace function call reference storage */
+	pool_t ref_pool;
+	/* function name storage */
+	strpool_t names;
 } rd_t;
 
 
@@ -403,6 +429,38 @@ rd_t* rd_create(void);
 void rd_free(rd_t* data);
 
 
+/**
+ * Creates function call record.
+ *
+ * The record is allocated from the trace data call pool and
+ * released with rd_fcall_free() or together with the trace data.
+ * Only the list and reference fields are initialized.
+ * @param[in] rd   the resource trace data.
+ * @return         the created function call record.
+ */
+rd_fcall_t* rd_fcall_create(rd_t* rd);
+
+/**
+ * Creates backtrace reference to function call record.
+ *
+ * @param[in] rd     the resource trace data.
+ * @param[in] call   the referenced function call.
+ * @return           the created reference node.
+ */
+ref_node_t* rd_fcall_create_ref(rd_t* rd, rd_fcall_t* call);
+
+/**
+ * Stores function name.
+ *
+ * The function names are stored only once and released together
+ * with the trace data, so they must not be freed by the caller.
+ * @param[in] rd     the resource trace data.
+ * @param[in] name   the function name (not necessary zero terminated).
+ * @param[in] len    the function name length.
+ * @return           the stored function name.
+ */
+char* rd_fcall_name(rd_t* rd, const char* name, size_t len);
+
 /**
  * Removes function call data.
  *
@@ -420,8 +478,8 @@ void rd_fcall_remove(rd_t* rd, rd_fcall_t* call);
  *
  * This function checks if the backtrace is already registered in
  * backtrace table. If yes - the existing record is reused and the
- * @p trace is freed. Otherwise @p trace backtrace is stored into
- * backtrace table.
+ * @p trace is freed (unless @p trace is the registered record itself).
+ * Otherwise @p trace backtrace is stored into backtrace table.
  * @param[in] rd     the resource trace data.
  * @param[in] call   the function call.
  * @param[in] trace  the backtrace data.
@@ -65,6 +65,11 @@
 /* The binary protocol identification magic byte. All files starting with
  * This byte is treated by post-processor as binary files. */
 #define SP_RTRACE_PROTO_HS_ID			0xF0
+
+/* The compressed binary file identification byte (the first byte of
+ * gzip format stream). Files starting with this byte are decompressed
+ * by post-processor and parsed as binary files. */
+#define SP_RTRACE_PROTO_GZIP_ID			0x1F
 /*
  *  Protocol parsing helpers.
  *
@@ -0,0 +1,313 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace_db.h"
+
+/* the section element sizes */
+static const size_t section_element_size[TDB_SECTION_MAX] = {
+	[TDB_SECTION_STRINGS] = sizeof(char),
+	[TDB_SECTION_MODULES] = sizeof(tdb_module_t),
+	[TDB_SECTION_ATTACHMENTS] = sizeof(tdb_attachment_t),
+	[TDB_SECTION_CONTEXTS] = sizeof(tdb_context_t),
+	[TDB_SECTION_RESOURCES] = sizeof(tdb_resource_t),
+	[TDB_SECTION_MMAPS] = sizeof(tdb_mmap_t),
+	[TDB_SECTION_COMMENTS] = sizeof(tdb_comment_t),
+	[TDB_SECTION_CALL_INDEX] = sizeof(int32_t),
+	[TDB_SECTION_CALL_TYPE] = sizeof(uint32_t),
+	[TDB_SECTION_CALL_CONTEXT] = sizeof(uint32_t),
+	[TDB_SECTION_CALL_TIMESTAMP] = sizeof(uint32_t),
+	[TDB_SECTION_CALL_NAME] = sizeof(uint32_t),
+	[TDB_SECTION_CALL_RESOURCE] = sizeof(uint32_t),
+	[TDB_SECTION_CALL_RES_ID] = sizeof(pointer_t),
+	[TDB_SECTION_CALL_RES_SIZE] = sizeof(int32_t),
+	[TDB_SECTION_CALL_TRACE] = sizeof(uint32_t),
+	[TDB_SECTION_CALL_ARGS] = sizeof(uint32_t),
+	[TDB_SECTION_ARGS] = sizeof(tdb_arg_t),
+	[TDB_SECTION_TRACE_FRAMES] = sizeof(uint32_t),
+	[TDB_SECTION_FRAMES] = sizeof(pointer_t),
+	[TDB_SECTION_FRAME_NAMES] = sizeof(uint32_t),
+	[TDB_SECTION_TRACE_CALLS] = sizeof(uint32_t),
+	[TDB_SECTION_INDEX_TIME] = sizeof(uint32_t),
+	[TDB_SECTION_INDEX_CALL] = sizeof(uint32_t),
+	[TDB_SECTION_INDEX_RES_ID] = sizeof(uint32_t),
+	[TDB_SECTION_INDEX_TRACE] = sizeof(uint32_t),
+};
+
+/**
+ * Validates the database section layout.
+ *
+ * Only the section sizes are validated, so opening the database
+ * doesn't need to scan its data. The references between sections
+ * are validated when accessed.
+ * @param[in] db   the database.
+ * @return         true if the database is valid.
+ */
+static bool validate_sections(tdb_t* db)
+{
+	int i;
+	for (i = 0; i < TDB_SECTION_MAX; i++) {
+		const tdb_section_t* section = &db->header->sections[i];
+		if (section->offset & 7 || section->offset > db->size) return false;
+		if (section->count > (db->size - section->offset) / section_element_size[i]) return false;
+		db->sections[i] = db->data + section->offset;
+		db->counts[i] = section->count;
+	}
+	/* the string table must start with the empty (NULL) string and be zero terminated */
+	const char* strings = TDB_SECTION(db, TDB_SECTION_STRINGS, char);
+	if (!db->counts[TDB_SECTION_STRINGS] || strings[0] || strings[db->counts[TDB_SECTION_STRINGS] - 1]) return false;
+
+	db->ncalls = db->counts[TDB_SECTION_CALL_INDEX];
+	if (db->ncalls >= TDB_NONE) return false;
+	for (i = TDB_SECTION_CALL_TYPE; i <= TDB_SECTION_CALL_TRACE; i++) {
+		if (db->counts[i] != db->ncalls) return false;
+	}
+	if (db->counts[TDB_SECTION_CALL_ARGS] != db->ncalls + 1 ||
+			db->counts[TDB_SECTION_INDEX_TIME] != db->ncalls ||
+			db->counts[TDB_SECTION_INDEX_CALL] != db->ncalls ||
+			db->counts[TDB_SECTION_INDEX_RES_ID] != db->ncalls) return false;
+
+	if (!db->counts[TDB_SECTION_TRACE_FRAMES]) return false;
+	db->ntraces = db->counts[TDB_SECTION_TRACE_FRAMES] - 1;
+	if (db->counts[TDB_SECTION_TRACE_CALLS] != db->ntraces + 1 ||
+			db->counts[TDB_SECTION_FRAME_NAMES] != db->counts[TDB_SECTION_FRAMES]) return false;
+	return true;
+}
+
+/**
+ * Retrieves the range of rows from a row offset table.
+ *
+ * The row offset tables contain the first row of every record,
+ * followed by the total number of rows.
+ * @param[in] db        the database.
+ * @param[in] section   the row offset table section.
+ * @param[in] index     the record index.
+ * @param[in] nrows     the number of rows in the referenced section.
+ * @param[out] first    the first row.
+ * @return              the number of rows.
+ */
+static size_t get_row_range(const tdb_t* db, int section, size_t index, size_t nrows, size_t* first)
+{
+	const uint32_t* offsets = TDB_SECTION(db, section, uint32_t);
+	if (index + 1 >= db->counts[section]) return 0;
+	size_t start = offsets[index], end = offsets[index + 1];
+	if (start > end || end > nrows) return 0;
+	*first = start;
+	return end - start;
+}
+
+/*
+ * The call index search keys.
+ */
+
+static unsigned long key_timestamp(const tdb_t* db, uint32_t row)
+{
+	return TDB_SECTION(db, TDB_SECTION_CALL_TIMESTAMP, uint32_t)[row];
+}
+
+static unsigned long key_index(const tdb_t* db, uint32_t row)
+{
+	return TDB_SECTION(db, TDB_SECTION_CALL_INDEX, int32_t)[row];
+}
+
+static unsigned long key_res_id(const tdb_t* db, uint32_t row)
+{
+	return TDB_SECTION(db, TDB_SECTION_CALL_RES_ID, pointer_t)[row];
+}
+
+/**
+ * Finds the first call index row having key not less than the specified value.
+ *
+ * @param[in] db        the database.
+ * @param[in] index     the call index.
+ * @param[in] get_key   the call index key accessor.
+ * @param[in] value     the value to search.
+ * @param[in] adjust    the key adjustment, used to order signed keys.
+ * @return              the call index row.
+ */
+static size_t lower_bound(const tdb_t* db, const uint32_t* index, unsigned long (*get_key)(const tdb_t*, uint32_t),
+		unsigned long value, unsigned long adjust)
+{
+	size_t low = 0, high = db->ncalls;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		/* invalid rows stop the search */
+		if (index[mid] >= db->ncalls) return db->ncalls;
+		if (get_key(db, index[mid]) + adjust < value + adjust) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+/**
+ * Finds the calls having keys in the specified range.
+ *
+ * @param[in] db        the database.
+ * @param[in] section   the call index section.
+ * @param[in] get_key   the call index key accessor.
+ * @param[in] from      the range start.
+ * @param[in] to        the range end (inclusive).
+ * @param[in] adjust    the key adjustment, used to order signed keys.
+ * @param[out] rows     the matching call rows.
+ * @return              the number of matching calls.
+ */
+static size_t find_range(const tdb_t* db, int section, unsigned long (*get_key)(const tdb_t*, uint32_t),
+		unsigned long from, unsigned long to, unsigned long adjust, const uint32_t** rows)
+{
+	const uint32_t* index = TDB_SECTION(db, section, uint32_t);
+	*rows = index;
+	if (from + adjust > to + adjust) return 0;
+	size_t first = lower_bound(db, index, get_key, from, adjust);
+	size_t last = to + adjust == (unsigned long)-1 ? db->ncalls : lower_bound(db, index, get_key, to + 1, adjust);
+	*rows = index + first;
+	return last > first ? last - first : 0;
+}
+
+/*
+ * Public API implementation
+ */
+
+int tdb_open(tdb_t* db, const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return -errno;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		int rc = -errno;
+		close(fd);
+		return rc;
+	}
+	if ((size_t)st.st_size < sizeof(tdb_header_t)) {
+		close(fd);
+		return -EINVAL;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return -errno;
+
+	db->data = data;
+	db->size = st.st_size;
+	db->header = data;
+	if (memcmp(db->header->magic, TDB_MAGIC, sizeof(TDB_MAGIC)) || db->header->version != TDB_VERSION ||
+			db->header->pointer_size != sizeof(pointer_t) || !validate_sections(db)) {
+		tdb_close(db);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+void tdb_close(tdb_t* db)
+{
+	munmap((void*)(pointer_t)db->data, db->size);
+	db->data = NULL;
+	db->size = 0;
+	db->header = NULL;
+}
+
+const char* tdb_string(const tdb_t* db, uint32_t offset)
+{
+	if (offset == TDB_NULL || offset >= db->counts[TDB_SECTION_STRINGS]) return NULL;
+	return TDB_SECTION(db, TDB_SECTION_STRINGS, char) + offset;
+}
+
+bool tdb_get_call(const tdb_t* db, size_t row, sp_rtrace_fcall_t* call)
+{
+	if (row >= db->ncalls) return false;
+	call->index = TDB_SECTION(db, TDB_SECTION_CALL_INDEX, int32_t)[row];
+	call->type = TDB_SECTION(db, TDB_SECTION_CALL_TYPE, uint32_t)[row];
+	call->context = TDB_SECTION(db, TDB_SECTION_CALL_CONTEXT, uint32_t)[row];
+	call->timestamp = TDB_SECTION(db, TDB_SECTION_CALL_TIMESTAMP, uint32_t)[row];
+	const char* name = tdb_string(db, TDB_SECTION(db, TDB_SECTION_CALL_NAME, uint32_t)[row]);
+	call->name = (char*)(pointer_t)(name ? name : "");
+	call->res_id = TDB_SECTION(db, TDB_SECTION_CALL_RES_ID, pointer_t)[row];
+	call->res_size = TDB_SECTION(db, TDB_SECTION_CALL_RES_SIZE, int32_t)[row];
+
+	call->res_type = NULL;
+	call->res_type_flag = SP_RTRACE_FCALL_RFIELD_UNDEF;
+	uint32_t res = TDB_SECTION(db, TDB_SECTION_CALL_RESOURCE, uint32_t)[row];
+	if (res < db->counts[TDB_SECTION_RESOURCES]) {
+		const tdb_resource_t* resource = TDB_SECTION(db, TDB_SECTION_RESOURCES, tdb_resource_t) + res;
+		const char* type = tdb_string(db, resource->type);
+		if (!resource->hide && type) {
+			call->res_type = (void*)(pointer_t)type;
+			call->res_type_flag = SP_RTRACE_FCALL_RFIELD_NAME;
+		}
+	}
+	return true;
+}
+
+uint32_t tdb_get_call_trace(const tdb_t* db, size_t row)
+{
+	if (row >= db->ncalls) return TDB_NONE;
+	uint32_t trace = TDB_SECTION(db, TDB_SECTION_CALL_TRACE, uint32_t)[row];
+	return trace < db->ntraces ? trace : TDB_NONE;
+}
+
+size_t tdb_get_call_args(const tdb_t* db, size_t row, const tdb_arg_t** args)
+{
+	size_t first, count = get_row_range(db, TDB_SECTION_CALL_ARGS, row, db->counts[TDB_SECTION_ARGS], &first);
+	*args = TDB_SECTION(db, TDB_SECTION_ARGS, tdb_arg_t) + (count ? first : 0);
+	return count;
+}
+
+size_t tdb_get_trace(const tdb_t* db, uint32_t trace, const pointer_t** frames, const uint32_t** names)
+{
+	size_t first, count = get_row_range(db, TDB_SECTION_TRACE_FRAMES, trace, db->counts[TDB_SECTION_FRAMES], &first);
+	if (!count) first = 0;
+	*frames = TDB_SECTION(db, TDB_SECTION_FRAMES, pointer_t) + first;
+	*names = TDB_SECTION(db, TDB_SECTION_FRAME_NAMES, uint32_t) + first;
+	return count;
+}
+
+size_t tdb_find_by_time(const tdb_t* db, unsigned int from, unsigned int to, const uint32_t** rows)
+{
+	return find_range(db, TDB_SECTION_INDEX_TIME, key_timestamp, from, to, 0, rows);
+}
+
+size_t tdb_find_by_index(const tdb_t* db, int from, int to, const uint32_t** rows)
+{
+	/* the signed keys are ordered by shifting them into unsigned range */
+	unsigned long adjust = (unsigned long)1 << (sizeof(long) * 8 - 1);
+	return find_range(db, TDB_SECTION_INDEX_CALL, key_index, (long)from, (long)to, adjust, rows);
+}
+
+size_t tdb_find_by_res_id(const tdb_t* db, pointer_t res_id, const uint32_t** rows)
+{
+	return find_range(db, TDB_SECTION_INDEX_RES_ID, key_res_id, res_id, res_id, 0, rows);
+}
+
+size_t tdb_find_by_trace(const tdb_t* db, uint32_t trace, const uint32_t** rows)
+{
+	size_t first, count = get_row_range(db, TDB_SECTION_TRACE_CALLS, trace, db->counts[TDB_SECTION_INDEX_TRACE], &first);
+	*rows = TDB_SECTION(db, TDB_SECTION_INDEX_TRACE, uint32_t) + (count ? first : 0);
+	return count;
+}
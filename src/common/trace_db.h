@@ -0,0 +1,403 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+#ifndef TRACE_DB_H
+#define TRACE_DB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "library/sp_rtrace_defs.h"
+
+/**
+ * @file trace_db.h
+ *
+ * Trace database file format and reader.
+ *
+ * The trace database contains post-processed trace data in a form
+ * which can be mapped into memory and queried without parsing it.
+ * The function call fields are stored in separate columns, the
+ * backtraces are stored once and referenced by the calls. Every
+ * string is stored once in the string table and referenced by its
+ * offset. The call indexes list call rows ordered by timestamp,
+ * call index and resource identifier, so calls matching these values
+ * can be found with binary search. The calls sharing a backtrace are
+ * listed together in the backtrace index.
+ *
+ * The data is stored in the native byte order of the machine creating
+ * the database. All sections are aligned to 8 bytes.
+ */
+
+/* the database file identifier */
+#define TDB_MAGIC           "SPRTDB"
+
+/* the database format version */
+#define TDB_VERSION         1
+
+/* the string offset of NULL strings */
+#define TDB_NULL            0
+
+/* the row number used for missing references */
+#define TDB_NONE            ((uint32_t)-1)
+
+/**
+ * The database sections.
+ *
+ * The element type of each section is specified in the comments.
+ */
+enum tdb_section_index_t {
+	/* zero terminated strings (char), starting with empty string */
+	TDB_SECTION_STRINGS,
+	/* tracing modules (tdb_module_t) */
+	TDB_SECTION_MODULES,
+	/* attached files (tdb_attachment_t) */
+	TDB_SECTION_ATTACHMENTS,
+	/* context registry (tdb_context_t) */
+	TDB_SECTION_CONTEXTS,
+	/* resource registry (tdb_resource_t) */
+	TDB_SECTION_RESOURCES,
+	/* memory mappings (tdb_mmap_t) */
+	TDB_SECTION_MMAPS,
+	/* comments (tdb_comment_t) */
+	TDB_SECTION_COMMENTS,
+
+	/* call index (int32_t) */
+	TDB_SECTION_CALL_INDEX,
+	/* call type (uint32_t) */
+	TDB_SECTION_CALL_TYPE,
+	/* call context mask (uint32_t) */
+	TDB_SECTION_CALL_CONTEXT,
+	/* call timestamp (uint32_t) */
+	TDB_SECTION_CALL_TIMESTAMP,
+	/* call name string offset (uint32_t) */
+	TDB_SECTION_CALL_NAME,
+	/* call resource row or TDB_NONE (uint32_t) */
+	TDB_SECTION_CALL_RESOURCE,
+	/* call resource identifier (pointer_t) */
+	TDB_SECTION_CALL_RES_ID,
+	/* call resource size (int32_t) */
+	TDB_SECTION_CALL_RES_SIZE,
+	/* call backtrace row or TDB_NONE (uint32_t) */
+	TDB_SECTION_CALL_TRACE,
+	/* the first argument row of every call, followed by the
+	 * total number of arguments (uint32_t) */
+	TDB_SECTION_CALL_ARGS,
+	/* call arguments (tdb_arg_t) */
+	TDB_SECTION_ARGS,
+
+	/* the first frame row of every backtrace, followed by the
+	 * total number of frames (uint32_t) */
+	TDB_SECTION_TRACE_FRAMES,
+	/* backtrace frame addresses (pointer_t) */
+	TDB_SECTION_FRAMES,
+	/* resolved frame name string offsets (uint32_t) */
+	TDB_SECTION_FRAME_NAMES,
+	/* the first backtrace index row of every backtrace, followed by
+	 * the total number of rows in backtrace index (uint32_t) */
+	TDB_SECTION_TRACE_CALLS,
+
+	/* call rows ordered by timestamp (uint32_t) */
+	TDB_SECTION_INDEX_TIME,
+	/* call rows ordered by call index (uint32_t) */
+	TDB_SECTION_INDEX_CALL,
+	/* call rows ordered by resource identifier (uint32_t) */
+	TDB_SECTION_INDEX_RES_ID,
+	/* call rows grouped by backtrace (uint32_t) */
+	TDB_SECTION_INDEX_TRACE,
+
+	TDB_SECTION_MAX
+};
+
+/**
+ * The section location.
+ */
+typedef struct tdb_section_t {
+	/* the section offset in file */
+	uint64_t offset;
+	/* the number of elements in section */
+	uint64_t count;
+} tdb_section_t;
+
+/**
+ * The heap status information.
+ */
+typedef struct tdb_heap_t {
+	pointer_t heap_bottom;
+	pointer_t heap_top;
+	pointer_t lowest_block;
+	pointer_t highest_block;
+	int32_t arena;
+	int32_t ordblks;
+	int32_t smblks;
+	int32_t hblks;
+	int32_t hblkhd;
+	int32_t usmblks;
+	int32_t fsmblks;
+	int32_t uordblks;
+	int32_t fordblks;
+	int32_t keepcost;
+} tdb_heap_t;
+
+/**
+ * The database file header.
+ */
+typedef struct tdb_header_t {
+	/* the TDB_MAGIC identifier */
+	char magic[8];
+	/* the format version */
+	uint32_t version;
+	/* the size of pointer_t type */
+	uint32_t pointer_size;
+
+	/* the traced process identifier */
+	uint32_t pid;
+	/* the backtrace depth, -1 if not set */
+	int32_t backtrace_depth;
+	/* the trace timestamp */
+	int64_t timestamp_sec;
+	int64_t timestamp_usec;
+	/* the mask of applied filters (see filter_mask_t enum) */
+	uint32_t filter;
+	/* the architecture, process name and trace origin string offsets */
+	uint32_t arch;
+	uint32_t process;
+	uint32_t origin;
+	/* non zero if the heap status information is present */
+	uint32_t has_heap;
+	/* non zero if the leak summary is reported after function calls */
+	uint32_t leak_summary;
+	/* the heap status information */
+	tdb_heap_t heap;
+
+	/* the section locations */
+	tdb_section_t sections[TDB_SECTION_MAX];
+} tdb_header_t;
+
+/**
+ * Tracing module information.
+ */
+typedef struct tdb_module_t {
+	uint32_t id;
+	uint32_t vmajor;
+	uint32_t vminor;
+	uint32_t name;
+} tdb_module_t;
+
+/**
+ * Attached file information.
+ */
+typedef struct tdb_attachment_t {
+	uint32_t name;
+	uint32_t path;
+} tdb_attachment_t;
+
+/**
+ * Context registry record.
+ */
+typedef struct tdb_context_t {
+	uint32_t id;
+	uint32_t name;
+} tdb_context_t;
+
+/**
+ * Resource registry record.
+ */
+typedef struct tdb_resource_t {
+	uint32_t id;
+	uint32_t flags;
+	/* non zero if the resource type is hidden in call records */
+	uint32_t hide;
+	uint32_t type;
+	uint32_t desc;
+	uint32_t reserved;
+} tdb_resource_t;
+
+/**
+ * Memory mapping record.
+ */
+typedef struct tdb_mmap_t {
+	pointer_t from;
+	pointer_t to;
+	pointer_t bias;
+	uint32_t module;
+	uint32_t build_id;
+} tdb_mmap_t;
+
+/**
+ * Comment record.
+ */
+typedef struct tdb_comment_t {
+	/* the index of the preceding function call */
+	int32_t index;
+	uint32_t text;
+} tdb_comment_t;
+
+/**
+ * Function call argument record.
+ */
+typedef struct tdb_arg_t {
+	uint32_t name;
+	uint32_t value;
+} tdb_arg_t;
+
+/**
+ * The opened trace database.
+ */
+typedef struct tdb_t {
+	/* the mapped file data */
+	const char* data;
+	/* the mapped file size */
+	size_t size;
+	/* the file header */
+	const tdb_header_t* header;
+	/* the section data */
+	const void* sections[TDB_SECTION_MAX];
+	/* the number of elements in sections */
+	size_t counts[TDB_SECTION_MAX];
+	/* the number of function calls */
+	size_t ncalls;
+	/* the number of backtraces */
+	size_t ntraces;
+} tdb_t;
+
+/**
+ * Retrieves the section data.
+ *
+ * @param[in] db       the database.
+ * @param[in] section  the section index (see tdb_section_index_t enum).
+ * @param[in] type     the section element type.
+ */
+#define TDB_SECTION(db, section, type)    ((const type*)(db)->sections[section])
+
+/**
+ * Opens trace database.
+ *
+ * The database file is mapped into memory and its structure validated.
+ * @param[out] db    the database.
+ * @param[in] path   the database file path.
+ * @return           0 - success, -errno - failure (-EINVAL if the file
+ *                   is not a valid trace database).
+ */
+int tdb_open(tdb_t* db, const char* path);
+
+/**
+ * Closes trace database.
+ *
+ * @param[in] db   the database.
+ */
+void tdb_close(tdb_t* db);
+
+/**
+ * Retrieves string from the string table.
+ *
+ * @param[in] db      the database.
+ * @param[in] offset  the string offset.
+ * @return            the string or NULL for TDB_NULL and invalid offsets.
+ */
+const char* tdb_string(const tdb_t* db, uint32_t offset);
+
+/**
+ * Retrieves function call data.
+ *
+ * The resource type name is set only for visible resource types.
+ * @param[in] db     the database.
+ * @param[in] row    the call row.
+ * @param[out] call  the function call data.
+ * @return           true if the row is valid.
+ */
+bool tdb_get_call(const tdb_t* db, size_t row, sp_rtrace_fcall_t* call);
+
+/**
+ * Retrieves function call backtrace row.
+ *
+ * @param[in] db     the database.
+ * @param[in] row    the call row.
+ * @return           the backtrace row or TDB_NONE.
+ */
+uint32_t tdb_get_call_trace(const tdb_t* db, size_t row);
+
+/**
+ * Retrieves function call arguments.
+ *
+ * @param[in] db     the database.
+ * @param[in] row    the call row.
+ * @param[out] args  the call arguments.
+ * @return           the number of arguments.
+ */
+size_t tdb_get_call_args(const tdb_t* db, size_t row, const tdb_arg_t** args);
+
+/**
+ * Retrieves backtrace frames.
+ *
+ * @param[in] db       the database.
+ * @param[in] trace    the backtrace row.
+ * @param[out] frames  the frame addresses.
+ * @param[out] names   the resolved frame name string offsets.
+ * @return             the number of frames.
+ */
+size_t tdb_get_trace(const tdb_t* db, uint32_t trace, const pointer_t** frames, const uint32_t** names);
+
+/**
+ * Finds calls with timestamps in the specified range.
+ *
+ * @param[in] db     the database.
+ * @param[in] from   the range start.
+ * @param[in] to     the range end (inclusive).
+ * @param[out] rows  the matching call rows, ordered by timestamp.
+ * @return           the number of matching calls.
+ */
+size_t tdb_find_by_time(const tdb_t* db, unsigned int from, unsigned int to, const uint32_t** rows);
+
+/**
+ * Finds calls with call indexes in the specified range.
+ *
+ * @param[in] db     the database.
+ * @param[in] from   the range start.
+ * @param[in] to     the range end (inclusive).
+ * @param[out] rows  the matching call rows, ordered by call index.
+ * @return           the number of matching calls.
+ */
+size_t tdb_find_by_index(const tdb_t* db, int from, int to, const uint32_t** rows);
+
+/**
+ * Finds calls allocating or freeing the specified resource.
+ *
+ * @param[in] db      the database.
+ * @param[in] res_id  the resource identifier.
+ * @param[out] rows   the matching call rows.
+ * @return            the number of matching calls.
+ */
+size_t tdb_find_by_res_id(const tdb_t* db, pointer_t res_id, const uint32_t** rows);
+
+/**
+ * Finds calls having the specified backtrace.
+ *
+ * @param[in] db      the database.
+ * @param[in] trace   the backtrace row.
+ * @param[out] rows   the matching call rows.
+ * @return            the number of matching calls.
+ */
+size_t tdb_find_by_trace(const tdb_t* db, uint32_t trace, const uint32_t** rows);
+
+#endif
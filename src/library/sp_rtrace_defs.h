@@ -147,6 +147,9 @@ typedef struct sp_rtrace_header_t {
 	char* fields[SP_RTRACE_HEADER_MAX];
 } sp_rtrace_header_t;
 
+/* the maximum ELF build-id size in bytes */
+#define SP_RTRACE_BUILD_ID_SIZE     64
+
 /**
  * Memory mapping data.
  */
@@ -154,6 +157,11 @@ typedef struct sp_rtrace_mmap_t {
 	pointer_t from;
 	pointer_t to;
 	char* module;
+	/* the module ELF build-id in hexadecimal format, NULL if unknown */
+	char* build_id;
+	/* the module load bias (the difference between run-time and
+	 * link-time addresses) */
+	pointer_t bias;
 } sp_rtrace_mmap_t;
 
 
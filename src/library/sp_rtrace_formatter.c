@@ -24,9 +24,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <stdarg.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <errno.h>
 #include <limits.h>
 
@@ -35,6 +38,16 @@
 #include "common/sp_rtrace_proto.h"
 #include "common/header.h"
 #include "common/rtrace_data.h"
+#include "common/utils.h"
+
+/* the formatter output buffer size */
+#define FORMATTER_BUFFER_SIZE   (256 * 1024)
+
+/* the output buffer size used by the sp_rtrace_print_* wrapper functions */
+#define PRINT_BUFFER_SIZE       4096
+
+/* the maximum number of bytes reserved for a single numeric field */
+#define FIELD_SIZE_MAX          32
 
 const char* sp_rtrace_resource_flags_text[SP_RTRACE_RESOURCE_FLAGS_MAX] = {
 		"refcount",
@@ -52,7 +65,259 @@ const char* header_fields[SP_RTRACE_HEADER_MAX] = {
 		"origin",
 };
 
-int sp_rtrace_print_header(FILE* fp, const struct sp_rtrace_header_t* header)
+/**
+ * The buffered text formatter.
+ *
+ * The records are formatted into the output buffer, which is written
+ * either into the output file descriptor or, if the descriptor is -1,
+ * into the output stream.
+ */
+struct sp_rtrace_formatter_t {
+	/* the output file descriptor */
+	int fd;
+	/* the output stream, used when the file descriptor is not set */
+	FILE* fp;
+	/* the output buffer */
+	char* buffer;
+	/* the buffer write position */
+	char* head;
+	/* the buffer end */
+	char* tail;
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * Initializes formatter.
+ *
+ * @param[in] fmt     the formatter to initialize.
+ * @param[in] fd      the output file descriptor.
+ * @param[in] fp      the output stream.
+ * @param[in] buffer  the output buffer.
+ * @param[in] size    the output buffer size.
+ */
+static void formatter_init(sp_rtrace_formatter_t* fmt, int fd, FILE* fp, char* buffer, size_t size)
+{
+	fmt->fd = fd;
+	fmt->fp = fp;
+	fmt->buffer = buffer;
+	fmt->head = buffer;
+	fmt->tail = buffer + size;
+}
+
+/**
+ * Writes the data blocks into the formatter output.
+ *
+ * @param[in] fmt   the formatter.
+ * @param[in] iov   the data blocks.
+ * @param[in] n     the number of data blocks.
+ * @return          0 - success, -errno - failure.
+ */
+static int formatter_write(sp_rtrace_formatter_t* fmt, struct iovec* iov, int n)
+{
+	if (fmt->fd == -1) {
+		int i;
+		for (i = 0; i < n; i++) {
+			if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, fmt->fp) < iov[i].iov_len) return -errno;
+		}
+		return 0;
+	}
+	while (n) {
+		ssize_t size = writev(fmt->fd, iov, n);
+		if (size == -1) {
+			if (errno == EINTR) continue;
+			return -errno;
+		}
+		/* skip the written data, as pipes can accept only part of it */
+		while (n && (size_t)size >= iov->iov_len) {
+			size -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n) {
+			iov->iov_base = (char*)iov->iov_base + size;
+			iov->iov_len -= size;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Writes the buffered data followed by the specified data block.
+ *
+ * @param[in] fmt    the formatter.
+ * @param[in] data   the data to write after the buffered data.
+ * @param[in] size   the data size.
+ * @return           0 - success, -errno - failure.
+ */
+static int formatter_flush_data(sp_rtrace_formatter_t* fmt, const char* data, size_t size)
+{
+	struct iovec iov[2];
+	int n = 0;
+	if (fmt->head != fmt->buffer) {
+		iov[n].iov_base = fmt->buffer;
+		iov[n++].iov_len = fmt->head - fmt->buffer;
+	}
+	if (size) {
+		iov[n].iov_base = (void*)(pointer_t)data;
+		iov[n++].iov_len = size;
+	}
+	fmt->head = fmt->buffer;
+	return formatter_write(fmt, iov, n);
+}
+
+/**
+ * Ensures that the output buffer has enough space for the specified data.
+ *
+ * @param[in] fmt    the formatter.
+ * @param[in] size   the required size, not exceeding FIELD_SIZE_MAX.
+ * @return           0 - success, -errno - failure.
+ */
+static inline int formatter_reserve(sp_rtrace_formatter_t* fmt, size_t size)
+{
+	if ((size_t)(fmt->tail - fmt->head) >= size) return 0;
+	return formatter_flush_data(fmt, NULL, 0);
+}
+
+/**
+ * Appends data to the output buffer.
+ *
+ * Data not fitting into the buffer is written together with the
+ * buffered data, without copying it.
+ * @param[in] fmt    the formatter.
+ * @param[in] data   the data to append.
+ * @param[in] size   the data size.
+ * @return           0 - success, -errno - failure.
+ */
+static inline int formatter_put(sp_rtrace_formatter_t* fmt, const char* data, size_t size)
+{
+	if ((size_t)(fmt->tail - fmt->head) < size) return formatter_flush_data(fmt, data, size);
+	memcpy(fmt->head, data, size);
+	fmt->head += size;
+	return 0;
+}
+
+/**
+ * Appends zero terminated string to the output buffer.
+ *
+ * NULL strings are written as (null), like the printf based output did.
+ */
+static inline int formatter_puts(sp_rtrace_formatter_t* fmt, const char* str)
+{
+	if (!str) str = "(null)";
+	return formatter_put(fmt, str, strlen(str));
+}
+
+/**
+ * Writes value in hexadecimal format (like %lx).
+ *
+ * @param[in] ptr    the output position.
+ * @param[in] value  the value to write.
+ * @return           the position after the written value.
+ */
+static char* put_hex(char* ptr, unsigned long value)
+{
+	int ndigits = value ? (sizeof(value) * 8 - __builtin_clzl(value) + 3) >> 2 : 1;
+	char* end = ptr + ndigits;
+	do {
+		*--end = hex_digits[value & 0xf];
+		value >>= 4;
+	} while (end != ptr);
+	return ptr + ndigits;
+}
+
+/**
+ * Writes value in decimal format, zero padded to the specified width (like %0*lu).
+ *
+ * @param[in] ptr    the output position.
+ * @param[in] value  the value to write.
+ * @param[in] width  the minimum number of digits.
+ * @return           the position after the written value.
+ */
+static char* put_udec(char* ptr, unsigned long value, int width)
+{
+	char digits[FIELD_SIZE_MAX], *end = digits + sizeof(digits), *start = end;
+	do {
+		*--start = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (end - start < width) *--start = '0';
+	memcpy(ptr, start, end - start);
+	return ptr + (end - start);
+}
+
+/**
+ * Writes signed value in decimal format (like %ld).
+ */
+static char* put_dec(char* ptr, long value)
+{
+	if (value < 0) {
+		*ptr++ = '-';
+		return put_udec(ptr, -(unsigned long)value, 1);
+	}
+	return put_udec(ptr, value, 1);
+}
+
+/**
+ * Formats comment with the specified argument list.
+ *
+ * @param[in] fmt     the formatter.
+ * @param[in] format  the comment format template.
+ * @param[in] args    the template data.
+ * @return            0 - success, -errno - failure
+ */
+static int format_comment(sp_rtrace_formatter_t* fmt, const char* format, va_list args)
+{
+	va_list args_copy;
+	va_copy(args_copy, args);
+	size_t space = fmt->tail - fmt->head;
+	int size = vsnprintf(fmt->head, space, format, args_copy);
+	va_end(args_copy);
+	if (size < 0) return -EINVAL;
+	if ((size_t)size < space) {
+		fmt->head += size;
+		return 0;
+	}
+	int rc = formatter_flush_data(fmt, NULL, 0);
+	if (rc) return rc;
+	space = fmt->tail - fmt->head;
+	if ((size_t)size < space) {
+		fmt->head += vsnprintf(fmt->head, space, format, args);
+		return 0;
+	}
+	/* the comment doesn't fit into the buffer, format it separately */
+	char* text = (char*)malloc_a(size + 1);
+	vsnprintf(text, size + 1, format, args);
+	rc = formatter_flush_data(fmt, text, size);
+	free(text);
+	return rc;
+}
+
+/*
+ * Formatter API implementation
+ */
+
+sp_rtrace_formatter_t* sp_rtrace_formatter_create(int fd)
+{
+	sp_rtrace_formatter_t* fmt = (sp_rtrace_formatter_t*)malloc_a(sizeof(sp_rtrace_formatter_t) + FORMATTER_BUFFER_SIZE);
+	formatter_init(fmt, fd, NULL, (char*)(fmt + 1), FORMATTER_BUFFER_SIZE);
+	return fmt;
+}
+
+int sp_rtrace_formatter_flush(sp_rtrace_formatter_t* fmt)
+{
+	if (fmt->head == fmt->buffer) return 0;
+	return formatter_flush_data(fmt, NULL, 0);
+}
+
+int sp_rtrace_formatter_destroy(sp_rtrace_formatter_t* fmt)
+{
+	int rc = sp_rtrace_formatter_flush(fmt);
+	free(fmt);
+	return rc;
+}
+
+int sp_rtrace_format_header(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_header_t* header)
 {
 	char timestamp_s[32], version_s[32];
 	if (!header->fields[SP_RTRACE_HEADER_TIMESTAMP]) {
@@ -64,9 +329,8 @@ int sp_rtrace_print_header(FILE* fp, const struct sp_rtrace_header_t* header)
 	}
 	snprintf(version_s, sizeof(version_s), "%d.%d", SP_RTRACE_PROTO_VERSION_MAJOR, SP_RTRACE_PROTO_VERSION_MINOR);
 
-	char buffer[PATH_MAX];
-	int size = 0, i;
-	for (i = 0; i < SP_RTRACE_HEADER_MAX; i++) {
+	int rc = 0, i;
+	for (i = 0; i < SP_RTRACE_HEADER_MAX && !rc; i++) {
 		const char* value = header->fields[i];
 		switch (i) {
 			case SP_RTRACE_HEADER_TIMESTAMP:
@@ -79,30 +343,60 @@ int sp_rtrace_print_header(FILE* fp, const struct sp_rtrace_header_t* header)
 				break;
 		}
 		if (value) {
-			size += snprintf(buffer + size, PATH_MAX - size, "%s=%s, ", header_fields[i], value);
+			if ( (rc = formatter_puts(fmt, header_fields[i])) == 0 &&
+					(rc = formatter_put(fmt, "=", 1)) == 0 &&
+					(rc = formatter_puts(fmt, value)) == 0 ) {
+				rc = formatter_put(fmt, ", ", 2);
+			}
 		}
 	}
-	buffer[size++] = '\n';
-	buffer[size] = '\0';
-	if (fputs(buffer, fp) == EOF) return -errno;
-	return 0;
+	if (rc) return rc;
+	return formatter_put(fmt, "\n", 1);
 }
 
 
-int sp_rtrace_print_mmap(FILE* fp, const struct sp_rtrace_mmap_t* mmap)
+int sp_rtrace_format_mmap(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_mmap_t* mmap)
 {
-	if (fprintf(fp, ": %s => 0x%lx-0x%lx\n", mmap->module, mmap->from, mmap->to) == 0) return -errno;
-	return 0;
+	int rc;
+	if ( (rc = formatter_put(fmt, ": ", 2)) || (rc = formatter_puts(fmt, mmap->module)) ||
+			(rc = formatter_reserve(fmt, FIELD_SIZE_MAX * 2)) ) return rc;
+	char* ptr = fmt->head;
+	*ptr++ = ' ';
+	*ptr++ = '=';
+	*ptr++ = '>';
+	*ptr++ = ' ';
+	*ptr++ = '0';
+	*ptr++ = 'x';
+	ptr = put_hex(ptr, mmap->from);
+	*ptr++ = '-';
+	*ptr++ = '0';
+	*ptr++ = 'x';
+	ptr = put_hex(ptr, mmap->to);
+	fmt->head = ptr;
+	if (mmap->build_id) {
+		if ( (rc = formatter_put(fmt, " build-id=", 10)) || (rc = formatter_puts(fmt, mmap->build_id)) ||
+				(rc = formatter_reserve(fmt, FIELD_SIZE_MAX)) ) return rc;
+		ptr = fmt->head;
+		memcpy(ptr, " bias=0x", 8);
+		ptr = put_hex(ptr + 8, mmap->bias);
+		fmt->head = ptr;
+	}
+	return formatter_put(fmt, "\n", 1);
 }
 
 
-int sp_rtrace_print_call(FILE* fp, const struct sp_rtrace_fcall_t* call)
+int sp_rtrace_format_call(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_fcall_t* call)
 {
-	char buffer[2048], *ptr = buffer;
+	int rc;
+	if ( (rc = formatter_reserve(fmt, FIELD_SIZE_MAX * 2)) ) return rc;
 
-	ptr += sprintf(ptr, "%d. ", call->index);
+	char* ptr = put_dec(fmt->head, call->index);
+	*ptr++ = '.';
+	*ptr++ = ' ';
 	if (call->context) {
-		ptr += sprintf(ptr, "@%x ", (int)call->context);
+		*ptr++ = '@';
+		ptr = put_hex(ptr, call->context);
+		*ptr++ = ' ';
 	}
 	unsigned int timestamp = call->timestamp;
 	if (timestamp == (unsigned int)-1) {
@@ -118,9 +412,19 @@ int sp_rtrace_print_call(FILE* fp, const struct sp_rtrace_fcall_t* call)
 		usecs %= 1000 * 60;
 		int seconds = usecs / 1000;
 		usecs %= 1000;
-		ptr += sprintf(ptr, "[%02d:%02d:%02d.%03d] ", hours, minutes, seconds, usecs);
+		*ptr++ = '[';
+		ptr = put_udec(ptr, hours, 2);
+		*ptr++ = ':';
+		ptr = put_udec(ptr, minutes, 2);
+		*ptr++ = ':';
+		ptr = put_udec(ptr, seconds, 2);
+		*ptr++ = '.';
+		ptr = put_udec(ptr, usecs, 3);
+		*ptr++ = ']';
+		*ptr++ = ' ';
 	}
-	ptr += sprintf(ptr, "%s", call->name);
+	fmt->head = ptr;
+	if ( (rc = formatter_puts(fmt, call->name)) ) return rc;
 
 	/* append resource type for multi resource traces */
 	const char* res_name = NULL;
@@ -138,83 +442,195 @@ int sp_rtrace_print_call(FILE* fp, const struct sp_rtrace_fcall_t* call)
 		}
 	}
 	if (res_name) {
-		ptr += sprintf(ptr, "<%s>", res_name);
+		if ( (rc = formatter_put(fmt, "<", 1)) || (rc = formatter_puts(fmt, res_name)) ||
+				(rc = formatter_put(fmt, ">", 1)) ) return rc;
 	}
 
+	if ( (rc = formatter_reserve(fmt, FIELD_SIZE_MAX * 2)) ) return rc;
+	ptr = fmt->head;
+	*ptr++ = '(';
 	if (call->type == SP_RTRACE_FTYPE_ALLOC) {
-		ptr += sprintf(ptr, "(%d) = 0x%lx", call->res_size, call->res_id);
+		ptr = put_dec(ptr, call->res_size);
+		memcpy(ptr, ") = 0x", 6);
+		ptr = put_hex(ptr + 6, call->res_id);
 	}
 	else {
-		ptr += sprintf(ptr, "(0x%lx)", call->res_id);
+		*ptr++ = '0';
+		*ptr++ = 'x';
+		ptr = put_hex(ptr, call->res_id);
+		*ptr++ = ')';
 	}
 	*ptr++ = '\n';
-	if (fwrite(buffer, 1, ptr - buffer, fp) < (size_t)(ptr - buffer)) return -errno;
+	fmt->head = ptr;
 	return 0;
 }
 
 
-int sp_rtrace_print_trace(FILE* fp, const struct sp_rtrace_ftrace_t* trace)
+int sp_rtrace_format_trace_step(sp_rtrace_formatter_t* fmt, pointer_t addr, const char* resolved)
 {
-	int i, size = trace->nframes;
-	char buffer[PATH_MAX];
-	for (i = 0; i < size; i++) {
-		char* ptr = buffer;
-		ptr += sprintf(ptr, "\t0x%lx", trace->frames[i]);
-		if (trace->resolved_names && trace->resolved_names[i]) {
-			ptr += sprintf(ptr, " %s", trace->resolved_names[i]);
-		}
-		*ptr++ = '\n';
-		if (fwrite(buffer, 1, ptr - buffer, fp) < (size_t)(ptr - buffer)) return -errno;
+	int rc;
+	if ( (rc = formatter_reserve(fmt, FIELD_SIZE_MAX)) ) return rc;
+	char* ptr = fmt->head;
+	*ptr++ = '\t';
+	*ptr++ = '0';
+	*ptr++ = 'x';
+	ptr = put_hex(ptr, addr);
+	if (resolved) {
+		*ptr++ = ' ';
+		fmt->head = ptr;
+		if ( (rc = formatter_puts(fmt, resolved)) || (rc = formatter_reserve(fmt, 1)) ) return rc;
+		ptr = fmt->head;
 	}
-	if (fputc('\n', fp) == EOF) return -errno;
+	*ptr++ = '\n';
+	fmt->head = ptr;
 	return 0;
 }
 
 
-int sp_rtrace_print_trace_step(FILE* fp, void* addr, const char* resolved)
+int sp_rtrace_format_trace(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_ftrace_t* trace)
 {
-	int rc = 0;
-	if (resolved) {
-		rc = fprintf(fp, "\t0x%lx %s\n", (pointer_t)addr, resolved);
-	}
-	else {
-		rc = fprintf(fp, "\t0x%lx\n", (pointer_t)addr);
-	}
-	if (rc == 0) {
-		return -errno;
+	unsigned long i;
+	int rc;
+	for (i = 0; i < trace->nframes; i++) {
+		const char* resolved = trace->resolved_names ? trace->resolved_names[i] : NULL;
+		if ( (rc = sp_rtrace_format_trace_step(fmt, trace->frames[i], resolved)) ) return rc;
 	}
-	return 0;
+	return formatter_put(fmt, "\n", 1);
 }
 
 
-int sp_rtrace_print_context(FILE* fp, const struct sp_rtrace_context_t* context)
+int sp_rtrace_format_context(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_context_t* context)
 {
-	if (fprintf(fp, "@ %x : %s\n", (int)context->id, context->name) == 0) return -errno;
-	return 0;
+	int rc;
+	if ( (rc = formatter_reserve(fmt, FIELD_SIZE_MAX)) ) return rc;
+	char* ptr = fmt->head;
+	*ptr++ = '@';
+	*ptr++ = ' ';
+	ptr = put_hex(ptr, (unsigned int)context->id);
+	*ptr++ = ' ';
+	*ptr++ = ':';
+	*ptr++ = ' ';
+	fmt->head = ptr;
+	if ( (rc = formatter_puts(fmt, context->name)) ) return rc;
+	return formatter_put(fmt, "\n", 1);
 }
 
 
-int sp_rtrace_print_resource(FILE* fp, const struct sp_rtrace_resource_t* resource)
+int sp_rtrace_format_resource(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_resource_t* resource)
 {
-	char buffer[PATH_MAX], *ptr = buffer;
-	ptr += sprintf(ptr, "<%x> : %s (%s)", 1 << ((int)resource->id - 1), resource->type, resource->desc);
+	int rc;
+	if ( (rc = formatter_reserve(fmt, FIELD_SIZE_MAX)) ) return rc;
+	char* ptr = fmt->head;
+	*ptr++ = '<';
+	ptr = put_hex(ptr, 1u << ((int)resource->id - 1));
+	*ptr++ = '>';
+	*ptr++ = ' ';
+	*ptr++ = ':';
+	*ptr++ = ' ';
+	fmt->head = ptr;
+	if ( (rc = formatter_puts(fmt, resource->type)) || (rc = formatter_put(fmt, " (", 2)) ||
+			(rc = formatter_puts(fmt, resource->desc)) || (rc = formatter_put(fmt, ")", 1)) ) return rc;
 	if (resource->flags) {
-		*ptr++ = ' ';
-		*ptr++ = '[';
+		if ( (rc = formatter_put(fmt, " [", 2)) ) return rc;
 		unsigned int nflag = 0, flag;
 		while ( (flag = 1 << nflag) <= SP_RTRACE_RESOURCE_LAST_FLAG) {
-			if (nflag) *ptr++ = '|';
-			ptr += sprintf(ptr, "%s", sp_rtrace_resource_flags_text[nflag++]);
+			if (nflag && (rc = formatter_put(fmt, "|", 1))) return rc;
+			if ( (rc = formatter_puts(fmt, sp_rtrace_resource_flags_text[nflag++])) ) return rc;
 		}
-		*ptr++ = ']';
+		if ( (rc = formatter_put(fmt, "]", 1)) ) return rc;
+	}
+	return formatter_put(fmt, "\n", 1);
+}
+
+
+int sp_rtrace_format_comment(sp_rtrace_formatter_t* fmt, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int rc = format_comment(fmt, format, args);
+	va_end(args);
+	return rc;
+}
+
+
+int sp_rtrace_format_args(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_farg_t* args)
+{
+	int rc;
+	while (args->name) {
+		if ( (rc = formatter_put(fmt, "\t$", 2)) || (rc = formatter_puts(fmt, args->name)) ||
+				(rc = formatter_put(fmt, " = ", 3)) || (rc = formatter_puts(fmt, args->value)) ||
+				(rc = formatter_put(fmt, "\n", 1)) ) return rc;
+		args++;
 	}
-	*ptr++ = '\n';
-	*ptr = '\0';
-	if (fwrite(buffer, 1, ptr - buffer, fp) < (size_t)(ptr - buffer)) return -errno;
 	return 0;
 }
 
 
+int sp_rtrace_format_attachment(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_attachment_t* file)
+{
+	int rc;
+	if ( (rc = formatter_put(fmt, "& ", 2)) || (rc = formatter_puts(fmt, file->name)) ||
+			(rc = formatter_put(fmt, " : ", 3)) || (rc = formatter_puts(fmt, file->path)) ) return rc;
+	return formatter_put(fmt, "\n", 1);
+}
+
+/*
+ * Output stream API implementation.
+ *
+ * The records are formatted with a temporary formatter, writing
+ * into the output stream.
+ */
+
+#define PRINT_RECORD(fp, format_record) {\
+	char buffer[PRINT_BUFFER_SIZE];\
+	sp_rtrace_formatter_t fmt;\
+	formatter_init(&fmt, -1, fp, buffer, sizeof(buffer));\
+	int rc = format_record;\
+	if (rc == 0) rc = sp_rtrace_formatter_flush(&fmt);\
+	return rc;\
+}
+
+int sp_rtrace_print_header(FILE* fp, const struct sp_rtrace_header_t* header)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_header(&fmt, header));
+}
+
+
+int sp_rtrace_print_mmap(FILE* fp, const struct sp_rtrace_mmap_t* mmap)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_mmap(&fmt, mmap));
+}
+
+
+int sp_rtrace_print_call(FILE* fp, const struct sp_rtrace_fcall_t* call)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_call(&fmt, call));
+}
+
+
+int sp_rtrace_print_trace(FILE* fp, const struct sp_rtrace_ftrace_t* trace)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_trace(&fmt, trace));
+}
+
+
+int sp_rtrace_print_trace_step(FILE* fp, void* addr, const char* resolved)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_trace_step(&fmt, (pointer_t)addr, resolved));
+}
+
+
+int sp_rtrace_print_context(FILE* fp, const struct sp_rtrace_context_t* context)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_context(&fmt, context));
+}
+
+
+int sp_rtrace_print_resource(FILE* fp, const struct sp_rtrace_resource_t* resource)
+{
+	PRINT_RECORD(fp, sp_rtrace_format_resource(&fmt, resource));
+}
+
 
 int sp_rtrace_print_comment(FILE* fp, const char* format, ...)
 {
@@ -231,16 +647,11 @@ int sp_rtrace_print_comment(FILE* fp, const char* format, ...)
 
 int sp_rtrace_print_args(FILE* fp, const struct sp_rtrace_farg_t* args)
 {
-	while (args->name) {
-		if (fprintf(fp, "\t$%s = %s\n", args->name, args->value) == 0) return -errno;
-		args++;
-	}
-	return 0;
+	PRINT_RECORD(fp, sp_rtrace_format_args(&fmt, args));
 }
 
 
 int sp_rtrace_print_attachment(FILE* fp, const struct sp_rtrace_attachment_t* file)
 {
-	if (fprintf(fp, "& %s : %s\n", file->name, file->path) == 0) return -errno;
-	return 0;
+	PRINT_RECORD(fp, sp_rtrace_format_attachment(&fmt, file));
 }
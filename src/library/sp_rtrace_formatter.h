@@ -25,6 +25,14 @@
  * @file sp_rtrace_formatter.h
  *
  * API for printing rtrace text format compatible reports.
+ *
+ * The records can be printed either into an output stream with
+ * sp_rtrace_print_* functions, or formatted with sp_rtrace_format_*
+ * functions into the output buffer of a formatter instance, created
+ * with sp_rtrace_formatter_create() function. The formatter writes
+ * its buffer into the output file descriptor only when the buffer
+ * gets full, which is considerably faster when writing large reports.
+ * Both sets of functions produce identical output.
  */
 #ifndef SP_RTRACE_FORMATTER_H
 #define SP_RTRACE_FORMATTER_H
@@ -139,6 +147,130 @@ int sp_rtrace_print_args(FILE* fp, const struct sp_rtrace_farg_t* args);
  */
 int sp_rtrace_print_attachment(FILE* fp, const struct sp_rtrace_attachment_t* file);
 
+
+/**
+ * The buffered text formatter.
+ */
+typedef struct sp_rtrace_formatter_t sp_rtrace_formatter_t;
+
+/**
+ * Creates buffered text formatter.
+ *
+ * @param[in] fd   the output file descriptor.
+ * @return         the created formatter.
+ */
+sp_rtrace_formatter_t* sp_rtrace_formatter_create(int fd);
+
+/**
+ * Writes the buffered data into the output file descriptor.
+ *
+ * @param[in] fmt   the formatter.
+ * @return          0 - success, -errno - failure
+ */
+int sp_rtrace_formatter_flush(sp_rtrace_formatter_t* fmt);
+
+/**
+ * Flushes the buffered data and destroys the formatter.
+ *
+ * The output file descriptor is left open.
+ * @param[in] fmt   the formatter.
+ * @return          0 - success, -errno - failure
+ */
+int sp_rtrace_formatter_destroy(sp_rtrace_formatter_t* fmt);
+
+/**
+ * Formats report header.
+ *
+ * See sp_rtrace_print_header() function.
+ * @param[in] fmt       the formatter.
+ * @param[in] header    the report header.
+ * @return              0 - success, -errno - failure
+ */
+int sp_rtrace_format_header(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_header_t* header);
+
+/**
+ * Formats memory map information.
+ *
+ * @param[in] fmt    the formatter.
+ * @param[in] mmap   the memory mapping data.
+ * @return           0 - success, -errno - failure
+ */
+int sp_rtrace_format_mmap(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_mmap_t* mmap);
+
+/**
+ * Formats function call information.
+ *
+ * @param[in] fmt     the formatter.
+ * @param[in] call    the function call data.
+ * @return            0 - success, -errno - failure
+ */
+int sp_rtrace_format_call(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_fcall_t* call);
+
+/**
+ * Formats function stack trace.
+ *
+ * @param[in] fmt     the formatter.
+ * @param[in] trace   the stack trace data.
+ * @return            0 - success, -errno - failure
+ */
+int sp_rtrace_format_trace(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_ftrace_t* trace);
+
+/**
+ * Formats single stack trace step.
+ *
+ * @param[in] fmt       the formatter.
+ * @param[in] addr      the frame return address.
+ * @param[in] resolved  the resolved address name.
+ * @return              0 - success, -errno - failure
+ */
+int sp_rtrace_format_trace_step(sp_rtrace_formatter_t* fmt, pointer_t addr, const char* resolved);
+
+/**
+ * Formats context registry record.
+ *
+ * @param[in] fmt       the formatter.
+ * @param[in] context   the context data.
+ * @return              0 - success, -errno - failure
+ */
+int sp_rtrace_format_context(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_context_t* context);
+
+/**
+ * Formats resource registry record.
+ *
+ * @param[in] fmt       the formatter.
+ * @param[in] resource  the resource data.
+ * @return              0 - success, -errno - failure
+ */
+int sp_rtrace_format_resource(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_resource_t* resource);
+
+/**
+ * Formats comment.
+ *
+ * @param[in] fmt     the formatter.
+ * @param[in] format  the comment format template.
+ * @param[in] ...     the template data.
+ * @return            0 - success, -errno - failure
+ */
+int sp_rtrace_format_comment(sp_rtrace_formatter_t* fmt, const char* format, ...);
+
+/**
+ * Formats function arguments.
+ *
+ * @param[in] fmt    the formatter.
+ * @param[in] args   the function argument array, ending with item containing NULLs.
+ * @return           0 - success, -errno - failure
+ */
+int sp_rtrace_format_args(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_farg_t* args);
+
+/**
+ * Formats attachment information.
+ *
+ * @param[in] fmt    the formatter.
+ * @param[in] file   the attachment data.
+ * @return           0 - success, -errno - failure
+ */
+int sp_rtrace_format_attachment(sp_rtrace_formatter_t* fmt, const struct sp_rtrace_attachment_t* file);
+
 #ifdef  __cplusplus
 }
 #endif
@@ -21,15 +21,17 @@
  * 02r10-1301 USA
  */
 #include <stdlib.h>
+#include <stdbool.h>
 #include <limits.h>
-#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 #include "sp_rtrace_defs.h"
 
 #include "sp_rtrace_parser.h"
 
 #include "common/utils.h"
+#include "common/pool.h"
 #include "library/sp_rtrace_formatter.h"
 
 static int parse_record_mask = SP_RTRACE_RECORD_ALL;
@@ -40,112 +42,298 @@ enum {
 	PARSE_IGNORE = 1,
 };
 
+/**
+ * The text parser.
+ */
+struct sp_rtrace_parser_t {
+	/* the record types to parse */
+	int mask;
+	/* the string arena used to store the parsed strings,
+	 * NULL if the strings are allocated separately */
+	strpool_t* strings;
+	/* the parser instance string arena */
+	strpool_t arena;
+};
+
+/*
+ * The record fields are scanned directly from the input text. The
+ * scanning functions follow the scanf() conversions used to parse
+ * the records earlier, so the same records are accepted.
+ */
+
+/**
+ * Checks if the character is a whitespace character.
+ */
+static inline bool is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Checks if the character is a hexadecimal digit.
+ */
+static inline bool is_xdigit(char c)
+{
+	return (unsigned int)(c - '0') <= 9 || (unsigned int)((c | 0x20) - 'a') <= 5;
+}
+
+/**
+ * Skips whitespace characters.
+ *
+ * @param[in] ptr   the input text.
+ * @return          the first non-whitespace character.
+ */
+static inline const char* skip_space(const char* ptr)
+{
+	while (is_space(*ptr)) ptr++;
+	return ptr;
+}
+
+/**
+ * Scans hexadecimal number.
+ *
+ * Like the scanf() %x conversion, leading whitespace, sign and 0x
+ * prefix are accepted and values out of range are saturated to
+ * ULONG_MAX.
+ * @param[in] ptr     the input text.
+ * @param[out] value  the scanned value.
+ * @return            the text following the number or NULL if the
+ *                    text does not contain a number.
+ */
+static const char* scan_hex(const char* ptr, unsigned long* value)
+{
+	bool negative = false;
+	ptr = skip_space(ptr);
+	if (*ptr == '-' || *ptr == '+') negative = *ptr++ == '-';
+	/* the 0x prefix alone is scanned as zero */
+	const char* start = ptr;
+	if (ptr[0] == '0' && (ptr[1] | 0x20) == 'x') ptr += 2;
+
+	unsigned long result = 0;
+	bool overflow = false;
+	while (is_xdigit(*ptr)) {
+		unsigned int digit = (unsigned int)(*ptr - '0');
+		if (digit > 9) digit = ((*ptr | 0x20) - 'a') + 10;
+		if (result > (ULONG_MAX >> 4)) overflow = true;
+		result = (result << 4) | digit;
+		ptr++;
+	}
+	if (ptr == start) return NULL;
+	if (overflow) *value = ULONG_MAX;
+	else *value = negative ? -result : result;
+	return ptr;
+}
+
+/**
+ * Scans decimal number.
+ *
+ * Like the scanf() %d conversion, leading whitespace and sign are
+ * accepted. Values out of range are saturated to INT_MIN/INT_MAX.
+ * @param[in] ptr     the input text.
+ * @param[out] value  the scanned value.
+ * @return            the text following the number or NULL if the
+ *                    text does not contain a number.
+ */
+static const char* scan_dec(const char* ptr, int* value)
+{
+	bool negative = false;
+	ptr = skip_space(ptr);
+	if (*ptr == '-' || *ptr == '+') negative = *ptr++ == '-';
+
+	const char* start = ptr;
+	unsigned int limit = negative ? (unsigned int)INT_MAX + 1 : INT_MAX;
+	unsigned int result = 0;
+	while ((unsigned int)(*ptr - '0') <= 9) {
+		unsigned int digit = *ptr++ - '0';
+		result = result > (limit - digit) / 10 ? limit : result * 10 + digit;
+	}
+	if (ptr == start) return NULL;
+	*value = negative ? (int)-result : (int)result;
+	return ptr;
+}
+
+/**
+ * Scans a whitespace delimited token.
+ *
+ * @param[in] ptr   the input text.
+ * @return          the text following the token or NULL if the text
+ *                  does not contain a token.
+ */
+static const char* scan_token(const char* ptr)
+{
+	const char* start = ptr;
+	while (*ptr && !is_space(*ptr)) ptr++;
+	return ptr == start ? NULL : ptr;
+}
+
+/**
+ * Scans text up to the specified delimiter.
+ *
+ * @param[in] ptr    the input text.
+ * @param[in] delim  the delimiter character.
+ * @return           the delimiter position (or the end of text) or NULL if
+ *                   the text starts with the delimiter.
+ */
+static const char* scan_until(const char* ptr, char delim)
+{
+	const char* start = ptr;
+	while (*ptr && *ptr != delim) ptr++;
+	return ptr == start ? NULL : ptr;
+}
+
+/**
+ * Copies string into newly allocated buffer.
+ *
+ * @param[in] str     the string (not necessary zero terminated).
+ * @param[in] len     the string length.
+ * @return            the string copy.
+ */
+static char* copy_string(const char* str, size_t len)
+{
+	char* value = (char*)malloc_a(len + 1);
+	memcpy(value, str, len);
+	value[len] = '\0';
+	return value;
+}
+
+/**
+ * Stores the parsed string.
+ *
+ * @param[in] parser  the parser.
+ * @param[in] str     the string (not necessary zero terminated).
+ * @param[in] len     the string length.
+ * @return            the stored string.
+ */
+static char* store_string(const sp_rtrace_parser_t* parser, const char* str, size_t len)
+{
+	if (parser->strings) return strpool_add(parser->strings, str, len);
+	return copy_string(str, len);
+}
 
 /**
  * Parses trace frame record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain trace frame data.
- *                   PARSE_OK     - the trace frame data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace frame data, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain trace frame data.
+ *                    PARSE_OK     - the trace frame data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace frame data, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_backtrace(const char* line, sp_rtrace_btframe_t* data)
+static int parse_backtrace(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_btframe_t* data)
 {
 	if (*line != '\t') return PARSE_FAIL;
+	const char* ptr = skip_space(line);
+	if (ptr[0] != '0' || ptr[1] != 'x') return PARSE_FAIL;
+
+	pointer_t addr;
+	ptr = scan_hex(ptr + 2, &addr);
+	if (!ptr) return PARSE_FAIL;
+	if ( !(parser->mask & SP_RTRACE_RECORD_TRACE) ) return PARSE_IGNORE;
 
-	char resolved_name[PATH_MAX];
-	int n = sscanf(line, "\t0x%lx %[^\n]", &data->addr, resolved_name);
-	if (n < 1) return PARSE_FAIL;
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_TRACE) ) return PARSE_IGNORE;
-	data->name = (n == 2) ? strdup_a(resolved_name) : NULL;
+	data->addr = addr;
+	/* the resolved name is the rest of line */
+	const char* name = skip_space(ptr);
+	const char* end = scan_until(name, '\n');
+	data->name = end ? store_string(parser, name, end - name) : NULL;
 	return PARSE_OK;
 }
 
 /**
  * Parses function calll record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain function call data.
- *                   PARSE_OK     - the function call data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace function call, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain function call data.
+ *                    PARSE_OK     - the function call data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace function call, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_function_call(const char* line, sp_rtrace_fcall_t* data)
+static int parse_function_call(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_fcall_t* data)
 {
-	static char res_type_name[512];
-	int idx, context = 0;
-	int hours, minutes, seconds, mseconds;
+	int idx, res_size;
+	unsigned long context = 0, value;
 	int timestamp = 0;
 	pointer_t res_id;
-	int res_size;
-	char name[512], delim, function_type;
-	const char* ptr = line;
+	char function_type;
+	const char *ptr, *next, *res_type = NULL, *res_type_end = NULL;
 	unsigned int res_type_flag = SP_RTRACE_FCALL_RFIELD_UNDEF;
 
 	/* parse index field <index>. */
-	if (sscanf(ptr, "%d%c", &idx, &delim) != 2 || delim != '.') return PARSE_FAIL;
+	ptr = scan_dec(line, &idx);
+	if (!ptr || *ptr != '.') return PARSE_FAIL;
 	/* move cursor beyond index field */
-	ptr = strchr(ptr, ' ');
+	ptr = strchr(line, ' ');
 	if (!ptr) return PARSE_FAIL;
 	ptr++;
 
 	/* parse optional context mask */
-	if (sscanf(ptr, "@%x", &context) == 1) {
+	if (*ptr == '@' && scan_hex(ptr + 1, &context)) {
 		/* context mask was parsed successfully. Move cursor to next field */
-		ptr = strchr(ptr, '@');
 		ptr = strchr(ptr, ' ');
 		if (!ptr) return PARSE_FAIL;
 		ptr++;
 	}
 	/* parse optional timestamp */
-	if (sscanf(ptr, "[%d:%d:%d.%d]", &hours, &minutes, &seconds, &mseconds) == 4) {
-		/* timestamp was parsed successfully. Move cursor beyond timestamp */
-		timestamp = hours * 60 * 60 * 1000 + minutes * 60 * 1000 + seconds * 1000 + mseconds;
-		ptr = strchr(ptr, ' ');
-		if (!ptr) return PARSE_FAIL;
-		ptr++;
+	if (*ptr == '[') {
+		int hours, minutes, seconds, mseconds;
+		if ( (next = scan_dec(ptr + 1, &hours)) && *next == ':' &&
+				(next = scan_dec(next + 1, &minutes)) && *next == ':' &&
+				(next = scan_dec(next + 1, &seconds)) && *next == '.' &&
+				scan_dec(next + 1, &mseconds) ) {
+			/* timestamp was parsed successfully. Move cursor beyond timestamp */
+			timestamp = hours * 60 * 60 * 1000 + minutes * 60 * 1000 + seconds * 1000 + mseconds;
+			ptr = strchr(ptr, ' ');
+			if (!ptr) return PARSE_FAIL;
+			ptr++;
+		}
 	}
-	char* ptr2 = strrchr(ptr, '(');
-	if (!ptr2) return PARSE_FAIL;
-	if (*(ptr2 - 1) == '>') ptr2 = strrchr(ptr, '<');
-
-	memcpy(name, ptr, ptr2 - ptr);
-	name[ptr2 - ptr] = '\0';
-	ptr = ptr2;
+	const char* name_end = strrchr(ptr, '(');
+	if (!name_end) return PARSE_FAIL;
+	if (*(name_end - 1) == '>') {
+		name_end = strrchr(ptr, '<');
+		if (!name_end) return PARSE_FAIL;
+	}
+	const char* name = ptr;
+	ptr = name_end;
 	if (*ptr == '<') {
-		if (sscanf(ptr, "<%[^>]>", res_type_name) == 0) {
-			return PARSE_FAIL;
-		}
+		res_type = ptr + 1;
+		res_type_end = scan_until(res_type, '>');
+		if (!res_type_end) return PARSE_FAIL;
 		ptr = strchr(ptr, '(');
 		if (!ptr) return PARSE_FAIL;
 		res_type_flag = SP_RTRACE_FCALL_RFIELD_NAME;
 	}
-	if (sscanf(ptr, "(%d) = 0x%lx", &res_size, &res_id) == 2) {
+	/* (<size>) = 0x<id> */
+	if ( (next = scan_dec(ptr + 1, &res_size)) && *next == ')' &&
+			*(next = skip_space(next + 1)) == '=' &&
+			*(next = skip_space(next + 1)) == '0' && next[1] == 'x' &&
+			scan_hex(next + 2, &value) ) {
+		res_id = value;
 		function_type = SP_RTRACE_FTYPE_ALLOC;
 	}
-	else if (sscanf(ptr, "(0x%lx)", &res_id) == 1) {
+	/* (0x<id>) */
+	else if (ptr[1] == '0' && ptr[2] == 'x' && scan_hex(ptr + 3, &value)) {
+		res_id = value;
 		res_size = 0;
 		function_type = SP_RTRACE_FTYPE_FREE;
 	}
 	else {
 		return PARSE_FAIL;
 	}
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_CALL) ) return PARSE_IGNORE;
+	if ( !(parser->mask & SP_RTRACE_RECORD_CALL) ) return PARSE_IGNORE;
 
 	data->index = idx;
 	/* temporary assign the resource type name to res_type field. After returning
 	 * from this function the correct resource type structure will be found and
 	 * assigned instead. */
 	data->res_type_flag = res_type_flag;
-	data->res_type = res_type_flag == SP_RTRACE_FCALL_RFIELD_NAME ? strdup_a(res_type_name) : NULL;
+	data->res_type = res_type ? store_string(parser, res_type, res_type_end - res_type) : NULL;
 	data->type = function_type;
-	data->context = context;
-	data->name = strdup_a(name);
+	data->context = (unsigned int)context;
+	data->name = store_string(parser, name, name_end - name);
 	data->res_id = res_id;
 	data->res_size = (long)res_size;
 	data->timestamp = timestamp;
@@ -156,45 +344,85 @@ static int parse_function_call(const char* line, sp_rtrace_fcall_t* data)
 /**
  * Parses function argument record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain function argument data.
- *                   PARSE_OK     - the function argument data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace function argument, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain function argument data.
+ *                    PARSE_OK     - the function argument data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace function argument, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_arguments(const char* line, sp_rtrace_farg_t* data)
+static int parse_arguments(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_farg_t* data)
 {
-	char value[PATH_MAX], name[128];
-	if (*line != '\t' || sscanf(line, "\t$%s = %s", name, value) != 2) return PARSE_FAIL;
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_ARG) ) return PARSE_IGNORE;
-
-	data->name = strdup_a(name);
-	data->value = strdup_a(value);
+	if (*line != '\t') return PARSE_FAIL;
+	const char* name = skip_space(line);
+	if (*name != '$') return PARSE_FAIL;
+
+	/* $<name> = <value> */
+	name = skip_space(name + 1);
+	const char* name_end = scan_token(name);
+	if (!name_end) return PARSE_FAIL;
+	const char* value = skip_space(name_end);
+	if (*value != '=') return PARSE_FAIL;
+	value = skip_space(value + 1);
+	const char* value_end = scan_token(value);
+	if (!value_end) return PARSE_FAIL;
+	if ( !(parser->mask & SP_RTRACE_RECORD_ARG) ) return PARSE_IGNORE;
+
+	data->name = store_string(parser, name, name_end - name);
+	data->value = store_string(parser, value, value_end - value);
 	return PARSE_OK;
 }
 
 /**
  * Parses memory mapping record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain memory mapping data.
- *                   PARSE_OK     - the memory mapping data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace memory mapping, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain memory mapping data.
+ *                    PARSE_OK     - the memory mapping data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace memory mapping, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_memory_mapping(const char* line, sp_rtrace_mmap_t* data)
+static int parse_memory_mapping(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_mmap_t* data)
 {
-	char module[PATH_MAX];
+	if (*line != ':') return PARSE_FAIL;
+
+	/* : <module> => 0x<from>-0x<to> */
 	pointer_t from, to;
-	if (sscanf(line, ": %s => 0x%lx-0x%lx", module, &from, &to) != 3) return PARSE_FAIL;
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_MMAP) ) return PARSE_IGNORE;
-	data->module = strdup_a(module);
+	const char* module = skip_space(line + 1);
+	const char* module_end = scan_token(module);
+	if (!module_end) return PARSE_FAIL;
+	const char* ptr = skip_space(module_end);
+	if (ptr[0] != '=' || ptr[1] != '>') return PARSE_FAIL;
+	ptr = skip_space(ptr + 2);
+	if (ptr[0] != '0' || ptr[1] != 'x' || !(ptr = scan_hex(ptr + 2, &from))) return PARSE_FAIL;
+	if (ptr[0] != '-' || ptr[1] != '0' || ptr[2] != 'x' || !(ptr = scan_hex(ptr + 3, &to))) return PARSE_FAIL;
+	if ( !(parser->mask & SP_RTRACE_RECORD_MMAP) ) return PARSE_IGNORE;
+
+	data->module = store_string(parser, module, module_end - module);
 	data->from = from;
 	data->to = to;
+	data->build_id = NULL;
+	data->bias = 0;
+	/* the build-id and load bias are optional */
+	ptr = strstr(ptr, " build-id=");
+	if (ptr) {
+		const char* build_id = ptr + sizeof(" build-id=") - 1;
+		const char* build_id_end = build_id;
+		pointer_t bias;
+		while (build_id_end - build_id < SP_RTRACE_BUILD_ID_SIZE * 2 &&
+				((*build_id_end >= '0' && *build_id_end <= '9') || (*build_id_end >= 'a' && *build_id_end <= 'f'))) {
+			build_id_end++;
+		}
+		ptr = skip_space(build_id_end);
+		if (build_id_end != build_id && !strncmp(ptr, "bias=0x", sizeof("bias=0x") - 1) &&
+				scan_hex(ptr + sizeof("bias=0x") - 1, &bias)) {
+			data->build_id = store_string(parser, build_id, build_id_end - build_id);
+			data->bias = bias;
+		}
+	}
 	return PARSE_OK;
 }
 
@@ -202,22 +430,30 @@ static int parse_memory_mapping(const char* line, sp_rtrace_mmap_t* data)
 /**
  * Parses context registry record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain context registry data.
- *                   PARSE_OK     - the context registry data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace context registry, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain context registry data.
+ *                    PARSE_OK     - the context registry data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace context registry, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_context_registry(const char* line, sp_rtrace_context_t* data)
+static int parse_context_registry(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_context_t* data)
 {
-	char name[512];
-	unsigned int id;
-	if (sscanf(line, "@ %x : %[^\n]", &id, name) != 2) return PARSE_FAIL;
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_CONTEXT) ) return PARSE_IGNORE;
-	data->id = id;
-	data->name = strdup_a(name);
+	if (*line != '@') return PARSE_FAIL;
+
+	/* @ <id> : <name> */
+	unsigned long id;
+	const char* ptr = scan_hex(line + 1, &id);
+	if (!ptr) return PARSE_FAIL;
+	ptr = skip_space(ptr);
+	if (*ptr != ':') return PARSE_FAIL;
+	const char* name = skip_space(ptr + 1);
+	const char* name_end = scan_until(name, '\n');
+	if (!name_end) return PARSE_FAIL;
+	if ( !(parser->mask & SP_RTRACE_RECORD_CONTEXT) ) return PARSE_IGNORE;
+	data->id = (unsigned int)id;
+	data->name = store_string(parser, name, name_end - name);
 	return PARSE_OK;
 }
 
@@ -225,13 +461,21 @@ static int parse_context_registry(const char* line, sp_rtrace_context_t* data)
  * Parses resource type flags from input text.
  *
  * @param[in] text  the text containing resource type flags in textual format.
+ * @param[in] len   the text length.
  * @return          the resource type flags.
  */
-static unsigned int parse_resource_flags(const char* text) {
+static unsigned int parse_resource_flags(const char* text, size_t len) {
 	unsigned int nflag = 0, flag, flags = 0;
 
 	while ( (flag = 1 << nflag) <= SP_RTRACE_RESOURCE_LAST_FLAG ) {
-		if (strstr(text, sp_rtrace_resource_flags_text[nflag++])) flags |= flag;
+		const char* name = sp_rtrace_resource_flags_text[nflag++];
+		size_t name_len = strlen(name), i;
+		for (i = 0; i + name_len <= len; i++) {
+			if (!memcmp(text + i, name, name_len)) {
+				flags |= flag;
+				break;
+			}
+		}
 	}
 	return flags;
 }
@@ -239,90 +483,135 @@ static unsigned int parse_resource_flags(const char* text) {
 /**
  * Parses resource registry record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain resource registry data.
- *                   PARSE_OK     - the resource registry data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace resource registry, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain resource registry data.
+ *                    PARSE_OK     - the resource registry data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace resource registry, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_resource_registry(const char* line, sp_rtrace_resource_t* data)
+static int parse_resource_registry(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_resource_t* data)
 {
-	char type[512], desc[512], flags[1024];
-	unsigned int id;
-	int fields;
-	if ( (fields = sscanf(line, "<%x> : %[^ ] (%[^)]) [%[^]]]", &id, type, desc, flags)) < 3) return PARSE_FAIL;
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_CONTEXT) ) return PARSE_IGNORE;
-	data->id = ffs(id);
-	data->type = strdup_a(type);
-	data->desc = strdup_a(desc);
-	data->flags = fields >= 4 ? parse_resource_flags(flags) : 0;
+	if (*line != '<') return PARSE_FAIL;
+
+	/* <<id>> : <type> (<desc>) [<flags>] */
+	unsigned long id;
+	const char* ptr = scan_hex(line + 1, &id);
+	if (!ptr || *ptr != '>') return PARSE_FAIL;
+	ptr = skip_space(ptr + 1);
+	if (*ptr != ':') return PARSE_FAIL;
+	const char* type = skip_space(ptr + 1);
+	const char* type_end = scan_until(type, ' ');
+	if (!type_end) return PARSE_FAIL;
+	ptr = skip_space(type_end);
+	if (*ptr != '(') return PARSE_FAIL;
+	const char* desc = ptr + 1;
+	const char* desc_end = scan_until(desc, ')');
+	if (!desc_end) return PARSE_FAIL;
+	/* the flags are optional */
+	const char* flags = NULL, *flags_end = NULL;
+	if (*desc_end == ')') {
+		ptr = skip_space(desc_end + 1);
+		if (*ptr == '[') {
+			flags = ptr + 1;
+			flags_end = scan_until(flags, ']');
+		}
+	}
+	if ( !(parser->mask & SP_RTRACE_RECORD_RESOURCE) ) return PARSE_IGNORE;
+	data->id = ffs((unsigned int)id);
+	data->type = store_string(parser, type, type_end - type);
+	data->desc = store_string(parser, desc, desc_end - desc);
+	data->flags = flags_end ? parse_resource_flags(flags, flags_end - flags) : 0;
 	return PARSE_OK;
 }
 
 /**
  * Parses file attachment record from the input text.
  *
- * @param[in] line   the text to parse.
- * @param[out] data  the parsed data.
- * @return           PARSE_FAIL   - the input text does not contain file attachment data.
- *                   PARSE_OK     - the file attachment data was parsed successfully.
- *                   PARSE_IGNORE - the input text contains trace file attachment, but was
- *                                  set to be ignored by sp_rtrace_parser_set_mask()
- *                                  function.
+ * @param[in] parser  the parser.
+ * @param[in] line    the text to parse.
+ * @param[out] data   the parsed data.
+ * @return            PARSE_FAIL   - the input text does not contain file attachment data.
+ *                    PARSE_OK     - the file attachment data was parsed successfully.
+ *                    PARSE_IGNORE - the input text contains trace file attachment, but was
+ *                                   set to be ignored by the parser record mask.
  */
-static int parse_file_attachment(const char* line, sp_rtrace_attachment_t* data)
+static int parse_file_attachment(const sp_rtrace_parser_t* parser, const char* line, sp_rtrace_attachment_t* data)
 {
-	char name[512], path[PATH_MAX];
-	if (sscanf(line, "& %s : %s", name, path) != 2) return PARSE_FAIL;
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_ATTACHMENT) ) return PARSE_IGNORE;
-	data->name = strdup_a(name);
-	data->path = strdup_a(path);
+	if (*line != '&') return PARSE_FAIL;
+
+	/* & <name> : <path> */
+	const char* name = skip_space(line + 1);
+	const char* name_end = scan_token(name);
+	if (!name_end) return PARSE_FAIL;
+	const char* ptr = skip_space(name_end);
+	if (*ptr != ':') return PARSE_FAIL;
+	const char* path = skip_space(ptr + 1);
+	const char* path_end = scan_token(path);
+	if (!path_end) return PARSE_FAIL;
+	if ( !(parser->mask & SP_RTRACE_RECORD_ATTACHMENT) ) return PARSE_IGNORE;
+	data->name = store_string(parser, name, name_end - name);
+	data->path = store_string(parser, path, path_end - path);
 	return PARSE_OK;
 }
 
-
-/*
- * Public API
+/**
+ * Parses the text containing sp-rtrace text format record.
+ *
+ * The record parsers are tried in order, each of them checking the
+ * record type specific line prefix first.
+ * @param[in] parser   the parser.
+ * @param[in] text     the text to parse.
+ * @param[out] record  the parsed data.
+ * @return             the record type (see sp_rtrace_record_type_t enum).
  */
-
-int sp_rtrace_parser_parse_record(const char* text, sp_rtrace_record_t* record)
+static int parse_record(const sp_rtrace_parser_t* parser, const char* text, sp_rtrace_record_t* record)
 {
 	int rc;
-	rc = parse_backtrace(text, &record->frame);
+	rc = parse_backtrace(parser, text, &record->frame);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_TRACE;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
-	rc = parse_function_call(text, &record->call);
+	rc = parse_function_call(parser, text, &record->call);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_CALL;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
-	rc = parse_arguments(text, &record->arg);
+	rc = parse_arguments(parser, text, &record->arg);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_ARG;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
-	rc = parse_memory_mapping(text, &record->mmap);
+	rc = parse_memory_mapping(parser, text, &record->mmap);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_MMAP;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
-	rc = parse_context_registry(text, &record->context);
+	rc = parse_context_registry(parser, text, &record->context);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_CONTEXT;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
-	rc = parse_resource_registry(text, &record->resource);
+	rc = parse_resource_registry(parser, text, &record->resource);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_RESOURCE;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
-	rc = parse_file_attachment(text, &record->attachment);
+	rc = parse_file_attachment(parser, text, &record->attachment);
 	if (rc == PARSE_OK) return SP_RTRACE_RECORD_ATTACHMENT;
 	if (rc == PARSE_IGNORE) return SP_RTRACE_RECORD_NONE;
 
 	/* unknown record, assuming it's a comment */
-	if ( !(parse_record_mask & SP_RTRACE_RECORD_COMMENT) ) return SP_RTRACE_RECORD_NONE;
+	if ( !(parser->mask & SP_RTRACE_RECORD_COMMENT) ) return SP_RTRACE_RECORD_NONE;
 	return SP_RTRACE_RECORD_COMMENT;
 }
 
+/*
+ * Public API
+ */
+
+int sp_rtrace_parser_parse_record(const char* text, sp_rtrace_record_t* record)
+{
+	sp_rtrace_parser_t parser = {.mask = parse_record_mask, .strings = NULL};
+	return parse_record(&parser, text, record);
+}
+
 
 
 void sp_rtrace_parser_free_record(int type, sp_rtrace_record_t* record)
@@ -330,6 +619,7 @@ void sp_rtrace_parser_free_record(int type, sp_rtrace_record_t* record)
 	switch (type) {
 		case SP_RTRACE_RECORD_MMAP: {
 			if (record->mmap.module) free(record->mmap.module);
+			if (record->mmap.build_id) free(record->mmap.build_id);
 			break;
 		}
 		case SP_RTRACE_RECORD_CALL: {
@@ -370,19 +660,49 @@ void sp_rtrace_parser_set_mask(int mask)
 }
 
 
+sp_rtrace_parser_t* sp_rtrace_parser_create(int mask)
+{
+	sp_rtrace_parser_t* parser = (sp_rtrace_parser_t*)malloc_a(sizeof(sp_rtrace_parser_t));
+	parser->mask = mask;
+	parser->strings = &parser->arena;
+	strpool_init(&parser->arena);
+	return parser;
+}
+
+
+int sp_rtrace_parser_parse(sp_rtrace_parser_t* parser, const char* text, sp_rtrace_record_t* record)
+{
+	return parse_record(parser, text, record);
+}
+
+
+void sp_rtrace_parser_destroy(sp_rtrace_parser_t* parser)
+{
+	strpool_free(&parser->arena);
+	free(parser);
+}
+
+
 void sp_rtrace_parser_parse_header(const char* text, sp_rtrace_header_t* header)
 {
-	char key[256], value[PATH_MAX];
 	const char* ptr = text;
 	int i;
 
 	memset(header, 0, sizeof(sp_rtrace_header_t));
 
-	while (sscanf(ptr, "%[^=]=%[^,]", key, value) == 2) {
+	/* <key>=<value>, <key>=<value>... */
+	while (true) {
+		const char* key_end = scan_until(ptr, '=');
+		if (!key_end || *key_end != '=') break;
+		const char* value = key_end + 1;
+		const char* value_end = scan_until(value, ',');
+		if (!value_end) break;
+
+		size_t key_len = key_end - ptr;
 		for (i = 0; i < SP_RTRACE_HEADER_MAX; i++) {
-			if (!strcmp(key, header_fields[i])) {
+			if (!strncmp(ptr, header_fields[i], key_len) && header_fields[i][key_len] == '\0') {
 				if (header->fields[i]) free(header->fields[i]);
-				header->fields[i] = strdup_a(value);
+				header->fields[i] = copy_string(value, value_end - value);
 				break;
 			}
 		}
@@ -46,6 +46,13 @@
  *    User is responsible for handling the allocated resources manually
  *    or by freeing them with sp_rtrace_parser_free_record() function.
  *
+ * Alternatively a parser instance can be created with sp_rtrace_parser_create()
+ * function and the records parsed with sp_rtrace_parser_parse() function.
+ * The parser instance stores single copy of every parsed string in its
+ * string arena, so the parsed records must not be freed - the strings are
+ * valid until the parser is destroyed with sp_rtrace_parser_destroy()
+ * function. The parser instances don't share any state, so separate
+ * instances can be used by different threads at the same time.
  */
 
 #ifndef _SP_RTRACE_PARSER_H_
@@ -128,6 +135,42 @@ void sp_rtrace_parser_free_record(int type, sp_rtrace_record_t* record);
 void sp_rtrace_parser_set_mask(int mask);
 
 
+/**
+ * The text parser instance.
+ */
+typedef struct sp_rtrace_parser_t sp_rtrace_parser_t;
+
+/**
+ * Creates text parser instance.
+ *
+ * @param[in] mask  the mask of record types to parse (see the
+ *                  sp_rtrace_record_type_t enum).
+ * @return          the created parser.
+ */
+sp_rtrace_parser_t* sp_rtrace_parser_create(int mask);
+
+/**
+ * Parses the text containing sp-rtrace text format record.
+ *
+ * The data is stored in the sp_rtrace_record_t union like with
+ * sp_rtrace_parser_parse_record() function, but the record strings
+ * are stored in the parser string arena and must not be freed.
+ * @param[in] parser    the parser.
+ * @param[in] text      the text to parse.
+ * @param[out] record   the parsed data.
+ * @return              the record type (see sp_rtrace_record_type_t enum).
+ */
+int sp_rtrace_parser_parse(sp_rtrace_parser_t* parser, const char* text, sp_rtrace_record_t* record);
+
+/**
+ * Destroys text parser instance.
+ *
+ * The strings of the records parsed by this parser are freed.
+ * @param[in] parser   the parser.
+ */
+void sp_rtrace_parser_destroy(sp_rtrace_parser_t* parser);
+
+
 /**
  * Parses text into header fields.
  *
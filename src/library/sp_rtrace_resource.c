@@ -0,0 +1,47 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+#include "config.h"
+
+#include "sp_rtrace_resource.h"
+
+/*
+ * The default implementation does nothing. When the main tracing module
+ * (libsp-rtrace-main.so) is preloaded, it overrides these functions
+ * with implementations reporting the resources to the pre-processor.
+ */
+
+unsigned int sp_resource_register(const char* type __attribute__((unused)),
+		const char* desc __attribute__((unused)), unsigned int flags __attribute__((unused)))
+{
+	return 0;
+}
+
+void sp_resource_alloc(unsigned int resource_id __attribute__((unused)), const char* name __attribute__((unused)),
+		const void* res_id __attribute__((unused)), size_t size __attribute__((unused)))
+{
+}
+
+void sp_resource_free(unsigned int resource_id __attribute__((unused)), const char* name __attribute__((unused)),
+		const void* res_id __attribute__((unused)))
+{
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+#ifndef SP_RTRACE_RESOURCE_H
+#define SP_RTRACE_RESOURCE_H
+
+/**
+ * @file sp_rtrace_resource.h
+ * Resource tracing client side API for custom resource reporting.
+ *
+ * Allows applications to report allocations of their own resource
+ * types - for example objects allocated by pool or arena allocators.
+ * Without preloaded sp-rtrace main module the functions do nothing.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Registers custom resource type.
+ *
+ * Note that the type and desc values must refer to preallocated strings,
+ * which must not be freed until the process exits.
+ * @param[in] type   the resource type name.
+ * @param[in] desc   the resource description.
+ * @param[in] flags  the resource behaviour flags (sp_rtrace_resource_flags_t).
+ * @return           the resource type id. 0 is returned if the resource
+ *                   registration failed or tracing is not available.
+ */
+unsigned int sp_resource_register(const char* type, const char* desc, unsigned int flags);
+
+/**
+ * Reports resource allocation.
+ *
+ * @param[in] resource_id   the resource type id.
+ * @param[in] name          the reported function name (NULL - sp_resource_alloc).
+ * @param[in] res_id        the allocated resource identifier.
+ * @param[in] size          the allocated resource size.
+ * @return
+ */
+void sp_resource_alloc(unsigned int resource_id, const char* name, const void* res_id, size_t size);
+
+/**
+ * Reports resource deallocation.
+ *
+ * @param[in] resource_id   the resource type id.
+ * @param[in] name          the reported function name (NULL - sp_resource_free).
+ * @param[in] res_id        the freed resource identifier.
+ * @return
+ */
+void sp_resource_free(unsigned int resource_id, const char* name, const void* res_id);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
+
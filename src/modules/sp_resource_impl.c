@@ -0,0 +1,102 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+#include "config.h"
+
+/**
+ * @file sp_resource_impl.c
+ *
+ * Custom resource reporting support.
+ *
+ * Overrides the default (empty) libsp-rtrace1 custom resource API
+ * implementation (see: sp_rtrace_resource.h) to report the resources
+ * through the main module.
+ */
+
+#include <stdlib.h>
+
+#include "library/sp_rtrace_resource.h"
+#include "sp_rtrace_main.h"
+#include "sp_rtrace_module.h"
+
+#include "common/utils.h"
+
+/* the maximum number of custom resource types */
+#define SP_RESOURCE_REGISTRY_SIZE   16
+
+/* the custom resource registry */
+static module_resource_t resources[SP_RESOURCE_REGISTRY_SIZE];
+
+/* the number of registered custom resources */
+static unsigned int resource_index = 0;
+
+/* resource registry lock for thread synchronization */
+static volatile int resource_lock = 0;
+
+
+unsigned int sp_resource_register(const char* type, const char* desc, unsigned int flags)
+{
+	unsigned int id = 0;
+
+	if (!sp_rtrace_initialize()) return 0;
+
+	while (!sync_bool_compare_and_swap(&resource_lock, 0, 1));
+	if (resource_index < SP_RESOURCE_REGISTRY_SIZE) {
+		module_resource_t* resource = &resources[resource_index];
+		resource->type = type;
+		resource->desc = desc;
+		resource->flags = flags;
+		id = sp_rtrace_register_resource(resource);
+		if (id == (unsigned int)-1) id = 0;
+		if (id) resource_index++;
+	}
+	resource_lock = 0;
+	return id;
+}
+
+void sp_resource_alloc(unsigned int resource_id, const char* name, const void* res_id, size_t size)
+{
+	if (!sp_rtrace_options->enable || !resource_id) return;
+
+	module_fcall_t call = {
+		.type = SP_RTRACE_FTYPE_ALLOC,
+		.res_type_id = resource_id,
+		.name = name ? name : "sp_resource_alloc",
+		.res_id = (pointer_t)res_id,
+		.res_size = size,
+	};
+	sp_rtrace_write_function_call(&call, NULL, NULL);
+}
+
+void sp_resource_free(unsigned int resource_id, const char* name, const void* res_id)
+{
+	if (!sp_rtrace_options->enable || !resource_id) return;
+
+	module_fcall_t call = {
+		.type = SP_RTRACE_FTYPE_FREE,
+		.res_type_id = resource_id,
+		.name = name ? name : "sp_resource_free",
+		.res_id = (pointer_t)res_id,
+		.res_size = 0,
+	};
+	sp_rtrace_write_function_call(&call, NULL, NULL);
+}
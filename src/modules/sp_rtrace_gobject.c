@@ -39,8 +39,10 @@
 
 #include "sp_rtrace_main.h"
 #include "sp_rtrace_module.h"
+#include "sp_rtrace_objstat.h"
 
 #include "common/sp_rtrace_proto.h"
+#include "rtrace/rtrace_env.h"
 
 
  /*
@@ -65,6 +67,8 @@ static trace_t trace_off;
 static trace_t trace_on;
 /* tracing function initializers */
 static trace_t trace_init;
+/* live object statistics function references */
+static trace_t trace_summary;
 
 /* Runtime function references */
 static trace_t* trace_rt = &trace_init;
@@ -89,6 +93,25 @@ static module_resource_t res_gobject = {
 	.flags = SP_RTRACE_RESOURCE_REFCOUNT,
 };
 
+/* true if only live object statistics must be collected (SP_RTRACE_OBJECT_SUMMARY) */
+static bool summary_mode = false;
+
+/* the live object statistics */
+static objstat_t objstat;
+
+/* the tracing state */
+static bool trace_enabled = false;
+
+/**
+ * Retrieves GType name.
+ *
+ * @param[in] class_id  the GType value.
+ * @return              the type name.
+ */
+static const char* get_class_name(pointer_t class_id)
+{
+	return g_type_name((GType)class_id);
+}
 
 /**
  * Enables/disables tracing.
@@ -98,7 +121,13 @@ static module_resource_t res_gobject = {
  */
 static void enable_tracing(bool value)
 {
-	trace_rt = value ? &trace_on : &trace_off;
+	if (summary_mode) {
+		/* start with empty statistics and write the final snapshot when tracing is disabled */
+		if (value && !trace_enabled) objstat_reset(&objstat);
+		if (!value && trace_enabled) objstat_write_snapshot(&objstat);
+		trace_enabled = value;
+	}
+	trace_rt = value ? (summary_mode ? &trace_summary : &trace_on) : &trace_off;
 }
 
 /**
@@ -115,6 +144,10 @@ static void trace_initialize(void)
 			trace_off.g_type_free_instance = (g_type_free_instance_t)dlsym(RTLD_NEXT, "g_type_free_instance");
 			trace_off.g_object_ref = (g_object_ref_t)dlsym(RTLD_NEXT, "g_object_ref");
 			trace_off.g_object_unref = (g_object_unref_t)dlsym(RTLD_NEXT, "g_object_unref");
+
+			/* references don't change the live object set, so they are not tracked in summary mode */
+			trace_summary.g_object_ref = trace_off.g_object_ref;
+			trace_summary.g_object_unref = trace_off.g_object_unref;
 			init_mode = MODULE_LOADED;
 
 			LOG("module loaded: %s (%d.%d)", module_info.name, module_info.version_major, module_info.version_minor);
@@ -122,6 +155,11 @@ static void trace_initialize(void)
 
 		case MODULE_LOADED: {
 			if (sp_rtrace_initialize()) {
+				const char* summary = getenv(SP_RTRACE_OBJECT_SUMMARY);
+				if (summary && *summary) {
+					objstat_init(&objstat, module_info.name, atoi(summary), NULL, get_class_name);
+					summary_mode = true;
+				}
 				sp_rtrace_register_module(&module_info, enable_tracing);
 				sp_rtrace_register_resource(&res_gobject);
 				trace_init_rt = trace_rt;
@@ -226,6 +264,30 @@ static void trace_g_object_unref(gpointer object)
 }
 
 
+/*
+ * live object statistics functions
+ */
+static gpointer summary_g_object_newv(GType object_type, guint n_parameters, GParameter* parameters)
+{
+	gpointer rc = trace_off.g_object_newv(object_type, n_parameters, parameters);
+	if (rc) objstat_add(&objstat, (pointer_t)rc, (pointer_t)object_type);
+	return rc;
+}
+
+
+static void summary_g_type_free_instance(GTypeInstance* instance)
+{
+	/* unregister the instance before releasing it, so the address can't be
+	 * reused by another thread before the record is removed */
+	objstat_remove(&objstat, (pointer_t)instance);
+	trace_off.g_type_free_instance(instance);
+}
+
+static trace_t trace_summary = {
+	.g_object_newv = summary_g_object_newv,
+	.g_type_free_instance = summary_g_type_free_instance,
+};
+
 
 static trace_t trace_on = {
 	.g_object_newv = trace_g_object_newv,
@@ -26,7 +26,10 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
@@ -39,6 +42,7 @@
 #include <fcntl.h>
 #include <dlfcn.h>
 #include <malloc.h>
+#include <link.h>
 
 #include "rtrace/rtrace_env.h"
 #include "rtrace_common.h"
@@ -71,6 +75,12 @@ static int fd_proc = 0;
 /*  pre-processor pipe path */
 static char pipe_path[sizeof(SP_RTRACE_PIPE_PATTERN) + 16];
 
+/* the sp-rtrace daemon socket address, used in managed mode if set */
+static struct sockaddr_un daemon_addr = {.sun_family = AF_UNIX};
+
+/* true if the pre-processor pipe is connected to sp-rtrace daemon */
+static bool daemon_connected = false;
+
 /* backtrace lock for thread synchronization */
 __thread volatile sync_entity_t backtrace_lock = 0;
 
@@ -125,6 +135,8 @@ typedef struct rtrace_module_t {
 	unsigned char vmajor;
 	unsigned char vminor;
 	sp_rtrace_enable_tracing_t enable;
+	/* false if the module was deactivated with the runtime control file */
+	bool active;
 } rtrace_module_t;
 
 /* trace submodules */
@@ -138,6 +150,34 @@ static unsigned int rtrace_module_index = 0;
 static module_resource_t rtrace_resources[32];
 static unsigned int rtrace_resource_index = 0;
 
+/* the deactivated resource type mask, resource id N corresponds to bit N-1 */
+static unsigned int rtrace_disabled_resources = 0;
+
+
+/*
+ * Runtime module/resource control.
+ *
+ * The control file (SP_RTRACE_CONTROL) contains list of module names and
+ * resource types separated by whitespace or commas. Names prefixed with '-'
+ * are deactivated, others (optionally prefixed with '+') are activated.
+ * The name 'all' matches all modules and resources. The control file
+ * is read at startup and whenever the control signal is received.
+ */
+typedef struct control_rule_t {
+	const char* name;
+	bool value;
+} control_rule_t;
+
+/* the control file path */
+static char control_path[PATH_MAX];
+
+/* the control file contents, referenced by the control rules */
+static char control_data[1024];
+
+/* the control rules */
+static control_rule_t control_rules[64];
+static unsigned int control_rule_count = 0;
+
 /* inserts data at saved position */
 #define PACKET_INSERT(ptr, type, value) \
 	write_##type(ptr, value);
@@ -199,10 +239,89 @@ static void enable_tracing(bool value)
 {
 	unsigned int i;
 	for (i = 0; i < rtrace_module_index; i++) {
-		rtrace_modules[i].enable(value);
+		rtrace_modules[i].enable(value && rtrace_modules[i].active);
 	}
 }
 
+/* true while the modules are being disabled before closing the output pipe */
+static bool final_state_enabled = false;
+
+/**
+ * Disables tracing before closing the output pipe.
+ *
+ * The modules can write their final state data from the tracing
+ * enable function with sp_rtrace_write_final_function_call().
+ * @return
+ */
+static void disable_tracing_final(void)
+{
+	final_state_enabled = true;
+	enable_tracing(false);
+	final_state_enabled = false;
+}
+
+/**
+ * Reads control rules from the control file.
+ *
+ * @return   true if the control file was read successfully.
+ */
+static bool read_control_rules(void)
+{
+	int fd = open(control_path, O_RDONLY);
+	if (fd == -1) return false;
+	int size = read(fd, control_data, sizeof(control_data) - 1);
+	close(fd);
+	if (size < 0) return false;
+	control_data[size] = '\0';
+
+	control_rule_count = 0;
+	char* ptr = control_data;
+	while (*ptr && control_rule_count < ARRAY_SIZE(control_rules)) {
+		while (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == ',') ptr++;
+		if (!*ptr) break;
+		control_rule_t* rule = &control_rules[control_rule_count];
+		rule->value = (*ptr != '-');
+		if (*ptr == '-' || *ptr == '+') ptr++;
+		rule->name = ptr;
+		while (*ptr && *ptr != ' ' && *ptr != '\t' && *ptr != '\n' && *ptr != ',') ptr++;
+		if (*ptr) *ptr++ = '\0';
+		if (*rule->name) control_rule_count++;
+	}
+	return true;
+}
+
+/**
+ * Finds the control state of the specified module or resource.
+ *
+ * @param[in] name   the module name or resource type.
+ * @return           1 - activate, 0 - deactivate, -1 - not specified.
+ */
+static int get_control_state(const char* name)
+{
+	int state = -1;
+	unsigned int i;
+	/* the last matching rule takes precedence */
+	for (i = 0; i < control_rule_count; i++) {
+		if (!strcmp(control_rules[i].name, name) || !strcmp(control_rules[i].name, "all")) {
+			state = control_rules[i].value;
+		}
+	}
+	return state;
+}
+
+/**
+ * Sets the resource type activation state.
+ *
+ * @param[in] id      the resource type id.
+ * @param[in] value   true to activate, false to deactivate.
+ */
+static void set_resource_state(unsigned int id, bool value)
+{
+	unsigned int mask = 1 << (id - 1);
+	if (value) rtrace_disabled_resources &= ~mask;
+	else rtrace_disabled_resources |= mask;
+}
+
 
 /**
  * Opens named pipe to the pre-processor.
@@ -214,6 +333,22 @@ static void enable_tracing(bool value)
  */
 static int open_pipe(void)
 {
+	if (sp_rtrace_options->manage_preproc && *daemon_addr.sun_path) {
+		/* connect to the sp-rtrace daemon instead of spawning
+		 * a new pre-processor process */
+		LOG("connecting to sp-rtrace daemon %s", daemon_addr.sun_path);
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd != -1) {
+			if (connect(fd, (struct sockaddr*)&daemon_addr, sizeof(daemon_addr)) == 0) {
+				daemon_connected = true;
+				return fd;
+			}
+			close(fd);
+		}
+		fprintf(stderr, "WARNING: Failed to connect to sp-rtrace daemon %s (%s), "
+				"spawning pre-processor process instead.\n", daemon_addr.sun_path, strerror(errno));
+	}
+	daemon_connected = false;
 	if (sp_rtrace_options->manage_preproc) {
 		LOG("spawning pre-processor process");
 		/* spawn the pre-processor process if */
@@ -278,6 +413,9 @@ static void close_pipe(int fd)
 {
 	close(fd);
 
+	/* the daemon is not a child process */
+	if (daemon_connected) return;
+
 	int status;
 	wait(&status);
 }
@@ -517,6 +655,165 @@ static int write_heap_info(void)
 
 
 
+/*
+ * Memory mapping reporting.
+ *
+ * Instead of requesting pre-processor to rescan the process memory maps
+ * (NL packet) after every dlopen() call, the executable segments of the
+ * newly loaded objects are reported with memory map (MM) packets.
+ * dl_iterate_phdr() lists the loaded objects in the load order and
+ * reports the number of object loads and unloads. So unless objects were
+ * unloaded in the meantime, only the objects following the previously
+ * reported ones must be written.
+ */
+typedef struct mmap_scan_t {
+	/* the index of the currently iterated object */
+	unsigned int index;
+	/* the index of the first object to report */
+	unsigned int from;
+	/* true if the mappings must be written, false to update the counters only */
+	bool write;
+	/* false if the object load/unload counters are not supported */
+	bool supported;
+} mmap_scan_t;
+
+/* the number of loaded objects at the last report */
+static unsigned int mmap_objects = 0;
+
+/* the object load/unload counters at the last report */
+static unsigned long long mmap_adds = 0;
+static unsigned long long mmap_subs = 0;
+
+/* the memory mapping report lock */
+static sync_entity_t mmap_lock = 0;
+
+/**
+ * Writes memory map (MM) packet into processor pipe.
+ *
+ * @param[in] from    the mapping start address.
+ * @param[in] to      the mapping end address.
+ * @param[in] module  the mapped module name.
+ * @param[in] build_id  the module build-id in hex format (empty if unknown).
+ * @param[in] bias    the module load bias.
+ * @return            the number of bytes written.
+ */
+static int write_memory_map(pointer_t from, pointer_t to, const char* module, const char* build_id,
+		pointer_t bias)
+{
+	PACKET_INIT(SP_RTRACE_PROTO_MEMORY_MAP);
+	PACKET_WRITE(pointer, from);
+	PACKET_WRITE(pointer, to);
+	PACKET_WRITE(string, module);
+	PACKET_WRITE(string, build_id);
+	PACKET_WRITE(pointer, bias);
+	PACKET_FINISH();
+}
+
+/**
+ * Formats the build-id of a loaded object.
+ *
+ * The build-id is read from the GNU build-id note in the already
+ * mapped note segments of the object.
+ * @param[in] info      the loaded object information.
+ * @param[out] build_id the build-id in hex format, empty if the object
+ *                      has no build-id.
+ * @param[in] size      the output buffer size.
+ */
+static void get_object_build_id(struct dl_phdr_info* info, char* build_id, size_t size)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
+	*build_id = '\0';
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+		if (phdr->p_type != PT_NOTE) continue;
+		const char* ptr = (const char*)(info->dlpi_addr + phdr->p_vaddr);
+		const char* end = ptr + phdr->p_memsz;
+		while (ptr + sizeof(ElfW(Nhdr)) <= end) {
+			const ElfW(Nhdr)* note = (const ElfW(Nhdr)*)ptr;
+			const unsigned char* desc = (const unsigned char*)ptr + sizeof(ElfW(Nhdr)) + ((note->n_namesz + 3) & ~3);
+			if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && !memcmp(ptr + sizeof(ElfW(Nhdr)), "GNU", 4) &&
+					note->n_descsz * 2 < size && (const char*)desc + note->n_descsz <= end) {
+				unsigned int j;
+				for (j = 0; j < note->n_descsz; j++) {
+					*build_id++ = hex[desc[j] >> 4];
+					*build_id++ = hex[desc[j] & 0xf];
+				}
+				*build_id = '\0';
+				return;
+			}
+			ptr = (const char*)desc + ((note->n_descsz + 3) & ~3);
+		}
+	}
+}
+
+/**
+ * Reports the executable segments of a loaded object.
+ *
+ * This is dl_iterate_phdr() callback function.
+ * @param[in] info   the loaded object information.
+ * @param[in] size   the size of the information structure.
+ * @param[in] data   the scan state.
+ * @return           0 - continue iteration, 1 - stop iteration.
+ */
+static int report_object_mappings(struct dl_phdr_info* info, size_t size, void* data)
+{
+	mmap_scan_t* scan = (mmap_scan_t*)data;
+	if (size < offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs)) {
+		scan->supported = false;
+		return 1;
+	}
+	if (scan->index == 0) {
+		/* nothing was loaded or unloaded since the last report */
+		if (info->dlpi_adds == mmap_adds && info->dlpi_subs == mmap_subs) return 1;
+		/* the objects were unloaded, report all objects again - the
+		 * pre-processor drops the already known mappings */
+		if (info->dlpi_subs != mmap_subs) scan->from = 0;
+		mmap_adds = info->dlpi_adds;
+		mmap_subs = info->dlpi_subs;
+	}
+	if (scan->index++ < scan->from || !scan->write) return 0;
+	/* the main executable (empty name) is reported by the initial scan */
+	if (!*info->dlpi_name) return 0;
+
+	long page_mask = ~(sysconf(_SC_PAGESIZE) - 1);
+	char build_id[SP_RTRACE_BUILD_ID_SIZE * 2 + 1];
+	get_object_build_id(info, build_id, sizeof(build_id));
+	int i;
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+		if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_X)) continue;
+		pointer_t from = info->dlpi_addr + phdr->p_vaddr;
+		pointer_t to = (from + phdr->p_memsz - page_mask - 1) & page_mask;
+		write_memory_map(from & page_mask, to, info->dlpi_name, build_id, info->dlpi_addr);
+	}
+	return 0;
+}
+
+/**
+ * Reports the memory mappings of the objects loaded since the last report.
+ *
+ * @param[in] write   false to update the loaded object counters without
+ *                    reporting the mappings.
+ * @return            true - success, false - the loaded object counters are
+ *                    not supported and the mappings were not reported.
+ */
+static bool report_new_mappings(bool write)
+{
+	mmap_scan_t scan = {
+		.index = 0,
+		.from = mmap_objects,
+		.write = write,
+		.supported = true,
+	};
+	while (!sync_bool_compare_and_swap(&mmap_lock, 0, 1));
+	dl_iterate_phdr(report_object_mappings, &scan);
+	/* the iteration is stopped at the first object if nothing was changed */
+	if (scan.index) mmap_objects = scan.index;
+	mmap_lock = 0;
+	return scan.supported;
+}
+
 /**
  * Writes initial data packets (HS + MI) into processor pipe
  * and flushed it.
@@ -548,11 +845,13 @@ static void write_initial_data(void)
 	}
 
 	sp_rtrace_write_new_library("*");
+	/* the full memory map scan covers the currently loaded objects */
+	report_new_mappings(false);
 	pipe_buffer_flush();
 }
 
 /**
- * Monitor dlopen calls to generate new library (NL) packets.
+ * Monitor dlopen calls to report the memory mappings of new libraries.
  */
 static void* (*dlopen_rt)(const char*, int);
 
@@ -567,7 +866,7 @@ void* dlopen(const char* library, int flag)
 {
 	void* handle = dlopen_rt(library, flag);
 	if (handle && sp_rtrace_options->enable) {
-		sp_rtrace_write_new_library(library);
+		if (!report_new_mappings(true)) sp_rtrace_write_new_library(library);
 	}
 	return handle;
 }
@@ -590,7 +889,7 @@ static void signal_toggle_tracing(int signo __attribute((unused)))
 		if (fd_proc > 0) {
 			sp_rtrace_write_new_library("*");
 			write_heap_info();
-			enable_tracing(false);
+			disable_tracing_final();
 			pipe_buffer_flush();
 			close_pipe(fd_proc);
 			fd_proc = 0;
@@ -598,6 +897,29 @@ static void signal_toggle_tracing(int signo __attribute((unused)))
 	}
 }
 
+/**
+ * Signal handler for runtime module/resource control
+ */
+static void signal_control_tracing(int signo __attribute((unused)))
+{
+	if (!read_control_rules()) return;
+
+	unsigned int i;
+	for (i = 0; i < rtrace_module_index; i++) {
+		rtrace_module_t* module = &rtrace_modules[i];
+		int state = get_control_state(module->name);
+		if (state != -1 && module->active != state) {
+			LOG("module %s active=%d", module->name, state);
+			module->active = state;
+			if (sp_rtrace_options->enable) module->enable(state);
+		}
+	}
+	for (i = 0; i < rtrace_resource_index; i++) {
+		int state = get_control_state(rtrace_resources[i].type);
+		if (state != -1) set_resource_state(rtrace_resources[i].id, state);
+	}
+}
+
 /**
  * Copies at most size bytes from string src to dst including
  * the trailing null byte.
@@ -738,41 +1060,18 @@ static bool filter_validate(const sp_rtrace_filter_t* filter, const module_fcall
 	return sp_rtrace_filter_validate(filter, &fcall);
 }
 
-/*
- * Public API implementation
+/**
+ * Writes function call, arguments and backtrace packets into processor pipe.
+ *
+ * @param[in] call   the function call data.
+ * @param[in] trace  the backtrace data (can be NULL).
+ * @param[in] args   the function argument data (can be NULL).
+ * @return           the number of bytes written.
  */
-
-int sp_rtrace_write_new_library(const char* library)
-{
-	PACKET_INIT(SP_RTRACE_PROTO_NEW_LIBRARY);
-	PACKET_WRITE(string, library);
-	PACKET_FINISH();
-}
-
-int sp_rtrace_write_attachment(const module_attachment_t* file)
-{
-	/* try to relate the attachment to the output directory */
-	char relative_path[PATH_MAX];
-	calc_relative_path(sp_rtrace_options->output_dir, file->path, relative_path);
-
-	PACKET_INIT(SP_RTRACE_PROTO_ATTACHMENT);
-	PACKET_WRITE(string, file->name);
-	PACKET_WRITE(string, relative_path);
-	PACKET_FINISH();
-}
-
-int sp_rtrace_write_context_registry(const module_context_t* context)
+static int write_function_call(const module_fcall_t* call, const module_ftrace_t* trace, const module_farg_t* args)
 {
-	if (!sp_rtrace_options->enable) return 0;
-	PACKET_INIT(SP_RTRACE_PROTO_CONTEXT_REGISTRY);
-	PACKET_WRITE(dword, context->id);
-	PACKET_WRITE(string, context->name);
-	PACKET_FINISH();
-}
-
-int sp_rtrace_write_function_call(const module_fcall_t* call, const module_ftrace_t* trace, const module_farg_t* args)
-{
-	if (!sp_rtrace_options->enable) return 0;
+	if (rtrace_disabled_resources && call->res_type_id &&
+			(rtrace_disabled_resources & (1 << (call->res_type_id - 1)))) return 0;
 
 	pointer_t bt_frames[256];
 	module_ftrace_t trace_data = {
@@ -856,6 +1155,51 @@ int sp_rtrace_write_function_call(const module_fcall_t* call, const module_ftrac
 	PACKET_FINISH();
 }
 
+/*
+ * Public API implementation
+ */
+
+int sp_rtrace_write_new_library(const char* library)
+{
+	PACKET_INIT(SP_RTRACE_PROTO_NEW_LIBRARY);
+	PACKET_WRITE(string, library);
+	PACKET_FINISH();
+}
+
+int sp_rtrace_write_attachment(const module_attachment_t* file)
+{
+	/* try to relate the attachment to the output directory */
+	char relative_path[PATH_MAX];
+	calc_relative_path(sp_rtrace_options->output_dir, file->path, relative_path);
+
+	PACKET_INIT(SP_RTRACE_PROTO_ATTACHMENT);
+	PACKET_WRITE(string, file->name);
+	PACKET_WRITE(string, relative_path);
+	PACKET_FINISH();
+}
+
+int sp_rtrace_write_context_registry(const module_context_t* context)
+{
+	if (!sp_rtrace_options->enable) return 0;
+	PACKET_INIT(SP_RTRACE_PROTO_CONTEXT_REGISTRY);
+	PACKET_WRITE(dword, context->id);
+	PACKET_WRITE(string, context->name);
+	PACKET_FINISH();
+}
+
+int sp_rtrace_write_function_call(const module_fcall_t* call, const module_ftrace_t* trace, const module_farg_t* args)
+{
+	if (!sp_rtrace_options->enable) return 0;
+	return write_function_call(call, trace, args);
+}
+
+int sp_rtrace_write_final_function_call(const module_fcall_t* call, const module_ftrace_t* trace, const module_farg_t* args)
+{
+	if (!sp_rtrace_options->enable && !final_state_enabled) return 0;
+	return write_function_call(call, trace, args);
+}
+
+
 unsigned int sp_rtrace_register_module(const sp_rtrace_module_info_t *info, sp_rtrace_enable_tracing_t enable_func)
 {
 	unsigned int i, ok = 1;
@@ -877,7 +1221,8 @@ unsigned int sp_rtrace_register_module(const sp_rtrace_module_info_t *info, sp_r
 	module->vminor = info->version_minor;
 	module->name = info->name;
 	module->id = (1 << rtrace_module_index++);
-	module->enable(sp_rtrace_options->enable);
+	module->active = (get_control_state(module->name) != 0);
+	module->enable(sp_rtrace_options->enable && module->active);
 
 	/* If the tracing has been already enabled,
 	 *  write module info packet for the registered module */
@@ -905,6 +1250,7 @@ unsigned int sp_rtrace_register_resource(module_resource_t* resource)
 	}
 	resource->id = rtrace_resource_index + 1;
 	rtrace_resources[rtrace_resource_index++] = *resource;
+	if (get_control_state(resource->type) == 0) set_resource_state(resource->id, false);
 	if (sp_rtrace_options->enable) {
 		write_resource_registry(resource);
 	}
@@ -976,6 +1322,13 @@ bool sp_rtrace_initialize(void)
 			unsetenv("LD_PRELOAD");
 		}
 
+		/* read sp-rtrace daemon socket option */
+		const char* env_daemon = getenv(rtrace_env_opt[OPT_DAEMON]);
+		if (env_daemon) {
+			_stpncpy(daemon_addr.sun_path, env_daemon, sizeof(daemon_addr.sun_path));
+			LOG("daemon=%s", daemon_addr.sun_path);
+		}
+
 		/* read post-processor options */
 		const char* env_postproc = getenv(rtrace_env_opt[OPT_POSTPROC]);
 		if (env_postproc) {
@@ -1115,6 +1468,28 @@ static void trace_main_init(void)
 		fprintf(stderr, "ERROR: failed to set signal %d\n", toggle_signal);
 		exit (-1);
 	}
+
+	/* read the runtime control file and set up the control signal */
+	const char* env_control = getenv(SP_RTRACE_CONTROL);
+	if (env_control && *env_control) {
+		_stpncpy(control_path, env_control, sizeof(control_path));
+		read_control_rules();
+
+		int control_signal = SIGUSR2;
+		const char* env_control_signal = getenv(SP_RTRACE_CONTROL_SIGNAL);
+		if (env_control_signal) {
+			int sig = atoi(env_control_signal);
+			if (sig) control_signal = sig;
+		}
+		LOG("control=%s, control_signal=%d", control_path, control_signal);
+
+		struct sigaction sa_control = {.sa_handler = signal_control_tracing};
+		sigemptyset(&sa_control.sa_mask);
+		if (sigaction(control_signal, &sa_control, NULL) == -1) {
+			fprintf(stderr, "ERROR: failed to set signal %d\n", control_signal);
+			exit (-1);
+		}
+	}
 }
 
 static void trace_main_fini(void)
@@ -1124,7 +1499,7 @@ static void trace_main_fini(void)
 			sp_rtrace_write_new_library("*");
 			write_heap_info();
 		}
-		enable_tracing(false);
+		disable_tracing_final();
 		pipe_buffer_flush();
 		close_pipe(fd_proc);
 	}
@@ -82,6 +82,20 @@ extern sp_rtrace_options_t* sp_rtrace_options;
  */
 int sp_rtrace_write_function_call(const module_fcall_t* call, const module_ftrace_t* trace, const module_farg_t* args);
 
+/**
+ * Writes function call packet into processor pipe while tracing is
+ * being disabled.
+ *
+ * The tracing enable flag is cleared before the modules are disabled,
+ * so this function must be used by modules to report their final state
+ * data from the tracing enable function. Otherwise it works like
+ * sp_rtrace_write_function_call() function.
+ * @param[in] call  the function call data.
+ * @param[in] args  the function argument data (can be NULL).
+ * @return          the number of bytes written.
+ */
+int sp_rtrace_write_final_function_call(const module_fcall_t* call, const module_ftrace_t* trace, const module_farg_t* args);
+
 
 typedef void (*sp_rtrace_enable_tracing_t)(bool);
 
@@ -93,6 +107,9 @@ typedef void (*sp_rtrace_enable_tracing_t)(bool);
  * The main module uses registered functions to disable tracing in all modules before
  * calling some libc functions (for example backtrace). Or some functions might end
  * in infinite recursion.
+ * When tracing is being disabled the enabling function is called before the
+ * output pipe is closed, so the module can report its final state data with
+ * sp_rtrace_write_final_function_call() function.
  * @param[in] info          pointer to the module information structure.
  * @param[in] enable_func   the trace enabling/disabling function.
  * @return                  the module id or 0 if module registry is full.
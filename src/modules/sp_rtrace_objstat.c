@@ -0,0 +1,388 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "sp_rtrace_main.h"
+#include "sp_rtrace_module.h"
+#include "sp_rtrace_objstat.h"
+
+/* the initial live object table size */
+#define OBJECTS_HASH_SIZE   (1 << 12)
+
+/* the initial class table size */
+#define CLASSES_HASH_SIZE   (1 << 8)
+
+/* the postponed snapshot states */
+enum {
+	SNAPSHOT_NONE = 0,
+	SNAPSHOT_FULL,
+	SNAPSHOT_EMPTY,
+};
+
+/**
+ * Compares two live object records.
+ */
+static long object_compare(const objstat_object_t* obj1, const objstat_object_t* obj2)
+{
+	return obj1->instance == obj2->instance ? 0 : (obj1->instance < obj2->instance ? -1 : 1);
+}
+
+/**
+ * Calculates hash value for the live object record.
+ *
+ * The hash table scrambles the returned value, so the instance
+ * address can be used directly.
+ */
+static long object_hash(const objstat_object_t* obj)
+{
+	return obj->instance;
+}
+
+/**
+ * Compares two class records.
+ */
+static long class_compare(const objstat_class_t* cls1, const objstat_class_t* cls2)
+{
+	return cls1->id == cls2->id ? 0 : (cls1->id < cls2->id ? -1 : 1);
+}
+
+/**
+ * Calculates hash value for the class record.
+ */
+static long class_hash(const objstat_class_t* cls)
+{
+	return cls->id;
+}
+
+/**
+ * Locks the statistics tables.
+ *
+ * @param[in] stat  the statistics.
+ */
+static void objstat_lock(objstat_t* stat)
+{
+	while (!sync_bool_compare_and_swap(&stat->lock, 0, 1)) sched_yield();
+}
+
+/**
+ * Tries to lock the statistics tables without waiting.
+ *
+ * Used only by the snapshot requested from the toggle signal handler,
+ * which could have interrupted the thread holding the lock.
+ * @param[in] stat  the statistics.
+ * @return          true if the tables were locked.
+ */
+static bool objstat_trylock(objstat_t* stat)
+{
+	return sync_bool_compare_and_swap(&stat->lock, 0, 1);
+}
+
+/**
+ * Unlocks the statistics tables.
+ */
+static void objstat_unlock(objstat_t* stat)
+{
+	stat->lock = 0;
+}
+
+/**
+ * Locates the class record, creating new one if necessary.
+ *
+ * @param[in] stat      the statistics.
+ * @param[in] class_id  the class identifier.
+ * @return              the class record.
+ */
+static objstat_class_t* get_class(objstat_t* stat, pointer_t class_id)
+{
+	objstat_class_t template = {.id = class_id};
+	objstat_class_t* cls = (objstat_class_t*)hmap_find(&stat->classes, &template);
+	if (!cls) {
+		cls = (objstat_class_t*)malloc_a(sizeof(objstat_class_t));
+		cls->id = class_id;
+		cls->name = stat->get_class_name(class_id);
+		cls->live = 0;
+		cls->peak = 0;
+		cls->last = 0;
+		hmap_store(&stat->classes, cls);
+	}
+	return cls;
+}
+
+/**
+ * Adds a live object to its class statistics.
+ *
+ * @param[in] cls   the object class.
+ */
+static void class_add_object(objstat_class_t* cls)
+{
+	if (++cls->live > cls->peak) cls->peak = cls->live;
+}
+
+/**
+ * Resolves the class of a live object registered without class id.
+ *
+ * @param[in] obj   the live object record.
+ * @param[in] stat  the statistics.
+ * @return
+ */
+static long resolve_object_class(objstat_object_t* obj, objstat_t* stat)
+{
+	if (obj->cls) return 0;
+	pointer_t class_id = stat->get_class_id(obj->instance);
+	if (class_id) {
+		obj->cls = get_class(stat, class_id);
+		class_add_object(obj->cls);
+		stat->unresolved--;
+	}
+	return 0;
+}
+
+/**
+ * Class reference array used for snapshot sorting.
+ */
+typedef struct {
+	objstat_class_t** items;
+	int size;
+} class_array_t;
+
+/**
+ * Adds class record into class reference array.
+ */
+static long store_class_ref(objstat_class_t* cls, class_array_t* array)
+{
+	array->items[array->size++] = cls;
+	return 0;
+}
+
+/**
+ * Compares class records by the number of live instances (descending).
+ */
+static int class_compare_live(const void* item1, const void* item2)
+{
+	const objstat_class_t* cls1 = *(objstat_class_t* const*)item1;
+	const objstat_class_t* cls2 = *(objstat_class_t* const*)item2;
+	if (cls1->live != cls2->live) return cls2->live > cls1->live ? 1 : -1;
+	return strcmp(cls1->name ? cls1->name : "", cls2->name ? cls2->name : "");
+}
+
+/**
+ * Writes the class statistics into file.
+ *
+ * @param[in] stat   the statistics.
+ * @param[in] fd     the output file descriptor.
+ * @param[in] empty  true if the statistics are waiting for reset
+ *                   and must be reported as empty.
+ * @return           0 - success, -errno - failure.
+ */
+static int write_classes(objstat_t* stat, int fd, bool empty)
+{
+	char buffer[1024];
+	int count = stat->classes.count, size, i, rc = 0;
+
+	class_array_t array = {
+		.items = (objstat_class_t**)malloc_a((count ? count : 1) * sizeof(objstat_class_t*)),
+		.size = 0,
+	};
+	if (!empty) hmap_foreach2(&stat->classes, (op_binary_t)store_class_ref, &array);
+	qsort(array.items, array.size, sizeof(objstat_class_t*), class_compare_live);
+
+	size = snprintf(buffer, sizeof(buffer), "# %s live objects, snapshot %u\n# %8s %8s %8s  %s\n",
+			stat->name, stat->snapshot_index, "live", "change", "peak", "class");
+	if (write(fd, buffer, size) != size) rc = -errno;
+
+	for (i = 0; i < array.size && rc == 0; i++) {
+		objstat_class_t* cls = array.items[i];
+		size = snprintf(buffer, sizeof(buffer), "  %8ld %+8ld %8ld  %s\n", cls->live, cls->live - cls->last,
+				cls->peak, cls->name ? cls->name : "unknown");
+		if (size >= (int)sizeof(buffer)) size = sizeof(buffer) - 1;
+		if (write(fd, buffer, size) != size) rc = -errno;
+		cls->last = cls->live;
+	}
+	if (stat->unresolved && !empty && rc == 0) {
+		size = snprintf(buffer, sizeof(buffer), "  %8ld %8s %8s  %s\n", stat->unresolved, "", "", "(unresolved)");
+		if (write(fd, buffer, size) != size) rc = -errno;
+	}
+	free(array.items);
+	return rc;
+}
+
+/**
+ * Clears the statistics tables if reset was requested.
+ *
+ * Must be called with the tables locked.
+ * @param[in] stat  the statistics.
+ */
+static void apply_reset(objstat_t* stat)
+{
+	if (!stat->reset_pending) return;
+	hmap_free(&stat->objects, (op_unary_t)free);
+	hmap_free(&stat->classes, (op_unary_t)free);
+	hmap_init(&stat->objects, OBJECTS_HASH_SIZE, (op_unary_t)object_hash, (op_binary_t)object_compare);
+	hmap_init(&stat->classes, CLASSES_HASH_SIZE, (op_unary_t)class_hash, (op_binary_t)class_compare);
+	stat->unresolved = 0;
+	stat->reset_pending = 0;
+}
+
+/**
+ * Writes the per-class statistics snapshot into a file and sends
+ * attachment packet to the pre-processor.
+ *
+ * Must be called with the tables locked.
+ * @param[in] stat   the statistics.
+ * @param[in] empty  true if the statistics are waiting for reset
+ *                   and must be reported as empty.
+ * @return           0 - success, -errno - failure.
+ */
+static int write_snapshot(objstat_t* stat, bool empty)
+{
+	char pattern[64], filename[PATH_MAX];
+	int rc;
+
+	stat->snapshot_pending = SNAPSHOT_NONE;
+	if (stat->interval) stat->snapshot_time = time(NULL) + stat->interval;
+
+	snprintf(pattern, sizeof(pattern), "%s-classes", stat->name);
+	sp_rtrace_get_out_filename(pattern, filename, sizeof(filename));
+	int fd = creat(filename, 0644);
+	if (fd == -1) {
+		rc = -errno;
+		fprintf(stderr, "ERROR: failed to create %s statistics file %s (%s)\n", stat->name, filename, strerror(-rc));
+		return rc;
+	}
+	if (stat->get_class_id && !empty) {
+		hmap_foreach2(&stat->objects, (op_binary_t)resolve_object_class, stat);
+	}
+	rc = write_classes(stat, fd, empty);
+	stat->snapshot_index++;
+	close(fd);
+
+	module_attachment_t file = {
+			.name = pattern,
+			.path = filename,
+	};
+	sp_rtrace_write_attachment(&file);
+	return rc;
+}
+
+/**
+ * Prepares the tables for update.
+ *
+ * Writes the snapshot postponed by objstat_write_snapshot() and clears
+ * the tables if reset was requested. Must be called with the tables
+ * locked.
+ * @param[in] stat  the statistics.
+ */
+static void begin_update(objstat_t* stat)
+{
+	if (stat->snapshot_pending) write_snapshot(stat, stat->snapshot_pending == SNAPSHOT_EMPTY);
+	apply_reset(stat);
+}
+
+/*
+ * Public API implementation
+ */
+
+void objstat_init(objstat_t* stat, const char* name, unsigned int interval,
+		objstat_get_class_id_t get_class_id, objstat_get_class_name_t get_class_name)
+{
+	stat->name = name;
+	stat->interval = interval;
+	stat->get_class_id = get_class_id;
+	stat->get_class_name = get_class_name;
+	stat->snapshot_time = interval ? time(NULL) + interval : 0;
+	stat->snapshot_index = 0;
+	stat->unresolved = 0;
+	stat->lock = 0;
+	stat->reset_pending = 0;
+	stat->snapshot_pending = SNAPSHOT_NONE;
+	hmap_init(&stat->objects, OBJECTS_HASH_SIZE, (op_unary_t)object_hash, (op_binary_t)object_compare);
+	hmap_init(&stat->classes, CLASSES_HASH_SIZE, (op_unary_t)class_hash, (op_binary_t)class_compare);
+}
+
+void objstat_reset(objstat_t* stat)
+{
+	/* freeing the tables is not safe in signal handler, leave it to the next update */
+	stat->reset_pending = 1;
+	if (stat->interval) stat->snapshot_time = time(NULL) + stat->interval;
+}
+
+void objstat_add(objstat_t* stat, pointer_t instance, pointer_t class_id)
+{
+	objstat_object_t* obj = (objstat_object_t*)malloc_a(sizeof(objstat_object_t));
+	obj->instance = instance;
+
+	objstat_lock(stat);
+	begin_update(stat);
+	obj->cls = class_id ? get_class(stat, class_id) : NULL;
+	if (obj->cls) class_add_object(obj->cls);
+	else stat->unresolved++;
+
+	/* The instance address might be reused without the destructor being
+	 * tracked (for example when tracing was disabled at that time).
+	 * Replace the stale record in this case. */
+	objstat_object_t* old = (objstat_object_t*)hmap_store(&stat->objects, obj);
+	if (old) {
+		if (old->cls) old->cls->live--;
+		else stat->unresolved--;
+		free(old);
+	}
+	if (stat->interval && time(NULL) >= stat->snapshot_time) write_snapshot(stat, false);
+	objstat_unlock(stat);
+}
+
+void objstat_remove(objstat_t* stat, pointer_t instance)
+{
+	objstat_object_t template = {.instance = instance};
+
+	objstat_lock(stat);
+	begin_update(stat);
+	objstat_object_t* obj = (objstat_object_t*)hmap_find(&stat->objects, &template);
+	if (obj) {
+		hmap_remove(&stat->objects, obj);
+		if (obj->cls) obj->cls->live--;
+		else stat->unresolved--;
+	}
+	objstat_unlock(stat);
+
+	if (obj) free(obj);
+}
+
+int objstat_write_snapshot(objstat_t* stat)
+{
+	if (!objstat_trylock(stat)) {
+		/* leave the snapshot to the next update instead of deadlocking */
+		stat->snapshot_pending = stat->reset_pending ? SNAPSHOT_EMPTY : SNAPSHOT_FULL;
+		return -EBUSY;
+	}
+	int rc = write_snapshot(stat, stat->reset_pending);
+	objstat_unlock(stat);
+	return rc;
+}
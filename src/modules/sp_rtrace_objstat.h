@@ -0,0 +1,181 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file sp_rtrace_objstat.h
+ *
+ * Live object statistics support for object tracking modules
+ * (gobject, qobject).
+ *
+ * Instead of reporting every constructor/destructor/reference call
+ * the module registers the live objects in a table keyed by the
+ * instance address. Each object refers to its class record, which
+ * holds the class name (retrieved only once per class) and the
+ * number of live class instances. The per-class statistics are
+ * written into an attachment file when tracing is disabled and
+ * optionally at regular intervals.
+ */
+
+#ifndef SP_RTRACE_OBJSTAT_H
+#define SP_RTRACE_OBJSTAT_H
+
+#include <time.h>
+
+#include "common/hmap.h"
+#include "common/utils.h"
+#include "library/sp_rtrace_defs.h"
+
+/**
+ * Retrieves class identifier of the specified instance.
+ *
+ * Used to resolve classes of objects registered with zero class id.
+ * @param[in] instance  the object instance.
+ * @return              the class identifier or 0 if it can't be resolved.
+ */
+typedef pointer_t (*objstat_get_class_id_t)(pointer_t instance);
+
+/**
+ * Retrieves name of the specified class.
+ *
+ * @param[in] class_id  the class identifier.
+ * @return              the class name. The returned string must stay
+ *                      valid as long as the class is alive.
+ */
+typedef const char* (*objstat_get_class_name_t)(pointer_t class_id);
+
+/**
+ * Object class statistics.
+ */
+typedef struct objstat_class_t {
+	/* the class identifier */
+	pointer_t id;
+	/* the class name */
+	const char* name;
+	/* the number of live class instances */
+	long live;
+	/* the peak number of live class instances */
+	long peak;
+	/* the number of live instances at the last snapshot */
+	long last;
+} objstat_class_t;
+
+/**
+ * Live object record.
+ */
+typedef struct objstat_object_t {
+	/* the object instance address */
+	pointer_t instance;
+	/* the object class, NULL if not resolved yet */
+	objstat_class_t* cls;
+} objstat_object_t;
+
+/**
+ * Live object statistics.
+ */
+typedef struct objstat_t {
+	/* the statistics name, used as attachment name prefix */
+	const char* name;
+	/* the live objects, indexed by instance address */
+	hmap_t objects;
+	/* the object classes, indexed by class identifier */
+	hmap_t classes;
+	/* the class identifier resolver (can be NULL) */
+	objstat_get_class_id_t get_class_id;
+	/* the class name resolver */
+	objstat_get_class_name_t get_class_name;
+	/* the snapshot interval in seconds, 0 - snapshots are written
+	 * only when tracing is disabled */
+	unsigned int interval;
+	/* the next periodic snapshot time */
+	time_t snapshot_time;
+	/* the snapshot counter */
+	unsigned int snapshot_index;
+	/* the number of unresolved live objects */
+	long unresolved;
+	/* the table locking variable */
+	sync_entity_t lock;
+	/* the statistics must be cleared before the next update */
+	volatile int reset_pending;
+	/* the snapshot must be written before the next update */
+	volatile int snapshot_pending;
+} objstat_t;
+
+
+/**
+ * Initializes the live object statistics.
+ *
+ * @param[in] stat            the statistics to initialize.
+ * @param[in] name            the statistics name.
+ * @param[in] interval        the snapshot interval in seconds.
+ * @param[in] get_class_id    the class identifier resolver (can be NULL).
+ * @param[in] get_class_name  the class name resolver.
+ */
+void objstat_init(objstat_t* stat, const char* name, unsigned int interval,
+		objstat_get_class_id_t get_class_id, objstat_get_class_name_t get_class_name);
+
+/**
+ * Removes all objects and classes from the statistics.
+ *
+ * The tables are only marked for reset and cleared by the next
+ * objstat_add() or objstat_remove() call, so this function can be
+ * called from the tracing toggle signal handler.
+ * @param[in] stat  the statistics.
+ */
+void objstat_reset(objstat_t* stat);
+
+/**
+ * Registers a new live object.
+ *
+ * If the periodic snapshots are enabled and the snapshot interval
+ * has passed, or a snapshot was postponed, the snapshot is written.
+ * @param[in] stat      the statistics.
+ * @param[in] instance  the object instance.
+ * @param[in] class_id  the object class identifier. If 0 the class is
+ *                      resolved later with get_class_id callback.
+ */
+void objstat_add(objstat_t* stat, pointer_t instance, pointer_t class_id);
+
+/**
+ * Unregisters a destroyed object.
+ *
+ * Writes the snapshot if it was postponed.
+ * @param[in] stat      the statistics.
+ * @param[in] instance  the object instance.
+ */
+void objstat_remove(objstat_t* stat, pointer_t instance);
+
+/**
+ * Writes the per-class statistics snapshot into a file and sends
+ * attachment packet to the pre-processor.
+ *
+ * This function can be called from the tracing toggle signal handler.
+ * If the tables are locked by the interrupted or another thread, the
+ * snapshot is postponed to the next objstat_add() or objstat_remove()
+ * call.
+ * @param[in] stat   the statistics.
+ * @return           0 - success, -EBUSY - the snapshot was postponed,
+ *                   -errno - failure.
+ */
+int objstat_write_snapshot(objstat_t* stat);
+
+#endif
@@ -42,8 +42,9 @@
 
 #include "sp_rtrace_main.h"
 #include "sp_rtrace_module.h"
+#include "sp_rtrace_objstat.h"
 #include "common/sp_rtrace_proto.h"
-#include "common/htable.h"
+#include "rtrace/rtrace_env.h"
 
 
 #define QOBJECT_RES_SIZE	1
@@ -61,6 +62,10 @@ typedef void (*qobject_ctor2_t)(void* self, void* parent);
 typedef void (*qobject_ctor2_char_t)(void* self, void* parent, const char* arg);
 typedef void (*qobject_ctor2_private_t)(void* self, void* priv, void* parent);
 
+/* QObject::metaObject() virtual method, QMetaObject::className() method */
+typedef const void* (*qobject_metaobject_t)(const void* self);
+typedef const char* (*qmetaobject_classname_t)(const void* self);
+
 /**
  * Target function references.
  */
@@ -85,6 +90,8 @@ static trace_t trace_off;
 static trace_t trace_on;
 /* tracing function initializers */
 static trace_t trace_init;
+/* live object statistics function references */
+static trace_t trace_summary;
 
 /* Runtime function references */
 static trace_t* trace_rt = &trace_init;
@@ -109,6 +116,50 @@ static module_resource_t res_qobject = {
 	.flags = SP_RTRACE_RESOURCE_DEFAULT,
 };
 
+/* true if only live object statistics must be collected (SP_RTRACE_OBJECT_SUMMARY) */
+static bool summary_mode = false;
+
+/* the live object statistics */
+static objstat_t objstat;
+
+/* the tracing state */
+static bool trace_enabled = false;
+
+/* QMetaObject::className() reference. Qt4 has it inlined, so it
+ * will be NULL and the class name is read directly from QMetaObject. */
+static qmetaobject_classname_t qmetaobject_classname = NULL;
+
+/**
+ * Retrieves the meta object of a QObject instance.
+ *
+ * The derived class is not known yet when QObject constructor is
+ * called, so the class is resolved only when statistics snapshot is
+ * written. QObject::metaObject() is the first virtual method of
+ * QObject and the returned meta object is unique for each class.
+ * @param[in] instance  the QObject instance.
+ * @return              the meta object.
+ */
+static pointer_t get_class_id(pointer_t instance)
+{
+	qobject_metaobject_t* vtable = *(qobject_metaobject_t**)instance;
+	const void* meta = vtable[0]((const void*)instance);
+	return (pointer_t)meta;
+}
+
+/**
+ * Retrieves class name from the meta object.
+ *
+ * @param[in] class_id  the meta object.
+ * @return              the class name.
+ */
+static const char* get_class_name(pointer_t class_id)
+{
+	if (qmetaobject_classname) return qmetaobject_classname((const void*)class_id);
+	/* Qt4 QMetaObject data starts with superdata, stringdata pointers,
+	 * the string data starting with the class name */
+	return ((const char* const*)class_id)[1];
+}
+
 
 /**
  * Enables/disables tracing.
@@ -118,7 +169,13 @@ static module_resource_t res_qobject = {
  */
 static void enable_tracing(bool value)
 {
-	trace_rt = value ? &trace_on : &trace_off;
+	if (summary_mode) {
+		/* start with empty statistics and write the final snapshot when tracing is disabled */
+		if (value && !trace_enabled) objstat_reset(&objstat);
+		if (!value && trace_enabled) objstat_write_snapshot(&objstat);
+		trace_enabled = value;
+	}
+	trace_rt = value ? (summary_mode ? &trace_summary : &trace_on) : &trace_off;
 }
 
 #define DUMP_TRACEOFF_FIELD(field) fprintf(stderr, "\ttrace_off." #field "=%p\n", trace_off.field);
@@ -145,6 +202,8 @@ static void trace_initialize(void)
 			trace_off.qobject_ctor2 = (qobject_ctor2_t)dlsym(RTLD_NEXT, "_ZN7QObjectC2EPS_");
 			trace_off.qobject_ctor2_char = (qobject_ctor2_char_t)dlsym(RTLD_NEXT, "_ZN7QObjectC2EPS_PKc");
 			trace_off.qobject_ctor2_priv = (qobject_ctor2_private_t)dlsym(RTLD_NEXT, "_ZN7QObjectC2ER14QObjectPrivatePS_");
+
+			qmetaobject_classname = (qmetaobject_classname_t)dlsym(RTLD_NEXT, "_ZNK11QMetaObject9classNameEv");
 			
 			init_mode = MODULE_LOADED;
 
@@ -153,6 +212,11 @@ static void trace_initialize(void)
 
 		case MODULE_LOADED: {
 			if (sp_rtrace_initialize()) {
+				const char* summary = getenv(SP_RTRACE_OBJECT_SUMMARY);
+				if (summary && *summary) {
+					objstat_init(&objstat, module_info.name, atoi(summary), get_class_id, get_class_name);
+					summary_mode = true;
+				}
 				sp_rtrace_register_module(&module_info, enable_tracing);
 				sp_rtrace_register_resource(&res_qobject);
 				trace_init_rt = trace_rt;
@@ -296,6 +360,84 @@ static void trace_qobject_ctor2_priv(void* self, void* priv, void* parent)
 	sp_rtrace_write_function_call(&call, NULL, NULL);
 }
 
+/*
+ * live object statistics functions
+ *
+ * The destroyed objects are unregistered before calling the original
+ * destructor, so the address can't be reused by another thread before
+ * the record is removed.
+ */
+
+static void summary_qobject_dtor0(void* self)
+{
+	objstat_remove(&objstat, (pointer_t)self);
+	trace_off.qobject_dtor0(self);
+}
+
+static void summary_qobject_dtor1(void* self)
+{
+	objstat_remove(&objstat, (pointer_t)self);
+	trace_off.qobject_dtor1(self);
+}
+
+static void summary_qobject_dtor2(void* self)
+{
+	objstat_remove(&objstat, (pointer_t)self);
+	trace_off.qobject_dtor2(self);
+}
+
+
+static void summary_qobject_ctor1(void* self, void* parent)
+{
+	trace_off.qobject_ctor1(self, parent);
+	objstat_add(&objstat, (pointer_t)self, 0);
+}
+
+static void summary_qobject_ctor1_char(void* self, void* parent, const char* arg)
+{
+	trace_off.qobject_ctor1_char(self, parent, arg);
+	objstat_add(&objstat, (pointer_t)self, 0);
+}
+
+static void summary_qobject_ctor1_priv(void* self, void* priv, void* parent)
+{
+	trace_off.qobject_ctor1_priv(self, priv, parent);
+	objstat_add(&objstat, (pointer_t)self, 0);
+}
+
+
+static void summary_qobject_ctor2(void* self, void* parent)
+{
+	trace_off.qobject_ctor2(self, parent);
+	objstat_add(&objstat, (pointer_t)self, 0);
+}
+
+static void summary_qobject_ctor2_char(void* self, void* parent, const char* arg)
+{
+	trace_off.qobject_ctor2_char(self, parent, arg);
+	objstat_add(&objstat, (pointer_t)self, 0);
+}
+
+static void summary_qobject_ctor2_priv(void* self, void* priv, void* parent)
+{
+	trace_off.qobject_ctor2_priv(self, priv, parent);
+	objstat_add(&objstat, (pointer_t)self, 0);
+}
+
+static trace_t trace_summary = {
+	summary_qobject_dtor0,
+	summary_qobject_dtor1,
+	summary_qobject_dtor2,
+
+	summary_qobject_ctor1,
+	summary_qobject_ctor1_char,
+	summary_qobject_ctor1_priv,
+
+	summary_qobject_ctor2,
+	summary_qobject_ctor2_char,
+	summary_qobject_ctor2_priv,
+};
+
 static trace_t trace_on = {
 	trace_qobject_dtor0,
 	trace_qobject_dtor1,
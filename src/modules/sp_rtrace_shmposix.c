@@ -28,6 +28,7 @@
  * Posix shared memory tracking module.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -41,8 +42,10 @@
 
 #include "sp_rtrace_main.h"
 #include "sp_rtrace_module.h"
+#include "sp_rtrace_smaps.h"
 
 #include "common/sp_rtrace_proto.h"
+#include "rtrace/rtrace_env.h"
 
 #define ALIGN_TO_4KB (size) (((size)+4095) & 0xFFFFFC00)
 
@@ -139,6 +142,21 @@ static module_resource_t res_pshmfd = {
 	.flags = SP_RTRACE_RESOURCE_DEFAULT,
 };
 
+static module_resource_t res_pshmsample = {
+	.type = "pshmsample",
+	.desc = "posix shared memory mapping residency sample",
+	.flags = SP_RTRACE_RESOURCE_DEFAULT,
+};
+
+/* true if the mapping residency must be sampled (SP_RTRACE_SHM_SAMPLE) */
+static bool sample_mode = false;
+
+/* the residency sampling timer */
+static smaps_timer_t sample_timer;
+
+/* the tracing state */
+static bool trace_enabled = false;
+
 
 /*
  * Name registry implementation
@@ -475,6 +493,10 @@ typedef struct addr_node_t {
 	pointer_t addr;
 	/* the associated file descriptor */
 	int fd;
+	/* the mapping length, 0 if the mapping was unmapped */
+	size_t length;
+	/* the posix shared memory object name for shared object mappings, NULL otherwise */
+	char* name;
 } addr_node_t;
 
 /* the address mapping root */
@@ -499,22 +521,29 @@ static int addr_compare(const void* item1, const void* item2)
 /**
  * Stores new address mapping into registry.
  *
- * @param[in] addr   the new address.
- * @param[in] fd     the mapped descriptor.
+ * @param[in] addr     the new address.
+ * @param[in] fd       the mapped descriptor.
+ * @param[in] length   the mapping length.
+ * @param[in] name     the mapped posix shared memory object name or NULL.
  */
-static void addr_store(pointer_t addr, int fd)
+static void addr_store(pointer_t addr, int fd, size_t length, const char* name)
 {
 	addr_node_t node = {.addr = addr};
 	addr_node_t** ppnode = tfind(&node, &addr_root, addr_compare);
 	if (ppnode) {
 		addr_node_t* pnode = *ppnode;
 		pnode->fd = fd;
+		pnode->length = length;
+		if (pnode->name) free(pnode->name);
+		pnode->name = name ? strdup(name) : NULL;
 		return;
 	}
 	addr_node_t* pnode = malloc(sizeof(addr_node_t));
 	if (!pnode) return;
 	pnode->addr = addr;
 	pnode->fd = fd;
+	pnode->length = length;
+	pnode->name = name ? strdup(name) : NULL;
 	tsearch(pnode, &addr_root, addr_compare);
 }
 
@@ -533,6 +562,18 @@ static addr_node_t* addr_get(pointer_t addr)
 }
 
 #if DO_CLEANUP
+/**
+ * Releases resources allocated for address mapping registry node.
+ *
+ * @param[in] item   the address mapping registry node.
+ */
+static void addr_free_node(void* item)
+{
+	addr_node_t* pnode = item;
+	if (pnode->name) free(pnode->name);
+	free(pnode);
+}
+
 /**
  * Releases resources allocated by adress mapping registry.
  *
@@ -540,11 +581,75 @@ static addr_node_t* addr_get(pointer_t addr)
  */
 static void addr_cleanup(void)
 {
-	tdestroy(addr_root, free);
+	tdestroy(addr_root, addr_free_node);
 }
 #endif /* DO_CLEANUP */
 
 
+/*
+ * Mapping residency sampling
+ */
+
+/**
+ * Writes residency sample of a posix shared memory object mapping.
+ *
+ * The sample is reported as function call record of the 'pshmsample'
+ * resource with the object name, mapping length, resident and dirty
+ * sizes as arguments.
+ * @param[in] entry   the memory mapping residency data.
+ * @param[in] data    pointer to true if it's the final sample written
+ *                    when tracing is being disabled.
+ */
+static void write_mapping_sample(const smaps_entry_t* entry, void* data)
+{
+	addr_node_t* paddr = addr_get(entry->from);
+	if (paddr == NULL || paddr->name == NULL || paddr->length == 0) return;
+
+	char arg_length[2 + sizeof(long) * 2 + 1], arg_rss[32], arg_dirty[32];
+	snprintf(arg_length, sizeof(arg_length), "0x%lx", (unsigned long)paddr->length);
+	snprintf(arg_rss, sizeof(arg_rss), "%lu", entry->rss);
+	snprintf(arg_dirty, sizeof(arg_dirty), "%lu", entry->dirty);
+
+	module_fcall_t call = {
+		.type = SP_RTRACE_FTYPE_FREE,
+		.res_type_id = res_pshmsample.id,
+		.name = "shm_sample",
+		.res_id = paddr->addr,
+		.res_size = (size_t)0,
+	};
+	module_farg_t args[] = {
+		{.name="name", .value=paddr->name},
+		{.name="length", .value=arg_length},
+		{.name="rss", .value=arg_rss},
+		{.name="dirty", .value=arg_dirty},
+		{.name=NULL, .value=NULL}
+	};
+	/* the backtrace of sampling location has no meaning, so write empty backtrace */
+	module_ftrace_t trace = {.nframes = 0};
+	if (*(bool*)data) sp_rtrace_write_final_function_call(&call, &trace, args);
+	else sp_rtrace_write_function_call(&call, &trace, args);
+}
+
+/**
+ * Samples residency of the posix shared memory object mappings.
+ *
+ * @param[in] final  true if tracing is being disabled.
+ */
+static void sample_mappings(bool final)
+{
+	smaps_scan(write_mapping_sample, &final);
+}
+
+/**
+ * Samples residency of the posix shared memory object mappings if
+ * the sampling interval has passed.
+ */
+static void check_sample_timer(void)
+{
+	if (sample_mode && smaps_timer_check(&sample_timer)) sample_mappings(false);
+}
+
+
 /**
  * Enables/disables tracing.
  *
@@ -554,6 +659,11 @@ static void addr_cleanup(void)
 static void enable_tracing(bool value)
 {
 	trace_rt = value ? &trace_on : &trace_off;
+	if (sample_mode) {
+		/* write the final residency samples when tracing is disabled */
+		if (!value && trace_enabled) sample_mappings(true);
+		trace_enabled = value;
+	}
 }
 
 /**
@@ -587,12 +697,18 @@ static void trace_initialize(void)
 			if (sp_rtrace_initialize()) {
 				init_mode = MODULE_READY;
 
+				const char* sample = getenv(SP_RTRACE_SHM_SAMPLE);
+				if (sample && *sample) {
+					smaps_timer_init(&sample_timer, atoi(sample));
+					sample_mode = true;
+				}
 				sp_rtrace_register_module(&module_info, enable_tracing);
 				sp_rtrace_register_resource(&res_pshmmap);
 				sp_rtrace_register_resource(&res_fshmmap);
 				sp_rtrace_register_resource(&res_shmmap);
 				sp_rtrace_register_resource(&res_pshmobj);
 				sp_rtrace_register_resource(&res_pshmfd);
+				if (sample_mode) sp_rtrace_register_resource(&res_pshmsample);
 				trace_init_rt = trace_rt;
 
 				LOG("module ready: %s (%d.%d)", module_info.name, module_info.version_major, module_info.version_minor);
@@ -726,8 +842,10 @@ static int trace_creat(const char *pathname, mode_t mode)
 
 static void trace_mmap_common(const char *name, void *rc, size_t length, int prot, int flags, int fd, off64_t offset)
 {
-	addr_store((pointer_t)rc, fd);
 	fdreg_node_t* pfd = fdreg_get_fd(fd);
+	/* only shared mappings of posix shared memory objects are sampled */
+	bool shared = pfd && pfd->type == FD_POSIX && (flags & MAP_SHARED) && !(flags & (MAP_ANONYMOUS | MAP_ANON));
+	addr_store((pointer_t)rc, fd, length, shared ? pfd->name : NULL);
 
 	module_fcall_t call = {
 		.type = SP_RTRACE_FTYPE_ALLOC,
@@ -768,6 +886,7 @@ static void trace_mmap_common(const char *name, void *rc, size_t length, int pro
 		}
 	}
 	sp_rtrace_write_function_call(&call, NULL, args);
+	check_sample_timer();
 }
 
 
@@ -812,6 +931,7 @@ static int trace_munmap(void *addr, size_t length)
 	addr_node_t* paddr = addr_get((pointer_t)addr);
 	if (paddr) {
 		pfd = fdreg_get_fd(paddr->fd);
+		paddr->length = 0;
 	}
 
 	module_fcall_t call = {
@@ -828,6 +948,7 @@ static int trace_munmap(void *addr, size_t length)
 		{.name=NULL, .value=NULL}
 	};
 	sp_rtrace_write_function_call(&call, NULL, args);
+	check_sample_timer();
 	return rc;
 }
 
@@ -42,8 +42,10 @@
 
 #include "sp_rtrace_main.h"
 #include "sp_rtrace_module.h"
+#include "sp_rtrace_smaps.h"
 #include "common/sp_rtrace_proto.h"
 #include "common/htable.h"
+#include "rtrace/rtrace_env.h"
 
 
 #ifdef __amd64__
@@ -73,6 +75,10 @@ typedef struct {
 	const void* addr;
 	/* the shared memory segment id */
 	int shmid;
+	/* the shared memory segment size */
+	size_t size;
+	/* true if the segment was created by the current process */
+	bool owner;
 } addrmap_t;
 
 static htable_t addr2shmid;
@@ -173,6 +179,86 @@ static module_resource_t res_control = {
 	.flags = SP_RTRACE_RESOURCE_DEFAULT,
 };
 
+static module_resource_t res_sample = {
+	.type = "shmsample",
+	.desc = "shared memory attachment residency sample",
+	.flags = SP_RTRACE_RESOURCE_DEFAULT,
+};
+
+/* true if the attached segment residency must be sampled (SP_RTRACE_SHM_SAMPLE) */
+static bool sample_mode = false;
+
+/* the residency sampling timer */
+static smaps_timer_t sample_timer;
+
+/* the tracing state */
+static bool trace_enabled = false;
+
+/**
+ * Writes residency sample of an attached shared memory segment.
+ *
+ * The sample is reported as function call record of the 'shmsample'
+ * resource with the segment identifier, size, resident and dirty sizes
+ * and the segment attachment counter as arguments.
+ * @param[in] entry   the memory mapping residency data.
+ * @param[in] data    pointer to true if it's the final sample written
+ *                    when tracing is being disabled.
+ */
+static void write_attachment_sample(const smaps_entry_t* entry, void* data)
+{
+	addrmap_t node = {.addr = (const void*)entry->from};
+	addrmap_t* pnode = (addrmap_t*)htable_find(&addr2shmid, (void*)&node);
+	if (pnode == NULL) return;
+
+	char shmid_s[16], size_s[32], rss_s[32], dirty_s[32], nattach_s[16] = "";
+	struct shmid_ds ds;
+	sprintf(shmid_s, "0x%x", pnode->shmid);
+	sprintf(size_s, "%lu", (unsigned long)pnode->size);
+	sprintf(rss_s, "%lu", entry->rss);
+	sprintf(dirty_s, "%lu", entry->dirty);
+	if (trace_off.shmctl(pnode->shmid, IPC_STAT | IPC_64, &ds) == 0) {
+		sprintf(nattach_s, "%lu", (unsigned long)ds.shm_nattch);
+	}
+	module_fcall_t call = {
+			.type = SP_RTRACE_FTYPE_FREE,
+			.res_type_id = res_sample.id,
+			.name = "shm_sample",
+			.res_size = 0,
+			.res_id = (pointer_t)pnode->addr,
+	};
+	module_farg_t args[] = {
+			{.name = "shmid", .value = shmid_s},
+			{.name = "size", .value = size_s},
+			{.name = "rss", .value = rss_s},
+			{.name = "dirty", .value = dirty_s},
+			{.name = "nattach", .value = nattach_s},
+			{.name = NULL, .value = NULL}
+	};
+	/* the backtrace of sampling location has no meaning, so write empty backtrace */
+	module_ftrace_t trace = {.nframes = 0};
+	if (*(bool*)data) sp_rtrace_write_final_function_call(&call, &trace, args);
+	else sp_rtrace_write_function_call(&call, &trace, args);
+}
+
+/**
+ * Samples residency of the attached shared memory segments.
+ *
+ * @param[in] final  true if tracing is being disabled.
+ */
+static void sample_attachments(bool final)
+{
+	smaps_scan(write_attachment_sample, &final);
+}
+
+/**
+ * Samples residency of the attached shared memory segments if
+ * the sampling interval has passed.
+ */
+static void check_sample_timer(void)
+{
+	if (sample_mode && smaps_timer_check(&sample_timer)) sample_attachments(false);
+}
+
 
 /**
  * Enables/disables tracing.
@@ -183,6 +269,11 @@ static module_resource_t res_control = {
 static void enable_tracing(bool value)
 {
 	trace_rt = value ? &trace_on : &trace_off;
+	if (sample_mode) {
+		/* write the final residency samples when tracing is disabled */
+		if (!value && trace_enabled) sample_attachments(true);
+		trace_enabled = value;
+	}
 }
 
 
@@ -208,10 +299,16 @@ static void trace_initialize(void)
 
 		case MODULE_LOADED: {
 			if (sp_rtrace_initialize()) {
+				const char* sample = getenv(SP_RTRACE_SHM_SAMPLE);
+				if (sample && *sample) {
+					smaps_timer_init(&sample_timer, atoi(sample));
+					sample_mode = true;
+				}
 				sp_rtrace_register_module(&module_info, enable_tracing);
 				sp_rtrace_register_resource(&res_segment);
 				sp_rtrace_register_resource(&res_address);
 				sp_rtrace_register_resource(&res_control);
+				if (sample_mode) sp_rtrace_register_resource(&res_sample);
 				trace_init_rt = trace_rt;
 				init_mode = MODULE_READY;
 
@@ -238,6 +335,7 @@ static int trace_shmget(key_t key, size_t size, int shmflg)
 		};
 		sp_rtrace_write_function_call(&call, NULL, NULL);
 	}
+	check_sample_timer();
 	return rc;
 }
 
@@ -300,12 +398,15 @@ static void* trace_shmat(int shmid, const void *shmaddr, int shmflg)
 			sprintf(cpid_s, "%d", ds.shm_cpid);
 			size = ds.shm_segsz;
 
-			/* check if the segment was created by current process */
-			if (ds.shm_cpid == getpid()) {
-				/* store addr->shmid mapping */
+			/* Store addr->shmid mapping. Only segments created by current
+			 * process are checked for destruction in shmdt, but all attachments
+			 * are needed for residency sampling. */
+			if (ds.shm_cpid == getpid() || sample_mode) {
 				addrmap_t* node = htable_create_node(sizeof(addrmap_t));
 				node->shmid = shmid;
 				node->addr = rc;
+				node->size = ds.shm_segsz;
+				node->owner = (ds.shm_cpid == getpid());
 				node = htable_store(&addr2shmid, (void*)node);
 				if (node) {
 					/* TODO: Warning about overwriting already existing address ?
@@ -327,6 +428,7 @@ static void* trace_shmat(int shmid, const void *shmaddr, int shmflg)
 				{.name = NULL, .value = NULL}
 		};
 		sp_rtrace_write_function_call(&call, NULL, args);
+		check_sample_timer();
 	}
 	return rc;
 }
@@ -342,7 +444,7 @@ static int trace_shmdt(const void *shmaddr)
 		shmid = pnode->shmid;
 		/* if segment is marked for destruction, read its attachment counter */
 		struct shmid_ds ds;
-		if (trace_off.shmctl(shmid, IPC_STAT | IPC_64, &ds) == 0 && ds.shm_perm.mode & SHM_DEST) {
+		if (pnode->owner && trace_off.shmctl(shmid, IPC_STAT | IPC_64, &ds) == 0 && ds.shm_perm.mode & SHM_DEST) {
 			nattach = ds.shm_nattch;
 		}
 		htable_remove_node((void*)pnode);
@@ -373,6 +475,7 @@ static int trace_shmdt(const void *shmaddr)
 			};
 			sp_rtrace_write_function_call(&call2, NULL, NULL);
 		}
+		check_sample_timer();
 	}
 	return rc;
 }
@@ -0,0 +1,101 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "sp_rtrace_smaps.h"
+
+/**
+ * Reads size field value from smaps entry line.
+ *
+ * @param[in] line   the smaps entry line.
+ * @param[in] name   the field name (including the ':' character).
+ * @param[out] size  the field value in bytes.
+ * @return           true if the line contained the specified field.
+ */
+static bool read_size_field(const char* line, const char* name, unsigned long* size)
+{
+	size_t len = strlen(name);
+	unsigned long value;
+	if (strncmp(line, name, len) || sscanf(line + len, "%lu", &value) != 1) return false;
+	*size = value << 10;
+	return true;
+}
+
+/*
+ * Public API implementation
+ */
+
+int smaps_scan(smaps_callback_t callback, void* data)
+{
+	char line[PATH_MAX];
+	smaps_entry_t entry;
+	bool has_entry = false;
+
+	FILE* fp = fopen("/proc/self/smaps", "r");
+	if (!fp) return -errno;
+
+	while (fgets(line, sizeof(line), fp)) {
+		pointer_t from, to;
+		unsigned long value;
+		/* a new mapping starts with the address range line */
+		if (sscanf(line, "%lx-%lx ", &from, &to) == 2) {
+			if (has_entry) callback(&entry, data);
+			entry.from = from;
+			entry.to = to;
+			entry.rss = 0;
+			entry.dirty = 0;
+			has_entry = true;
+			continue;
+		}
+		if (read_size_field(line, "Rss:", &value)) {
+			entry.rss = value;
+			continue;
+		}
+		if (read_size_field(line, "Shared_Dirty:", &value) || read_size_field(line, "Private_Dirty:", &value)) {
+			entry.dirty += value;
+		}
+	}
+	if (has_entry) callback(&entry, data);
+	fclose(fp);
+	return 0;
+}
+
+void smaps_timer_init(smaps_timer_t* timer, unsigned int interval)
+{
+	timer->interval = interval;
+	timer->next = interval ? time(NULL) + interval : 0;
+}
+
+bool smaps_timer_check(smaps_timer_t* timer)
+{
+	if (!timer->interval) return false;
+	time_t now = time(NULL);
+	if (now < timer->next) return false;
+	timer->next = now + timer->interval;
+	return true;
+}
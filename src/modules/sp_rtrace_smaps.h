@@ -0,0 +1,100 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file sp_rtrace_smaps.h
+ *
+ * Memory mapping residency sampling support for shared memory
+ * tracking modules (shmsysv, shmposix).
+ *
+ * The resident and dirty sizes of the mappings are read from
+ * /proc/self/smaps file.
+ */
+
+#ifndef SP_RTRACE_SMAPS_H
+#define SP_RTRACE_SMAPS_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "library/sp_rtrace_defs.h"
+
+/**
+ * Memory mapping residency data.
+ */
+typedef struct smaps_entry_t {
+	/* the mapping start address */
+	pointer_t from;
+	/* the mapping end address */
+	pointer_t to;
+	/* the resident size in bytes */
+	unsigned long rss;
+	/* the dirty (shared + private) size in bytes */
+	unsigned long dirty;
+} smaps_entry_t;
+
+/**
+ * Processes memory mapping residency data.
+ *
+ * @param[in] entry  the memory mapping data.
+ * @param[in] data   the user data.
+ */
+typedef void (*smaps_callback_t)(const smaps_entry_t* entry, void* data);
+
+/**
+ * Sampling interval timer.
+ */
+typedef struct smaps_timer_t {
+	/* the sampling interval in seconds, 0 - sample only when tracing is disabled */
+	unsigned int interval;
+	/* the next sampling time */
+	time_t next;
+} smaps_timer_t;
+
+/**
+ * Scans /proc/self/smaps file and calls the callback function for
+ * every memory mapping.
+ *
+ * @param[in] callback  the callback function.
+ * @param[in] data      the user data passed to the callback function.
+ * @return              0 - success, -errno - failure.
+ */
+int smaps_scan(smaps_callback_t callback, void* data);
+
+/**
+ * Initializes sampling interval timer.
+ *
+ * @param[in] timer     the timer.
+ * @param[in] interval  the sampling interval in seconds.
+ */
+void smaps_timer_init(smaps_timer_t* timer, unsigned int interval);
+
+/**
+ * Checks if the sampling interval has passed and rearms the timer.
+ *
+ * @param[in] timer  the timer.
+ * @return           true if the memory mappings must be sampled.
+ */
+bool smaps_timer_check(smaps_timer_t* timer);
+
+#endif
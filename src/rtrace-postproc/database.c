@@ -0,0 +1,572 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "database.h"
+#include "sp_rtrace_postproc.h"
+
+#include "common/trace_db.h"
+#include "common/header.h"
+#include "common/msg.h"
+#include "common/utils.h"
+
+/* the initial string table size */
+#define STRINGS_SIZE         (64 * 1024)
+
+/* the number of string index records per pool chunk */
+#define STRINGS_ENTRY_COUNT  1024
+
+/**
+ * The string index record.
+ */
+typedef struct string_entry_t {
+	/* the string to look up, NULL for the stored strings */
+	const char* key;
+	/* the string length */
+	size_t len;
+	/* the string offset in the string table */
+	uint32_t offset;
+} string_entry_t;
+
+/**
+ * The database string table.
+ *
+ * The table stores single copy of every string.
+ */
+static struct {
+	/* the string data */
+	char* data;
+	size_t size;
+	size_t limit;
+	/* the string index */
+	hmap_t index;
+	/* the string index records */
+	pool_t entries;
+} strings;
+
+/**
+ * Retrieves the string referred by the string index record.
+ */
+static const char* string_entry_text(const string_entry_t* entry)
+{
+	return entry->key ? entry->key : strings.data + entry->offset;
+}
+
+/**
+ * Compares two string index records.
+ */
+static long string_entry_compare(const string_entry_t* entry1, const string_entry_t* entry2)
+{
+	if (entry1->len != entry2->len) return entry1->len < entry2->len ? -1 : 1;
+	return memcmp(string_entry_text(entry1), string_entry_text(entry2), entry1->len);
+}
+
+/**
+ * Calculates hash value for the string index record.
+ */
+static long string_entry_hash(const string_entry_t* entry)
+{
+	const char* text = string_entry_text(entry);
+	unsigned int hash = 2166136261u;
+	size_t i;
+	for (i = 0; i < entry->len; i++) {
+		hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Initializes the string table.
+ *
+ * The string table starts with empty string, so TDB_NULL offset
+ * can be used for NULL strings.
+ */
+static void strings_init(void)
+{
+	strings.limit = STRINGS_SIZE;
+	strings.data = (char*)malloc_a(strings.limit);
+	strings.data[0] = '\0';
+	strings.size = 1;
+	hmap_init(&strings.index, 0, (op_unary_t)string_entry_hash, (op_binary_t)string_entry_compare);
+	pool_init(&strings.entries, sizeof(string_entry_t), STRINGS_ENTRY_COUNT);
+}
+
+/**
+ * Frees the string table.
+ */
+static void strings_free(void)
+{
+	hmap_free(&strings.index, NULL);
+	pool_free(&strings.entries);
+	free(strings.data);
+	strings.data = NULL;
+}
+
+/**
+ * Adds string to the string table.
+ *
+ * @param[in] str   the string to add.
+ * @return          the string offset in the string table.
+ */
+static uint32_t strings_add(const char* str)
+{
+	if (!str) return TDB_NULL;
+
+	string_entry_t template = {.key = str, .len = strlen(str)};
+	string_entry_t* entry = (string_entry_t*)hmap_find(&strings.index, &template);
+	if (entry) return entry->offset;
+
+	if (strings.size + template.len + 1 > TDB_NONE) {
+		msg_error("too much string data for trace database\n");
+		exit (-1);
+	}
+	if (strings.size + template.len + 1 > strings.limit) {
+		while (strings.size + template.len + 1 > strings.limit) strings.limit <<= 1;
+		strings.data = (char*)realloc_a(strings.data, strings.limit);
+	}
+	entry = (string_entry_t*)pool_alloc(&strings.entries);
+	entry->key = NULL;
+	entry->len = template.len;
+	entry->offset = strings.size;
+	memcpy(strings.data + strings.size, str, template.len + 1);
+	strings.size += template.len + 1;
+	hmap_store(&strings.index, entry);
+	return entry->offset;
+}
+
+/**
+ * The database section data.
+ */
+typedef struct {
+	const void* data;
+	size_t count;
+	size_t size;
+} section_data_t;
+
+/*
+ * The call columns used by the call index sorting.
+ */
+static const uint32_t* sort_timestamps;
+static const int32_t* sort_indexes;
+static const pointer_t* sort_res_ids;
+
+#define COMPARE_KEYS(key1, key2, row1, row2) \
+	((key1) != (key2) ? ((key1) < (key2) ? -1 : 1) : ((row1) < (row2) ? -1 : (row1) != (row2)))
+
+static int compare_rows_by_time(const void* row1, const void* row2)
+{
+	uint32_t r1 = *(const uint32_t*)row1, r2 = *(const uint32_t*)row2;
+	return COMPARE_KEYS(sort_timestamps[r1], sort_timestamps[r2], r1, r2);
+}
+
+static int compare_rows_by_index(const void* row1, const void* row2)
+{
+	uint32_t r1 = *(const uint32_t*)row1, r2 = *(const uint32_t*)row2;
+	return COMPARE_KEYS(sort_indexes[r1], sort_indexes[r2], r1, r2);
+}
+
+static int compare_rows_by_res_id(const void* row1, const void* row2)
+{
+	uint32_t r1 = *(const uint32_t*)row1, r2 = *(const uint32_t*)row2;
+	return COMPARE_KEYS(sort_res_ids[r1], sort_res_ids[r2], r1, r2);
+}
+
+/**
+ * Creates call index.
+ *
+ * @param[in] ncalls    the number of calls.
+ * @param[in] compare   the call row comparison function.
+ * @return              the call rows in index order.
+ */
+static uint32_t* create_call_index(size_t ncalls, int (*compare)(const void*, const void*))
+{
+	uint32_t* rows = (uint32_t*)malloc_a(sizeof(uint32_t) * (ncalls + 1));
+	size_t i;
+	for (i = 0; i < ncalls; i++) rows[i] = i;
+	qsort(rows, ncalls, sizeof(uint32_t), compare);
+	return rows;
+}
+
+/**
+ * The backtrace table data.
+ */
+typedef struct {
+	/* the backtraces, sorted by their address */
+	rd_ftrace_t** traces;
+	/* the backtrace rows, assigned in the order of first use */
+	uint32_t* rows;
+	/* the number of backtraces */
+	size_t count;
+	/* the backtraces in row order */
+	rd_ftrace_t** table;
+	/* the number of backtrace rows */
+	size_t size;
+} trace_table_t;
+
+static long add_trace(rd_ftrace_t* trace, trace_table_t* table)
+{
+	table->traces[table->count++] = trace;
+	return 0;
+}
+
+static int compare_traces(const void* trace1, const void* trace2)
+{
+	pointer_t t1 = (pointer_t)*(rd_ftrace_t* const*)trace1, t2 = (pointer_t)*(rd_ftrace_t* const*)trace2;
+	return t1 < t2 ? -1 : t1 != t2;
+}
+
+/**
+ * Retrieves the backtrace row.
+ *
+ * The backtrace rows are assigned when the backtraces are used for
+ * the first time, so the backtraces of the consequent calls are
+ * placed next to each other.
+ * @param[in] table   the backtrace table.
+ * @param[in] trace   the backtrace.
+ * @return            the backtrace row.
+ */
+static uint32_t get_trace_row(trace_table_t* table, rd_ftrace_t* trace)
+{
+	if (!trace) return TDB_NONE;
+	rd_ftrace_t** ptr = (rd_ftrace_t**)bsearch(&trace, table->traces, table->count, sizeof(rd_ftrace_t*), compare_traces);
+	if (!ptr) return TDB_NONE;
+	uint32_t* row = &table->rows[ptr - table->traces];
+	if (*row == TDB_NONE) {
+		*row = table->size;
+		table->table[table->size++] = trace;
+	}
+	return *row;
+}
+
+/**
+ * Writes the database file.
+ *
+ * @param[in] path       the database file path.
+ * @param[in] header     the database header.
+ * @param[in] sections   the section data.
+ */
+static void write_database_file(const char* path, tdb_header_t* header, const section_data_t* sections)
+{
+	static const char padding[8];
+	int i;
+
+	/* calculate section offsets */
+	uint64_t offset = (sizeof(tdb_header_t) + 7) & ~7;
+	for (i = 0; i < TDB_SECTION_MAX; i++) {
+		header->sections[i].offset = offset;
+		header->sections[i].count = sections[i].count;
+		offset += (sections[i].count * sections[i].size + 7) & ~7;
+	}
+
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL) {
+		msg_error("failed to create trace database %s (%s)\n", path, strerror(errno));
+		exit (-1);
+	}
+	size_t pos = 0;
+	bool failed = fwrite(header, sizeof(tdb_header_t), 1, fp) != 1;
+	pos += sizeof(tdb_header_t);
+	for (i = 0; i < TDB_SECTION_MAX && !failed; i++) {
+		if (pos != header->sections[i].offset) {
+			failed = fwrite(padding, header->sections[i].offset - pos, 1, fp) != 1;
+			pos = header->sections[i].offset;
+		}
+		size_t size = sections[i].count * sections[i].size;
+		if (size) {
+			failed = failed || fwrite(sections[i].data, size, 1, fp) != 1;
+			pos += size;
+		}
+	}
+	if (fclose(fp) != 0 || failed) {
+		msg_error("failed to write trace database %s (%s)\n", path, strerror(errno));
+		exit (-1);
+	}
+}
+
+#define SET_SECTION(index, array, n) \
+	sections[index].data = array; \
+	sections[index].count = n; \
+	sections[index].size = sizeof(*(array));
+
+/*
+ * Public API implementation
+ */
+
+void write_trace_database(rd_t* rd, const char* path)
+{
+	section_data_t sections[TDB_SECTION_MAX];
+	dlist_node_t* node;
+	size_t i, n;
+
+	strings_init();
+
+	/* the trace information */
+	tdb_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TDB_MAGIC, sizeof(TDB_MAGIC));
+	header.version = TDB_VERSION;
+	header.pointer_size = sizeof(pointer_t);
+	header.pid = rd->pinfo->pid;
+	header.backtrace_depth = rd->pinfo->backtrace_depth;
+	header.timestamp_sec = rd->pinfo->timestamp.tv_sec;
+	header.timestamp_usec = rd->pinfo->timestamp.tv_usec;
+	/* the database contains uncompressed call data */
+	header.filter = rd->filter & FILTER_MASK_RESET;
+	if (postproc_options.filter_leaks) {
+		header.filter |= FILTER_MASK_LEAKS;
+		header.leak_summary = 1;
+	}
+	header.arch = strings_add(rd->hshake->arch);
+	header.process = strings_add(rd->pinfo->name);
+	header.origin = strings_add(rd->pinfo->trace_origin);
+	if (rd->hinfo) {
+		header.has_heap = 1;
+		header.heap.heap_bottom = rd->hinfo->heap_bottom;
+		header.heap.heap_top = rd->hinfo->heap_top;
+		header.heap.lowest_block = rd->hinfo->lowest_block;
+		header.heap.highest_block = rd->hinfo->highest_block;
+		header.heap.arena = rd->hinfo->arena;
+		header.heap.ordblks = rd->hinfo->ordblks;
+		header.heap.smblks = rd->hinfo->smblks;
+		header.heap.hblks = rd->hinfo->hblks;
+		header.heap.hblkhd = rd->hinfo->hblkhd;
+		header.heap.usmblks = rd->hinfo->usmblks;
+		header.heap.fsmblks = rd->hinfo->fsmblks;
+		header.heap.uordblks = rd->hinfo->uordblks;
+		header.heap.fordblks = rd->hinfo->fordblks;
+		header.heap.keepcost = rd->hinfo->keepcost;
+	}
+
+	/* the trace environment records */
+	for (n = 0, node = dlist_first(&rd->minfo); node; node = node->next) n++;
+	tdb_module_t* modules = (tdb_module_t*)malloc_a(sizeof(tdb_module_t) * n + 1);
+	for (i = 0, node = dlist_first(&rd->minfo); node; node = node->next, i++) {
+		rd_minfo_t* minfo = (rd_minfo_t*)node;
+		modules[i].id = minfo->id;
+		modules[i].vmajor = minfo->vmajor;
+		modules[i].vminor = minfo->vminor;
+		modules[i].name = strings_add(minfo->name);
+	}
+	SET_SECTION(TDB_SECTION_MODULES, modules, n);
+
+	for (n = 0, node = dlist_first(&rd->files); node; node = node->next) n++;
+	tdb_attachment_t* attachments = (tdb_attachment_t*)malloc_a(sizeof(tdb_attachment_t) * n + 1);
+	for (i = 0, node = dlist_first(&rd->files); node; node = node->next, i++) {
+		rd_attachment_t* file = (rd_attachment_t*)node;
+		attachments[i].name = strings_add(file->data.name);
+		attachments[i].path = strings_add(file->data.path);
+	}
+	SET_SECTION(TDB_SECTION_ATTACHMENTS, attachments, n);
+
+	for (n = 0, node = dlist_first(&rd->contexts); node; node = node->next) n++;
+	tdb_context_t* contexts = (tdb_context_t*)malloc_a(sizeof(tdb_context_t) * n + 1);
+	for (i = 0, node = dlist_first(&rd->contexts); node; node = node->next, i++) {
+		rd_context_t* context = (rd_context_t*)node;
+		contexts[i].id = context->data.id;
+		contexts[i].name = strings_add(context->data.name);
+	}
+	SET_SECTION(TDB_SECTION_CONTEXTS, contexts, n);
+
+	for (n = 0, node = dlist_first(&rd->resources); node; node = node->next) n++;
+	tdb_resource_t* resources = (tdb_resource_t*)malloc_a(sizeof(tdb_resource_t) * n + 1);
+	rd_resource_t** resource_refs = (rd_resource_t**)malloc_a(sizeof(rd_resource_t*) * n + 1);
+	size_t nresources = n;
+	for (i = 0, node = dlist_first(&rd->resources); node; node = node->next, i++) {
+		rd_resource_t* resource = (rd_resource_t*)node;
+		resources[i].id = resource->data.id;
+		resources[i].flags = resource->data.flags;
+		resources[i].hide = resource->hide;
+		resources[i].type = strings_add(resource->data.type);
+		resources[i].desc = strings_add(resource->data.desc);
+		resources[i].reserved = 0;
+		resource_refs[i] = resource;
+	}
+	SET_SECTION(TDB_SECTION_RESOURCES, resources, n);
+
+	for (n = 0, node = dlist_first(&rd->mmaps); node; node = node->next) n++;
+	tdb_mmap_t* mmaps = (tdb_mmap_t*)malloc_a(sizeof(tdb_mmap_t) * n + 1);
+	for (i = 0, node = dlist_first(&rd->mmaps); node; node = node->next, i++) {
+		rd_mmap_t* mmap = (rd_mmap_t*)node;
+		mmaps[i].from = mmap->data.from;
+		mmaps[i].to = mmap->data.to;
+		mmaps[i].bias = mmap->data.bias;
+		mmaps[i].module = strings_add(mmap->data.module);
+		mmaps[i].build_id = strings_add(mmap->data.build_id);
+	}
+	SET_SECTION(TDB_SECTION_MMAPS, mmaps, n);
+
+	for (n = 0, node = dlist_first(&rd->comments); node; node = node->next) n++;
+	tdb_comment_t* comments = (tdb_comment_t*)malloc_a(sizeof(tdb_comment_t) * n + 1);
+	for (i = 0, node = dlist_first(&rd->comments); node; node = node->next, i++) {
+		rd_comment_t* comment = (rd_comment_t*)node;
+		comments[i].index = comment->index;
+		comments[i].text = strings_add(comment->text);
+	}
+	SET_SECTION(TDB_SECTION_COMMENTS, comments, n);
+
+	/* the backtrace table */
+	trace_table_t traces = {.count = 0, .size = 0};
+	traces.traces = (rd_ftrace_t**)malloc_a(sizeof(rd_ftrace_t*) * (rd->ftraces.count + 1));
+	hmap_foreach2(&rd->ftraces, (op_binary_t)add_trace, &traces);
+	qsort(traces.traces, traces.count, sizeof(rd_ftrace_t*), compare_traces);
+	traces.rows = (uint32_t*)malloc_a(sizeof(uint32_t) * (traces.count + 1));
+	memset(traces.rows, 0xff, sizeof(uint32_t) * traces.count);
+	traces.table = (rd_ftrace_t**)malloc_a(sizeof(rd_ftrace_t*) * (traces.count + 1));
+
+	/* the call columns */
+	size_t ncalls = 0, nargs = 0;
+	for (node = dlist_first(&rd->calls); node; node = node->next) {
+		rd_fcall_t* call = (rd_fcall_t*)node;
+		if (call->args) {
+			sp_rtrace_farg_t* arg;
+			for (arg = call->args->data; arg->name; arg++) nargs++;
+		}
+		ncalls++;
+	}
+	if (ncalls >= TDB_NONE || nargs >= TDB_NONE) {
+		msg_error("too many function calls for trace database\n");
+		exit (-1);
+	}
+	int32_t* call_index = (int32_t*)malloc_a(sizeof(int32_t) * ncalls + 1);
+	uint32_t* call_type = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	uint32_t* call_context = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	uint32_t* call_timestamp = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	uint32_t* call_name = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	uint32_t* call_resource = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	pointer_t* call_res_id = (pointer_t*)malloc_a(sizeof(pointer_t) * ncalls + 1);
+	int32_t* call_res_size = (int32_t*)malloc_a(sizeof(int32_t) * ncalls + 1);
+	uint32_t* call_trace = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	uint32_t* call_args = (uint32_t*)malloc_a(sizeof(uint32_t) * (ncalls + 1));
+	tdb_arg_t* args = (tdb_arg_t*)malloc_a(sizeof(tdb_arg_t) * nargs + 1);
+
+	nargs = 0;
+	for (i = 0, node = dlist_first(&rd->calls); node; node = node->next, i++) {
+		rd_fcall_t* call = (rd_fcall_t*)node;
+		call_index[i] = call->data.index;
+		call_type[i] = call->data.type;
+		call_context[i] = call->data.context;
+		call_timestamp[i] = call->data.timestamp;
+		call_name[i] = strings_add(call->data.name);
+		call_resource[i] = TDB_NONE;
+		if (call->data.res_type_flag == SP_RTRACE_FCALL_RFIELD_REF) {
+			for (n = 0; n < nresources; n++) {
+				if (resource_refs[n] == call->data.res_type) {
+					call_resource[i] = n;
+					break;
+				}
+			}
+		}
+		call_res_id[i] = call->data.res_id;
+		call_res_size[i] = call->data.res_size;
+		call_trace[i] = get_trace_row(&traces, call->trace);
+		call_args[i] = nargs;
+		if (call->args) {
+			sp_rtrace_farg_t* arg;
+			for (arg = call->args->data; arg->name; arg++) {
+				args[nargs].name = strings_add(arg->name);
+				args[nargs++].value = strings_add(arg->value);
+			}
+		}
+	}
+	call_args[ncalls] = nargs;
+	SET_SECTION(TDB_SECTION_CALL_INDEX, call_index, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_TYPE, call_type, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_CONTEXT, call_context, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_TIMESTAMP, call_timestamp, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_NAME, call_name, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_RESOURCE, call_resource, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_RES_ID, call_res_id, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_RES_SIZE, call_res_size, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_TRACE, call_trace, ncalls);
+	SET_SECTION(TDB_SECTION_CALL_ARGS, call_args, ncalls + 1);
+	SET_SECTION(TDB_SECTION_ARGS, args, nargs);
+
+	/* the backtrace frames, in backtrace row order */
+	size_t nframes = 0;
+	for (i = 0; i < traces.size; i++) nframes += traces.table[i]->data.nframes;
+	if (nframes >= TDB_NONE) {
+		msg_error("too many backtrace frames for trace database\n");
+		exit (-1);
+	}
+	uint32_t* trace_frames = (uint32_t*)malloc_a(sizeof(uint32_t) * (traces.size + 1));
+	pointer_t* frames = (pointer_t*)malloc_a(sizeof(pointer_t) * nframes + 1);
+	uint32_t* frame_names = (uint32_t*)malloc_a(sizeof(uint32_t) * nframes + 1);
+	nframes = 0;
+	for (i = 0; i < traces.size; i++) {
+		sp_rtrace_ftrace_t* trace = &traces.table[i]->data;
+		trace_frames[i] = nframes;
+		for (n = 0; n < trace->nframes; n++) {
+			frames[nframes] = trace->frames[n];
+			frame_names[nframes++] = trace->resolved_names ? strings_add(trace->resolved_names[n]) : TDB_NULL;
+		}
+	}
+	trace_frames[traces.size] = nframes;
+	SET_SECTION(TDB_SECTION_TRACE_FRAMES, trace_frames, traces.size + 1);
+	SET_SECTION(TDB_SECTION_FRAMES, frames, nframes);
+	SET_SECTION(TDB_SECTION_FRAME_NAMES, frame_names, nframes);
+
+	/* the call indexes */
+	sort_timestamps = call_timestamp;
+	sort_indexes = call_index;
+	sort_res_ids = call_res_id;
+	uint32_t* index_time = create_call_index(ncalls, compare_rows_by_time);
+	uint32_t* index_call = create_call_index(ncalls, compare_rows_by_index);
+	uint32_t* index_res_id = create_call_index(ncalls, compare_rows_by_res_id);
+	SET_SECTION(TDB_SECTION_INDEX_TIME, index_time, ncalls);
+	SET_SECTION(TDB_SECTION_INDEX_CALL, index_call, ncalls);
+	SET_SECTION(TDB_SECTION_INDEX_RES_ID, index_res_id, ncalls);
+
+	/* the backtrace index, grouping calls by backtrace rows */
+	uint32_t* trace_calls = (uint32_t*)calloc_a(traces.size + 1, sizeof(uint32_t));
+	uint32_t* index_trace = (uint32_t*)malloc_a(sizeof(uint32_t) * ncalls + 1);
+	for (i = 0; i < ncalls; i++) {
+		if (call_trace[i] != TDB_NONE) trace_calls[call_trace[i] + 1]++;
+	}
+	for (i = 0; i < traces.size; i++) trace_calls[i + 1] += trace_calls[i];
+	for (i = 0; i < ncalls; i++) {
+		if (call_trace[i] != TDB_NONE) index_trace[trace_calls[call_trace[i]]++] = i;
+	}
+	/* the row offsets were moved to the next backtrace while filling the index */
+	for (i = traces.size; i > 0; i--) trace_calls[i] = trace_calls[i - 1];
+	trace_calls[0] = 0;
+	SET_SECTION(TDB_SECTION_TRACE_CALLS, trace_calls, traces.size + 1);
+	SET_SECTION(TDB_SECTION_INDEX_TRACE, index_trace, trace_calls[traces.size]);
+
+	SET_SECTION(TDB_SECTION_STRINGS, strings.data, strings.size);
+
+	write_database_file(path, &header, sections);
+
+	for (i = 0; i < TDB_SECTION_MAX; i++) {
+		if (i != TDB_SECTION_STRINGS) free((void*)(pointer_t)sections[i].data);
+	}
+	free(resource_refs);
+	free(traces.traces);
+	free(traces.rows);
+	free(traces.table);
+	strings_free();
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file database.h
+ *
+ * This file provides trace database generation for --database option.
+ */
+#ifndef DATABASE_H
+#define DATABASE_H
+
+#include "common/rtrace_data.h"
+
+/**
+ * Writes the processed trace data into trace database.
+ *
+ * See common/trace_db.h for the database format description.
+ * @param[in] rd     the resource trace data.
+ * @param[in] path   the database file path.
+ */
+void write_trace_database(rd_t* rd, const char* path);
+
+#endif
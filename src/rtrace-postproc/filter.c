@@ -27,16 +27,21 @@
 #include <search.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "filter.h"
+#include "writer.h"
 
 #include "common/sp_rtrace_proto.h"
 #include "common/resolve_utils.h"
 #include "common/utils.h"
+#include "common/hmap.h"
 #include "common/msg.h"
 #include "sp_rtrace_postproc.h"
 
-#define HASH_SIZE      (1 << 16)
+/* the initial size of resource index table */
+#define HASH_SIZE      (1 << 12)
 
 
 /**
@@ -46,8 +51,6 @@
  * function call. The call->res_id field is used as indexing value.
  */
 typedef struct fres_t {
-	/* hash table support */
-	htable_node_t node;
 	/* the associated function call */
 	rd_fcall_t* call;
 	/* resource reference counter */
@@ -65,9 +68,37 @@ typedef struct fres_index_t {
 	/* the rtrace data */
 	rd_t* rd;
 	/* the resource->function calls index table */
-	htable_t table;
+	hmap_t table;
 } fres_index_t;
 
+
+/**
+ * The streaming leak filter state.
+ */
+typedef struct filter_stream_t {
+	/* the live resource index, index.rd is NULL if the filter is not active */
+	fres_index_t index;
+	/* the lowest and highest allocated blocks, including the freed ones */
+	pointer_t lowest_block;
+	pointer_t highest_block;
+} filter_stream_t;
+
+static filter_stream_t stream = {.index = {.rd = NULL}, .lowest_block = (pointer_t)~0L, .highest_block = 0};
+
+/**
+ * The live mode reporting state.
+ */
+typedef struct filter_live_t {
+	/* the report interval in seconds, 0 - live mode is disabled */
+	unsigned int interval;
+	/* the last report time */
+	time_t report_time;
+	/* the activity since the last report */
+	live_rate_t rate;
+} filter_live_t;
+
+static filter_live_t live = {.interval = 0};
+
 /**
  * Frees resource index data.
  *
@@ -111,25 +142,17 @@ static long res_compare(const fres_t* res1, const fres_t* res2)
 /**
  * Calculates hash value for the resource.
  *
- * TODO: find better hash function.
+ * The hash table scrambles the returned value, so the resource
+ * identifier can be used directly.
  * @param[in] res   the resource index data.
  * @return          the hash value.
  */
 static long res_hash(const fres_t* res)
 {
-	unsigned long hash = 0;
-	unsigned long value = (unsigned long)res->call->data.res_id;
-	while (value) {
-		hash ^= value & ((1 << 16) - 1);
-		value >>= 3;
-	}
+	unsigned long hash = res->call->data.res_id;
 	if (res->call->data.res_type) {
 		rd_resource_t* res_type = res->call->data.res_type;
-		value = res_type->data.id;
-		while (value) {
-			hash ^= value & ((1 << 16) - 1);
-			value >>= 3;
-		}
+		hash ^= hmap_mix(res_type->data.id);
 	}
 	return hash;
 }
@@ -147,19 +170,20 @@ static long res_hash(const fres_t* res)
  * hash table based index is used (fres_index_t::index).
  * @param[in] call  the function call record to check.
  * @param[in] data  the indexing data (see fres_index_t structure)
- * @return
+ * @return          1 if the call record was removed, 0 otherwise.
  */
 static long fcall_remove_freed(rd_fcall_t* call, void* data)
 {
 	fres_index_t* idx = (fres_index_t*)data;
 	fres_t find_res = {.call = call};
-	fres_t* res = htable_find(&idx->table, &find_res);
+	fres_t* res = hmap_find(&idx->table, &find_res);
 	rd_resource_t* res_type = call->data.res_type;
 
 	if (call->data.type == SP_RTRACE_FTYPE_ALLOC) {
 		if (res && (res_type->data.flags & SP_RTRACE_RESOURCE_REFCOUNT)) {
 			res->ref_count++;
 			rd_fcall_remove(idx->rd, call);
+			return 1;
 		}
 		else {
 			/* create resource index record */
@@ -167,63 +191,30 @@ static long fcall_remove_freed(rd_fcall_t* call, void* data)
 			new_res->call = call;
 			new_res->ref_count = 1;
 			/* store the created record into resource index table */
-			fres_t* old_res = htable_store(&idx->table, new_res);
+			fres_t* old_res = hmap_store(&idx->table, new_res);
 			if (old_res) free_fres_rec(old_res);
 		}
 	}
 	else if (call->data.type == SP_RTRACE_FTYPE_FREE) {
-		/* create resource template for htable_find function. As the
-		 * compare function of resource hash table uses only call->res
-		 * id value, setting the .call field is enough for lookups */
 		if (res) {
 			res->ref_count--;
 			if (res->ref_count == 0 || !(res_type->data.flags & SP_RTRACE_RESOURCE_REFCOUNT)) {
 				/* The resource allocation record found. Remove the record
 				 * from function call list and free it. Also remove and
 				 * free the resource index record */
-				htable_remove_node((htable_node_t*)res);
+				hmap_remove(&idx->table, res);
 				rd_fcall_remove(idx->rd, res->call);
 				free_fres_rec(res);
 			}
 		}
 		/* deallocation call record is always removed */
 		rd_fcall_remove(idx->rd, call);
+		return 1;
 	}
 	return 0;
 }
 
 
-/**
- * Removes function call record if its context doesn't match filtering mask.
- *
- * @param[in] call   the function call record to check.
- * @param[in] data   the rtrace data.
- * @return
- */
-static void fcall_filter_context(rd_fcall_t* call, rd_t* rd)
-{
-	if ( (postproc_options.filter_context && !(call->data.context & postproc_options.filter_context)) ||
-			(!postproc_options.filter_context && call->data.context) ) {
-		rd_fcall_remove(rd, call);
-	}
-}
-
-
-/**
- * Removes function call record if its module id doesn't match filtering mask.
- *
- * @param[in] call   the function call record to check.
- * @param[in] data   the rtrace data.
- * @return
- */
-static void fcall_filter_resource(rd_fcall_t* call, rd_t* rd)
-{
-	rd_resource_t* res = call->data.res_type;
-	if (res && !( (1 << (res->data.id - 1)) & postproc_options.filter_resource)) {
-		rd_fcall_remove(rd, call);
-	}
-}
-
 /**
  * Find the lowest and highest allocation blocks.
  *
@@ -332,8 +323,6 @@ static void* filter_load_index_data(const char* filename)
  * Helper data structure containing necessary data for index filter.
  */
 typedef struct index_filter_t {
-	/* the rtrace data */
-	rd_t* rd;
 	/* true if include filter is applied, false if exclude */
 	bool include;
 	/* the include/exclude index map */
@@ -341,25 +330,6 @@ typedef struct index_filter_t {
 } index_filter_t;
 
 
-/**
- * The event filtering function.
- *
- * This function performs call index lookup in the index tree and removes
- * call if:
- *   1) exclude rule is set and index was found
- *   2) include rule is set and index was not found
- * @param[in] call    the call to check.
- * @param[in] filter  the index filtering data.
- */
-static void fcall_filter_index(rd_fcall_t* call, index_filter_t* filter)
-{
-	unsigned long idx = call->data.index;
-	bool found = tfind((void*)idx, &filter->index_map, filter_compare_event_index);
-	if ((found && !filter->include) || (!found && filter->include)) {
-		rd_fcall_remove(filter->rd, call);
-	}
-}
-
 /**
  * Empty function to pass to tdestroy.
  * @param
@@ -378,26 +348,100 @@ void filter_leaks(rd_t* rd)
 	/* indexing structure to wrap needed data into single argument */
 	fres_index_t idx = {.rd = rd};
 	/* create resource indexing hash table */
-	if (htable_init(&idx.table, HASH_SIZE, (op_unary_t)res_hash, (op_binary_t)res_compare) != 0) {
+	if (hmap_init(&idx.table, HASH_SIZE, (op_unary_t)res_hash, (op_binary_t)res_compare) != 0) {
 		msg_error("failed to create resource indexing table\n");
 		exit (-1);
 	}
 
 	dlist_foreach2(&rd->calls, (op_binary_t)fcall_remove_freed, (void*)&idx);
 
-	htable_free(&idx.table, (op_unary_t)free_fres_rec);
+	hmap_free(&idx.table, (op_unary_t)free_fres_rec);
+}
+
+void filter_stream_init(rd_t* rd)
+{
+	if (stream.index.rd) return;
+	if (hmap_init(&stream.index.table, HASH_SIZE, (op_unary_t)res_hash, (op_binary_t)res_compare) != 0) {
+		msg_error("failed to create resource indexing table\n");
+		exit (-1);
+	}
+	stream.index.rd = rd;
+}
+
+bool filter_stream_add_call(rd_t* rd __attribute__((unused)), rd_fcall_t* call)
+{
+	if (call->data.type == SP_RTRACE_FTYPE_ALLOC) {
+		/* the heap statistics report the range of all allocations */
+		if (call->data.res_id < stream.lowest_block) stream.lowest_block = call->data.res_id;
+		if (call->data.res_id > stream.highest_block) stream.highest_block = call->data.res_id;
+	}
+	/* The resource type is not set for the calls of unregistered resources
+	 * (see read_generic_packet()), keep them as the leak filter would do */
+	if (!call->data.res_type) return false;
+	return fcall_remove_freed(call, &stream.index) != 0;
+}
+
+bool filter_stream_active(void)
+{
+	return stream.index.rd != NULL;
 }
 
-void filter_context(rd_t* rd)
+void filter_stream_free(void)
 {
-	dlist_foreach2(&rd->contexts, (op_binary_t)context_filter_mask, (void*)&rd->contexts);
-	dlist_foreach2(&rd->calls, (op_binary_t)fcall_filter_context, (void*)rd);
+	if (!stream.index.rd) return;
+	hmap_free(&stream.index.table, (op_unary_t)free_fres_rec);
+	stream.index.rd = NULL;
 }
 
-void filter_resource(rd_t* rd)
+void filter_live_init(rd_t* rd, unsigned int interval)
 {
-	dlist_foreach2(&rd->resources, (op_binary_t)resource_filter_mask, (void*)&rd->resources);
-	dlist_foreach2(&rd->calls, (op_binary_t)fcall_filter_resource, (void*)rd);
+	filter_stream_init(rd);
+	live.interval = interval;
+	live.report_time = time(NULL);
+	memset(&live.rate, 0, sizeof(live.rate));
+}
+
+void filter_live_add_call(rd_fcall_t* call)
+{
+	if (call->data.type == SP_RTRACE_FTYPE_ALLOC) {
+		live.rate.allocs++;
+		live.rate.alloc_size += call->data.res_size;
+	}
+	else if (call->data.type == SP_RTRACE_FTYPE_FREE) {
+		live.rate.frees++;
+	}
+}
+
+int filter_live_timeout(void)
+{
+	time_t now = time(NULL);
+	if (now >= live.report_time + (time_t)live.interval) return 0;
+	return (live.report_time + live.interval - now) * 1000;
+}
+
+void filter_live_report(rd_t* rd, bool force)
+{
+	time_t now = time(NULL);
+	if (!force && now < live.report_time + (time_t)live.interval) return;
+	/* the report can't be written before the process information is received */
+	if (!rd->pinfo) {
+		live.report_time = now;
+		return;
+	}
+
+	live.rate.index++;
+	live.rate.period = now - live.report_time;
+	write_live_report(rd, &live.rate);
+
+	live.report_time = now;
+	live.rate.allocs = 0;
+	live.rate.alloc_size = 0;
+	live.rate.frees = 0;
+}
+
+void filter_live_free(void)
+{
+	live.interval = 0;
 }
 
 void filter_update_resource_visibility(rd_t* rd)
@@ -412,7 +456,8 @@ void filter_update_resource_visibility(rd_t* rd)
 
 void filter_find_lowhigh_blocks(rd_t* rd)
 {
-	rd->hinfo->lowest_block = (pointer_t)~0L;
+	rd->hinfo->lowest_block = stream.lowest_block;
+	rd->hinfo->highest_block = stream.highest_block;
 	dlist_foreach2(&rd->calls, (op_binary_t)fcall_find_lowhigh_blocks, (void*)rd->hinfo);
 }
 
@@ -440,35 +485,10 @@ void filter_trim_backtraces(rd_t* rd)
 	/* trim the backtraces. Note that only backtrace size is changed, the allocated memory
 	 * is not reallocated */
 	unsigned long bt_depth = rd->pinfo->backtrace_depth;
-	htable_foreach2(&rd->ftraces, (op_binary_t)trim_backtrace, (void*)bt_depth);
-}
-
-
-void filter_include(rd_t* rd)
-{
-	index_filter_t filter = {
-			.rd = rd,
-			.include = true,
-			.index_map = filter_load_index_data(postproc_options.include_file),
-	};
-
-	dlist_foreach2(&rd->calls, (op_binary_t)fcall_filter_index, (void*)&filter);
-	if (filter.index_map) tdestroy(filter.index_map, free_index);
+	hmap_foreach2(&rd->ftraces, (op_binary_t)trim_backtrace, (void*)bt_depth);
 }
 
 
-void filter_exclude(rd_t* rd)
-{
-	index_filter_t filter = {
-			.rd = rd,
-			.include = false,
-			.index_map = filter_load_index_data(postproc_options.exclude_file),
-	};
-
-	dlist_foreach2(&rd->calls, (op_binary_t)fcall_filter_index, (void*)&filter);
-	if (filter.index_map) tdestroy(filter.index_map, free_index);
-}
-
 /*
  * Code address range filtering support
  */
@@ -476,7 +496,6 @@ void filter_exclude(rd_t* rd)
 
 /**/
 typedef struct {
-	rd_t* rd;
 	unsigned long start;
 	unsigned long size;
 } call_address_filter_t;
@@ -509,41 +528,225 @@ static long mmap_lookup_filter_range_target_found(__attribute__((unused)) rd_mma
 	return !filter->start;
 }
 
+
+/*
+ * Function call filter chain
+ */
+
+/* the maximum number of checks in a filter chain stage */
+#define FILTER_CHECK_MAX      4
+
+/**
+ * Function call check.
+ *
+ * @param[in] call   the function call record to check.
+ * @param[in] data   the check specific data.
+ * @return           true if the call record must be kept.
+ */
+typedef bool (*fcall_check_t)(const rd_fcall_t* call, void* data);
+
+/**
+ * Filter chain check with its data.
+ */
+typedef struct filter_check_t {
+	fcall_check_t check;
+	void* data;
+} filter_check_t;
+
+/**
+ * The function call filter chain.
+ *
+ * The --resource, --include, --exclude, --context and --call-address
+ * options are compiled into a list of checks, which are evaluated for
+ * every function call record in a single pass. The checks using only
+ * the function call record fields are evaluated already while the
+ * binary trace data is being read, so the backtraces and arguments of
+ * the removed calls are not read at all.
+ */
+typedef struct filter_chain_t {
+	/* the function call record field checks */
+	filter_check_t call_checks[FILTER_CHECK_MAX];
+	int ncall_checks;
+	/* the checks requiring the whole trace data (backtraces, memory mappings) */
+	filter_check_t trace_checks[FILTER_CHECK_MAX];
+	int ntrace_checks;
+	/* true if the call record field checks are evaluated while reading data */
+	bool stream;
+	/* the include/exclude filter data */
+	index_filter_t include;
+	index_filter_t exclude;
+	/* the call address range filter data */
+	call_address_filter_t range;
+	/* the rtrace data */
+	rd_t* rd;
+} filter_chain_t;
+
+static filter_chain_t chain = {.ncall_checks = 0, .ntrace_checks = 0};
+
 /**
- * Removes allocation events with backtraces not containing any addresses in the
+ * Checks if the function call context matches the context filter.
+ */
+static bool check_context(const rd_fcall_t* call, void* data __attribute__((unused)))
+{
+	if (postproc_options.filter_context) return call->data.context & postproc_options.filter_context;
+	return !call->data.context;
+}
+
+/**
+ * Checks if the function call resource type matches the resource filter.
+ */
+static bool check_resource(const rd_fcall_t* call, void* data __attribute__((unused)))
+{
+	rd_resource_t* res = call->data.res_type;
+	return !res || ((1 << (res->data.id - 1)) & postproc_options.filter_resource);
+}
+
+/**
+ * Checks if the function call event index passes the include/exclude filter.
+ *
+ * The call is removed if:
+ *   1) exclude rule is set and index was found
+ *   2) include rule is set and index was not found
+ */
+static bool check_index(const rd_fcall_t* call, index_filter_t* filter)
+{
+	unsigned long idx = call->data.index;
+	bool found = tfind((void*)idx, &filter->index_map, filter_compare_event_index) != NULL;
+	return found == filter->include;
+}
+
+/**
+ * Checks if the function call backtrace contains an address in the
  * specified range.
- * @param call
- * @param filter
  */
-static void fcall_filter_range(rd_fcall_t* call, call_address_filter_t* filter)
+static bool check_range(const rd_fcall_t* call, call_address_filter_t* filter)
 {
 	unsigned int i;
+	if (!call->trace) return false;
 	for (i = 0; i < call->trace->data.nframes; i++) {
 		pointer_t address = call->trace->data.frames[i];
 		if (address >= filter->start && address < filter->start + filter->size) {
-			return;
+			return true;
 		}
 	}
-	rd_fcall_remove(filter->rd, call);
+	return false;
 }
 
+/**
+ * Adds check to a filter chain stage.
+ *
+ * @param[in] checks  the filter chain stage.
+ * @param[in] count   the number of checks in the stage.
+ * @param[in] check   the check function.
+ * @param[in] data    the check data.
+ */
+static void chain_add_check(filter_check_t* checks, int* count, fcall_check_t check, void* data)
+{
+	checks[*count].check = check;
+	checks[*count].data = data;
+	(*count)++;
+}
 
-void filter_call_address_range(rd_t* rd)
+/**
+ * Evaluates filter chain stage.
+ *
+ * @param[in] checks  the filter chain stage.
+ * @param[in] count   the number of checks in the stage.
+ * @param[in] call    the function call record to check.
+ * @return            true if the call passes all checks.
+ */
+static bool chain_check(const filter_check_t* checks, int count, const rd_fcall_t* call)
 {
-	call_address_filter_t filter = {
-		.rd = rd,
-		.start = 0,
-		.size = 0,
-	};
+	int i;
+	for (i = 0; i < count; i++) {
+		if (!checks[i].check(call, checks[i].data)) return false;
+	}
+	return true;
+}
 
-	dlist_foreach2_in(&rd->mmaps, dlist_first(&rd->mmaps), (op_binary_t)mmap_lookup_filter_range_target_found,
-			(void*)&filter, (op_binary_t)mmap_lookup_filter_range_target, (void*)&filter);
-	if (!filter.start) {
-		msg_warning("failed to find the specified call address range target: %s\n", postproc_options.filter_range_target);
-		free(postproc_options.filter_range_target);
-		postproc_options.filter_range_target = NULL;
-		return;
+/**
+ * Removes function call record not passing the filter chain.
+ *
+ * @param[in] call   the function call record to check.
+ * @param[in] fc     the filter chain.
+ */
+static void fcall_filter_chain(rd_fcall_t* call, filter_chain_t* fc)
+{
+	if ((!fc->stream && !chain_check(fc->call_checks, fc->ncall_checks, call)) ||
+			!chain_check(fc->trace_checks, fc->ntrace_checks, call)) {
+		rd_fcall_remove(fc->rd, call);
 	}
+}
 
-	dlist_foreach2(&rd->calls, (op_binary_t)fcall_filter_range, (void*)&filter);
+
+void filter_chain_init(bool stream)
+{
+	chain.stream = stream;
+	chain.ncall_checks = 0;
+	chain.ntrace_checks = 0;
+
+	if (postproc_options.filter_resource) {
+		chain_add_check(chain.call_checks, &chain.ncall_checks, check_resource, NULL);
+	}
+	if (postproc_options.filter_context != -1) {
+		chain_add_check(chain.call_checks, &chain.ncall_checks, check_context, NULL);
+	}
+	if (postproc_options.include_file) {
+		chain.include.include = true;
+		chain.include.index_map = filter_load_index_data(postproc_options.include_file);
+		chain_add_check(chain.call_checks, &chain.ncall_checks, (fcall_check_t)check_index, &chain.include);
+	}
+	if (postproc_options.exclude_file) {
+		chain.exclude.include = false;
+		chain.exclude.index_map = filter_load_index_data(postproc_options.exclude_file);
+		chain_add_check(chain.call_checks, &chain.ncall_checks, (fcall_check_t)check_index, &chain.exclude);
+	}
+}
+
+bool filter_chain_check_call(const rd_fcall_t* call)
+{
+	return chain_check(chain.call_checks, chain.ncall_checks, call);
+}
+
+void filter_chain_apply(rd_t* rd)
+{
+	chain.rd = rd;
+
+	/* remove the filtered out context and resource type records */
+	if (postproc_options.filter_resource) {
+		dlist_foreach2(&rd->resources, (op_binary_t)resource_filter_mask, (void*)&rd->resources);
+	}
+	if (postproc_options.filter_context != -1) {
+		dlist_foreach2(&rd->contexts, (op_binary_t)context_filter_mask, (void*)&rd->contexts);
+	}
+
+	/* the call address range can be located only after the memory mappings are read */
+	if (postproc_options.filter_range_target) {
+		chain.range.start = 0;
+		chain.range.size = 0;
+		dlist_foreach2_in(&rd->mmaps, dlist_first(&rd->mmaps), (op_binary_t)mmap_lookup_filter_range_target_found,
+				(void*)&chain.range, (op_binary_t)mmap_lookup_filter_range_target, (void*)&chain.range);
+		if (chain.range.start) {
+			chain_add_check(chain.trace_checks, &chain.ntrace_checks, (fcall_check_t)check_range, &chain.range);
+		}
+		else {
+			msg_warning("failed to find the specified call address range target: %s\n", postproc_options.filter_range_target);
+			free(postproc_options.filter_range_target);
+			postproc_options.filter_range_target = NULL;
+		}
+	}
+
+	if (chain.ntrace_checks || (!chain.stream && chain.ncall_checks)) {
+		dlist_foreach2(&rd->calls, (op_binary_t)fcall_filter_chain, (void*)&chain);
+	}
+}
+
+void filter_chain_free(void)
+{
+	if (chain.include.index_map) tdestroy(chain.include.index_map, free_index);
+	if (chain.exclude.index_map) tdestroy(chain.exclude.index_map, free_index);
+	chain.include.index_map = NULL;
+	chain.exclude.index_map = NULL;
+	chain.ncall_checks = 0;
+	chain.ntrace_checks = 0;
 }
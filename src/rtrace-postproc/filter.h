@@ -30,6 +30,7 @@
  */
 
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "common/rtrace_data.h"
 
@@ -46,31 +47,32 @@ typedef struct {
 
 
 /**
- * Filters leaked resources by removing allocation and deallocation
- * function call records for the freed resources.
- *
- * This function is used to process the --remove-freed command line option.
- * @param[in] rd   the resource trace data storage.
- * @return
+ * The live mode activity data, collected between
+ * two live reports.
  */
-void filter_leaks(rd_t* rd);
-
+typedef struct {
+	/* the report number */
+	unsigned int index;
+	/* the number of seconds since the previous report */
+	unsigned int period;
+	/* the number of allocation calls */
+	unsigned long allocs;
+	/* the total size of allocated resources */
+	unsigned long long alloc_size;
+	/* the number of deallocation calls */
+	unsigned long frees;
+} live_rate_t;
 
-/**
- * Filters allocations with contexts matching the specified context filter.
- *
- * @param[in] rd   the resource trace data storage.
- * @return
- */
-void filter_context(rd_t* rd);
 
 /**
- * Filters allocations with resource types matching the specified resource filter.
+ * Filters leaked resources by removing allocation and deallocation
+ * function call records for the freed resources.
  *
+ * This function is used to process the --remove-freed command line option.
  * @param[in] rd   the resource trace data storage.
  * @return
  */
-void filter_resource(rd_t* rd);
+void filter_leaks(rd_t* rd);
 
 
 /**
@@ -113,28 +115,112 @@ void filter_trim_backtraces(rd_t* rd);
 
 
 /**
- * Performs include filter, removing call events not listed in the include file.
+ * Initializes function call filter chain.
  *
- * @param[in] rd  the resource trace data storage.
+ * The filters selected by the --resource, --include, --exclude and
+ * --context options are compiled into a list of function call checks.
+ * @param[in] stream  true if the checks are evaluated while reading
+ *                    the trace data (see filter_chain_check_call()).
  */
-void filter_include(rd_t* rd);
+void filter_chain_init(bool stream);
 
+/**
+ * Checks if the function call record passes the filter chain.
+ *
+ * Only the function call record fields are checked, so this function
+ * can be used before the call backtrace is read.
+ * @param[in] call  the function call record.
+ * @return          true if the call record must be kept.
+ */
+bool filter_chain_check_call(const rd_fcall_t* call);
 
 /**
- * Performs exclude filter, removing call events listed in the exclude file.
+ * Applies the filter chain to the trace data.
  *
- * @param[in] rd  the resource trace data storage.
+ * The filtered out context and resource type records are removed and
+ * the function call records are checked in a single pass. The call
+ * address range filter (--call-address option) is added to the chain
+ * here, as it needs the memory mapping data.
+ * @param[in] rd   the resource trace data storage.
  */
-void filter_exclude(rd_t* rd);
+void filter_chain_apply(rd_t* rd);
 
+/**
+ * Releases the filter chain resources.
+ */
+void filter_chain_free(void);
 
 /**
- * Filters allocations with backtraces having an address in the specified range.
+ * Initializes streaming leak filter.
  *
- * This filter is used to reduce the allocations scope to a specific function
- * (code) in the target binary.
- * @param rd
+ * The streaming leak filter matches the deallocations against the live
+ * resource allocations while the trace data is being read. The freed
+ * allocation and deallocation records are dropped right away, so the
+ * memory usage is bound by the number of live resources rather than
+ * by the trace length.
+ * @param[in] rd   the resource trace data storage.
+ */
+void filter_stream_init(rd_t* rd);
+
+/**
+ * Passes a new function call record to the streaming leak filter.
+ *
+ * The call record must be already stored in the trace data. The
+ * backtrace and arguments are not needed and should not be read
+ * for the removed calls.
+ * @param[in] rd    the resource trace data storage.
+ * @param[in] call  the function call record.
+ * @return          true if the call record was removed.
+ */
+bool filter_stream_add_call(rd_t* rd, rd_fcall_t* call);
+
+/**
+ * Checks if the streaming leak filter is active.
+ *
+ * @return   true if the streaming leak filter has been initialized.
+ */
+bool filter_stream_active(void);
+
+/**
+ * Releases the streaming leak filter resources.
+ */
+void filter_stream_free(void);
+
+/**
+ * Initializes live mode reporting.
+ *
+ * The live mode uses streaming leak filter, so the trace data contains
+ * only the live resources when the reports are written.
+ * @param[in] rd        the resource trace data storage.
+ * @param[in] interval  the live report interval in seconds.
+ */
+void filter_live_init(rd_t* rd, unsigned int interval);
+
+/**
+ * Updates the live mode activity data with a new function call record.
+ *
+ * @param[in] call  the function call record.
+ */
+void filter_live_add_call(rd_fcall_t* call);
+
+/**
+ * Calculates the time left until the next live report.
+ *
+ * @return   the time in milliseconds.
+ */
+int filter_live_timeout(void);
+
+/**
+ * Writes live report if the report interval has passed.
+ *
+ * @param[in] rd     the resource trace data storage.
+ * @param[in] force  write the report regardless of the interval.
+ */
+void filter_live_report(rd_t* rd, bool force);
+
+/**
+ * Releases the live mode reporting resources.
  */
-void filter_call_address_range(rd_t* rd);
+void filter_live_free(void);
 
 #endif /* FILTER_H*/
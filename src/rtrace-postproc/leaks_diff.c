@@ -0,0 +1,419 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "leaks_diff.h"
+#include "sp_rtrace_postproc.h"
+
+#include "common/log_writer.h"
+#include "common/msg.h"
+#include "common/utils.h"
+
+#include "library/sp_rtrace_formatter.h"
+
+#define HASH_SIZE      (1 << 12)
+
+/* the initial symbol path buffer size */
+#define PATH_SIZE      4096
+
+/* the maximum number of resource types */
+#define RESOURCE_MAX   32
+
+/* the compared traces */
+enum {
+	TRACE_BASE,
+	TRACE_NEW,
+	TRACE_MAX
+};
+
+/**
+ * The leaks of backtraces having the same symbol path.
+ */
+typedef struct {
+	/* the resource type name */
+	const char* res_type;
+	/* the symbol path - frame symbols separated by newlines */
+	char* path;
+	size_t path_len;
+	/* the record hash value */
+	long hash;
+	/* the number and total size of leaks in each trace */
+	int count[TRACE_MAX];
+	long long size[TRACE_MAX];
+} diff_rec_t;
+
+/**
+ * The resource type leak totals.
+ */
+typedef struct {
+	const char* res_type;
+	int count[TRACE_MAX];
+	long long size[TRACE_MAX];
+} diff_total_t;
+
+/**
+ * The leak comparison data.
+ */
+typedef struct {
+	/* the leak records, indexed by resource type and symbol path */
+	hmap_t recs;
+	/* the memory mappings of the trace being processed, sorted by address */
+	const sp_rtrace_mmap_t** mmaps;
+	size_t nmmaps;
+	/* the trace being processed */
+	int trace;
+	/* the symbol path of the backtrace being processed */
+	char* path;
+	size_t path_len;
+	size_t path_limit;
+} diff_t;
+
+/**
+ * Calculates hash value for zero terminated string.
+ */
+static long string_hash(const char* str, long hash)
+{
+	while (*str) hash = (hash ^ (unsigned char)*str++) * 16777619u;
+	return hash;
+}
+
+static long diff_rec_hash(const diff_rec_t* rec)
+{
+	return rec->hash;
+}
+
+static long diff_rec_compare(const diff_rec_t* rec1, const diff_rec_t* rec2)
+{
+	if (rec1->hash != rec2->hash) return rec1->hash < rec2->hash ? -1 : 1;
+	if (rec1->path_len != rec2->path_len) return rec1->path_len < rec2->path_len ? -1 : 1;
+	long rc = strcmp(rec1->res_type, rec2->res_type);
+	if (rc) return rc;
+	return memcmp(rec1->path, rec2->path, rec1->path_len);
+}
+
+static void diff_rec_free(diff_rec_t* rec)
+{
+	free(rec->path);
+	free(rec);
+}
+
+/**
+ * Appends text to the symbol path buffer.
+ *
+ * @param[in] diff   the leak comparison data.
+ * @param[in] text   the text to append.
+ * @param[in] len    the text length.
+ */
+static void path_append(diff_t* diff, const char* text, size_t len)
+{
+	if (diff->path_len + len + 1 > diff->path_limit) {
+		while (diff->path_len + len + 1 > diff->path_limit) diff->path_limit <<= 1;
+		diff->path = (char*)realloc_a(diff->path, diff->path_limit);
+	}
+	memcpy(diff->path + diff->path_len, text, len);
+	diff->path_len += len;
+	diff->path[diff->path_len] = '\0';
+}
+
+static int compare_mmaps(const void* mmap1, const void* mmap2)
+{
+	pointer_t from1 = (*(const sp_rtrace_mmap_t* const*)mmap1)->from;
+	pointer_t from2 = (*(const sp_rtrace_mmap_t* const*)mmap2)->from;
+	return from1 < from2 ? -1 : from1 != from2;
+}
+
+/**
+ * Finds the memory mapping containing the specified address.
+ *
+ * @param[in] diff   the leak comparison data.
+ * @param[in] addr   the address.
+ * @return           the memory mapping or NULL.
+ */
+static const sp_rtrace_mmap_t* find_mmap(const diff_t* diff, pointer_t addr)
+{
+	size_t low = 0, high = diff->nmmaps;
+	/* find the first mapping starting after the address */
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+		if (diff->mmaps[mid]->from <= addr) low = mid + 1;
+		else high = mid;
+	}
+	if (low && addr < diff->mmaps[low - 1]->to) return diff->mmaps[low - 1];
+	return NULL;
+}
+
+/**
+ * Appends backtrace frame symbol to the symbol path.
+ *
+ * Resolved frames are identified by function name and module name,
+ * the source location is ignored as it changes between builds.
+ * Unresolved frames are identified by module name and the address
+ * offset in module.
+ * @param[in] diff      the leak comparison data.
+ * @param[in] addr      the frame address.
+ * @param[in] resolved  the resolved frame name or NULL.
+ */
+static void path_append_frame(diff_t* diff, pointer_t addr, const char* resolved)
+{
+	const sp_rtrace_mmap_t* mmap = find_mmap(diff, addr);
+	const char* module = NULL;
+	if (mmap && mmap->module) {
+		module = strrchr(mmap->module, '/');
+		module = module ? module + 1 : mmap->module;
+	}
+	if (diff->path_len) path_append(diff, "\n", 1);
+
+	if (resolved && strncmp(resolved, "from ", 5)) {
+		const char* end = strstr(resolved, " at ");
+		if (!end) end = strstr(resolved, " from ");
+		size_t len = end ? (size_t)(end - resolved) : strlen(resolved);
+		path_append(diff, resolved, len);
+		if (module) {
+			path_append(diff, " in ", 4);
+			path_append(diff, module, strlen(module));
+		}
+		return;
+	}
+	char offset[32];
+	if (module) {
+		path_append(diff, module, strlen(module));
+		path_append(diff, offset, sprintf(offset, "+0x%lx", addr - mmap->from));
+	}
+	else {
+		path_append(diff, offset, sprintf(offset, "0x%lx", addr));
+	}
+}
+
+/**
+ * Retrieves resource type name of the function call.
+ */
+static const char* get_call_res_type(const rd_fcall_t* call)
+{
+	switch (call->data.res_type_flag) {
+		case SP_RTRACE_FCALL_RFIELD_REF: {
+			const rd_resource_t* res = call->data.res_type;
+			if (res && res->data.type) return res->data.type;
+			break;
+		}
+		case SP_RTRACE_FCALL_RFIELD_NAME: {
+			if (call->data.res_type) return call->data.res_type;
+			break;
+		}
+	}
+	return "";
+}
+
+/**
+ * Adds leaks of the backtrace to the leak records.
+ *
+ * @param[in] trace   the backtrace.
+ * @param[in] diff    the leak comparison data.
+ * @return
+ */
+static long add_trace_leaks(rd_ftrace_t* trace, diff_t* diff)
+{
+	size_t i;
+	diff->path_len = 0;
+	diff->path[0] = '\0';
+	for (i = 0; i < trace->data.nframes; i++) {
+		path_append_frame(diff, trace->data.frames[i], trace->data.resolved_names ? trace->data.resolved_names[i] : NULL);
+	}
+	long path_hash = string_hash(diff->path, 2166136261u);
+
+	diff_rec_t* rec = NULL;
+	dlist_node_t* node;
+	for (node = dlist_first(&trace->calls); node; node = node->next) {
+		rd_fcall_t* call = (rd_fcall_t*)REF_NODE(node)->ref;
+		if (call->data.type != SP_RTRACE_FTYPE_ALLOC) continue;
+
+		const char* res_type = get_call_res_type(call);
+		/* the calls of a backtrace usually have the same resource type */
+		if (!rec || strcmp(rec->res_type, res_type)) {
+			diff_rec_t template = {
+					.res_type = res_type,
+					.path = diff->path,
+					.path_len = diff->path_len,
+					.hash = string_hash(res_type, path_hash),
+			};
+			rec = (diff_rec_t*)hmap_find(&diff->recs, &template);
+			if (!rec) {
+				rec = (diff_rec_t*)calloc_a(1, sizeof(diff_rec_t));
+				*rec = template;
+				rec->path = strdup_a(diff->path);
+				hmap_store(&diff->recs, rec);
+			}
+		}
+		rec->count[diff->trace]++;
+		rec->size[diff->trace] += call->data.res_size;
+	}
+	return 0;
+}
+
+/**
+ * Adds leaks of the trace to the leak records.
+ *
+ * @param[in] diff    the leak comparison data.
+ * @param[in] rd      the resource trace data.
+ * @param[in] trace   the trace (TRACE_BASE or TRACE_NEW).
+ */
+static void add_leaks(diff_t* diff, rd_t* rd, int trace)
+{
+	dlist_node_t* node;
+	size_t n = 0;
+	for (node = dlist_first(&rd->mmaps); node; node = node->next) n++;
+	diff->mmaps = (const sp_rtrace_mmap_t**)malloc_a(sizeof(sp_rtrace_mmap_t*) * (n + 1));
+	diff->nmmaps = 0;
+	for (node = dlist_first(&rd->mmaps); node; node = node->next) {
+		diff->mmaps[diff->nmmaps++] = &((rd_mmap_t*)node)->data;
+	}
+	qsort(diff->mmaps, diff->nmmaps, sizeof(sp_rtrace_mmap_t*), compare_mmaps);
+
+	diff->trace = trace;
+	hmap_foreach2(&rd->ftraces, (op_binary_t)add_trace_leaks, diff);
+
+	free(diff->mmaps);
+	diff->mmaps = NULL;
+	diff->nmmaps = 0;
+}
+
+/**
+ * The changed leak records.
+ */
+typedef struct {
+	diff_rec_t** recs;
+	size_t count;
+	diff_total_t totals[RESOURCE_MAX];
+	size_t ntotals;
+} diff_changes_t;
+
+static long collect_changes(diff_rec_t* rec, diff_changes_t* changes)
+{
+	size_t i;
+	for (i = 0; i < changes->ntotals; i++) {
+		if (!strcmp(changes->totals[i].res_type, rec->res_type)) break;
+	}
+	if (i == changes->ntotals && changes->ntotals < RESOURCE_MAX) {
+		changes->totals[changes->ntotals++].res_type = rec->res_type;
+	}
+	if (i < changes->ntotals) {
+		diff_total_t* total = &changes->totals[i];
+		int trace;
+		for (trace = 0; trace < TRACE_MAX; trace++) {
+			total->count[trace] += rec->count[trace];
+			total->size[trace] += rec->size[trace];
+		}
+	}
+	if (rec->count[TRACE_NEW] != rec->count[TRACE_BASE] || rec->size[TRACE_NEW] != rec->size[TRACE_BASE]) {
+		changes->recs[changes->count++] = rec;
+	}
+	return 0;
+}
+
+/**
+ * Compares leak records by the leak size change in descending order.
+ */
+static int compare_changes(const void* item1, const void* item2)
+{
+	const diff_rec_t* rec1 = *(diff_rec_t* const*)item1;
+	const diff_rec_t* rec2 = *(diff_rec_t* const*)item2;
+	long long delta1 = rec1->size[TRACE_NEW] - rec1->size[TRACE_BASE];
+	long long delta2 = rec2->size[TRACE_NEW] - rec2->size[TRACE_BASE];
+	if (delta1 != delta2) return delta1 > delta2 ? -1 : 1;
+	delta1 = rec1->count[TRACE_NEW] - rec1->count[TRACE_BASE];
+	delta2 = rec2->count[TRACE_NEW] - rec2->count[TRACE_BASE];
+	if (delta1 != delta2) return delta1 > delta2 ? -1 : 1;
+	int rc = strcmp(rec1->res_type, rec2->res_type);
+	if (rc) return rc;
+	return strcmp(rec1->path, rec2->path);
+}
+
+/**
+ * Writes leak change summary line.
+ */
+static int write_change(sp_rtrace_formatter_t* formatter, const char* res_type, const int* count, const long long* size)
+{
+	return sp_rtrace_format_comment(formatter, "# <%s> %+d block(s), %+lld bytes (%d => %d block(s), %lld => %lld bytes)\n",
+			res_type, count[TRACE_NEW] - count[TRACE_BASE], size[TRACE_NEW] - size[TRACE_BASE],
+			count[TRACE_BASE], count[TRACE_NEW], size[TRACE_BASE], size[TRACE_NEW]);
+}
+
+/*
+ * Public API
+ */
+
+void write_leaks_diff(rd_t* rd, rd_t* rd_base)
+{
+	diff_t diff = {.path_limit = PATH_SIZE};
+	if (hmap_init(&diff.recs, HASH_SIZE, (op_unary_t)diff_rec_hash, (op_binary_t)diff_rec_compare) != 0) {
+		msg_error("failed to create leak comparison table\n");
+		exit (-1);
+	}
+	diff.path = (char*)malloc_a(diff.path_limit);
+
+	add_leaks(&diff, rd_base, TRACE_BASE);
+	add_leaks(&diff, rd, TRACE_NEW);
+
+	diff_changes_t changes = {.count = 0, .ntotals = 0};
+	memset(changes.totals, 0, sizeof(changes.totals));
+	changes.recs = (diff_rec_t**)malloc_a(sizeof(diff_rec_t*) * (diff.recs.count + 1));
+	hmap_foreach2(&diff.recs, (op_binary_t)collect_changes, &changes);
+	qsort(changes.recs, changes.count, sizeof(diff_rec_t*), compare_changes);
+
+	fflush(stdout);
+	sp_rtrace_formatter_t* formatter = sp_rtrace_formatter_create(STDOUT_FILENO);
+
+	TRY(sp_rtrace_format_comment(formatter, "# leak changes from %s to %s\n", postproc_options.diff_file,
+			postproc_options.input_file ? postproc_options.input_file : "standard input"));
+	size_t i;
+	for (i = 0; i < changes.ntotals; i++) {
+		TRY(write_change(formatter, changes.totals[i].res_type, changes.totals[i].count, changes.totals[i].size));
+	}
+	TRY(sp_rtrace_format_comment(formatter, "# %d of %d backtrace(s) changed\n\n", (int)changes.count, (int)diff.recs.count));
+
+	for (i = 0; i < changes.count; i++) {
+		diff_rec_t* rec = changes.recs[i];
+		TRY(write_change(formatter, rec->res_type, rec->count, rec->size));
+		const char* frame = rec->path;
+		while (*frame) {
+			const char* end = strchr(frame, '\n');
+			int len = end ? end - frame : (int)strlen(frame);
+			TRY(sp_rtrace_format_comment(formatter, "\t%.*s\n", len, frame));
+			frame += len;
+			if (*frame) frame++;
+		}
+		TRY(sp_rtrace_format_comment(formatter, "\n"));
+	}
+
+	int rc = sp_rtrace_formatter_destroy(formatter);
+	if (rc < 0) {
+		msg_error("failed to write output data (%s)\n", strerror(-rc));
+		exit (-1);
+	}
+
+	free(changes.recs);
+	free(diff.path);
+	hmap_free(&diff.recs, (op_unary_t)diff_rec_free);
+}
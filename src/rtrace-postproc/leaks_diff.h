@@ -0,0 +1,49 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file leaks_diff.h
+ *
+ * This file provides leak comparison for --diff option.
+ */
+#ifndef LEAKS_DIFF_H
+#define LEAKS_DIFF_H
+
+#include "common/rtrace_data.h"
+
+/**
+ * Writes the leak changes between two traces.
+ *
+ * The leaked resources are grouped by resource type and backtrace
+ * symbol path. The frames are identified by the resolved function
+ * name and module, or by the module relative address for unresolved
+ * frames, so the backtraces of different runs (or builds) can be
+ * matched regardless of the module load addresses. The groups with
+ * changed leak count or size are written into standard output,
+ * sorted by the leak size change.
+ * @param[in] rd        the resource trace data.
+ * @param[in] rd_base   the baseline resource trace data.
+ */
+void write_leaks_diff(rd_t* rd, rd_t* rd_base);
+
+#endif
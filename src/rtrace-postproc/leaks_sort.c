@@ -41,8 +41,12 @@ typedef struct {
  */
 static long count_leaks(ref_node_t* call_ref, ftrace_ref_t* trace_ref)
 {
+	rd_fcall_t* call = (rd_fcall_t*)call_ref->ref;
 	trace_ref->leak_count++;
-	trace_ref->leak_size += ((rd_fcall_t*)call_ref->ref)->data.res_size;
+	trace_ref->leak_size += call->data.res_size;
+	if (trace_ref->leak_count == 1 || call->data.index < trace_ref->first_index) {
+		trace_ref->first_index = call->data.index;
+	}
 	return 0;
 }
 
@@ -59,38 +63,52 @@ static long sort_leak(rd_ftrace_t* trace, leaks_sort_t* sdata)
 	ref->ref = trace;
 	ref->leak_count = 0;
 	ref->leak_size = 0;
+	ref->first_index = 0;
 
 	dlist_foreach2(&trace->calls, (op_binary_t)count_leaks, (void*)ref);
 	dlist_add(sdata->sorted, ref);
 	return 0;
 }
 
+/**
+ * Orders backtraces with equal leaks by their first function call.
+ *
+ * @param[in] diff    the leak comparison result.
+ * @param[in] tref1   the first backtrace reference.
+ * @param[in] tref2   the second backtrace reference.
+ * @return            the comparison result.
+ */
+static long compare_first_index(long diff, ftrace_ref_t* tref1, ftrace_ref_t* tref2)
+{
+	return diff ? diff : tref1->first_index - tref2->first_index;
+}
+
 long leaks_compare_by_size_asc(ftrace_ref_t* tref1, ftrace_ref_t* tref2)
 {
-	return tref1->leak_size - tref2->leak_size;
+	return compare_first_index(tref1->leak_size - tref2->leak_size, tref1, tref2);
 }
 
 long leaks_compare_by_size_desc(ftrace_ref_t* tref1, ftrace_ref_t* tref2)
 {
-	return tref2->leak_size - tref1->leak_size;
+	return compare_first_index(tref2->leak_size - tref1->leak_size, tref1, tref2);
 }
 
 long leaks_compare_by_count_asc(ftrace_ref_t* tref1, ftrace_ref_t* tref2)
 {
-	return tref1->leak_count - tref2->leak_count;
+	return compare_first_index(tref1->leak_count - tref2->leak_count, tref1, tref2);
 }
 
 long leaks_compare_by_count_desc(ftrace_ref_t* tref1, ftrace_ref_t* tref2)
 {
-	return tref2->leak_count - tref1->leak_count;
+	return compare_first_index(tref2->leak_count - tref1->leak_count, tref1, tref2);
 }
 
-void leaks_sort(htable_t* htraces, dlist_t* sorted, op_binary_t compare)
+void leaks_sort(hmap_t* htraces, dlist_t* sorted, op_binary_t compare)
 {
 	leaks_sort_t sort_data = {
 			.sorted = sorted,
 			.compare = compare,
 	};
-	htable_foreach2(htraces, (op_binary_t)sort_leak, (void*)&sort_data);
+	hmap_foreach2(htraces, (op_binary_t)sort_leak, (void*)&sort_data);
 	dlist_sort(sorted, compare);
 }
@@ -31,7 +31,7 @@
 #define LEAKS_SORT_H
 
 #include "common/dlist.h"
-#include "common/htable.h"
+#include "common/hmap.h"
 
 /**
  * Backtrace reference data.
@@ -41,6 +41,8 @@ typedef struct {
 	rd_ftrace_t* ref;
 	int leak_count;
 	int leak_size;
+	/* the index of the first function call with this backtrace */
+	int first_index;
 } ftrace_ref_t;
 
 /**
@@ -87,12 +89,14 @@ long leaks_compare_by_count_desc(ftrace_ref_t* tref1, ftrace_ref_t* tref2);
  * Sorts backtraces of the leaked resources.
  *
  * This function creates backtrace reference list sorted by the specified
- * comparison function.
+ * comparison function. The backtraces with equal leaks are sorted by
+ * their first function call index, so the order doesn't depend on
+ * the backtrace table layout.
  * @param[in] htraces   the backtrace hash table.
  * @param[out] sorted   the output list.
  * @param[in] compare   the comparison function.
  */
-void leaks_sort(htable_t* htraces, dlist_t* sorted, op_binary_t compare);
+void leaks_sort(hmap_t* htraces, dlist_t* sorted, op_binary_t compare);
 
 
 #endif
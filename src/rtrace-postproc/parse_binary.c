@@ -29,6 +29,13 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <zlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "sp_rtrace_postproc.h"
 #include "common/sp_rtrace_proto.h"
@@ -36,14 +43,45 @@
 #include "library/sp_rtrace_defs.h"
 
 #include "parse_binary.h"
+#include "filter.h"
 #include "common/utils.h"
 
 /* the read buffer size */
 #define BUFFER_SIZE			4096
 
+/* the gzip format flag for inflateInit2() window bits parameter */
+#define COMPRESSION_GZIP	16
+
+/* the maximum number of backtrace frames looked up in the backtrace
+ * table without allocating the backtrace record first */
+#define BT_LOOKUP_FRAMES	256
+
 /* the current function call index */
 static int call_index = 1;
 
+/* the last function call record, waiting for its arguments and backtrace */
+static rd_fcall_t* fcall_prev = NULL;
+
+/* true if the last function call record was removed by the streaming leak
+ * filter and its arguments and backtrace must be skipped */
+static bool fcall_skip = false;
+
+/* the precalculated hash values of the following backtrace packets,
+ * NULL if the hash values are calculated while reading the packets */
+static const long* bt_hashes = NULL;
+
+/**
+ * Binary data input stream.
+ */
+typedef struct binary_input_t {
+	/* the input file descriptor */
+	int fd;
+	/* the decompression stream, NULL for uncompressed input */
+	z_stream* zs;
+	/* the compressed data buffer */
+	unsigned char buffer[BUFFER_SIZE];
+} binary_input_t;
+
 
 enum {
 	PACKET_OK = 0,
@@ -62,6 +100,8 @@ static rd_hshake_t* read_handshake_packet(const char* data)
 {
 	/* reset the function call index as handshake packet means parsing new data */
 	call_index = 1;
+	fcall_prev = NULL;
+	fcall_skip = false;
 	/**/
 	rd_hshake_t* hs = (rd_hshake_t*)malloc_a(sizeof(rd_hshake_t));
 	unsigned char len;
@@ -122,18 +162,30 @@ static rd_resource_t* read_packet_RR(const rd_hshake_t* hs, const char* data)
 /**
  * Reads memory mapping packet.
  *
+ * The build-id and load bias fields are optional.
  * @param[in] data   the binary data.
  * @param[in] size   the data size.
  * @return           the memory mapping record.
  */
-static rd_mmap_t* read_packet_MM(const rd_hshake_t* hs __attribute__((unused)), const char* data)
+static rd_mmap_t* read_packet_MM(const rd_hshake_t* hs __attribute__((unused)), const char* data, int size)
 {
 	SP_RTRACE_PROTO_CHECK_ALIGNMENT(data);
 
+	const char* end = data + size;
 	rd_mmap_t* fmap = (rd_mmap_t*)dlist_create_node(sizeof(rd_mmap_t));
 	data += read_pointer(data, &fmap->data.from);
 	data += read_pointer(data, &fmap->data.to);
-	read_stringa(data, &fmap->data.module);
+	data += read_stringa(data, &fmap->data.module);
+	fmap->data.build_id = NULL;
+	fmap->data.bias = 0;
+	if (data < end) {
+		data += read_stringa(data, &fmap->data.build_id);
+		read_pointer(data, &fmap->data.bias);
+		if (!*fmap->data.build_id) {
+			free(fmap->data.build_id);
+			fmap->data.build_id = NULL;
+		}
+	}
 	return fmap;
 }
 
@@ -210,14 +262,16 @@ static rd_attachment_t* read_packet_FILE(const rd_hshake_t* hs __attribute__((un
 /**
  * Reads function call packet.
  *
+ * The function call record is allocated from the trace data
+ * call pool and the function name is stored in the name arena.
+ * @param[in] rd     the resource trace data.
  * @param[in] data   the binary data.
- * @param[in] size   the data size.
  * @return           the function call record.
  */
-static rd_fcall_t* read_packet_FC(const rd_hshake_t* hs __attribute__((unused)), const char* data)
+static rd_fcall_t* read_packet_FC(rd_t* rd, const char* data)
 {
 	SP_RTRACE_PROTO_CHECK_ALIGNMENT(data);
-	rd_fcall_t* call = (rd_fcall_t*)dlist_create_node(sizeof(rd_fcall_t));
+	rd_fcall_t* call = rd_fcall_create(rd);
 	sp_rtrace_fcall_t* cd = &call->data;
 	cd->index = call_index++;
 	/* read resource type id into res_type field. A reference to the resource
@@ -231,12 +285,14 @@ static rd_fcall_t* read_packet_FC(const rd_hshake_t* hs __attribute__((unused)),
 	data += read_dword(data, &cd->context);
 	data += read_dword(data, &cd->timestamp);
 	data += read_dword(data, &cd->type);
-	data += read_stringa(data, &cd->name);
+	unsigned short len = 0;
+	read_word(data, &len);
+	/* the packet string length includes the alignment padding, so
+	 * pool only the name itself */
+	cd->name = rd_fcall_name(rd, data + sizeof(short), strnlen(data + sizeof(short), len));
+	data += len ? len + sizeof(short) : SP_RTRACE_PROTO_TYPE_SIZE;
 	data += read_dword(data, (unsigned int*)&cd->res_size);
 	read_pointer(data, &cd->res_id);
-	call->trace = NULL;
-	call->args = NULL;
-	call->ref = NULL;
 	return call;
 }
 
@@ -244,17 +300,33 @@ static rd_fcall_t* read_packet_FC(const rd_hshake_t* hs __attribute__((unused)),
 /**
  * Reads function trace packet.
  *
+ * Most of the backtraces are repeated, so the backtrace table is
+ * checked first and the backtrace record is allocated only for
+ * new backtraces.
+ * @param[in] rd     the resource trace data.
  * @param[in] data   the binary data.
- * @param[in] size   the data size.
+ * @param[in] hash   the precalculated backtrace hash value, NULL if not known.
  * @return           the function trace record.
  */
-static rd_ftrace_t* read_packet_BT(const rd_hshake_t* hs __attribute__((unused)), const char* data)
+static rd_ftrace_t* read_packet_BT(rd_t* rd, const char* data, const long* hash)
 {
 	SP_RTRACE_PROTO_CHECK_ALIGNMENT(data);
 
-	rd_ftrace_t* trace = (rd_ftrace_t*)htable_create_node(sizeof(rd_ftrace_t));
+	pointer_t frames[BT_LOOKUP_FRAMES];
+	rd_ftrace_t template = {.hash = hash ? *hash : 0, .hash_valid = hash != NULL, .data = {.frames = frames}};
+	data += read_dword2long(data, &template.data.nframes);
+	if (template.data.nframes <= BT_LOOKUP_FRAMES) {
+		memcpy(frames, data, sizeof(pointer_t) * template.data.nframes);
+		rd_ftrace_t* xtrace = (rd_ftrace_t*)hmap_find(&rd->ftraces, &template);
+		if (xtrace) return xtrace;
+	}
+
+	rd_ftrace_t* trace = (rd_ftrace_t*)malloc_a(sizeof(rd_ftrace_t));
+	/* the hash value was calculated by the lookup (or in advance) */
+	trace->hash = template.hash;
+	trace->hash_valid = template.hash_valid;
 	trace->ref_count = 0;
-	data += read_dword2long(data, &trace->data.nframes);
+	trace->data.nframes = template.data.nframes;
 	trace->data.frames = (pointer_t*)malloc_a(sizeof(pointer_t) * trace->data.nframes);
 	memcpy(trace->data.frames, data, sizeof(pointer_t) * trace->data.nframes);
 	/* binary packets can't contain resolved address names */
@@ -310,55 +382,85 @@ static rd_hinfo_t* read_packet_HI(const rd_hshake_t* hs __attribute__((unused)),
 }
 
 /**
- * Reads generic packet.
+ * Reads packet header.
  *
- * @param[in] data   the binary data.
- * @param[in] size   the data size.
- * @return           the number of bytes processed.
+ * @param[in] hs       the handshake data.
+ * @param[in] data     the binary data.
+ * @param[in] size     the data size.
+ * @param[out] type    the packet type.
+ * @param[out] offset  the packet data offset.
+ * @return             the packet size, PACKET_INCOMPLETE if the data does not
+ *                     contain the whole packet or PACKET_UNKNOWN if a handshake
+ *                     packet was found.
  */
-static int read_generic_packet(rd_t* rd, const char* data, int size)
+static int read_packet_header(const rd_hshake_t* hs, const char* data, int size, unsigned int* type, int* offset)
 {
-	static rd_resource_t* res_index[33];
 	/* first check if the packet contains enough data to read size value */
 	if (size < SP_RTRACE_PROTO_LENGTH_SIZE + SP_RTRACE_PROTO_TYPE_SIZE) return PACKET_INCOMPLETE;
 
-	static rd_fcall_t* fcall_prev = NULL;
-	unsigned int len, type;
-	int offset;
+	unsigned int len;
 
 	/* in version < 2.0 size field was before type field ([size][type]).
 	 * Starting with 2.0 those fields were swapped.  */
-	if (rd->hshake->vmajor < 2) {
+	if (hs->vmajor < 2) {
 		/* check if the buffer has at least one full packet */
-		offset = read_dword(data, &len);
-		len += offset;
+		*offset = read_dword(data, &len);
+		len += *offset;
 		/* read packet type */
-		offset += read_dword(data + offset, &type);
+		*offset += read_dword(data + *offset, type);
 	}
 	else {
 		/* read the type packet */
-		offset = read_dword(data, &type);
+		*offset = read_dword(data, type);
 
 		/* check if the buffer has at least one full packet */
-		offset += read_dword(data + offset, &len);
-		len += offset;
-
-		if ((unsigned char)data[0] == SP_RTRACE_PROTO_HS_ID) {
-			/* Received handshake packet in the middle of data stream.
-			 * It might be possible that multiple data files are streamed into
-			 * post-processor. In this case simply stop parsing the new packets
-			 * and process the received data  */
-			msg_warning("handshake packet received in the middle of data stream\n");
-			return PACKET_UNKNOWN;
-		}
-		//LOG("type=%c%c%c%c, size=%d", data[0], data[1], data[2], data[3], len);
+		*offset += read_dword(data + *offset, &len);
+		len += *offset;
 
+		if ((unsigned char)data[0] == SP_RTRACE_PROTO_HS_ID) return PACKET_UNKNOWN;
+		//LOG("type=%c%c%c%c, size=%d", data[0], data[1], data[2], data[3], len);
 	}
 	if ((int)len > size) {
 		return PACKET_INCOMPLETE;
 	}
+	return len;
+}
+
+/**
+ * Reads generic packet.
+ *
+ * @param[in] data   the binary data.
+ * @param[in] size   the data size.
+ * @return           the number of bytes processed.
+ */
+static int read_generic_packet(rd_t* rd, const char* data, int size)
+{
+	static rd_resource_t* res_index[33];
+	unsigned int type;
+	int offset;
+
+	int len = read_packet_header(rd->hshake, data, size, &type, &offset);
+	if (len == PACKET_UNKNOWN) {
+		/* Received handshake packet in the middle of data stream.
+		 * It might be possible that multiple data files are streamed into
+		 * post-processor. In this case simply stop parsing the new packets
+		 * and process the received data  */
+		msg_warning("handshake packet received in the middle of data stream\n");
+	}
+	if (len <= 0) return len;
 	data += offset;
 
+	/* take the precalculated backtrace hash value, before
+	 * the backtrace packet can be skipped */
+	const long* hash = NULL;
+	if (type == SP_RTRACE_PROTO_BACKTRACE && bt_hashes) hash = bt_hashes++;
+
+	/* the arguments and backtrace of the removed function call are not read */
+	if (fcall_skip) {
+		if (type == SP_RTRACE_PROTO_FUNCTION_ARGS || type == SP_RTRACE_PROTO_BACKTRACE) return len;
+		fcall_skip = false;
+	}
+
 	/* process packet depending on its type */
 
 	switch (type) {
@@ -366,7 +468,7 @@ static int read_generic_packet(rd_t* rd, const char* data, int size)
 		rd_ftrace_t* trace;
 
 		case SP_RTRACE_PROTO_MEMORY_MAP:
-			dlist_add(&rd->mmaps, read_packet_MM(rd->hshake, data));
+			dlist_add(&rd->mmaps, read_packet_MM(rd->hshake, data, len - offset));
 			fcall_prev = NULL;
 			break;
 
@@ -383,14 +485,27 @@ static int read_generic_packet(rd_t* rd, const char* data, int size)
 			break;
 
 		case SP_RTRACE_PROTO_FUNCTION_CALL:
-			fcall_prev = read_packet_FC(rd->hshake, data);
+			fcall_prev = read_packet_FC(rd, data);
 			dlist_add(&rd->calls, fcall_prev);
 			fcall_prev->data.res_type = res_index[(long)fcall_prev->data.res_type];
 			fcall_prev->data.res_type_flag = SP_RTRACE_FCALL_RFIELD_REF;
+			/* drop the filtered out calls before their backtraces are stored */
+			if (!filter_chain_check_call(fcall_prev)) {
+				rd_fcall_remove(rd, fcall_prev);
+				fcall_prev = NULL;
+				fcall_skip = true;
+				break;
+			}
+			if (postproc_options.live_interval) filter_live_add_call(fcall_prev);
+			/* drop the freed allocations before their backtraces are stored */
+			if (filter_stream_active() && filter_stream_add_call(rd, fcall_prev)) {
+				fcall_prev = NULL;
+				fcall_skip = true;
+			}
 			break;
 
 		case SP_RTRACE_PROTO_BACKTRACE:
-			trace = read_packet_BT(rd->hshake, data);
+			trace = read_packet_BT(rd, data, hash);
 			/* check if function call record for this backtrace has been processed.
 			 * It should have been a record processed right before this one.
 			 */
@@ -398,6 +513,8 @@ static int read_generic_packet(rd_t* rd, const char* data, int size)
 				rd_fcall_set_ftrace(rd, fcall_prev, trace);
 			}
 			else {
+				/* the registered backtraces are always referenced by calls */
+				if (!trace->ref_count) rd_ftrace_free(trace);
 				msg_warning("a backtrace packet did not follow function call/function argument packet\n");
 			}
 			fcall_prev = NULL;
@@ -443,25 +560,72 @@ static int read_generic_packet(rd_t* rd, const char* data, int size)
 }
 
 /**
- * Read data from the specified file descriptor and process it.
+ * Reads data from the input stream, decompressing it if necessary.
  *
- * @param[out] rd   the resource trace data.
- * @param[in] fd    the data source file descriptor.
- * @return
+ * The compressed input is decompressed in a streaming fashion. Truncated
+ * compressed data (for example when the pre-processor was killed) is
+ * treated as the end of input.
+ * @param[in] input  the input stream.
+ * @param[out] data  the output buffer.
+ * @param[in] size   the output buffer size.
+ * @return           the number of bytes read, 0 - end of input, -1 - failure.
  */
-static void read_binary_data(rd_t* rd, int fd)
+static int read_input(binary_input_t* input, char* data, int size)
 {
-	/* point ptr_in at the second byte in buffer, as the first
-	 * one is supposed to be taken by the binary protocol identification
-	 * byte, read earlier. This is done to keep the packet alignment.
-	 */
-	char buffer[BUFFER_SIZE * 2], *ptr_in = buffer + 1;
-	int n, data_len, size;
+	if (!input->zs) return read(input->fd, data, size);
 
-	/* read and process the handshake packet */
-	n = read(fd, ptr_in, BUFFER_SIZE - 1);
-	data_len = *(unsigned char*)ptr_in++;
-	if (data_len >= n || (rd->hshake = read_handshake_packet(ptr_in)) == NULL) {
+	z_stream* zs = input->zs;
+	zs->next_out = (unsigned char*)data;
+	zs->avail_out = size;
+	while (zs->avail_out == (unsigned int)size) {
+		if (zs->avail_in == 0) {
+			int n = read(input->fd, input->buffer, sizeof(input->buffer));
+			if (n < 0) return -1;
+			if (n == 0) break;
+			zs->next_in = input->buffer;
+			zs->avail_in = n;
+		}
+		int rc = inflate(zs, Z_NO_FLUSH);
+		if (rc == Z_STREAM_END) {
+			/* a new gzip member can follow, for example when compressed logs are concatenated */
+			inflateReset(zs);
+		}
+		else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+			msg_error("failed to decompress input data (%s)\n", zs->msg ? zs->msg : "unknown error");
+			return -1;
+		}
+	}
+	return size - zs->avail_out;
+}
+
+/**
+ * Waits until the input stream has data available.
+ *
+ * The live reports are written when the report interval passes
+ * while waiting.
+ * @param[in] rd   the resource trace data.
+ * @param[in] fd   the input file descriptor.
+ */
+static void wait_input(rd_t* rd, int fd)
+{
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	while (!postproc_abort && poll(&pfd, 1, filter_live_timeout()) == 0) {
+		filter_live_report(rd, false);
+	}
+}
+
+/**
+ * Reads and checks the handshake packet.
+ *
+ * @param[out] rd    the resource trace data.
+ * @param[in] data   the binary data, starting with handshake packet.
+ * @param[in] size   the data size.
+ * @return           the handshake packet size.
+ */
+static int read_handshake(rd_t* rd, const char* data, int size)
+{
+	int data_len = *(const unsigned char*)data++;
+	if (data_len >= size || (rd->hshake = read_handshake_packet(data)) == NULL) {
 		/* A handshake packet fragmentation is a sign of error,
 		 * as the handshake packet size is less than 256 bytes
 		 * and it's the first packet written into pipe. So in
@@ -483,8 +647,387 @@ static void read_binary_data(rd_t* rd, int fd)
 		msg_warning("architecture mismatch: %s (expected %s)\n",
 		            rd->hshake->arch, BUILD_ARCH);
 	}
-	n -= data_len + 1;
-	ptr_in += data_len;
+	return data_len + 1;
+}
+
+/*
+ * Pipelined packet processing.
+ *
+ * The input data is split at packet boundaries into chunks by a reader
+ * thread. The chunks are passed to worker threads, calculating the
+ * backtrace hash values, and then processed by the main thread in the
+ * input order, so the stateful processing (function call/backtrace
+ * association, resource registry, streaming leak filter) is not
+ * changed.
+ */
+
+/* the maximum number of packets in a pipeline chunk */
+#define CHUNK_PACKETS		16384
+
+/* the initial pipeline chunk buffer size for stream input */
+#define CHUNK_BUFFER_SIZE	(256 * 1024)
+
+/* the number of pipeline chunks per worker thread */
+#define CHUNKS_PER_WORKER	2
+
+/**
+ * Pipeline data chunk.
+ */
+typedef struct chunk_t {
+	/* the chunk data, containing only whole packets */
+	const char* data;
+	/* the chunk data size */
+	int size;
+	/* the data buffer for stream input */
+	char* buffer;
+	/* the data buffer size */
+	int buffer_size;
+	/* the backtrace hash values, in backtrace packet order */
+	long hashes[CHUNK_PACKETS];
+	/* true if the hash values are calculated */
+	bool ready;
+} chunk_t;
+
+/**
+ * Packet processing pipeline.
+ */
+typedef struct pipeline_t {
+	/* the handshake data, defining the packet header format */
+	const rd_hshake_t* hs;
+
+	/* the mapped input data left to split */
+	const char* data;
+	size_t size;
+
+	/* the stream input, NULL for mapped input */
+	binary_input_t* input;
+	/* the data left to split from the last chunk (or the
+	 * first input buffer) */
+	const char* tail;
+	int ntail;
+
+	/* the pipeline chunks, used as a ring buffer */
+	chunk_t* chunks;
+	unsigned int nchunks;
+	/* the number of chunks split, taken by workers and processed */
+	unsigned long nsplit;
+	unsigned long ndecode;
+	unsigned long nmerge;
+	/* true if the whole input was split */
+	bool eof;
+	/* true if the packet processing was stopped */
+	bool stop;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} pipeline_t;
+
+/**
+ * Finds the whole packets at the beginning of the data.
+ *
+ * When a handshake packet is found, its header is included, so the
+ * packet processing reports it and stops at it.
+ * @param[in] hs      the handshake data.
+ * @param[in] data    the binary data.
+ * @param[in] size    the data size.
+ * @param[out] last   true if no more packets can follow (handshake packet was found).
+ * @return            the size of the whole packets.
+ */
+static int split_packets(const rd_hshake_t* hs, const char* data, int size, bool* last)
+{
+	unsigned int type;
+	int offset, len, count = 0, total = 0;
+
+	*last = false;
+	while (count++ < CHUNK_PACKETS) {
+		len = read_packet_header(hs, data + total, size - total, &type, &offset);
+		if (len == PACKET_UNKNOWN) {
+			*last = true;
+			return total + SP_RTRACE_PROTO_LENGTH_SIZE + SP_RTRACE_PROTO_TYPE_SIZE;
+		}
+		if (len <= 0) break;
+		total += len;
+	}
+	return total;
+}
+
+/**
+ * Splits the next chunk from the mapped input data.
+ *
+ * @param[in] pl      the pipeline.
+ * @param[out] chunk  the chunk to fill.
+ * @return            true if more data can follow.
+ */
+static bool split_mapped_chunk(pipeline_t* pl, chunk_t* chunk)
+{
+	bool last;
+	chunk->data = pl->data;
+	chunk->size = split_packets(pl->hs, pl->data, pl->size > INT_MAX ? INT_MAX : pl->size, &last);
+	pl->data += chunk->size;
+	pl->size -= chunk->size;
+	/* an empty chunk means truncated data at the end of input */
+	return !last && chunk->size;
+}
+
+/**
+ * Reads and splits the next chunk from the stream input.
+ *
+ * The data following the whole packets is copied into the
+ * next chunk.
+ * @param[in] pl      the pipeline.
+ * @param[out] chunk  the chunk to fill.
+ * @return            true if more data can follow.
+ */
+static bool split_stream_chunk(pipeline_t* pl, chunk_t* chunk)
+{
+	bool last, more = true;
+	int n = pl->ntail;
+
+	if (chunk->buffer_size < n) {
+		chunk->buffer_size = n;
+		chunk->buffer = (char*)realloc_a(chunk->buffer, chunk->buffer_size);
+	}
+	memcpy(chunk->buffer, pl->tail, n);
+	chunk->data = chunk->buffer;
+	chunk->size = 0;
+
+	while (true) {
+		/* fill the buffer */
+		while (more && n < chunk->buffer_size) {
+			int nbytes = read_input(pl->input, chunk->buffer + n, chunk->buffer_size - n);
+			if (nbytes <= 0) more = false;
+			else n += nbytes;
+		}
+		chunk->size = split_packets(pl->hs, chunk->buffer, n, &last);
+		if (last) {
+			more = false;
+			break;
+		}
+		if (chunk->size || !more) break;
+		/* the packet doesn't fit into the buffer */
+		chunk->buffer_size *= 2;
+		chunk->buffer = (char*)realloc_a(chunk->buffer, chunk->buffer_size);
+	}
+	pl->tail = chunk->buffer + chunk->size;
+	pl->ntail = n - chunk->size;
+	return more || (pl->ntail && chunk->size);
+}
+
+/**
+ * The pipeline reader thread.
+ *
+ * Splits the input data into chunks.
+ * @param[in] arg   the pipeline.
+ * @return
+ */
+static void* pipeline_reader(void* arg)
+{
+	pipeline_t* pl = (pipeline_t*)arg;
+	bool more = true;
+
+	while (more) {
+		pthread_mutex_lock(&pl->mutex);
+		while (!pl->stop && pl->nsplit - pl->nmerge == pl->nchunks) {
+			pthread_cond_wait(&pl->cond, &pl->mutex);
+		}
+		bool stop = pl->stop;
+		pthread_mutex_unlock(&pl->mutex);
+		if (stop) break;
+
+		/* the chunk is not accessed by other threads until it's split */
+		chunk_t* chunk = &pl->chunks[pl->nsplit % pl->nchunks];
+		chunk->ready = false;
+		more = pl->input ? split_stream_chunk(pl, chunk) : split_mapped_chunk(pl, chunk);
+
+		pthread_mutex_lock(&pl->mutex);
+		if (chunk->size) pl->nsplit++;
+		if (!more) pl->eof = true;
+		pthread_cond_broadcast(&pl->cond);
+		pthread_mutex_unlock(&pl->mutex);
+	}
+	return NULL;
+}
+
+/**
+ * Calculates the hash values of the chunk backtrace packets.
+ *
+ * @param[in] hs      the handshake data.
+ * @param[in] chunk   the chunk.
+ */
+static void hash_chunk(const rd_hshake_t* hs, chunk_t* chunk)
+{
+	const char* data = chunk->data;
+	int size = chunk->size, offset, len;
+	unsigned int type;
+	long* hash = chunk->hashes;
+
+	while ((len = read_packet_header(hs, data, size, &type, &offset)) > 0) {
+		if (type == SP_RTRACE_PROTO_BACKTRACE) {
+			unsigned long nframes;
+			offset += read_dword2long(data + offset, &nframes);
+			*hash++ = rd_ftrace_calc_hash((const pointer_t*)(data + offset), nframes);
+		}
+		data += len;
+		size -= len;
+	}
+}
+
+/**
+ * The pipeline worker thread.
+ *
+ * Calculates the backtrace hash values of the split chunks.
+ * @param[in] arg   the pipeline.
+ * @return
+ */
+static void* pipeline_worker(void* arg)
+{
+	pipeline_t* pl = (pipeline_t*)arg;
+
+	pthread_mutex_lock(&pl->mutex);
+	while (true) {
+		while (!pl->stop && !pl->eof && pl->ndecode == pl->nsplit) {
+			pthread_cond_wait(&pl->cond, &pl->mutex);
+		}
+		if (pl->stop || pl->ndecode == pl->nsplit) break;
+		chunk_t* chunk = &pl->chunks[pl->ndecode++ % pl->nchunks];
+		pthread_mutex_unlock(&pl->mutex);
+
+		hash_chunk(pl->hs, chunk);
+
+		pthread_mutex_lock(&pl->mutex);
+		chunk->ready = true;
+		pthread_cond_broadcast(&pl->cond);
+	}
+	pthread_mutex_unlock(&pl->mutex);
+	return NULL;
+}
+
+/**
+ * Processes the chunk packets.
+ *
+ * @param[out] rd    the resource trace data.
+ * @param[in] chunk  the chunk.
+ * @return           0 - success, PACKET_UNKNOWN - the processing must be stopped.
+ */
+static int merge_chunk(rd_t* rd, chunk_t* chunk)
+{
+	const char* data = chunk->data;
+	int size = chunk->size;
+
+	bt_hashes = chunk->hashes;
+	while (size) {
+		int rc = read_generic_packet(rd, data, size);
+		if (rc <= 0) {
+			bt_hashes = NULL;
+			return PACKET_UNKNOWN;
+		}
+		data += rc;
+		size -= rc;
+	}
+	bt_hashes = NULL;
+	return 0;
+}
+
+/**
+ * Processes the packets with the reader and worker threads.
+ *
+ * @param[out] rd   the resource trace data.
+ * @param[in] pl    the pipeline with initialized input fields.
+ */
+static void run_pipeline(rd_t* rd, pipeline_t* pl)
+{
+	unsigned int nworkers = postproc_options.threads, i;
+	pthread_t reader, workers[nworkers];
+
+	pl->hs = rd->hshake;
+	pl->nchunks = nworkers * CHUNKS_PER_WORKER;
+	pl->chunks = (chunk_t*)calloc_a(pl->nchunks, sizeof(chunk_t));
+	if (pl->input) {
+		for (i = 0; i < pl->nchunks; i++) {
+			pl->chunks[i].buffer_size = CHUNK_BUFFER_SIZE;
+			pl->chunks[i].buffer = (char*)malloc_a(CHUNK_BUFFER_SIZE);
+		}
+	}
+	pl->nsplit = 0;
+	pl->ndecode = 0;
+	pl->nmerge = 0;
+	pl->eof = false;
+	pl->stop = false;
+	pthread_mutex_init(&pl->mutex, NULL);
+	pthread_cond_init(&pl->cond, NULL);
+
+	if (pthread_create(&reader, NULL, pipeline_reader, pl) != 0) {
+		msg_error("failed to create pipeline reader thread\n");
+		exit (-1);
+	}
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create(&workers[i], NULL, pipeline_worker, pl) != 0) {
+			msg_error("failed to create pipeline worker thread\n");
+			exit (-1);
+		}
+	}
+
+	pthread_mutex_lock(&pl->mutex);
+	while (true) {
+		chunk_t* chunk = &pl->chunks[pl->nmerge % pl->nchunks];
+		while (!(pl->nmerge < pl->nsplit && chunk->ready) && !(pl->eof && pl->nmerge == pl->nsplit)) {
+			pthread_cond_wait(&pl->cond, &pl->mutex);
+		}
+		if (pl->nmerge == pl->nsplit) break;
+		pthread_mutex_unlock(&pl->mutex);
+
+		int rc = merge_chunk(rd, chunk);
+
+		pthread_mutex_lock(&pl->mutex);
+		pl->nmerge++;
+		pthread_cond_broadcast(&pl->cond);
+		if (rc < 0) break;
+	}
+	pl->stop = true;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->mutex);
+
+	pthread_join(reader, NULL);
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	pthread_cond_destroy(&pl->cond);
+	pthread_mutex_destroy(&pl->mutex);
+	for (i = 0; i < pl->nchunks; i++) {
+		free(pl->chunks[i].buffer);
+	}
+	free(pl->chunks);
+}
+
+/**
+ * Read data from the specified input stream and process it.
+ *
+ * @param[out] rd    the resource trace data.
+ * @param[in] input  the data source.
+ * @return
+ */
+static void read_binary_data(rd_t* rd, binary_input_t* input)
+{
+	/* point ptr_in at the second byte in buffer, as the first
+	 * one is supposed to be taken by the binary protocol identification
+	 * byte, read earlier. This is done to keep the packet alignment.
+	 */
+	char buffer[BUFFER_SIZE * 2], *ptr_in = buffer + 1;
+	int n, size;
+
+	/* read and process the handshake packet */
+	n = read_input(input, ptr_in, BUFFER_SIZE - 1);
+	size = read_handshake(rd, ptr_in, n);
+	n -= size;
+	ptr_in += size;
+
+	/* the live reports are written while waiting for the input data,
+	 * so the live mode always reads the packets sequentially */
+	if (postproc_options.threads && !postproc_options.live_interval) {
+		pipeline_t pl = {.data = NULL, .size = 0, .input = input, .tail = ptr_in, .ntail = n};
+		run_pipeline(rd, &pl);
+		return;
+	}
 
 	/* main packet reading/processing loop */
 	while (true) {
@@ -502,20 +1045,103 @@ static void read_binary_data(rd_t* rd, int fd)
 
 		/* move the incomplete packet to the beginning of buffer */
 		memmove(buffer, ptr_in, n);
+		if (postproc_options.live_interval) {
+			filter_live_report(rd, false);
+			/* keep writing the live reports while waiting for input data */
+			if (!input->zs || !input->zs->avail_in) wait_input(rd, input->fd);
+		}
 		/* read new data chunk into buffer */
-		int nbytes = read(fd, buffer + n, BUFFER_SIZE - 1);
+		int nbytes = read_input(input, buffer + n, BUFFER_SIZE - 1);
 		if (nbytes <= 0) break;
 		n += nbytes;
 		ptr_in = buffer;
 	}
 }
 
+/**
+ * Maps the input file into memory and processes the packets in place.
+ *
+ * The file must be mapped from its beginning to keep the packet
+ * alignment, the processing starts at the current file offset (right
+ * after the protocol identification byte). The packet data is copied
+ * into the trace data records, so the file is unmapped afterwards.
+ * @param[out] rd    the resource trace data.
+ * @param[in] fd     the input file descriptor.
+ * @param[in] size   the input file size.
+ * @return           0 - success, -1 - the file can't be mapped.
+ */
+static int read_mapped_data(rd_t* rd, int fd, off_t size)
+{
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+	if (offset == -1 || offset >= size || (unsigned long long)size > SIZE_MAX) return -1;
+
+	char* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) return -1;
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	const char* data = map + offset;
+	size_t n = size - offset;
+	/* the packet sizes are limited to int range, so the remaining data
+	 * size can be safely truncated for larger than 2GB files */
+	int rc = read_handshake(rd, data, n > INT_MAX ? INT_MAX : n);
+	if (postproc_options.threads) {
+		pipeline_t pl = {.data = data + rc, .size = n - rc, .input = NULL, .tail = NULL, .ntail = 0};
+		run_pipeline(rd, &pl);
+		munmap(map, size);
+		return 0;
+	}
+	while (true) {
+		data += rc;
+		n -= rc;
+		if (!n) break;
+		/* stop at unknown packet or truncated data, like the stream reader */
+		rc = read_generic_packet(rd, data, n > INT_MAX ? INT_MAX : n);
+		if (rc <= 0) break;
+	}
+	munmap(map, size);
+	return 0;
+}
+
 /*
  * Public API implementation.
  */
 void process_binary_data(rd_t* rd, int fd)
 {
-	read_binary_data(rd, fd);
+	struct stat st;
+	/* The regular files are processed in place, except in live mode,
+	 * where the file might be still growing. */
+	if (postproc_options.live_interval || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+			read_mapped_data(rd, fd, st.st_size) == -1) {
+		binary_input_t input = {.fd = fd, .zs = NULL};
+		read_binary_data(rd, &input);
+	}
+
+	if (postproc_options.input_file) {
+		close(fd);
+	}
+}
+
+void process_compressed_data(rd_t* rd, int fd)
+{
+	z_stream zs = {.zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL, .avail_in = 0, .next_in = Z_NULL};
+	binary_input_t input = {.fd = fd, .zs = &zs};
+
+	if (inflateInit2(&zs, COMPRESSION_GZIP + MAX_WBITS) != Z_OK) {
+		msg_error("failed to initialize input decompression\n");
+		exit (-1);
+	}
+	/* feed the already read identification byte to the decompressor */
+	input.buffer[0] = SP_RTRACE_PROTO_GZIP_ID;
+	zs.next_in = input.buffer;
+	zs.avail_in = 1;
+
+	char proto_id;
+	if (read_input(&input, &proto_id, 1) != 1 || (unsigned char)proto_id != SP_RTRACE_PROTO_HS_ID) {
+		msg_error("the compressed input stream does not contain binary trace data\n");
+		exit (-1);
+	}
+	read_binary_data(rd, &input);
+	inflateEnd(&zs);
 
 	if (postproc_options.input_file) {
 		close(fd);
@@ -46,5 +46,18 @@
  */
 void process_binary_data(rd_t* rd, int fd);
 
+/**
+ * Processes compressed binary format input data.
+ *
+ * The compressed data is a gzip format stream of binary format data,
+ * written by pre-processor with --compress option. The first byte of
+ * gzip stream must have been already read from the input.
+ *
+ * @param[out]  rd  the resource trace data container.
+ * @param[in]   fd  the input file descriptor.
+ * @return
+ */
+void process_compressed_data(rd_t* rd, int fd);
+
 #endif
 
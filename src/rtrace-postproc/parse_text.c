@@ -112,7 +112,8 @@ static void store_backtrace(rd_t* rd, dlist_t* calls, sp_rtrace_btframe_t* bt, i
 {
 	int i;
 
-	rd_ftrace_t* trace = htable_create_node(sizeof(rd_ftrace_t));
+	rd_ftrace_t* trace = malloc_a(sizeof(rd_ftrace_t));
+	trace->hash_valid = false;
 	trace->data.resolved_names = NULL;
 	trace->ref_count = 0;
 	trace->data.nframes = size;
@@ -125,8 +126,7 @@ static void store_backtrace(rd_t* rd, dlist_t* calls, sp_rtrace_btframe_t* bt, i
 			if (trace->data.resolved_names == NULL) {
 				trace->data.resolved_names = calloc_a(size, sizeof(char*));
 			}
-			trace->data.resolved_names[i] = bt[i].name;
-			bt[i].name = NULL;
+			trace->data.resolved_names[i] = strdup_a(bt[i].name);
 		}
 	}
 	rd_fcalls_set_ftrace(rd, calls, trace);
@@ -146,7 +146,11 @@ static void store_call_arguments(rd_fcall_t* call, sp_rtrace_farg_t* args, int s
 {
 	rd_fargs_t* fargs = (rd_fargs_t*)malloc_a(sizeof(rd_fargs_t));
 	fargs->data = malloc_a(sizeof(sp_rtrace_farg_t) * (size + 1));
-	memcpy(fargs->data, args, sizeof(sp_rtrace_farg_t) * size);
+	int i;
+	for (i = 0; i < size; i++) {
+		fargs->data[i].name = strdup_a(args[i].name);
+		fargs->data[i].value = strdup_a(args[i].value);
+	}
 	fargs->data[size].name = NULL;
 	fargs->data[size].value = NULL;
 	call->args = fargs;
@@ -200,6 +204,10 @@ static void read_text_data(rd_t* rd, FILE* fp)
 	}
 	parse_header(rd, line);
 
+	/* the parsed record strings are owned by the parser and must be
+	 * copied when stored into the trace data */
+	sp_rtrace_parser_t* parser = sp_rtrace_parser_create(SP_RTRACE_RECORD_ALL);
+
 	dlist_init(&last_calls);
 
 	sp_rtrace_btframe_t* bt = malloc_a(sizeof(sp_rtrace_btframe_t) * bt_limit);
@@ -218,7 +226,7 @@ static void read_text_data(rd_t* rd, FILE* fp)
 
 		sp_rtrace_record_t rec;
 
-		int rec_type = sp_rtrace_parser_parse_record(line, &rec);
+		int rec_type = sp_rtrace_parser_parse(parser, line, &rec);
 
 		if (rec_type == SP_RTRACE_RECORD_TRACE) {
 			if (dlist_first(&last_calls)) {
@@ -271,19 +279,15 @@ static void read_text_data(rd_t* rd, FILE* fp)
 		}
 
 		if (rec_type == SP_RTRACE_RECORD_CALL) {
-			rd_fcall_t* call = dlist_create_node(sizeof(rd_fcall_t));
+			rd_fcall_t* call = rd_fcall_create(rd);
 			call->data = rec.call;
-			call->trace = NULL;
-			call->args = NULL;
-			call->ref = NULL;
+			call->data.name = rd_fcall_name(rd, rec.call.name, strlen(rec.call.name));
 
 			/* The res_type field temporary has the resource type name string assigned.
-			 * Lookup the resource record and correctly assign to it.
-			 * The resource type name is stored in a static buffer, so it must be left unfreed */
+			 * Lookup the resource record and correctly assign to it. */
 			if (call->data.res_type_flag == SP_RTRACE_FCALL_RFIELD_NAME) {
 				sp_rtrace_resource_t resource = {.type = (char*)call->data.res_type};
 				call->data.res_type = dlist_find(&rd->resources, (void*)&resource, (op_binary_t)compare_resource);
-				free(resource.type);
 			}
 			else {
 				/* If resource type was not set in text log, it means only one resource type is present.
@@ -293,8 +297,7 @@ static void read_text_data(rd_t* rd, FILE* fp)
 			call->data.res_type_flag = SP_RTRACE_FCALL_RFIELD_REF;
 			dlist_add(&rd->calls, call);
 
-			ref_node_t* ref = (ref_node_t*)dlist_create_node(sizeof(ref_node_t));
-			ref->ref = call;
+			ref_node_t* ref = rd_fcall_create_ref(rd, call);
 			dlist_add(&last_calls, ref);
 			comment_index = call->data.index;
 			continue;
@@ -312,12 +315,16 @@ static void read_text_data(rd_t* rd, FILE* fp)
 		if (rec_type == SP_RTRACE_RECORD_MMAP) {
 			rd_mmap_t* mmap = dlist_create_node(sizeof(rd_mmap_t));
 			mmap->data = rec.mmap;
+			mmap->data.module = strdup_a(rec.mmap.module);
+			if (rec.mmap.build_id) mmap->data.build_id = strdup_a(rec.mmap.build_id);
 			dlist_add(&rd->mmaps, mmap);
 			continue;
 		}
 
 		if (rec_type == SP_RTRACE_RECORD_CONTEXT) {
 			rd_context_t* context = dlist_create_node(sizeof(rd_context_t));
+			context->data.id = 0;
+			context->data.name = NULL;
 			dlist_add(&rd->contexts, context);
 			continue;
 		}
@@ -326,18 +333,19 @@ static void read_text_data(rd_t* rd, FILE* fp)
 			if (!dlist_find(&rd->resources, &rec.resource, (op_binary_t)compare_resource)) {
 				rd_resource_t* resource = dlist_create_node(sizeof(rd_resource_t));
 				resource->data = rec.resource;
+				resource->data.type = strdup_a(rec.resource.type);
+				resource->data.desc = strdup_a(rec.resource.desc);
 				resource->hide = false;
 				dlist_add(&rd->resources, resource);
 			}
-			else {
-				sp_rtrace_parser_free_record(rec_type, &rec);
-			}
 			continue;
 		}
 
 		if (rec_type == SP_RTRACE_RECORD_ATTACHMENT) {
 			rd_attachment_t* file = dlist_create_node(sizeof(rd_attachment_t));
 			file->data = rec.attachment;
+			file->data.name = strdup_a(rec.attachment.name);
+			file->data.path = strdup_a(rec.attachment.path);
 			dlist_add(&rd->files, file);
 			continue;
 		}
@@ -363,6 +371,7 @@ static void read_text_data(rd_t* rd, FILE* fp)
 
 	free(bt);
 	free(args);
+	sp_rtrace_parser_destroy(parser);
 
 	dlist_sort(&rd->calls, (op_binary_t)compare_calls);
 }
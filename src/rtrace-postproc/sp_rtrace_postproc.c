@@ -52,6 +52,8 @@
 #include "leaks_sort.h"
 #include "filter.h"
 #include "writer.h"
+#include "database.h"
+#include "leaks_diff.h"
 
 /**
  * The post-processor options.
@@ -73,6 +75,10 @@ postproc_options_t postproc_options = {
 	.filter_range_start = 0,
 	.filter_range_size = 0,
 	.filter_range_target = NULL,
+	.live_interval = 0,
+	.threads = 0,
+	.database_file = NULL,
+	.diff_file = NULL,
 };
 
 volatile sig_atomic_t postproc_abort = 0;
@@ -89,6 +95,8 @@ static void free_options(void)
 	if (postproc_options.include_file) free(postproc_options.include_file);
 	if (postproc_options.exclude_file) free(postproc_options.exclude_file);
 	if (postproc_options.filter_range_target) free(postproc_options.filter_range_target);
+	if (postproc_options.database_file) free(postproc_options.database_file);
+	if (postproc_options.diff_file) free(postproc_options.diff_file);
 }
 
 /**
@@ -123,13 +131,30 @@ static void display_usage(void)
 			" --call-address <target>:<start>+<size>\n"
 			"                     filter allocations which backtraces contains an address\n"
 			"                     in the specified range.\n"
+			"  -L <seconds>     - live mode. The freed allocations are removed while\n"
+			"                     the binary trace data is being received and a live\n"
+			"                     report (largest live allocation groups, live resource\n"
+			"                     totals and allocation rate) is written every <seconds>\n"
+			"                     into <pid>-<index>.rtrace.live.txt file.\n"
+			"  -j <threads>     - split the binary input data with a reader thread and\n"
+			"                     calculate backtrace hashes with <threads> worker\n"
+			"                     threads while the packets are being processed.\n"
+			"                     Ignored in live mode.\n"
+			"  -D <path>        - write the processed trace data into trace database\n"
+			"                     <path> instead of text log. The database can be\n"
+			"                     queried with sp-rtrace-query.\n"
+			"  -d <path>        - compare the leaks with the baseline trace <path>.\n"
+			"                     The leaked resources of both traces are grouped\n"
+			"                     by their backtrace symbols and the changes of\n"
+			"                     leak counts and sizes are written instead of\n"
+			"                     text log.\n"
 			"  -q               - hide warning messages.\n"
 			"  -h               - this help page.\n"
 	);
 }
 
 
-static FILE* start_resolver(char* filename)
+static int start_resolver(char* filename)
 {
 	int fds[2];
 	if (pipe(fds) != 0) {
@@ -151,7 +176,7 @@ static FILE* start_resolver(char* filename)
 		msg_error("failed to execute resolver process %s (%s)\n", SP_RTRACE_RESOLVER, strerror(errno));
 	}
 	close(fds[0]);
-	return fdopen(fds[1], "w");
+	return fds[1];
 }
 
 /**
@@ -162,7 +187,7 @@ static FILE* start_resolver(char* filename)
  */
 static void write_rtrace_log(rd_t* rd)
 {
-	FILE* fp;
+	int fd;
 	char path[PATH_MAX];
 	char *output_file = NULL;
 
@@ -176,29 +201,28 @@ static void write_rtrace_log(rd_t* rd)
 		output_file = path;
 	}
 	if (postproc_options.resolve) {
-		fp = start_resolver(output_file);
-		if (fp == NULL) {
-			msg_error("failed to get resolver pipe\n");
-			exit (-1);
-		}
+		fd = start_resolver(output_file);
 	}
 	else {
 		if (output_file) {
-			fp = fopen(output_file, "w");
-			if (fp == NULL) {
+			fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+			if (fd == -1) {
 				msg_error("failed to create log file %s\n", output_file);
 				exit (-1);
 			}
 			printf("INFO: Created text log file %s\n", output_file);
 		}
 		else {
-			fp = stdout;
+			/* the INFO messages are written into standard output too */
+			fflush(stdout);
+			fd = STDOUT_FILENO;
 		}
 	}
 
 	/* initialize formatted data wrapper structure */
+	sp_rtrace_formatter_t* formatter = sp_rtrace_formatter_create(fd);
 	fmt_data_t fmt = {
-			.fp = fp,
+			.formatter = formatter,
 			.rd = rd,
 			.comment = dlist_first(&rd->comments),
 	};
@@ -213,9 +237,13 @@ static void write_rtrace_log(rd_t* rd)
 	if (postproc_options.filter_leaks) {
 		write_leak_summary(&fmt);
 	}
-	/* */
+	int rc = sp_rtrace_formatter_destroy(formatter);
+	if (rc < 0) {
+		msg_error("failed to write output data (%s)\n", strerror(-rc));
+		exit (-1);
+	}
 	if (postproc_options.output_dir || postproc_options.resolve) {
-		fclose(fp);
+		close(fd);
 	}
 	if (postproc_options.pid_resolve) {
 		int status;
@@ -223,6 +251,98 @@ static void write_rtrace_log(rd_t* rd)
 	}
 }
 
+/**
+ * Reads resource trace data and applies the post-processing options.
+ *
+ * @param[in] rd     the resource trace data.
+ * @param[in] path   the input file path or NULL to read the standard input.
+ */
+static void read_trace(rd_t* rd, const char* path)
+{
+	/* determine the type of input stream - binary or text */
+	int fd = STDIN_FILENO;
+	/* read data from the specified file or standard input if no
+	 * input file was specified */
+	if (path) {
+		fd = open(path, O_RDONLY);
+		if (fd == -1) {
+			msg_error("failed to open input file %s (%s)\n", path, strerror(errno));
+			exit (-1);
+		}
+	}
+	unsigned char proto_id;
+	if (read(fd, &proto_id, 1) != 1) {
+		msg_error("failed to read identification byte from the input stream.\n");
+		exit (-1);
+	}
+	bool binary_input = proto_id == SP_RTRACE_PROTO_HS_ID || proto_id == SP_RTRACE_PROTO_GZIP_ID;
+	if (postproc_options.live_interval) {
+		if (binary_input) {
+			filter_live_init(rd, postproc_options.live_interval);
+		}
+		else {
+			msg_warning("live mode is supported only for binary format input\n");
+			postproc_options.live_interval = 0;
+		}
+	}
+	/* the function call filters are applied while reading binary data */
+	filter_chain_init(binary_input);
+	/* The binary trace data is ordered by calls, so the leaks can be filtered
+	 * while reading it. The call address range filter is applied before leak
+	 * filtering and needs the full trace data (memory mappings) */
+	if (postproc_options.filter_leaks && binary_input && !postproc_options.filter_range_target) {
+		filter_stream_init(rd);
+	}
+	if (proto_id == SP_RTRACE_PROTO_HS_ID) {
+		process_binary_data(rd, fd);
+	}
+	else if (proto_id == SP_RTRACE_PROTO_GZIP_ID) {
+		process_compressed_data(rd, fd);
+	}
+	else {
+		FILE* fp = fdopen(fd, "r");
+		if (!fp) {
+			msg_error("failed to reopen input stream.\n");
+			exit (-1);
+		}
+		ungetc(proto_id, fp);
+		process_text_data(rd, fp);
+	}
+
+	if (!rd->pinfo) {
+		msg_error("failed to parse log header.\n");
+		exit (-1);
+	}
+
+	if (postproc_options.live_interval) {
+		/* write the final live report, the remaining data is
+		 * processed in the normal way */
+		filter_live_report(rd, true);
+		filter_live_free();
+	}
+	/* the freed resources have been already removed by streaming leak filter */
+	bool leaks_filtered = filter_stream_active();
+	filter_stream_free();
+
+	if (postproc_options.backtrace_depth != -1) {
+		filter_trim_backtraces(rd);
+	}
+
+	/* apply selected post-processing options */
+	filter_chain_apply(rd);
+	filter_chain_free();
+
+	if (rd->hinfo) {
+		filter_find_lowhigh_blocks(rd);
+	}
+
+	if (postproc_options.filter_leaks && !leaks_filtered) {
+		filter_leaks(rd);
+	}
+
+	filter_update_resource_visibility(rd);
+}
+
 /**
  * Block the sigint from aborting the program execution.
  *
@@ -269,13 +389,17 @@ int main(int argc, char* argv[])
 			 {"exclude", 1, 0, 'X'},
 			 {"quiet", 0, 0, 'q'},
 			 {"call-address", 1, 0, 'g'},
+			 {"live", 1, 0, 'L'},
+			 {"threads", 1, 0, 'j'},
+			 {"database", 1, 0, 'D'},
+			 {"diff", 1, 0, 'd'},
 			 {0, 0, 0, 0}
 	};
 	/* parse command line options */
 	int opt;
 	opterr = 0;
 	
-	while ( (opt = getopt_long(argc, argv, "i:o:tcs:ahrlC:R:b:q", long_options, NULL)) != -1) {
+	while ( (opt = getopt_long(argc, argv, "i:o:tcs:ahrlC:R:b:qL:j:D:d:", long_options, NULL)) != -1) {
 		switch(opt) {
 			case 'h':
 				display_usage();
@@ -386,6 +510,42 @@ int main(int argc, char* argv[])
 			case 't':
 				break;
 
+			case 'L':
+				if (postproc_options.live_interval) {
+					msg_warning("overriding previously given option: -L %u\n", postproc_options.live_interval);
+				}
+				if (sscanf(optarg, "%u", &postproc_options.live_interval) != 1 || !postproc_options.live_interval) {
+					msg_error("invalid live report interval: %s\n", optarg);
+					exit (-1);
+				}
+				break;
+
+			case 'j':
+				if (postproc_options.threads) {
+					msg_warning("overriding previously given option: -j %u\n", postproc_options.threads);
+				}
+				if (sscanf(optarg, "%u", &postproc_options.threads) != 1 || !postproc_options.threads) {
+					msg_error("invalid number of threads: %s\n", optarg);
+					exit (-1);
+				}
+				break;
+
+			case 'D':
+				if (postproc_options.database_file) {
+					msg_warning("overriding previously given option: -D %s\n", postproc_options.database_file);
+					free(postproc_options.database_file);
+				}
+				postproc_options.database_file = strdup_a(optarg);
+				break;
+
+			case 'd':
+				if (postproc_options.diff_file) {
+					msg_warning("overriding previously given option: -d %s\n", postproc_options.diff_file);
+					free(postproc_options.diff_file);
+				}
+				postproc_options.diff_file = strdup_a(optarg);
+				break;
+
 			case 'g': {
 				char target[4096];
 				if (sscanf(optarg, "%[^:]:%lx+%lx", target, &postproc_options.filter_range_start, &postproc_options.filter_range_size) != 3) {
@@ -421,80 +581,41 @@ int main(int argc, char* argv[])
 					"--compress options.\n");
 		exit (-1);
 	}
-
-	/* determine the type of input stream - binary or text */
-	int fd = STDIN_FILENO;
-	/* read data from the specified file or standard input if no
-	 * input file was specified with --input-file option */
-	if (postproc_options.input_file) {
-		fd = open(postproc_options.input_file, O_RDONLY);
-		if (fd == -1) {
-			msg_error("failed to open input file %s (%s)\n",
-					postproc_options.input_file, strerror(errno));
-			exit (-1);
-		}
-	}
-	unsigned char proto_id;
-	if (read(fd, &proto_id, 1) != 1) {
-		msg_error("failed to read identification byte from the input stream.\n");
+	if (postproc_options.database_file && postproc_options.resolve) {
+		msg_error("--resolve option can't be used with --database option, resolve "
+					"the trace before converting it.\n");
 		exit (-1);
 	}
-	if (proto_id == SP_RTRACE_PROTO_HS_ID) {
-		process_binary_data(rd, fd);
-	}
-	else {
-		FILE* fp = fdopen(fd, "r");
-		if (!fp) {
-			msg_error("failed to reopen input stream.\n");
+	if (postproc_options.diff_file) {
+		if (postproc_options.resolve || postproc_options.database_file || postproc_options.live_interval) {
+			msg_error("--diff option can't be used with --resolve, --database or --live "
+					"options.\n");
 			exit (-1);
 		}
-		ungetc(proto_id, fp);
-		process_text_data(rd, fp);
-	}
-
-	if (!rd->pinfo) {
-		msg_error("failed to parse log header.\n");
-		exit (-1);
-	}
-
-	if (postproc_options.backtrace_depth != -1) {
-		filter_trim_backtraces(rd);
-	}
-
-	/* apply selected post-processing options */
-	if (postproc_options.filter_resource) {
-		filter_resource(rd);
-	}
-
-	if (postproc_options.filter_range_target) {
-		filter_call_address_range(rd);
-	}
-
-	if (postproc_options.include_file) {
-		filter_include(rd);
+		/* the leaked resources are compared */
+		postproc_options.filter_leaks = true;
 	}
 
-	if (postproc_options.exclude_file) {
-		filter_exclude(rd);
-	}
+	read_trace(rd, postproc_options.input_file);
 
-	if (postproc_options.filter_context != -1) {
-		filter_context(rd);
+	/* write resulting output */
+	if (postproc_options.diff_file) {
+		rd_t* rd_base = rd_create();
+		if (rd_base == NULL) {
+			msg_error("failed to create rtrace data container\n");
+			exit (-1);
+		}
+		read_trace(rd_base, postproc_options.diff_file);
+		write_leaks_diff(rd, rd_base);
+		rd_free(rd_base);
 	}
-
-	if (rd->hinfo) {
-		filter_find_lowhigh_blocks(rd);
+	else if (postproc_options.database_file) {
+		write_trace_database(rd, postproc_options.database_file);
 	}
-
-	if (postproc_options.filter_leaks) {
-		filter_leaks(rd);
+	else {
+		write_rtrace_log(rd);
 	}
 
-	filter_update_resource_visibility(rd);
-
-	/* write resulting output */
-	write_rtrace_log(rd);
-
 	rd_free(rd);
 
 	free_options();
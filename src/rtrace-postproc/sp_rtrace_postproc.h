@@ -55,6 +55,10 @@ typedef struct postproc_options_t {
 	unsigned long filter_range_start;
 	unsigned long filter_range_size;
 	char* filter_range_target;
+	unsigned int live_interval;
+	unsigned int threads;
+	char* database_file;
+	char* diff_file;
 } postproc_options_t;
 
 extern postproc_options_t postproc_options;
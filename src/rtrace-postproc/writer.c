@@ -26,6 +26,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "writer.h"
 #include "filter.h"
@@ -33,41 +36,40 @@
 #include "sp_rtrace_postproc.h"
 
 #include "common/header.h"
+#include "common/log_writer.h"
 #include "common/msg.h"
+#include "common/utils.h"
+
+#include "rtrace_common.h"
 
 #include "library/sp_rtrace_formatter.h"
 
-#define TRY(x) {\
-	int rc = x;\
-	if (rc < 0) {\
-		fprintf(stderr, "Error while writing output data (%s)\n", strerror(-rc));\
-		exit (-1);\
-	}\
-}
+/* the number of allocation groups written into live report */
+#define LIVE_REPORT_TOP    20
 
 /**
  * Writes module information log record into text log.
  *
  * @param[in] minfo      the module information data.
- * @param[in] formatter  the log file.
+ * @param[in] formatter  the log formatter.
  * @return
  */
-static int write_module_info(rd_minfo_t* minfo, FILE* fp)
+static int write_module_info(rd_minfo_t* minfo, sp_rtrace_formatter_t* formatter)
 {
-	TRY(sp_rtrace_print_comment(fp, "## tracing module: [%x] %s (%d.%d)\n", minfo->id, minfo->name, minfo->vmajor, minfo->vminor));
+	log_write_module_info(formatter, minfo->id, minfo->name, minfo->vmajor, minfo->vminor);
 	return 0;
 }
 
 /**
  * Writes file attachment record into text log.
  *
- * @param[in] file  the file attachment data.
- * @param[in] fp    the log file.
+ * @param[in] file       the file attachment data.
+ * @param[in] formatter  the log formatter.
  * @return
  */
-static int write_attachment_info(rd_attachment_t* file, FILE* fp)
+static int write_attachment_info(rd_attachment_t* file, sp_rtrace_formatter_t* formatter)
 {
-	TRY(sp_rtrace_print_attachment(fp, &file->data));
+	TRY(sp_rtrace_format_attachment(formatter, &file->data));
 	return 0;
 }
 
@@ -88,12 +90,12 @@ static long comment_check_index(rd_comment_t* comment, void* data)
  * Prints comment.
  *
  * @param comment
- * @param fp
+ * @param formatter
  * @return
  */
-static int fcall_write_comment(const rd_comment_t* comment, FILE* fp)
+static int fcall_write_comment(const rd_comment_t* comment, sp_rtrace_formatter_t* formatter)
 {
-	return sp_rtrace_print_comment(fp, comment->text);
+	return sp_rtrace_format_comment(formatter, comment->text);
 }
 
 /**
@@ -110,13 +112,13 @@ static int write_function_call(rd_fcall_t* call, fmt_data_t* fmt)
 	/* first write all comments with index less than current call index */
 	if (fmt->comment) {
 		fmt->comment = dlist_foreach2_in(&fmt->rd->comments, fmt->comment,
-				(op_binary_t)comment_check_index, (void*)(long)call->data.index, (op_binary_t)fcall_write_comment, fmt->fp);
+				(op_binary_t)comment_check_index, (void*)(long)call->data.index, (op_binary_t)fcall_write_comment, fmt->formatter);
 	}
 
 	/* then write the function call itself */
-	TRY(sp_rtrace_print_call(fmt->fp, &call->data));
-	if (call->args) TRY(sp_rtrace_print_args(fmt->fp, call->args->data));
-	if (call->trace) TRY(sp_rtrace_print_trace(fmt->fp, &call->trace->data));
+	TRY(sp_rtrace_format_call(fmt->formatter, &call->data));
+	if (call->args) TRY(sp_rtrace_format_args(fmt->formatter, call->args->data));
+	if (call->trace) TRY(sp_rtrace_format_trace(fmt->formatter, &call->trace->data));
 	return 0;
 }
 
@@ -136,12 +138,12 @@ static int write_compressed_function_call(ref_node_t* node, fmt_data_t* fmt)
 	/* first write all comments with index less than current call index */
 	if (fmt->comment) {
 		fmt->comment = dlist_foreach2_in(&fmt->rd->comments, fmt->comment,
-				(op_binary_t)comment_check_index, (void*)(long)call->data.index, (op_binary_t)fcall_write_comment, fmt->fp);
+				(op_binary_t)comment_check_index, (void*)(long)call->data.index, (op_binary_t)fcall_write_comment, fmt->formatter);
 	}
 
 	/* then write the function call itself */
-	TRY(sp_rtrace_print_call(fmt->fp, &call->data));
-	if (call->args) TRY(sp_rtrace_print_args(fmt->fp, call->args->data));
+	TRY(sp_rtrace_format_call(fmt->formatter, &call->data));
+	if (call->args) TRY(sp_rtrace_format_args(fmt->formatter, call->args->data));
 	return 0;
 }
 
@@ -159,40 +161,33 @@ static int write_compressed_function_call(ref_node_t* node, fmt_data_t* fmt)
 static int write_compressed_backtrace(ftrace_ref_t* trace, fmt_data_t* fmt)
 {
 	dlist_foreach2(&trace->ref->calls, (op_binary_t)write_compressed_function_call, fmt);
-	TRY(sp_rtrace_print_comment(fmt->fp, "# allocation summary: %d block(s) with total size %d\n",
+	TRY(sp_rtrace_format_comment(fmt->formatter, "# allocation summary: %d block(s) with total size %d\n",
             trace->leak_count, trace->leak_size));
-	TRY(sp_rtrace_print_trace(fmt->fp, &trace->ref->data));
+	TRY(sp_rtrace_format_trace(fmt->formatter, &trace->ref->data));
 	return 0;
 }
 
 /**
- * Writes heap statistics information.
+ * Writes live allocation group into live report.
  *
- * @param[in] fp     the output stream.
- * @param[in] hinfo  the heap information data.
+ * Only the last allocation of the group is written, followed by
+ * the group summary and the backtrace.
+ * @param[in] trace   the backtrace data.
+ * @param[in] fmt     the log file handle.
  * @return
  */
-static void write_heap_information(FILE* fp, rd_hinfo_t* hinfo)
+static int write_live_allocations(ftrace_ref_t* trace, fmt_data_t* fmt)
 {
-	TRY(sp_rtrace_print_comment(fp, "## heap status information:\n"));
-	TRY(sp_rtrace_print_comment(fp, "##   heap bottom 0x%lx\n", hinfo->heap_bottom));
-	TRY(sp_rtrace_print_comment(fp, "##   heap top 0x%lx\n", hinfo->heap_top));
-	TRY(sp_rtrace_print_comment(fp, "##   lowest block 0x%lx\n", hinfo->lowest_block));
-	TRY(sp_rtrace_print_comment(fp, "##   highest block 0x%lx\n", hinfo->highest_block));
-	TRY(sp_rtrace_print_comment(fp, "##   non-mapped space allocated from system %d\n", hinfo->arena));
-	TRY(sp_rtrace_print_comment(fp, "##   count of free chunks %d\n", hinfo->ordblks));
-	TRY(sp_rtrace_print_comment(fp, "##   count of freed fastbin blocks %d\n", hinfo->smblks));
-	TRY(sp_rtrace_print_comment(fp, "##   count of mapped regions %d\n", hinfo->hblks));
-	TRY(sp_rtrace_print_comment(fp, "##   space in mapped regions %d\n", hinfo->hblkhd));
-	TRY(sp_rtrace_print_comment(fp, "##   maximum total allocated space %d\n", hinfo->usmblks));
-	TRY(sp_rtrace_print_comment(fp, "##   space available in freed fastbin blocks %d\n", hinfo->fsmblks));
-	TRY(sp_rtrace_print_comment(fp, "##   total allocated space, both normal and mmapped %d\n", hinfo->uordblks));
-	TRY(sp_rtrace_print_comment(fp, "##   total free space %d\n", hinfo->fordblks));
-	TRY(sp_rtrace_print_comment(fp, "##   space ideally releasable via malloc_trim %d\n", hinfo->keepcost));
+	rd_fcall_t* call = (rd_fcall_t*)REF_NODE(dlist_last(&trace->ref->calls))->ref;
+	TRY(sp_rtrace_format_call(fmt->formatter, &call->data));
+	TRY(sp_rtrace_format_comment(fmt->formatter, "# allocation summary: %d block(s) with total size %d\n",
+            trace->leak_count, trace->leak_size));
+	TRY(sp_rtrace_format_trace(fmt->formatter, &trace->ref->data));
+	return 0;
 }
 
 typedef struct {
-	FILE* fp;
+	sp_rtrace_formatter_t* formatter;
 	leak_data_t leaks[32];
 } leaks_t;
 
@@ -204,9 +199,9 @@ typedef struct {
  */
 static void write_leaks(rd_resource_t* res, leaks_t* leaks)
 {
-	TRY(sp_rtrace_print_comment(leaks->fp, "# Resource - %s (%s):\n", res->data.type, res->data.desc));
+	TRY(sp_rtrace_format_comment(leaks->formatter, "# Resource - %s (%s):\n", res->data.type, res->data.desc));
 	int idx = ffs(res->data.id) - 1;
-	TRY(sp_rtrace_print_comment(leaks->fp, "# %d block(s) leaked with total size of %d bytes\n", leaks->leaks[idx].count, leaks->leaks[idx].total_size));
+	TRY(sp_rtrace_format_comment(leaks->formatter, "# %d block(s) leaked with total size of %d bytes\n", leaks->leaks[idx].count, leaks->leaks[idx].total_size));
 
 }
 
@@ -214,36 +209,36 @@ static void write_leaks(rd_resource_t* res, leaks_t* leaks)
  * Prints memory mapping information.
  *
  * @param mmap
- * @param fp
+ * @param formatter
  * @return
  */
-static int write_mmap(const rd_mmap_t* mmap, FILE* fp)
+static int write_mmap(const rd_mmap_t* mmap, sp_rtrace_formatter_t* formatter)
 {
-	return sp_rtrace_print_mmap(fp, &mmap->data);
+	return sp_rtrace_format_mmap(formatter, &mmap->data);
 }
 
 /**
  * Writes context data.
  *
  * @param context
- * @param fp
+ * @param formatter
  * @return
  */
-static int write_context(const rd_context_t* context, FILE* fp)
+static int write_context(const rd_context_t* context, sp_rtrace_formatter_t* formatter)
 {
-	return sp_rtrace_print_context(fp, &context->data);
+	return sp_rtrace_format_context(formatter, &context->data);
 }
 
 /**
  * Writes resource type information.
  *
  * @param context
- * @param fp
+ * @param formatter
  * @return
  */
-static int write_resource(const rd_resource_t* resource, FILE* fp)
+static int write_resource(const rd_resource_t* resource, sp_rtrace_formatter_t* formatter)
 {
-	return sp_rtrace_print_resource(fp, &resource->data);
+	return sp_rtrace_format_resource(formatter, &resource->data);
 }
 
 
@@ -253,7 +248,7 @@ static int write_resource(const rd_resource_t* resource, FILE* fp)
 
 void write_leak_summary(fmt_data_t* fmt)
 {
-	leaks_t leaks = {.fp = fmt->fp};
+	leaks_t leaks = {.formatter = fmt->formatter};
 	dlist_foreach2(&fmt->rd->calls, (op_binary_t)filter_sum_leaks, leaks.leaks);
 
 	dlist_foreach2(&fmt->rd->resources, (op_binary_t)write_leaks, &leaks);
@@ -262,55 +257,92 @@ void write_leak_summary(fmt_data_t* fmt)
 
 void write_trace_environment(fmt_data_t* fmt)
 {
-	/* prepare version and timestamp strings */
-	char timestamp[64], spid[8], btdepth[16];
-	sprintf(spid, "%d", fmt->rd->pinfo->pid);
-	struct tm* tm = localtime(&fmt->rd->pinfo->timestamp.tv_sec);
-	sprintf(timestamp, "%d.%d.%d %02d:%02d:%02d", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
-	sprintf(btdepth, "%d", fmt->rd->pinfo->backtrace_depth);
-	
-	sp_rtrace_header_t header =  {
-			.fields = { 
-					NULL,                   // HEADER_VERSION
-					fmt->rd->hshake->arch,  // HEADER_ARCH 
-					timestamp,              // HEADER_TIMESTAMP
-					fmt->rd->pinfo->name,   // HEADER_PROCESS
-					spid,                   // HEADER_PID
-					NULL,                    // HEADER_FILTER
-					fmt->rd->pinfo->backtrace_depth == -1 ? NULL : btdepth, // HEADER_BACKTRACE_DEPTH
-					fmt->rd->pinfo->trace_origin, // HEADER_ORIGIN
-			},
-	};
 	unsigned int filter = fmt->rd->filter;
 	/* reset filter mask by leaving only permanent filters (leaks, resolve) */ 
 	filter &= (FILTER_MASK_RESET);
 	/* set filter mask according to options */
 	if (postproc_options.compress) filter |= FILTER_MASK_COMPRESS;
 	if (postproc_options.filter_leaks) filter |= FILTER_MASK_LEAKS;
-	header_set_filter(&header, filter);
-	
+
 	/* write header data */
-	TRY(sp_rtrace_print_header(fmt->fp, &header));
-	/* clear the header filter to free the header filter field */
-	header_set_filter(&header, 0);
+	log_write_header(fmt->formatter, fmt->rd->hshake->arch, fmt->rd->pinfo->name, fmt->rd->pinfo->pid,
+			fmt->rd->pinfo->timestamp.tv_sec, fmt->rd->pinfo->backtrace_depth, fmt->rd->pinfo->trace_origin, filter);
 
 	/* write attachment data */
-	dlist_foreach2(&fmt->rd->files, (op_binary_t)write_attachment_info, fmt->fp);
+	dlist_foreach2(&fmt->rd->files, (op_binary_t)write_attachment_info, fmt->formatter);
 
 	/* write heap information if exists */
-	if (fmt->rd->hinfo) write_heap_information(fmt->fp, fmt->rd->hinfo);
+	if (fmt->rd->hinfo) log_write_heap_info(fmt->formatter, fmt->rd->hinfo);
 
 	/* write tracing module data */
-	dlist_foreach2(&fmt->rd->minfo, (op_binary_t)write_module_info, fmt->fp);
+	dlist_foreach2(&fmt->rd->minfo, (op_binary_t)write_module_info, fmt->formatter);
 
 	/* write context registry */
-	dlist_foreach2(&fmt->rd->contexts, (op_binary_t)write_context, fmt->fp);
+	dlist_foreach2(&fmt->rd->contexts, (op_binary_t)write_context, fmt->formatter);
 
 	/* write resource registry */
-	dlist_foreach2(&fmt->rd->resources, (op_binary_t)write_resource, fmt->fp);
+	dlist_foreach2(&fmt->rd->resources, (op_binary_t)write_resource, fmt->formatter);
 
 	/* write memory mapping data */
-	dlist_foreach2(&fmt->rd->mmaps, (op_binary_t)write_mmap, fmt->fp);
+	dlist_foreach2(&fmt->rd->mmaps, (op_binary_t)write_mmap, fmt->formatter);
+}
+
+void write_live_report(rd_t* rd, const live_rate_t* rate)
+{
+	static char path[PATH_MAX];
+	char tmp_path[PATH_MAX + sizeof(".tmp")];
+
+	/* the report file name is allocated with the first report and reused afterwards */
+	if (!*path) {
+		const char* dir = postproc_options.output_dir ? postproc_options.output_dir : ".";
+		if (get_log_filename(rd->pinfo->pid, dir, SP_RTRACE_LIVE_FILE_PATTERN, path, sizeof(path)) != 0) {
+			msg_error("failed to make new live report file name for directory %s\n", dir);
+			exit (-1);
+		}
+		printf("INFO: Writing live reports to %s\n", path);
+	}
+	/* write the report into temporary file and replace the old report
+	 * with it, so the report file is always complete */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd == -1) {
+		msg_error("failed to create live report file %s (%s)\n", tmp_path, strerror(errno));
+		return;
+	}
+	sp_rtrace_formatter_t* formatter = sp_rtrace_formatter_create(fd);
+	fmt_data_t fmt = {
+			.formatter = formatter,
+			.rd = rd,
+			.comment = NULL,
+	};
+	write_trace_environment(&fmt);
+
+	unsigned int period = rate->period ? rate->period : 1;
+	time_t now = time(NULL);
+	TRY(sp_rtrace_format_comment(formatter, "## live report #%u at %s", rate->index, ctime(&now)));
+	TRY(sp_rtrace_format_comment(formatter, "##   allocation rate %lu calls/s, %llu bytes/s\n", rate->allocs / period,
+			rate->alloc_size / period));
+	TRY(sp_rtrace_format_comment(formatter, "##   deallocation rate %lu calls/s\n", rate->frees / period));
+
+	/* write the largest live allocation groups */
+	dlist_t leaks;
+	dlist_init(&leaks);
+	leaks_sort(&rd->ftraces, &leaks, (op_binary_t)leaks_compare_by_size_desc);
+	ftrace_ref_t* ref = (ftrace_ref_t*)dlist_first(&leaks);
+	int i;
+	for (i = 0; ref && i < LIVE_REPORT_TOP; ref = (ftrace_ref_t*)ref->node.next, i++) {
+		if (!ref->leak_count) break;
+		write_live_allocations(ref, &fmt);
+	}
+	dlist_free(&leaks, (op_unary_t)free);
+
+	write_leak_summary(&fmt);
+	TRY(sp_rtrace_formatter_destroy(formatter));
+	close(fd);
+
+	if (rename(tmp_path, path) != 0) {
+		msg_error("failed to replace live report file %s (%s)\n", path, strerror(errno));
+	}
 }
 
 void write_trace_calls(fmt_data_t* fmt)
@@ -329,6 +361,6 @@ void write_trace_calls(fmt_data_t* fmt)
 
 	if (fmt->comment) {
 		fmt->comment = dlist_foreach2_in(&fmt->rd->comments, fmt->comment,
-				(op_binary_t)comment_check_index, (void*)(long)LONG_MAX, (op_binary_t)fcall_write_comment, fmt->fp);
+				(op_binary_t)comment_check_index, (void*)(long)LONG_MAX, (op_binary_t)fcall_write_comment, fmt->formatter);
 	}
 }
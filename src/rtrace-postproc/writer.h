@@ -30,6 +30,8 @@
  */
 
 #include "common/rtrace_data.h"
+#include "filter.h"
+#include "library/sp_rtrace_formatter.h"
 
 
 /**
@@ -37,7 +39,7 @@
  * they can be passed as a single argument.
  */
 typedef struct {
-	FILE* fp;
+	sp_rtrace_formatter_t* formatter;
 	rd_t* rd;
 	dlist_node_t* comment;
 } fmt_data_t;
@@ -77,6 +79,19 @@ void write_leak_summary(fmt_data_t* fmt);
 void write_trace_calls(fmt_data_t* fmt);
 
 
+/**
+ * Writes live report.
+ *
+ * The live report is a text log containing the largest live
+ * allocation groups (by backtrace), live resource totals and the
+ * allocation rate since the previous report. The report file is
+ * replaced with every new report.
+ * @param[in] rd    the resource trace data.
+ * @param[in] rate  the activity since the previous report.
+ */
+void write_live_report(rd_t* rd, const live_rate_t* rate);
+
+
 
 
 #endif /* WRITER_H */
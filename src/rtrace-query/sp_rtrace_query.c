@@ -0,0 +1,598 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+#include "config.h"
+
+/**
+ * @file sp_rtrace_query.c
+ *
+ * Trace database query tool (sp-rtrace-query) implementation.
+ *
+ * The query tool reads trace databases created by sp-rtrace-postproc
+ * --database option. The function calls are selected with the
+ * database indexes and written in the post-processor text format,
+ * so the query results can be further processed by other sp-rtrace
+ * tools.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/trace_db.h"
+#include "common/header.h"
+#include "common/log_writer.h"
+#include "common/utils.h"
+#include "common/msg.h"
+#include "library/sp_rtrace_defs.h"
+#include "library/sp_rtrace_formatter.h"
+
+/**
+ * The query options.
+ */
+typedef struct query_options_t {
+	char* input_file;
+	/* the timestamp range */
+	bool filter_time;
+	unsigned int time_from;
+	unsigned int time_to;
+	/* the call index range */
+	bool filter_index;
+	int index_from;
+	int index_to;
+	/* the resource identifier */
+	bool filter_res_id;
+	pointer_t res_id;
+	/* the index of call which backtrace must be matched */
+	bool filter_backtrace;
+	int backtrace_call;
+	/* write only query summary */
+	bool summary;
+} query_options_t;
+
+static query_options_t query_options = {
+	.input_file = NULL,
+	.filter_time = false,
+	.filter_index = false,
+	.filter_res_id = false,
+	.filter_backtrace = false,
+	.summary = false,
+};
+
+/**
+ * Free options resources allocated during command line parsing.
+ *
+ * @return
+ */
+static void free_options(void)
+{
+	if (query_options.input_file) free(query_options.input_file);
+}
+
+
+static void display_usage(void)
+{
+	printf("sp-rtrace-query is used to retrieve function calls from trace\n"
+	       "databases created with sp-rtrace-postproc --database option. The\n"
+	       "matching function calls are written in post-processor text format.\n"
+	       "Usage: sp-rtrace-query [<options>]\n"
+	       "where <options> are:\n"
+	       "  -i <path>          - the trace database path.\n"
+	       "  -t <start>-<end>   - list calls with timestamps in the specified range.\n"
+	       "                       The timestamp format is [[hh:]mm:]ss[.sss].\n"
+	       "  -I <first>-<last>  - list calls with indexes in the specified range.\n"
+	       "  -a <address>       - list calls allocating or freeing the resource\n"
+	       "                       at the specified (hex) address.\n"
+	       "  -b <index>         - list calls having the same backtrace as the call\n"
+	       "                       with the specified index.\n"
+	       "  -s                 - write only the query summary.\n"
+	       "  -h                 - this help page.\n"
+	       "If multiple filter options are given, the listed calls must match all\n"
+	       "of them.\n"
+	      );
+}
+
+/**
+ * Parses timestamp in [[hh:]mm:]ss[.sss] format.
+ *
+ * @param[in] text        the text to parse.
+ * @param[out] timestamp  the timestamp in milliseconds.
+ * @return                the end of parsed text or NULL on failure.
+ */
+static const char* parse_timestamp(const char* text, unsigned int* timestamp)
+{
+	const char* ptr = text;
+	unsigned int value = 0, fields = 0;
+
+	while (fields < 3) {
+		if (*ptr < '0' || *ptr > '9') return NULL;
+		unsigned int field = 0;
+		while (*ptr >= '0' && *ptr <= '9') field = field * 10 + *ptr++ - '0';
+		value = value * 60 + field;
+		fields++;
+		if (*ptr != ':') break;
+		ptr++;
+	}
+	value *= 1000;
+	if (*ptr == '.') {
+		unsigned int scale = 100;
+		ptr++;
+		while (*ptr >= '0' && *ptr <= '9') {
+			value += (*ptr++ - '0') * scale;
+			scale /= 10;
+		}
+	}
+	*timestamp = value;
+	return ptr;
+}
+
+/**
+ * Retrieves string from the database string table.
+ *
+ * The sp-rtrace data structures use non-constant strings, while the
+ * strings in mapped database are read only.
+ * @param[in] db      the trace database.
+ * @param[in] offset  the string offset.
+ * @return            the string or NULL.
+ */
+static char* db_string(const tdb_t* db, uint32_t offset)
+{
+	const char* str = tdb_string(db, offset);
+	return (char*)(pointer_t)str;
+}
+
+/**
+ * Writes trace environment data.
+ *
+ * The environment data is written in the same order as the
+ * post-processor writes it.
+ * @param[in] db         the trace database.
+ * @param[in] formatter  the log formatter.
+ */
+static void write_trace_environment(const tdb_t* db, sp_rtrace_formatter_t* formatter)
+{
+	const tdb_header_t* dbh = db->header;
+	size_t i;
+
+	log_write_header(formatter, db_string(db, dbh->arch), db_string(db, dbh->process), dbh->pid,
+			dbh->timestamp_sec, dbh->backtrace_depth, db_string(db, dbh->origin), dbh->filter);
+
+	const tdb_attachment_t* attachments = TDB_SECTION(db, TDB_SECTION_ATTACHMENTS, tdb_attachment_t);
+	for (i = 0; i < db->counts[TDB_SECTION_ATTACHMENTS]; i++) {
+		sp_rtrace_attachment_t file = {
+				.name = db_string(db, attachments[i].name),
+				.path = db_string(db, attachments[i].path),
+		};
+		TRY(sp_rtrace_format_attachment(formatter, &file));
+	}
+
+	if (dbh->has_heap) {
+		const tdb_heap_t* heap = &dbh->heap;
+		rd_hinfo_t hinfo = {
+				.heap_bottom = heap->heap_bottom,
+				.heap_top = heap->heap_top,
+				.lowest_block = heap->lowest_block,
+				.highest_block = heap->highest_block,
+				.arena = heap->arena,
+				.ordblks = heap->ordblks,
+				.smblks = heap->smblks,
+				.hblks = heap->hblks,
+				.hblkhd = heap->hblkhd,
+				.usmblks = heap->usmblks,
+				.fsmblks = heap->fsmblks,
+				.uordblks = heap->uordblks,
+				.fordblks = heap->fordblks,
+				.keepcost = heap->keepcost,
+		};
+		log_write_heap_info(formatter, &hinfo);
+	}
+
+	const tdb_module_t* modules = TDB_SECTION(db, TDB_SECTION_MODULES, tdb_module_t);
+	for (i = 0; i < db->counts[TDB_SECTION_MODULES]; i++) {
+		log_write_module_info(formatter, modules[i].id, tdb_string(db, modules[i].name), modules[i].vmajor,
+				modules[i].vminor);
+	}
+
+	const tdb_context_t* contexts = TDB_SECTION(db, TDB_SECTION_CONTEXTS, tdb_context_t);
+	for (i = 0; i < db->counts[TDB_SECTION_CONTEXTS]; i++) {
+		sp_rtrace_context_t context = {
+				.id = contexts[i].id,
+				.name = db_string(db, contexts[i].name),
+		};
+		TRY(sp_rtrace_format_context(formatter, &context));
+	}
+
+	const tdb_resource_t* resources = TDB_SECTION(db, TDB_SECTION_RESOURCES, tdb_resource_t);
+	for (i = 0; i < db->counts[TDB_SECTION_RESOURCES]; i++) {
+		sp_rtrace_resource_t resource = {
+				.id = resources[i].id,
+				.type = db_string(db, resources[i].type),
+				.desc = db_string(db, resources[i].desc),
+				.flags = resources[i].flags,
+		};
+		TRY(sp_rtrace_format_resource(formatter, &resource));
+	}
+
+	const tdb_mmap_t* mmaps = TDB_SECTION(db, TDB_SECTION_MMAPS, tdb_mmap_t);
+	for (i = 0; i < db->counts[TDB_SECTION_MMAPS]; i++) {
+		sp_rtrace_mmap_t mmap = {
+				.from = mmaps[i].from,
+				.to = mmaps[i].to,
+				.module = db_string(db, mmaps[i].module),
+				.build_id = db_string(db, mmaps[i].build_id),
+				.bias = mmaps[i].bias,
+		};
+		TRY(sp_rtrace_format_mmap(formatter, &mmap));
+	}
+}
+
+/**
+ * Writes comments preceding the specified call index.
+ *
+ * @param[in] db         the trace database.
+ * @param[in] formatter  the log formatter.
+ * @param[in] index      the call index.
+ * @param[in,out] next   the next comment to write.
+ */
+static void write_comments(const tdb_t* db, sp_rtrace_formatter_t* formatter, long index, size_t* next)
+{
+	const tdb_comment_t* comments = TDB_SECTION(db, TDB_SECTION_COMMENTS, tdb_comment_t);
+	while (*next < db->counts[TDB_SECTION_COMMENTS] && comments[*next].index < index) {
+		const char* text = tdb_string(db, comments[*next].text);
+		if (text) TRY(sp_rtrace_format_comment(formatter, "%s", text));
+		(*next)++;
+	}
+}
+
+/**
+ * Writes function call with its arguments and backtrace.
+ *
+ * @param[in] db         the trace database.
+ * @param[in] formatter  the log formatter.
+ * @param[in] row        the call row.
+ * @param[in] call       the call data.
+ */
+static void write_function_call(const tdb_t* db, sp_rtrace_formatter_t* formatter, size_t row, const sp_rtrace_fcall_t* call)
+{
+	TRY(sp_rtrace_format_call(formatter, call));
+
+	const tdb_arg_t* args;
+	size_t i, nargs = tdb_get_call_args(db, row, &args);
+	for (i = 0; i < nargs; i++) {
+		sp_rtrace_farg_t arg[2] = {
+				{
+					.name = db_string(db, args[i].name),
+					.value = db_string(db, args[i].value),
+				},
+				{.name = NULL, .value = NULL},
+		};
+		if (!arg[0].name) continue;
+		if (!arg[0].value) arg[0].value = (char*)(pointer_t)"";
+		TRY(sp_rtrace_format_args(formatter, arg));
+	}
+
+	uint32_t trace = tdb_get_call_trace(db, row);
+	if (trace != TDB_NONE) {
+		const pointer_t* frames;
+		const uint32_t* names;
+		size_t nframes = tdb_get_trace(db, trace, &frames, &names);
+		for (i = 0; i < nframes; i++) {
+			TRY(sp_rtrace_format_trace_step(formatter, frames[i], tdb_string(db, names[i])));
+		}
+		TRY(sp_rtrace_format_comment(formatter, "\n"));
+	}
+}
+
+/**
+ * The resource usage summary.
+ */
+typedef struct {
+	int count;
+	long long total_size;
+} leak_data_t;
+
+/**
+ * Sums allocations of the specified call.
+ *
+ * @param[in] db      the trace database.
+ * @param[in] row     the call row.
+ * @param[in] call    the call data.
+ * @param[out] leaks  the resource usage summary.
+ */
+static void sum_leaks(const tdb_t* db, size_t row, const sp_rtrace_fcall_t* call, leak_data_t* leaks)
+{
+	if (call->type != SP_RTRACE_FTYPE_ALLOC) return;
+	uint32_t res = TDB_SECTION(db, TDB_SECTION_CALL_RESOURCE, uint32_t)[row];
+	unsigned int id = res < db->counts[TDB_SECTION_RESOURCES] ? TDB_SECTION(db, TDB_SECTION_RESOURCES, tdb_resource_t)[res].id : 0;
+	leak_data_t* leak = &leaks[id ? (id - 1) & 31 : 0];
+	leak->count++;
+	leak->total_size += call->res_size;
+}
+
+/**
+ * Checks if the call matches the query options.
+ *
+ * @param[in] db     the trace database.
+ * @param[in] row    the call row.
+ * @param[in] trace  the backtrace row to match.
+ * @return           true if the call matches.
+ */
+static bool match_call(const tdb_t* db, size_t row, uint32_t trace)
+{
+	if (query_options.filter_time) {
+		unsigned int timestamp = TDB_SECTION(db, TDB_SECTION_CALL_TIMESTAMP, uint32_t)[row];
+		if (timestamp < query_options.time_from || timestamp > query_options.time_to) return false;
+	}
+	if (query_options.filter_index) {
+		int index = TDB_SECTION(db, TDB_SECTION_CALL_INDEX, int32_t)[row];
+		if (index < query_options.index_from || index > query_options.index_to) return false;
+	}
+	if (query_options.filter_res_id) {
+		if (TDB_SECTION(db, TDB_SECTION_CALL_RES_ID, pointer_t)[row] != query_options.res_id) return false;
+	}
+	if (query_options.filter_backtrace) {
+		if (tdb_get_call_trace(db, row) != trace) return false;
+	}
+	return true;
+}
+
+static int compare_rows(const void* row1, const void* row2)
+{
+	uint32_t r1 = *(const uint32_t*)row1, r2 = *(const uint32_t*)row2;
+	return r1 < r2 ? -1 : r1 != r2;
+}
+
+/**
+ * Selects the calls matching query options.
+ *
+ * The smallest candidate set is taken from the indexes of the
+ * specified filters and the remaining filters are checked for each
+ * candidate.
+ * @param[in] db     the trace database.
+ * @param[out] rows  the matching call rows in the trace order.
+ * @return           the number of matching calls.
+ */
+static size_t select_calls(const tdb_t* db, uint32_t** rows)
+{
+	const uint32_t* candidates = NULL;
+	size_t ncandidates = db->ncalls, count, i;
+	const uint32_t* index_rows;
+	uint32_t trace = TDB_NONE;
+
+	if (query_options.filter_time) {
+		count = tdb_find_by_time(db, query_options.time_from, query_options.time_to, &index_rows);
+		if (count <= ncandidates) {
+			candidates = index_rows;
+			ncandidates = count;
+		}
+	}
+	if (query_options.filter_index) {
+		count = tdb_find_by_index(db, query_options.index_from, query_options.index_to, &index_rows);
+		if (count <= ncandidates) {
+			candidates = index_rows;
+			ncandidates = count;
+		}
+	}
+	if (query_options.filter_res_id) {
+		count = tdb_find_by_res_id(db, query_options.res_id, &index_rows);
+		if (count <= ncandidates) {
+			candidates = index_rows;
+			ncandidates = count;
+		}
+	}
+	if (query_options.filter_backtrace) {
+		if (tdb_find_by_index(db, query_options.backtrace_call, query_options.backtrace_call, &index_rows)) {
+			trace = tdb_get_call_trace(db, *index_rows);
+		}
+		count = trace == TDB_NONE ? 0 : tdb_find_by_trace(db, trace, &index_rows);
+		if (count <= ncandidates) {
+			candidates = index_rows;
+			ncandidates = count;
+		}
+	}
+
+	*rows = (uint32_t*)malloc_a(sizeof(uint32_t) * (ncandidates + 1));
+	count = 0;
+	for (i = 0; i < ncandidates; i++) {
+		size_t row = candidates ? candidates[i] : i;
+		if (match_call(db, row, trace)) (*rows)[count++] = row;
+	}
+	if (candidates) qsort(*rows, count, sizeof(uint32_t), compare_rows);
+	return count;
+}
+
+/**
+ * Writes the query summary.
+ *
+ * @param[in] db      the trace database.
+ * @param[in] rows    the matching call rows.
+ * @param[in] count   the number of matching calls.
+ */
+static void write_summary(const tdb_t* db, const uint32_t* rows, size_t count)
+{
+	size_t i, allocs = 0, frees = 0;
+	long long alloc_size = 0;
+	for (i = 0; i < count; i++) {
+		if (TDB_SECTION(db, TDB_SECTION_CALL_TYPE, uint32_t)[rows[i]] == SP_RTRACE_FTYPE_ALLOC) {
+			allocs++;
+			alloc_size += TDB_SECTION(db, TDB_SECTION_CALL_RES_SIZE, int32_t)[rows[i]];
+		}
+		else frees++;
+	}
+	printf("matching calls: %zu of %zu\n", count, db->ncalls);
+	printf("allocations: %zu with total size of %lld bytes\n", allocs, alloc_size);
+	printf("deallocations: %zu\n", frees);
+}
+
+/**
+ * Writes the matching calls in post-processor text format.
+ *
+ * @param[in] db      the trace database.
+ * @param[in] rows    the matching call rows.
+ * @param[in] count   the number of matching calls.
+ */
+static void write_calls(const tdb_t* db, const uint32_t* rows, size_t count)
+{
+	size_t i, comment = 0;
+	leak_data_t leaks[32];
+	memset(leaks, 0, sizeof(leaks));
+
+	fflush(stdout);
+	sp_rtrace_formatter_t* formatter = sp_rtrace_formatter_create(STDOUT_FILENO);
+	write_trace_environment(db, formatter);
+
+	for (i = 0; i < count; i++) {
+		sp_rtrace_fcall_t call;
+		if (!tdb_get_call(db, rows[i], &call)) continue;
+		write_comments(db, formatter, call.index, &comment);
+		write_function_call(db, formatter, rows[i], &call);
+		sum_leaks(db, rows[i], &call, leaks);
+	}
+	write_comments(db, formatter, LONG_MAX, &comment);
+
+	if (db->header->leak_summary) {
+		const tdb_resource_t* resources = TDB_SECTION(db, TDB_SECTION_RESOURCES, tdb_resource_t);
+		for (i = 0; i < db->counts[TDB_SECTION_RESOURCES]; i++) {
+			TRY(sp_rtrace_format_comment(formatter, "# Resource - %s (%s):\n", tdb_string(db, resources[i].type),
+					tdb_string(db, resources[i].desc)));
+			int idx = ffs(resources[i].id) - 1;
+			leak_data_t* leak = &leaks[idx < 0 ? 0 : idx];
+			TRY(sp_rtrace_format_comment(formatter, "# %d block(s) leaked with total size of %d bytes\n", leak->count,
+					(int)leak->total_size));
+		}
+	}
+	TRY(sp_rtrace_formatter_destroy(formatter));
+}
+
+int main(int argc, char* argv[])
+{
+	/* command line options */
+	struct option long_options[] = {
+			 {"input-file", 1, 0, 'i'},
+			 {"time", 1, 0, 't'},
+			 {"index", 1, 0, 'I'},
+			 {"address", 1, 0, 'a'},
+			 {"backtrace", 1, 0, 'b'},
+			 {"summary", 0, 0, 's'},
+			 {"help", 0, 0, 'h'},
+			 {0, 0, 0, 0},
+	};
+	/* parse command line options */
+	int opt;
+	opterr = 0;
+
+	while ( (opt = getopt_long(argc, argv, "i:t:I:a:b:sh", long_options, NULL)) != -1) {
+		switch(opt) {
+		case 'h':
+			display_usage();
+			exit (0);
+
+		case 'i':
+			if (query_options.input_file) {
+				msg_warning("overriding previously given option: -i %s\n", query_options.input_file);
+				free(query_options.input_file);
+			}
+			query_options.input_file = strdup_a(optarg);
+			break;
+
+		case 't': {
+			const char* ptr = parse_timestamp(optarg, &query_options.time_from);
+			if (!ptr || *ptr++ != '-' || !(ptr = parse_timestamp(ptr, &query_options.time_to)) || *ptr) {
+				msg_error("invalid timestamp range (<start>-<end>): %s\n", optarg);
+				exit (-1);
+			}
+			query_options.filter_time = true;
+			break;
+		}
+
+		case 'I':
+			if (sscanf(optarg, "%d-%d", &query_options.index_from, &query_options.index_to) != 2) {
+				msg_error("invalid call index range (<first>-<last>): %s\n", optarg);
+				exit (-1);
+			}
+			query_options.filter_index = true;
+			break;
+
+		case 'a':
+			if (sscanf(optarg, "%lx", &query_options.res_id) != 1) {
+				msg_error("invalid resource address: %s\n", optarg);
+				exit (-1);
+			}
+			query_options.filter_res_id = true;
+			break;
+
+		case 'b':
+			if (sscanf(optarg, "%d", &query_options.backtrace_call) != 1) {
+				msg_error("invalid call index: %s\n", optarg);
+				exit (-1);
+			}
+			query_options.filter_backtrace = true;
+			break;
+
+		case 's':
+			query_options.summary = true;
+			break;
+
+		case '?':
+			msg_error("unknown sp-rtrace-query option: %c\n", optopt);
+			display_usage();
+			exit (-1);
+		}
+	}
+	if (optind < argc) {
+		msg_error("unknown sp-rtrace-query argument: %s\n", argv[optind]);
+		display_usage();
+		exit(-1);
+	}
+	if (!query_options.input_file) {
+		msg_error("the trace database must be specified with -i option\n");
+		display_usage();
+		exit (-1);
+	}
+
+	tdb_t db;
+	int rc = tdb_open(&db, query_options.input_file);
+	if (rc < 0) {
+		if (rc == -EINVAL) msg_error("%s is not a valid trace database\n", query_options.input_file);
+		else msg_error("failed to open trace database %s (%s)\n", query_options.input_file, strerror(-rc));
+		exit (-1);
+	}
+
+	uint32_t* rows;
+	size_t count = select_calls(&db, &rows);
+	if (query_options.summary) write_summary(&db, rows, count);
+	else write_calls(&db, rows, count);
+	free(rows);
+
+	tdb_close(&db);
+
+	free_options();
+
+	return 0;
+}
@@ -242,6 +242,7 @@ static long mmap_compare(const rs_mmap_t* mmap1, const rs_mmap_t* mmap2)
 static void rs_mmap_free_node(rs_mmap_t* map)
 {
 	if (map->module) free(map->module);
+	if (map->image) free(map->image);
 	if (map->is_cache_owner) {
 		rs_cache_record_clear(map->cache);
 		free(map->cache);
@@ -272,7 +273,10 @@ static int elf_get_address_info(rs_cache_record_t* rec, pointer_t address, symbo
 	Elf_Shdr_t *shdr, *str_shdr;
 
 	pointer_t abs_address = address;
-	if (!rec->mmap->is_absolute) {
+	if (rec->mmap->has_bias) {
+		abs_address -= rec->mmap->bias;
+	}
+	else if (!rec->mmap->is_absolute) {
 		abs_address -= rec->mmap->from;
 	}
 
@@ -337,7 +341,10 @@ static int bfd_get_address_info(rs_cache_record_t* rec, pointer_t address, symbo
 	bfd_vma pc, vma;
 	bfd_size_type size;
 
-	if (!rec->mmap->is_absolute) {
+	if (rec->mmap->has_bias) {
+		abs_address -= rec->mmap->bias;
+	}
+	else if (!rec->mmap->is_absolute) {
 		abs_address -= rec->mmap->from;
 	}
 
@@ -590,7 +597,7 @@ const char* rs_resolve_address(rs_cache_t* rs, pointer_t address, const char* na
 		}
 		if (map != map->cache->mmap) {
 			rs_cache_record_clear(map->cache);
-			if (rs_load_symbols(map->cache, map->module) < 0) {
+			if (rs_load_symbols(map->cache, map->image) < 0) {
 				rs_cache_record_clear(map->cache);
 				sprintf(buffer, "\t0x%lx from %s\n", address, rs_target_path(map->module));
 				break;
@@ -607,15 +614,20 @@ const char* rs_resolve_address(rs_cache_t* rs, pointer_t address, const char* na
 	return buffer;
 }
 
-rs_mmap_t* rs_mmap_add_module(rs_cache_t* rs, const char* module, pointer_t from, pointer_t to, bool single_cache)
+rs_mmap_t* rs_mmap_add_module(rs_cache_t* rs, const char* module, const char* image, pointer_t from, pointer_t to,
+		pointer_t bias, bool has_bias, bool single_cache)
 {
 	rs_mmap_t* map = NULL;
-	int is_absolute = rs_mmap_is_absolute(module);
+	if (!image) image = module;
+	int is_absolute = rs_mmap_is_absolute(image);
 	if (is_absolute >= 0) {
 		map = malloc_a(sizeof(rs_mmap_t));
 		map->module = strdup_a(module);
+		map->image = strdup_a(image);
 		map->from = from;
 		map->to = to;
+		map->bias = bias;
+		map->has_bias = has_bias;
 		map->fin = NULL;
 		map->fout = NULL;
 		map->is_absolute = is_absolute;
@@ -64,6 +64,13 @@ typedef struct rs_mmap_t {
 	pointer_t from;
 	pointer_t to;
 
+	/* the file containing module symbols (the module itself or
+	 * its copy located by build-id) */
+	char* image;
+	/* the module load bias, valid if has_bias is set */
+	pointer_t bias;
+	bool has_bias;
+
 	bool is_absolute;
 
 	rs_cache_record_t* cache;
@@ -104,13 +111,17 @@ const char* rs_resolve_address(rs_cache_t* rs, pointer_t address, const char* na
 /**
  * Adds new memory mapping record to the resolver cache.
  *
- * @param[in] rs      the resolver cache.
- * @param[in] module  the module name.
- * @param[in] from    the start address.
- * @param[in] to      the end address.
- * @return            the added memory mapping record.
+ * @param[in] rs        the resolver cache.
+ * @param[in] module    the module name.
+ * @param[in] image     the file containing module symbols (NULL - use the module file).
+ * @param[in] from      the start address.
+ * @param[in] to        the end address.
+ * @param[in] bias      the module load bias.
+ * @param[in] has_bias  true if the load bias is known.
+ * @return              the added memory mapping record.
  */
-rs_mmap_t* rs_mmap_add_module(rs_cache_t* rs, const char* module, pointer_t from, pointer_t to, bool single_cache);
+rs_mmap_t* rs_mmap_add_module(rs_cache_t* rs, const char* module, const char* image, pointer_t from, pointer_t to,
+		pointer_t bias, bool has_bias, bool single_cache);
 
 /**
  * Retrieves memory mapping record covering the specified address.
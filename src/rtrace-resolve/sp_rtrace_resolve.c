@@ -54,8 +54,10 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "common/utils.h"
+#include "common/resolve_utils.h"
 #include "common/rtrace_data.h"
 #include "common/msg.h"
 #include "library/sp_rtrace_defs.h"
@@ -74,6 +76,7 @@ resolve_options_t resolve_options = {
 	.full_path = false,
 	.keep_resolved = false,
 	.root_path = NULL,
+	.debug_dir = NULL,
 };
 
 
@@ -89,6 +92,7 @@ static void free_options(void)
 	if (resolve_options.input_file) free(resolve_options.input_file);
 	if (resolve_options.output_file) free(resolve_options.output_file);
 	if (resolve_options.root_path) free(resolve_options.root_path);
+	if (resolve_options.debug_dir) free(resolve_options.debug_dir);
 }
 
 
@@ -111,6 +115,10 @@ static void display_usage(void)
 	       "                 from input stream are ignored and the addresses are\n"
 	       "                 always resolved again).\n"
 	       "  -r <path>    - specify guest OS root path for cross platform resolving.\n"
+	       "  -d <path>    - the debug directory, containing symbol files in\n"
+	       "                 .build-id/<xx>/<rest of build-id>[.debug] layout. The\n"
+	       "                 symbol files are located by the module build-ids\n"
+	       "                 recorded in the memory mapping records.\n"
 	       "  -h           - this help page.\n"
 	      );
 }
@@ -140,23 +148,58 @@ static int parse_backtrace_index(const char* line, rs_cache_t* rs)
 	return -EINVAL;
 }
 
+/**
+ * Locates module symbol file by its build-id in the debug directory.
+ *
+ * The symbol files are looked up in the gdb compatible
+ * <debug dir>/.build-id/<xx>/<rest of build-id>[.debug] layout.
+ * @param[in] build_id  the module build-id.
+ * @param[out] path     the located symbol file path.
+ * @param[in] size      the path buffer size.
+ * @return              true if the symbol file was found.
+ */
+static bool locate_build_id_file(const char* build_id, char* path, size_t size)
+{
+	if (!resolve_options.debug_dir || strlen(build_id) < 3) return false;
+	snprintf(path, size, "%s/.build-id/%.2s/%s.debug", resolve_options.debug_dir, build_id, build_id + 2);
+	if (access(path, R_OK) == 0) return true;
+	snprintf(path, size, "%s/.build-id/%.2s/%s", resolve_options.debug_dir, build_id, build_id + 2);
+	return access(path, R_OK) == 0;
+}
+
 /**
  * Reads memory mapping record from the line.
  *
  * This function attempts to read memory mapping record from the
  * specified line and adds the mapping to the mmaps array if
  * successful.
+ * When the record contains module build-id the symbols are read
+ * from the matching file in debug directory if possible. Otherwise
+ * the local module file is used, after checking that its build-id
+ * matches the traced module.
  * @param[in] line   the line to parse.
  * @param[in] rs     the resolver cache.
  * @return
  */
 static const char* parse_mmap_record(const char* line, rs_cache_t* rs)
 {
-	char module[PATH_MAX];
-	pointer_t from, to;
+	char module[PATH_MAX], image[PATH_MAX];
+	char build_id[SP_RTRACE_BUILD_ID_SIZE * 2 + 1], local_id[SP_RTRACE_BUILD_ID_SIZE * 2 + 1];
+	pointer_t from, to, bias = 0;
 	if (sscanf(line, ": %s => 0x%lx-0x%lx", module, &from, &to) == 3) {
-		const char *host_path = rs_host_path(module);
-		rs_mmap_t* mmap = rs_mmap_add_module(rs, host_path, from, to,
+		const char *host_path = rs_host_path(module), *image_path = NULL;
+		const char* ptr = strstr(line, " build-id=");
+		bool has_bias = ptr && sscanf(ptr, " build-id=%128[0-9a-f] bias=0x%lx", build_id, &bias) == 2;
+		if (has_bias) {
+			if (locate_build_id_file(build_id, image, sizeof(image))) {
+				image_path = image;
+			}
+			else if (rs_read_build_id(host_path, 0, from, local_id, sizeof(local_id), NULL) == 0 &&
+					strcmp(build_id, local_id)) {
+				msg_warning("build-id mismatch for %s, the resolved names might be wrong\n", host_path);
+			}
+		}
+		rs_mmap_t* mmap = rs_mmap_add_module(rs, host_path, image_path, from, to, bias, has_bias,
 				!(resolve_options.mode & MODE_FULL_CACHE));
 		if (!mmap) {
 			char* ptr = strchr(module, '/');
@@ -471,13 +514,14 @@ int main(int argc, char* argv[])
 			 {"keep-resolved", 0, 0, 'k'},
 			 {"quiet", 0, 0, 'q'},
 			 {"root", 1, 0, 'r'},
+			 {"debug-dir", 1, 0, 'd'},
 			 {0, 0, 0, 0},
 	};
 	/* parse command line options */
 	int opt;
 	opterr = 0;
 
-	while ( (opt = getopt_long(argc, argv, "i:o:hm:pkt:qr:", long_options, NULL)) != -1) {
+	while ( (opt = getopt_long(argc, argv, "i:o:hm:pkt:qr:d:", long_options, NULL)) != -1) {
 		switch(opt) {
 		case 'h':
 			display_usage();
@@ -551,6 +595,14 @@ int main(int argc, char* argv[])
 			resolve_options.root_path = strdup_a(optarg);
 			break;
 
+		case 'd':
+			if (resolve_options.debug_dir) {
+				msg_warning("overriding previously given option: -d %s\n", resolve_options.debug_dir);
+				free(resolve_options.debug_dir);
+			}
+			resolve_options.debug_dir = strdup_a(optarg);
+			break;
+
 		case '?':
 			msg_error("unknown sp-resolve option: %c\n", optopt);
 			display_usage();
@@ -54,6 +54,8 @@ typedef struct resolve_options_t {
 	bool full_path;
 	bool keep_resolved;
 	char* root_path;
+	/* the directory containing .build-id symbol file links */
+	char* debug_dir;
 } resolve_options_t;
 
 
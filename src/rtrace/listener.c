@@ -26,6 +26,7 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -36,6 +37,8 @@
 #include <time.h>
 #include <limits.h>
 #include <malloc.h>
+#include <zlib.h>
+#include <search.h>
 
 #include "listener.h"
 #include "rtrace_env.h"
@@ -47,144 +50,545 @@
 #include "common/sp_rtrace_proto.h"
 #include "common/debug_log.h"
 #include "common/msg.h"
+#include "common/resolve_utils.h"
 
-/* the read buffer size */
-#define BUFFER_SIZE			4096
 
-
-int fd_out = 0;
 int fd_in = 0;
 
-/* the output buffer */
-static char output_buffer[BUFFER_SIZE * 2];
+/* the compression level of compressed binary logs */
+#define COMPRESSION_LEVEL		6
+
+/* the gzip format flag for deflateInit2() window bits parameter */
+#define COMPRESSION_GZIP		16
+
+/**
+ * The live allocation record.
+ *
+ * Contains the function call packet of a resource allocation followed
+ * by its backtrace and function argument packets.
+ */
+typedef struct listener_alloc_t {
+	/* the resource type id */
+	unsigned int res_type;
+	/* the resource identifier */
+	pointer_t res_id;
+	/* the number of references to reference counted resources */
+	unsigned int ref_count;
+	/* the function call number, used to write snapshot in allocation order */
+	unsigned long call;
+	/* the packet data */
+	char* data;
+	unsigned int size;
+} listener_alloc_t;
+
+/**
+ * The compressed output state.
+ */
+typedef struct listener_zstream_t {
+	/* the zlib stream */
+	z_stream zs;
+	/* the compressed data buffer */
+	unsigned char buffer[BUFFER_SIZE * 4];
+} listener_zstream_t;
+
+/**
+ * Stores the data not accepted by non-blocking output into the pending
+ * output buffer.
+ *
+ * @param[in] stream  the data stream.
+ * @param[in] iov     the data blocks.
+ * @param[in] count   the number of data blocks.
+ * @param[in] skip    the number of bytes already written.
+ */
+static void store_pending(listener_stream_t* stream, const struct iovec* iov, int count, size_t skip)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		size_t size = iov[i].iov_len;
+		const char* data = (const char*)iov[i].iov_base;
+		if (skip >= size) {
+			skip -= size;
+			continue;
+		}
+		data += skip;
+		size -= skip;
+		skip = 0;
+		if (stream->pending_size + size > stream->pending_capacity) {
+			if (!stream->pending_capacity) stream->pending_capacity = BUFFER_SIZE * 4;
+			while (stream->pending_size + size > stream->pending_capacity) stream->pending_capacity <<= 1;
+			stream->pending = (char*)realloc_a(stream->pending, stream->pending_capacity);
+		}
+		memcpy(stream->pending + stream->pending_size, data, size);
+		stream->pending_size += size;
+	}
+}
+
+/**
+ * Writes data blocks into output descriptor.
+ *
+ * The data is written completely into blocking output. The data which
+ * can't be written into non-blocking output without blocking is stored
+ * into pending output buffer, which is written later with
+ * listener_stream_write_pending().
+ * @param[in] stream  the data stream.
+ * @param[in] iov     the data blocks.
+ * @param[in] count   the number of data blocks.
+ * @return            0 - success, -1 - failure.
+ */
+static int write_fd(listener_stream_t* stream, struct iovec* iov, int count)
+{
+	size_t size = 0;
+	int i;
+	for (i = 0; i < count; i++) size += iov[i].iov_len;
+	stream->segment_size += size;
 
-/* the output buffer head */
-static char* output_buffer_head = output_buffer;
+	/* keep the data order if there is already data waiting */
+	if (stream->pending_size) {
+		store_pending(stream, iov, count, 0);
+		return 0;
+	}
+	while (true) {
+		ssize_t nbytes = writev(stream->fd_out, iov, count);
+		if (nbytes < 0) {
+			if (errno == EINTR) continue;
+			if (!stream->nonblocking || errno != EAGAIN) {
+				stream->output_failed = true;
+				return -1;
+			}
+			nbytes = 0;
+		}
+		if ((size_t)nbytes == size) return 0;
+		if (stream->nonblocking) {
+			store_pending(stream, iov, count, nbytes);
+			return 0;
+		}
+		/* continue the partial write */
+		size -= nbytes;
+		while ((size_t)nbytes >= iov->iov_len) {
+			nbytes -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		iov->iov_base = (char*)iov->iov_base + nbytes;
+		iov->iov_len -= nbytes;
+	}
+}
 
-/* the handshake packet buffer */
-static char hs_buffer[256];
-static int hs_size = 0;
+/**
+ * Writes the pending output data in blocking mode.
+ *
+ * @param[in] stream  the data stream.
+ * @return            0 - success, -1 - failure.
+ */
+static int drain_pending(listener_stream_t* stream)
+{
+	if (!stream->pending_size) return 0;
+	int flags = fcntl(stream->fd_out, F_GETFL);
+	if (flags != -1) fcntl(stream->fd_out, F_SETFL, flags & ~O_NONBLOCK);
+	while (stream->pending_size) {
+		if (listener_stream_write_pending(stream) < 0) return -1;
+	}
+	return 0;
+}
+
+/**
+ * Compresses data and writes the compressed data blocks into output.
+ *
+ * @param[in] stream  the data stream.
+ * @param[in] data    the data to compress.
+ * @param[in] size    the data size.
+ * @param[in] flush   the zlib flush mode.
+ * @return            0 - success, -1 - failure.
+ */
+static int write_compressed(listener_stream_t* stream, void* data, size_t size, int flush)
+{
+	z_stream* zs = &stream->zstream->zs;
+	zs->next_in = data;
+	zs->avail_in = size;
+	do {
+		zs->next_out = stream->zstream->buffer;
+		zs->avail_out = sizeof(stream->zstream->buffer);
+		if (deflate(zs, flush) == Z_STREAM_ERROR) {
+			errno = EINVAL;
+			return -1;
+		}
+		struct iovec iov = {
+			.iov_base = stream->zstream->buffer,
+			.iov_len = sizeof(stream->zstream->buffer) - zs->avail_out,
+		};
+		if (iov.iov_len && write_fd(stream, &iov, 1) < 0) return -1;
+	} while (zs->avail_out == 0);
+	return 0;
+}
+
+/**
+ * Writes data blocks into output, compressing them if necessary.
+ *
+ * @param[in] stream  the data stream.
+ * @param[in] iov     the data blocks.
+ * @param[in] count   the number of data blocks.
+ * @return            0 - success, -1 - failure.
+ */
+static int write_output(listener_stream_t* stream, struct iovec* iov, int count)
+{
+	if (!stream->zstream) return write_fd(stream, iov, count);
+
+	int i;
+	for (i = 0; i < count; i++) {
+		if (write_compressed(stream, iov[i].iov_base, iov[i].iov_len, Z_NO_FLUSH) < 0) return -1;
+	}
+	return 0;
+}
 
 /**
  * Flushes the output buffer.
  *
+ * @param[in] stream  the data stream.
  * @return
  */
-static int flush_data(void)
+static int flush_data(listener_stream_t* stream)
 {
-	int size = output_buffer_head - output_buffer;
-	if (fd_out > 0 && size) {
-		if (write(fd_out, output_buffer, size) < 0) {
+	int size = stream->output_buffer_head - stream->output_buffer;
+	if (stream->fd_out > 0 && size) {
+		struct iovec iov = {.iov_base = stream->output_buffer, .iov_len = size};
+		/* the data of failed output is discarded, the failure is already reported */
+		if (stream->output_failed) size = -1;
+		else if (write_output(stream, &iov, 1) < 0) {
 			msg_error("failed to write to file/post-processor pipe (%s)\n",
 					strerror(errno));
-			return -1;
+			size = -1;
 		}
 	}
-	output_buffer_head = output_buffer;
+	stream->output_buffer_head = stream->output_buffer;
 	return size;
 }
 
+/*
+ * Flight recorder ring buffer support
+ */
+
+/**
+ * Copies data from the flight recorder ring buffer.
+ *
+ * @param[in] stream  the data stream.
+ * @param[in] offset  the data offset in ring buffer.
+ * @param[out] data   the output buffer.
+ * @param[in] size    the number of bytes to copy.
+ */
+static void ring_read(listener_stream_t* stream, size_t offset, char* data, size_t size)
+{
+	size_t tail = rtrace_options.recorder_size - offset;
+	if (size <= tail) {
+		memcpy(data, stream->ring + offset, size);
+		return;
+	}
+	memcpy(data, stream->ring + offset, tail);
+	memcpy(data + tail, stream->ring, size - tail);
+}
+
+/**
+ * Removes the oldest packet from the flight recorder ring buffer.
+ *
+ * @param[in] stream  the data stream.
+ * @return            the type of the removed packet.
+ */
+static unsigned int ring_drop_packet(listener_stream_t* stream)
+{
+	char header[SP_RTRACE_PROTO_TYPE_SIZE + SP_RTRACE_PROTO_LENGTH_SIZE];
+	unsigned int type, len;
+
+	ring_read(stream, stream->ring_head, header, sizeof(header));
+	read_dword(header, &type);
+	read_dword(header + SP_RTRACE_PROTO_TYPE_SIZE, &len);
+	len += sizeof(header);
+	if (len > stream->ring_size) {
+		/* only a part of the packet was stored, discard everything */
+		stream->ring_head = 0;
+		stream->ring_size = 0;
+		return type;
+	}
+	stream->ring_head = (stream->ring_head + len) % rtrace_options.recorder_size;
+	stream->ring_size -= len;
+	return type;
+}
+
+/**
+ * Makes space for a new packet in the flight recorder ring buffer.
+ *
+ * The oldest packets are removed to make space for the new packet. The
+ * backtrace and function argument packets left without their function
+ * call packet are removed too.
+ * @param[in] stream  the data stream.
+ * @param[in] size    the packet size.
+ */
+static void ring_reserve(listener_stream_t* stream, size_t size)
+{
+	size_t capacity = rtrace_options.recorder_size;
+	if (stream->ring_size + size <= capacity) return;
+	while (stream->ring_size + size > capacity) ring_drop_packet(stream);
+	while (stream->ring_size) {
+		char header[SP_RTRACE_PROTO_TYPE_SIZE];
+		unsigned int type;
+		ring_read(stream, stream->ring_head, header, sizeof(header));
+		read_dword(header, &type);
+		if (type != SP_RTRACE_PROTO_BACKTRACE && type != SP_RTRACE_PROTO_FUNCTION_ARGS) break;
+		ring_drop_packet(stream);
+	}
+}
+
+/**
+ * Writes data into the flight recorder ring buffer.
+ *
+ * The data consists of whole packets, except large packets which are
+ * written in several chunks. The space for the whole packet is reserved
+ * when its first chunk is written, so the partially stored packet is never
+ * removed. Packets larger than the ring buffer are discarded.
+ * @param[in] stream  the data stream.
+ * @param[in] data    the data to write.
+ * @param[in] size    the number of bytes to write.
+ */
+static void ring_write(listener_stream_t* stream, const char* data, size_t size)
+{
+	size_t capacity = rtrace_options.recorder_size;
+	while (size) {
+		size_t len;
+		if (stream->ring_skip) {
+			/* skip the rest of discarded packet */
+			len = size < stream->ring_skip ? size : stream->ring_skip;
+			stream->ring_skip -= len;
+			data += len;
+			size -= len;
+			continue;
+		}
+		if (!stream->ring_left) {
+			/* new packet, the packet header is always written as a whole */
+			unsigned int packet_len;
+			read_dword(data + SP_RTRACE_PROTO_TYPE_SIZE, &packet_len);
+			len = packet_len + SP_RTRACE_PROTO_TYPE_SIZE + SP_RTRACE_PROTO_LENGTH_SIZE;
+			if (len > capacity) {
+				LOG("discarding %zu bytes packet not fitting the flight recorder buffer", len);
+				stream->ring_skip = len;
+				continue;
+			}
+			ring_reserve(stream, len);
+			stream->ring_left = len;
+			stream->ring_partial = 0;
+		}
+		len = size < stream->ring_left ? size : stream->ring_left;
+
+		size_t offset = (stream->ring_head + stream->ring_size) % capacity;
+		size_t tail = capacity - offset;
+		if (len <= tail) {
+			memcpy(stream->ring + offset, data, len);
+		}
+		else {
+			memcpy(stream->ring + offset, data, tail);
+			memcpy(stream->ring, data + tail, len - tail);
+		}
+		stream->ring_size += len;
+		stream->ring_left -= len;
+		stream->ring_partial = stream->ring_left ? stream->ring_partial + len : 0;
+		data += len;
+		size -= len;
+	}
+}
+
 /**
  * Writes the data.
  *
  * The data is buffered internally unless the --disable-event-buffering option is
- * specified.
+ * specified. Data that would fill the buffer is written together with the
+ * buffered data instead of being copied into the buffer.
+ * @param[in] stream  the data stream.
  * @param[in] data    the data to write.
  * @param[in] size    the number of bytes to write.
  * @return            the number of bytes written.
  */
-static int write_data(const char* data, int size)
+static int write_data(listener_stream_t* stream, char* data, int size)
 {
+	/* in flight recorder mode the data is kept in memory until dumped */
+	if (stream->ring) {
+		ring_write(stream, data, size);
+		return size;
+	}
 	/* write directly to the output stream if the event buffering is disabled */
 	if (rtrace_options.disable_packet_buffering) {
-		return write(fd_out, data, size);
+		struct iovec iov = {.iov_base = data, .iov_len = size};
+		return write_output(stream, &iov, 1) < 0 ? -1 : size;
 	}
-	/* write data to buffer and flush it if necessary */
-	memcpy(output_buffer_head, data, size);
-	output_buffer_head += size;
-	if (output_buffer_head - output_buffer >= BUFFER_SIZE) {
-		if (flush_data() < 0) return -1;
+	int buffered = stream->output_buffer_head - stream->output_buffer;
+	if (buffered + size < BUFFER_SIZE) {
+		/* write data to buffer */
+		memcpy(stream->output_buffer_head, data, size);
+		stream->output_buffer_head += size;
+		return size;
+	}
+	stream->output_buffer_head = stream->output_buffer;
+	if (stream->fd_out > 0) {
+		/* the data of failed output is discarded, the failure is already reported */
+		if (stream->output_failed) return -1;
+		struct iovec iov[] = {
+			{.iov_base = stream->output_buffer, .iov_len = buffered},
+			{.iov_base = data, .iov_len = size},
+		};
+		if (write_output(stream, iov, 2) < 0) {
+			msg_error("failed to write to file/post-processor pipe (%s)\n",
+					strerror(errno));
+			return -1;
+		}
 	}
 	return size;
 }
 /*
- * Memory mapping scanning support
+ * Memory mapping tracking support
+ *
+ * The memory mappings are kept in a binary search tree (tsearch) ordered
+ * by the address ranges. As the mappings don't overlap, ranges overlapping
+ * each other are treated as equal, so a tree lookup with a range returns
+ * the (first found) mapping overlapping it.
  */
+
 /**
- * Internal memory mapping record cache.
+ * Compares memory mapping address ranges.
+ *
+ * @param[in] item1  the first mapping record.
+ * @param[in] item2  the second mapping record.
+ * @return           <0 - item1 is below item2, >0 - item1 is above
+ *                   item2, 0 - the ranges overlap.
  */
-dlist_t s_mmaps;
+static int range_compare(const void* item1, const void* item2)
+{
+	const rd_mmap_t* mmap1 = (const rd_mmap_t*)item1;
+	const rd_mmap_t* mmap2 = (const rd_mmap_t*)item2;
+	if (mmap1->data.to <= mmap2->data.from) return -1;
+	if (mmap1->data.from >= mmap2->data.to) return 1;
+	return 0;
+}
 
-#if 0 /* unused for now */
 /**
- * Compares memory mapping cache record with module name.
+ * Stores memory mapping record.
  *
- * @param[in] mmap  the cache record.
- * @param[in] name  the module name.
- * @return          0 - equal.
+ * The mappings overlapping the new mapping are removed.
+ * @param[in] stream  the data stream.
+ * @param[in] from    the mapping start address.
+ * @param[in] to      the mapping end address.
+ * @param[in] module  the mapped module name.
+ * @param[in] build_id  the module build-id (can be NULL).
+ * @param[in] bias    the module load bias.
+ * @return            true if the mapping was added, false if the same
+ *                    mapping was already stored.
  */
-static long mmap_compare(rd_mmap_t* mmap, const char* name)
+static bool store_mmap(listener_stream_t* stream, pointer_t from, pointer_t to, char* module,
+		const char* build_id, pointer_t bias)
 {
-	return strcmp(mmap->data.module, name);
+	rd_mmap_t key = {.data = {.from = from, .to = to, .module = module}};
+	rd_mmap_t** node;
+
+	while ((node = (rd_mmap_t**)tfind(&key, &stream->mmaps, range_compare)) != NULL) {
+		rd_mmap_t* mmap = *node;
+		/* if the addresses are the same - skip */
+		if (mmap->data.from == from && mmap->data.to == to && !strcmp(mmap->data.module, module)) return false;
+		tdelete(mmap, &stream->mmaps, range_compare);
+		rd_mmap_free(mmap);
+	}
+	rd_mmap_t* mmap = (rd_mmap_t*)malloc_a(sizeof(rd_mmap_t));
+	mmap->data.from = from;
+	mmap->data.to = to;
+	mmap->data.module = strdup_a(module);
+	mmap->data.build_id = build_id && *build_id ? strdup_a(build_id) : NULL;
+	mmap->data.bias = bias;
+	tsearch(mmap, &stream->mmaps, range_compare);
+	return true;
 }
-#endif
 
-static long range_compare(rd_mmap_t* mmap1, sp_rtrace_mmap_t* mmap2)
+/**
+ * Writes memory map packet into output stream.
+ *
+ * @param[in] mmap    the memory mapping record.
+ * @param[in] stream  the data stream.
+ * @return            0 - success, -1 - failure.
+ */
+static long write_mmap_packet(rd_mmap_t* mmap, listener_stream_t* stream)
 {
-	if (mmap1->data.to < mmap2->from) return -1;
-	if (mmap1->data.from > mmap2->to) return 1;
-	return 0;
+	char packet[PATH_MAX + SP_RTRACE_BUILD_ID_SIZE * 2 + 48];
+	/* assemble and write MM packet */
+	char* ptr = packet + write_dword(packet, SP_RTRACE_PROTO_MEMORY_MAP);
+	ptr += SP_RTRACE_PROTO_TYPE_SIZE;
+	ptr += write_pointer(ptr, mmap->data.from);
+	ptr += write_pointer(ptr, mmap->data.to);
+	ptr += write_string(ptr, mmap->data.module);
+	ptr += write_string(ptr, mmap->data.build_id ? mmap->data.build_id : "");
+	ptr += write_pointer(ptr, mmap->data.bias);
+	int size = ptr - packet;
+	write_dword(packet + SP_RTRACE_PROTO_TYPE_SIZE, size - SP_RTRACE_PROTO_TYPE_SIZE - SP_RTRACE_PROTO_LENGTH_SIZE);
+	/* write the assembled packet to the output stream */
+	return write_data(stream, packet, size) < 0 ? -1 : 0;
+}
+
+/* the stream, which memory mappings are being written by write_mmap_packets() */
+static listener_stream_t* mmap_walk_stream;
+
+/**
+ * Writes memory map packet of the visited tree node.
+ */
+static void write_mmap_node(const void* node, VISIT visit, int depth __attribute__((unused)))
+{
+	if (visit == postorder || visit == leaf) {
+		write_mmap_packet(*(rd_mmap_t* const*)node, mmap_walk_stream);
+	}
+}
+
+/**
+ * Writes memory map packets of all stored mappings in address order.
+ *
+ * @param[in] stream  the data stream.
+ */
+static void write_mmap_packets(listener_stream_t* stream)
+{
+	mmap_walk_stream = stream;
+	twalk(stream->mmaps, write_mmap_node);
 }
 
 /**
  * Parse maps file and write memory map packets into output stream.
  *
- * @param[in] pid   the target process identifier.
+ * The build-id and load bias of the mapped modules are read from the
+ * module files.
+ * @param[in] stream  the data stream.
  * @return
  */
-static int scan_mmap_data(void)
+static int scan_mmap_data(listener_stream_t* stream)
 {
-	char name[PATH_MAX], buffer[PATH_MAX];
-	sprintf(name, "/proc/%d/maps", rtrace_options.pid);
+	char name[PATH_MAX], buffer[PATH_MAX], build_id[SP_RTRACE_BUILD_ID_SIZE * 2 + 1];
+	sprintf(name, "/proc/%d/maps", stream->pid);
 	FILE* fp = fopen(name, "r");
 	if (fp) {
 		while (fgets(name, PATH_MAX, fp)) {
-			pointer_t from, to;
+			pointer_t from, to, bias;
+			unsigned long offset;
 			char rights[8];
-			if (sscanf(name, "%lx-%lx %s %[^ ] %[^ ] %[^ ] %[^ ]", &from, &to, rights, buffer, buffer, buffer, buffer) == 7 && rights[2] == 'x') {
+			if (sscanf(name, "%lx-%lx %s %lx %[^ ] %[^ ] %[^ ]", &from, &to, rights, &offset, buffer, buffer, buffer) == 7 && rights[2] == 'x') {
 				if (*buffer) buffer[strlen(buffer) - 1] = '\0';
 				/* check if the memory mapping is not already registered */
-				sp_rtrace_mmap_t map = {
-						.module = buffer,
-						.from = from,
-						.to = to,
-				};
-				rd_mmap_t* mmap = (rd_mmap_t*)dlist_find(&s_mmaps, (void*)&map, (op_binary_t)range_compare);
-				if (mmap) {
-					/* if the addresses are the same - skip */
-					if (!strcmp(mmap->data.module, buffer) && mmap->data.from == from && mmap->data.to == to) continue;
-					/* update mapping record */
-					dlist_remove(&s_mmaps, mmap);
-					rd_mmap_free(mmap);
+				rd_mmap_t key = {.data = {.from = from, .to = to, .module = buffer}};
+				rd_mmap_t** node = (rd_mmap_t**)tfind(&key, &stream->mmaps, range_compare);
+				if (node && (*node)->data.from == from && (*node)->data.to == to &&
+						!strcmp((*node)->data.module, buffer)) continue;
+
+				bias = from - offset;
+				if (*buffer != '/' || rs_read_build_id(buffer, offset, from, build_id, sizeof(build_id), &bias) < 0) {
+					*build_id = '\0';
 				}
-				mmap = dlist_create_node(sizeof(rd_mmap_t));
-				mmap->data.from = from;
-				mmap->data.to = to;
-				mmap->data.module = strdup_a(buffer);
-				dlist_add(&s_mmaps, mmap);
-
-				/* assemble and write MM packet */
-				char* ptr = name + write_dword(name, SP_RTRACE_PROTO_MEMORY_MAP);
-				ptr += SP_RTRACE_PROTO_TYPE_SIZE;
-				ptr += write_pointer(ptr, from);
-				ptr += write_pointer(ptr, to);
-				ptr += write_string(ptr, buffer);
-				int size = ptr - name;
-				write_dword(name + SP_RTRACE_PROTO_TYPE_SIZE, size - SP_RTRACE_PROTO_TYPE_SIZE - SP_RTRACE_PROTO_LENGTH_SIZE);
-				/* write the assembled packet to the output stream */
-				if (write_data(name, size) < 0) {
-					fclose(fp);
-					return -1;
+				store_mmap(stream, from, to, buffer, build_id, bias);
+
+				/* the flight recorder writes the cached mappings when dumped */
+				if (!stream->ring) {
+					rd_mmap_t mmap = {.data = {.from = from, .to = to, .module = buffer,
+							.build_id = *build_id ? build_id : NULL, .bias = bias}};
+					if (write_mmap_packet(&mmap, stream) < 0) {
+						fclose(fp);
+						return -1;
+					}
 				}
 			}
 		}
@@ -193,14 +597,409 @@ static int scan_mmap_data(void)
 	return 0;
 }
 
+/*
+ * Output rotation support
+ */
+
+/**
+ * Checks if the packet describes process state and must be repeated
+ * at the beginning of every output segment.
+ *
+ * The memory map packets are not stored, as the current memory
+ * mappings are kept in the memory mapping cache.
+ * @param[in] type   the packet type.
+ * @return           true if the packet must be stored.
+ */
+static bool is_state_packet(unsigned int type)
+{
+	return type == SP_RTRACE_PROTO_PROCESS_INFO || type == SP_RTRACE_PROTO_MODULE_INFO ||
+			type == SP_RTRACE_PROTO_RESOURCE_REGISTRY || type == SP_RTRACE_PROTO_CONTEXT_REGISTRY;
+}
+
+/**
+ * Stores process state packet.
+ *
+ * @param[in] stream  the data stream.
+ * @param[in] data    the packet data.
+ * @param[in] size    the packet size.
+ */
+static void store_state_packet(listener_stream_t* stream, const char* data, int size)
+{
+	if (stream->state_size + size > stream->state_capacity) {
+		stream->state_capacity = (stream->state_size + size) * 2;
+		stream->state = (char*)realloc_a(stream->state, stream->state_capacity);
+	}
+	memcpy(stream->state + stream->state_size, data, size);
+	stream->state_size += size;
+}
+
+/**
+ * Starts a new output segment.
+ *
+ * Rotation is enabled only for binary log files. The segment index file
+ * is created together with the first segment.
+ * @param[in] stream  the data stream.
+ */
+static void start_segment(listener_stream_t* stream)
+{
+	if (stream->segment == 0) {
+		stream->rotate = (rtrace_options.rotate_size || rtrace_options.rotate_time) && stream->output_file;
+		if (stream->rotate) {
+			char path[PATH_MAX];
+			snprintf(path, sizeof(path), "%s.index", stream->output_file);
+			stream->index_fp = fopen(path, "we");
+			if (stream->index_fp) {
+				fprintf(stream->index_fp, "# segment file start end first_call last_call\n");
+			}
+			else {
+				msg_warning("failed to create segment index file %s (%s)\n", path, strerror(errno));
+			}
+		}
+	}
+	stream->segment_size = 0;
+	stream->segment_first_call = stream->calls + 1;
+	gettimeofday(&stream->segment_start, NULL);
+}
+
+/**
+ * Checks if the output segment limits have been reached.
+ *
+ * @param[in] stream  the data stream.
+ * @return            true if the output must be rotated.
+ */
+static bool is_rotation_due(listener_stream_t* stream)
+{
+	if (!stream->rotate || stream->fd_out <= 0) return false;
+	if (rtrace_options.rotate_size && stream->segment_size >= rtrace_options.rotate_size) return true;
+	return rtrace_options.rotate_time && time(NULL) >= stream->segment_start.tv_sec + rtrace_options.rotate_time;
+}
+
+/**
+ * Closes the current output segment and opens the next one.
+ *
+ * The handshake, stored process state packets and the current memory
+ * mappings are written at the beginning of the new segment, so it can
+ * be post-processed independently from the other segments.
+ * @param[in] stream  the data stream.
+ * @return            0 - success, -1 - failure.
+ */
+static int rotate_output(listener_stream_t* stream)
+{
+	rtrace_disconnect_output(stream, true);
+	if (stream->output_file) {
+		free(stream->output_file);
+		stream->output_file = NULL;
+	}
+	stream->segment++;
+	if (rtrace_connect_output(stream) <= 0) return -1;
+	start_segment(stream);
+
+	if (write_data(stream, stream->hs_buffer, stream->hs_size) < 0) return -1;
+	if (stream->state_size && write_data(stream, stream->state, stream->state_size) < 0) return -1;
+	write_mmap_packets(stream);
+	return 0;
+}
+
+/**
+ * Writes the current segment record into segment index file.
+ *
+ * @param[in] stream  the data stream.
+ */
+static void write_segment_index(listener_stream_t* stream)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	fprintf(stream->index_fp, "%u %s %ld.%06ld %ld.%06ld %lu %lu\n", stream->segment,
+			stream->output_file ? stream->output_file : "-",
+			(long)stream->segment_start.tv_sec, (long)stream->segment_start.tv_usec,
+			(long)tv.tv_sec, (long)tv.tv_usec, stream->segment_first_call, stream->calls);
+	fflush(stream->index_fp);
+}
+
+/*
+ * Flight recorder support
+ */
+
+/**
+ * Writes the flight recorder contents into a new output file or
+ * post-processor pipe.
+ *
+ * The handshake, stored process state packets and the current memory
+ * mappings are written before the recorded packets, so the output can
+ * be post-processed as a normal trace. The recorder is emptied afterwards.
+ * @param[in] stream  the data stream.
+ * @param[in] reason  the dump reason.
+ * @return            0 - success, -1 - failure.
+ */
+static int dump_recorder(listener_stream_t* stream, const char* reason)
+{
+	if (!stream->handshake || !stream->ring_size) return 0;
+
+	fprintf(stderr, "INFO: Dumping flight recorder data of process %d (%s).\n", stream->pid, reason);
+	if (rtrace_connect_output(stream) <= 0) return -1;
+
+	/* detach the ring buffer, so the data is written to the output */
+	char* ring = stream->ring;
+	stream->ring = NULL;
+	int rc = 0;
+	if (write_data(stream, stream->hs_buffer, stream->hs_size) < 0 ||
+			(stream->state_size && write_data(stream, stream->state, stream->state_size) < 0)) {
+		rc = -1;
+	}
+	write_mmap_packets(stream);
+	/* the partially received large packet is not written */
+	size_t size = stream->ring_size - stream->ring_partial;
+	size_t tail = rtrace_options.recorder_size - stream->ring_head;
+	if (tail > size) tail = size;
+	if (rc == 0 && (write_data(stream, ring + stream->ring_head, tail) < 0 ||
+			(tail < size && write_data(stream, ring, size - tail) < 0))) {
+		rc = -1;
+	}
+	rtrace_disconnect_output(stream, true);
+	if (stream->output_file) {
+		free(stream->output_file);
+		stream->output_file = NULL;
+	}
+	stream->ring = ring;
+	stream->ring_head = 0;
+	stream->ring_size = 0;
+	/* discard the rest of partially received large packet */
+	stream->ring_skip += stream->ring_left;
+	stream->ring_left = 0;
+	stream->ring_partial = 0;
+	return rc;
+}
+
+/**
+ * Checks if the heap size reported by heap information packet
+ * exceeds the flight recorder heap limit.
+ *
+ * @param[in] data    the packet payload.
+ * @return            true if the flight recorder must be dumped.
+ */
+static bool is_heap_limit_exceeded(const char* data)
+{
+	unsigned int arena, hblkhd;
+	if (!rtrace_options.recorder_heap) return false;
+	/* the packet starts with heap bottom and top addresses followed by
+	 * mallinfo fields arena, ordblks, smblks, hblks, hblkhd ... */
+	read_dword(data + 8, &arena);
+	read_dword(data + 24, &hblkhd);
+	return (unsigned long long)arena + hblkhd >= rtrace_options.recorder_heap;
+}
+
+/*
+ * Live allocation snapshot support
+ */
+
+/**
+ * Compares live allocation records by resource type and identifier.
+ */
+static int alloc_compare(const void* item1, const void* item2)
+{
+	const listener_alloc_t* alloc1 = (const listener_alloc_t*)item1;
+	const listener_alloc_t* alloc2 = (const listener_alloc_t*)item2;
+	if (alloc1->res_type != alloc2->res_type) return alloc1->res_type < alloc2->res_type ? -1 : 1;
+	if (alloc1->res_id != alloc2->res_id) return alloc1->res_id < alloc2->res_id ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Compares live allocation records by function call number.
+ */
+static int alloc_compare_call(const void* item1, const void* item2)
+{
+	const listener_alloc_t* alloc1 = *(listener_alloc_t* const*)item1;
+	const listener_alloc_t* alloc2 = *(listener_alloc_t* const*)item2;
+	return alloc1->call == alloc2->call ? 0 : (alloc1->call < alloc2->call ? -1 : 1);
+}
+
+/**
+ * Releases live allocation record.
+ */
+static void alloc_free(void* item)
+{
+	listener_alloc_t* alloc = (listener_alloc_t*)item;
+	free(alloc->data);
+	free(alloc);
+}
+
+/**
+ * Appends packet data to live allocation record.
+ *
+ * @param[in] alloc  the live allocation record.
+ * @param[in] data   the packet data.
+ * @param[in] size   the packet size.
+ */
+static void alloc_append(listener_alloc_t* alloc, const char* data, unsigned int size)
+{
+	alloc->data = (char*)realloc_a(alloc->data, alloc->size + size);
+	memcpy(alloc->data + alloc->size, data, size);
+	alloc->size += size;
+}
+
+/**
+ * Updates the live allocation records with a pass-through packet.
+ *
+ * Allocation function call packets add new records and deallocation
+ * packets remove them. The backtrace and function argument packets are
+ * appended to the preceding allocation record.
+ * @param[in] stream  the data stream.
+ * @param[in] data    the packet data.
+ * @param[in] type    the packet type.
+ * @param[in] offset  the packet payload offset.
+ * @param[in] len     the packet size.
+ */
+static void track_alloc_packet(listener_stream_t* stream, const char* data, unsigned int type,
+		unsigned int offset, unsigned int len)
+{
+	if (type == SP_RTRACE_PROTO_BACKTRACE || type == SP_RTRACE_PROTO_FUNCTION_ARGS) {
+		if (stream->alloc_last) alloc_append(stream->alloc_last, data, len);
+		return;
+	}
+	stream->alloc_last = NULL;
+
+	if (type == SP_RTRACE_PROTO_RESOURCE_REGISTRY) {
+		unsigned int id, flags = 0;
+		offset += read_dword(data + offset, &id);
+		/* the resource flags were added in protocol version 1.3 */
+		if (stream->hs_buffer[2] > 1 || (stream->hs_buffer[2] == 1 && stream->hs_buffer[3] >= 3)) {
+			read_dword(data + offset, &flags);
+		}
+		if (id < sizeof(stream->refcount_types) * 8 && (flags & SP_RTRACE_RESOURCE_REFCOUNT)) {
+			stream->refcount_types |= 1ULL << id;
+		}
+		return;
+	}
+	if (type != SP_RTRACE_PROTO_FUNCTION_CALL) return;
+
+	listener_alloc_t key;
+	unsigned int ftype, context, timestamp, res_size;
+	char name[256];
+	offset += read_dword(data + offset, &key.res_type);
+	offset += read_dword(data + offset, &context);
+	offset += read_dword(data + offset, &timestamp);
+	offset += read_dword(data + offset, &ftype);
+	int size = read_string(data + offset, name, sizeof(name));
+	if (size < 0) return;
+	offset += size;
+	offset += read_dword(data + offset, &res_size);
+	read_pointer(data + offset, &key.res_id);
+
+	bool refcount = key.res_type < sizeof(stream->refcount_types) * 8 &&
+			(stream->refcount_types & (1ULL << key.res_type));
+	listener_alloc_t** node = (listener_alloc_t**)tfind(&key, &stream->allocs, alloc_compare);
+	if (ftype == SP_RTRACE_FTYPE_ALLOC) {
+		listener_alloc_t* alloc;
+		if (node) {
+			alloc = *node;
+			if (refcount) {
+				alloc->ref_count++;
+				return;
+			}
+			/* the resource was released without the deallocation being
+			 * tracked, replace the stale record */
+			alloc->size = 0;
+		}
+		else {
+			alloc = (listener_alloc_t*)malloc_a(sizeof(listener_alloc_t));
+			alloc->res_type = key.res_type;
+			alloc->res_id = key.res_id;
+			alloc->data = NULL;
+			alloc->size = 0;
+			tsearch(alloc, &stream->allocs, alloc_compare);
+			stream->alloc_count++;
+		}
+		alloc->ref_count = 1;
+		alloc->call = stream->calls;
+		alloc_append(alloc, data, len);
+		stream->alloc_last = alloc;
+	}
+	else if (ftype == SP_RTRACE_FTYPE_FREE && node) {
+		listener_alloc_t* alloc = *node;
+		if (refcount && --alloc->ref_count) return;
+		tdelete(alloc, &stream->allocs, alloc_compare);
+		alloc_free(alloc);
+		stream->alloc_count--;
+	}
+}
+
+/* the live allocation array being filled by store_alloc_node() */
+static listener_alloc_t** alloc_walk_array;
+static unsigned int alloc_walk_size;
+
+/**
+ * Stores live allocation record of the visited tree node into array.
+ */
+static void store_alloc_node(const void* node, VISIT visit, int depth __attribute__((unused)))
+{
+	if (visit == postorder || visit == leaf) {
+		alloc_walk_array[alloc_walk_size++] = *(listener_alloc_t* const*)node;
+	}
+}
+
+/**
+ * Writes the live allocations into a new output file or post-processor
+ * pipe.
+ *
+ * The snapshot is written like a normal trace - the handshake, stored
+ * process state packets and the current memory mappings are followed by
+ * the live allocation packets in the allocation order. The trace output
+ * of the stream is not affected.
+ * @param[in] stream  the data stream.
+ * @return            0 - success, -1 - failure.
+ */
+static int write_snapshot(listener_stream_t* stream)
+{
+	if (!stream->handshake) return 0;
+
+	fprintf(stderr, "INFO: Writing live allocation snapshot of process %d (%u allocations).\n",
+			stream->pid, stream->alloc_count);
+
+	listener_stream_t* snapshot = (listener_stream_t*)malloc_a(sizeof(listener_stream_t));
+	listener_stream_init(snapshot, -1, stream->pid);
+	if (snapshot->output_dir) free(snapshot->output_dir);
+	if (snapshot->postproc) free(snapshot->postproc);
+	snapshot->output_dir = stream->output_dir ? strdup_a(stream->output_dir) : NULL;
+	snapshot->postproc = stream->postproc ? strdup_a(stream->postproc) : NULL;
+	snapshot->handshake = true;
+
+	int rc = -1;
+	if (rtrace_connect_output(snapshot) > 0) {
+		rc = 0;
+		if (write_data(snapshot, stream->hs_buffer, stream->hs_size) < 0 ||
+				(stream->state_size && write_data(snapshot, stream->state, stream->state_size) < 0)) {
+			rc = -1;
+		}
+		snapshot->mmaps = stream->mmaps;
+		write_mmap_packets(snapshot);
+		snapshot->mmaps = NULL;
+
+		alloc_walk_array = (listener_alloc_t**)malloc_a((stream->alloc_count + 1) * sizeof(listener_alloc_t*));
+		alloc_walk_size = 0;
+		twalk(stream->allocs, store_alloc_node);
+		qsort(alloc_walk_array, alloc_walk_size, sizeof(listener_alloc_t*), alloc_compare_call);
+		unsigned int i;
+		for (i = 0; i < alloc_walk_size && rc == 0; i++) {
+			if (write_data(snapshot, alloc_walk_array[i]->data, alloc_walk_array[i]->size) < 0) rc = -1;
+		}
+		free(alloc_walk_array);
+		rtrace_disconnect_output(snapshot, true);
+	}
+	listener_stream_free(snapshot);
+	free(snapshot);
+	return rc;
+}
+
 /**
  * Processes handshake packet.
  *
+ * @param[in] stream the data stream.
  * @param[in] data   the binary data stream.
  * @param[in] size   the size of binary data stream.
  * @return           the number of bytes processed.
  */
-static int process_handshake(const char* data, int size)
+static int process_handshake(listener_stream_t* stream, const char* data, int size)
 {
 	/* read and process the handshake packet */
 	int len = (unsigned char)*(data + 1) + 2;
@@ -214,58 +1013,62 @@ static int process_handshake(const char* data, int size)
 	 */
 	if (len > size) return -1;
 
-	memcpy(hs_buffer, data, len);
-	hs_size = len;
+	memcpy(stream->hs_buffer, data, len);
+	stream->hs_size = len;
+	stream->handshake = true;
 
 	return len;
 }
-#include "common/sp_rtrace_proto.h"
 
 /**
- * Processes generic packet.
+ * Checks if the packet must be inspected by pre-processor.
  *
- * @param[in] data   the binary data stream.
- * @param[in] size   the size of binary data stream.
- * @return           the number of bytes processed.
+ * Other packets are forwarded to the output stream as they are.
+ * @param[in] type   the packet type.
+ * @return           true if the packet must be processed.
  */
-static int process_packet(const char* data, size_t size)
+static bool is_inspected_packet(unsigned int type)
 {
-	unsigned int len, type;
-	unsigned int offset;
-
-	if (size < SP_RTRACE_PROTO_LENGTH_SIZE + SP_RTRACE_PROTO_TYPE_SIZE) {
-		return -1;
-	}
-
-	/* read the type packet */
-	offset = read_dword(data, &type);
-	/* check if the buffer has at least one full packet */
-	offset += read_dword(data + offset, &len);
-	len += offset;
-
-	//LOG("type=%c%c, size=%d", *(char*)&type, *((char*)&type + 1), len - offset);
-
-	if (len > size) {
-		return -1;
-	}
+	return type == SP_RTRACE_PROTO_OUTPUT_SETTINGS || type == SP_RTRACE_PROTO_PROCESS_INFO ||
+			type == SP_RTRACE_PROTO_NEW_LIBRARY || type == SP_RTRACE_PROTO_ATTACHMENT ||
+			type == SP_RTRACE_PROTO_MEMORY_MAP;
+}
 
+/**
+ * Processes packet that must be inspected by pre-processor.
+ *
+ * The packet data is not written to the output stream, but it can be
+ * modified in place.
+ * @param[in] stream the data stream.
+ * @param[in] data   the packet data.
+ * @param[in] type   the packet type.
+ * @param[in] offset the packet payload offset.
+ * @return           1 - the packet must be forwarded to the output stream,
+ *                   0 - the packet must be dropped, -1 - failure.
+ */
+static int process_packet(listener_stream_t* stream, char* data, unsigned int type, unsigned int offset)
+{
 	if (type == SP_RTRACE_PROTO_OUTPUT_SETTINGS) {
 		char value[PATH_MAX];
 		offset += read_string(data + offset, value, PATH_MAX);
 		if (*value) {
-			if (rtrace_options.output_dir) free(rtrace_options.output_dir);
-			rtrace_options.output_dir = strdup_a(value);
+			if (stream->output_dir) free(stream->output_dir);
+			stream->output_dir = strdup_a(value);
 		}
 		offset += read_string(data + offset, value, PATH_MAX);
 		if (*value) {
-			if (rtrace_options.postproc) free(rtrace_options.postproc);
-			rtrace_options.postproc = strdup_a(value);
+			if (stream->postproc) free(stream->postproc);
+			stream->postproc = strdup_a(value);
 		}
 
+		/* the flight recorder output is initialized when the recorder is dumped */
+		if (stream->ring) return 1;
+
 		/* output settings updated, now the output stream can be initialized */
-		rtrace_connect_output();
+		rtrace_connect_output(stream);
+		start_segment(stream);
 		/* write cached handshake packet after output stream has been initialized */
-		if (write_data(hs_buffer, hs_size) < 0) return -1;
+		if (write_data(stream, stream->hs_buffer, stream->hs_size) < 0) return -1;
 	}
 	else if (type == SP_RTRACE_PROTO_PROCESS_INFO) {
 
@@ -275,19 +1078,40 @@ static int process_packet(const char* data, size_t size)
 		if (!secs) {
 			struct timeval tv;
 			gettimeofday(&tv, NULL);
-			write_dword((char*)data + offset + 4, tv.tv_sec);
-			write_dword((char*)data + offset + 8, tv.tv_usec);
+			write_dword(data + offset + 4, tv.tv_sec);
+			write_dword(data + offset + 8, tv.tv_usec);
 		}
 		/* store target process pid. It will be needed to locate maps file */
-		read_dword(data + offset, (unsigned int*)&rtrace_options.pid);
+		read_dword(data + offset, (unsigned int*)&stream->pid);
 	}
 	else if (type == SP_RTRACE_PROTO_NEW_LIBRARY) {
 		/* NL packet is not forwarded further to  post-processor.
 		 * Just scan the maps data */
 		char path[PATH_MAX];
 		read_string(data + offset, path, sizeof(path));
-		scan_mmap_data();
-		return len;
+		if (!strcmp(path, "*")) stream->scans++;
+		scan_mmap_data(stream);
+		return 0;
+	}
+	else if (type == SP_RTRACE_PROTO_MEMORY_MAP) {
+		/* MM packets are reported by the main module for the libraries
+		 * loaded with dlopen(). Store the mapping and forward it unless
+		 * it's already known */
+		pointer_t from, to, bias = 0;
+		unsigned int len;
+		char module[PATH_MAX], build_id[SP_RTRACE_BUILD_ID_SIZE * 2 + 1] = "";
+		read_dword(data + SP_RTRACE_PROTO_TYPE_SIZE, &len);
+		len += offset;
+		offset += read_pointer(data + offset, &from);
+		offset += read_pointer(data + offset, &to);
+		offset += read_string(data + offset, module, sizeof(module));
+		/* the build-id and load bias fields are optional */
+		if (offset < len) {
+			offset += read_string(data + offset, build_id, sizeof(build_id));
+			read_pointer(data + offset, &bias);
+		}
+		/* the flight recorder writes the cached mappings when dumped */
+		return store_mmap(stream, from, to, module, build_id, bias) && !stream->ring;
 	}
 	else if (type == SP_RTRACE_PROTO_ATTACHMENT) {
 		/* check for zero size attachments */
@@ -295,10 +1119,10 @@ static int process_packet(const char* data, size_t size)
 		char* out = path;
 		offset += read_string(data + offset, path, sizeof(path));
 		read_string(data + offset, path, sizeof(path));
-		if (*path != '/' && rtrace_options.output_dir) {
-			out = stpcpy(path, rtrace_options.output_dir);
+		if (*path != '/' && stream->output_dir) {
+			out = stpcpy(path, stream->output_dir);
 			*out++ = '/';
-			read_string(data + offset, out, sizeof(path) - strlen(rtrace_options.output_dir) - 1);
+			read_string(data + offset, out, sizeof(path) - strlen(stream->output_dir) - 1);
 		}
 		struct stat file_stat;
 		if (stat(path, &file_stat) == -1) {
@@ -310,22 +1134,315 @@ static int process_packet(const char* data, size_t size)
 			}
 		}
 	}
-	write_data(data, len);
-	return len;
+	return 1;
+}
+
+/**
+ * Processes the packets in the input buffer.
+ *
+ * The pass-through packets are not copied - runs of consecutive
+ * pass-through packets are written to the output stream directly from
+ * the input buffer. Pass-through packets larger than the buffer are
+ * forwarded with splice() when the input is a pipe (see
+ * listener_stream_read()).
+ * @param[in] stream the data stream.
+ * @param[in] data   the binary data stream.
+ * @param[in] size   the size of binary data stream.
+ * @return           the number of bytes processed.
+ */
+static int process_packets(listener_stream_t* stream, char* data, int size)
+{
+	char* run = data;
+	char* ptr = data;
+	bool rotate = is_rotation_due(stream);
+	bool dump = false;
+
+	while (true) {
+		unsigned int len, type, offset;
+		int avail = size - (ptr - data);
+
+		if (avail < SP_RTRACE_PROTO_LENGTH_SIZE + SP_RTRACE_PROTO_TYPE_SIZE) break;
+
+		/* read the type packet */
+		offset = read_dword(ptr, &type);
+		/* check if the buffer has at least one full packet */
+		offset += read_dword(ptr + offset, &len);
+		len += offset;
+
+		/* rotate output before a packet not depending on the previous packets */
+		if (rotate && type != SP_RTRACE_PROTO_BACKTRACE && type != SP_RTRACE_PROTO_FUNCTION_ARGS) {
+			if (ptr > run) write_data(stream, run, ptr - run);
+			run = ptr;
+			if (rotate_output(stream) < 0) return -1;
+			rotate = false;
+		}
+		if (type == SP_RTRACE_PROTO_FUNCTION_CALL && (int)len <= avail) stream->calls++;
+
+		if (!is_inspected_packet(type)) {
+			if ((int)len > avail) {
+				/* packets fitting the input buffer are processed when completed */
+				if (len <= BUFFER_SIZE) break;
+				/* forward the available part of a large packet and the rest
+				 * will be forwarded by the following reads */
+				ptr += avail;
+				stream->forward_size = len - avail;
+				/* large packets are not stored in the live allocation records */
+				stream->alloc_last = NULL;
+				break;
+			}
+			if (stream->snapshots) track_alloc_packet(stream, ptr, type, offset, len);
+			if (stream->ring) {
+				if (is_state_packet(type)) {
+					/* the flight recorder writes the state packets when dumped */
+					if (ptr > run) write_data(stream, run, ptr - run);
+					store_state_packet(stream, ptr, len);
+					run = ptr + len;
+				}
+				else if (type == SP_RTRACE_PROTO_HEAP_INFO && is_heap_limit_exceeded(ptr + offset)) {
+					dump = true;
+				}
+			}
+			else if ((stream->rotate || stream->snapshots) && is_state_packet(type)) {
+				store_state_packet(stream, ptr, len);
+			}
+			ptr += len;
+			continue;
+		}
+		if ((int)len > avail) break;
+
+		/* write the preceding pass-through packets before processing */
+		if (ptr > run) write_data(stream, run, ptr - run);
+		int rc = process_packet(stream, ptr, type, offset);
+		if (rc < 0) return -1;
+		if ((stream->rotate || stream->ring || stream->snapshots) && is_state_packet(type)) {
+			store_state_packet(stream, ptr, len);
+			if (stream->ring) rc = 0;
+		}
+		/* forwarded packets start a new run */
+		run = rc ? ptr : ptr + len;
+		ptr += len;
+	}
+	if (ptr > run) write_data(stream, run, ptr - run);
+	/* the large packet forwarding bypasses the output buffer */
+	if (stream->forward_size) flush_data(stream);
+	if (dump && dump_recorder(stream, "heap limit exceeded") < 0) return -1;
+	return ptr - data;
 }
 
 /*
  * Public API
  */
 
-int process_data()
+void listener_stream_init(listener_stream_t* stream, int fd, int pid)
 {
-	char buffer[BUFFER_SIZE * 2], *ptr_in = buffer;
-	int n, offset, size;
+	stream->fd_in = fd;
+	stream->fd_out = 0;
+	stream->pid = pid;
+	stream->output_dir = rtrace_options.output_dir ? strdup_a(rtrace_options.output_dir) : NULL;
+	stream->postproc = rtrace_options.postproc ? strdup_a(rtrace_options.postproc) : NULL;
+	stream->pid_postproc = 0;
+	stream->output_file = NULL;
+	stream->handshake = false;
+	stream->hs_size = 0;
+	stream->output_buffer_head = stream->output_buffer;
+	stream->input_size = 0;
+	stream->forward_size = 0;
+	stream->zstream = NULL;
+	stream->nonblocking = false;
+	stream->pending = NULL;
+	stream->pending_size = 0;
+	stream->pending_capacity = 0;
+	stream->fd_out_polled = 0;
+	stream->input_paused = false;
+	stream->output_failed = false;
+	stream->rotate = false;
+	stream->segment = 0;
+	stream->segment_size = 0;
+	stream->segment_first_call = 1;
+	stream->calls = 0;
+	stream->index_fp = NULL;
+	stream->state = NULL;
+	stream->state_size = 0;
+	stream->state_capacity = 0;
+	stream->ring = rtrace_options.recorder_size ? (char*)malloc_a(rtrace_options.recorder_size) : NULL;
+	stream->ring_head = 0;
+	stream->ring_size = 0;
+	stream->ring_partial = 0;
+	stream->ring_left = 0;
+	stream->ring_skip = 0;
+	stream->scans = 0;
+	stream->dumps = rtrace_dump_requests;
+	/* splice() requires pipe at one end of the transfer */
+	struct stat fd_stat;
+	stream->splice = fstat(fd, &fd_stat) == 0 && S_ISFIFO(fd_stat.st_mode);
+	stream->mmaps = NULL;
+	stream->snapshots = rtrace_options.snapshots;
+	stream->allocs = NULL;
+	stream->alloc_count = 0;
+	stream->alloc_last = NULL;
+	stream->refcount_types = 0;
+}
 
-	dlist_init(&s_mmaps);
-	/* read and process the handshake packet */
-	n = read(fd_in, buffer, BUFFER_SIZE - 1);
+int listener_stream_read(listener_stream_t* stream)
+{
+	char* ptr_in = stream->input_buffer;
+	int size;
+
+	if (stream->forward_size && stream->splice && stream->fd_out > 0 && !stream->zstream && !stream->nonblocking) {
+		/* move the large packet data directly from input pipe to the output */
+		ssize_t nbytes = splice(stream->fd_in, NULL, stream->fd_out, NULL, stream->forward_size,
+				SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (nbytes >= 0 || errno != EINVAL) {
+			if (nbytes > 0) stream->forward_size -= nbytes;
+			return nbytes;
+		}
+		/* the output doesn't support splicing, fall back to reading */
+		LOG("splice() not supported, disabling");
+		stream->splice = false;
+	}
+
+	listener_stream_check_dump(stream);
+
+	/* read new data chunk into buffer */
+	int nbytes = read(stream->fd_in, stream->input_buffer + stream->input_size, BUFFER_SIZE);
+	if (nbytes == 0 && stream->ring && stream->scans < 2) {
+		/* the main module requests memory map scan when the trace is
+		 * stopped, so the target process has been terminated abnormally */
+		dump_recorder(stream, "trace was not stopped normally");
+	}
+	if (nbytes <= 0) return nbytes;
+	int n = stream->input_size + nbytes;
+
+	if (stream->forward_size) {
+		/* forward the large packet data through the output buffer */
+		size = (unsigned int)n < stream->forward_size ? n : (int)stream->forward_size;
+		write_data(stream, ptr_in, size);
+		stream->forward_size -= size;
+		ptr_in += size;
+		n -= size;
+	}
+
+	if (!stream->handshake) {
+		/* the first packet must be handshake packet */
+		size = process_handshake(stream, ptr_in, n);
+		if (size <= 0) {
+			msg_error("handshaking packet processing failed\n");
+			errno = EPROTO;
+			return -1;
+		}
+		ptr_in += size;
+		n -= size;
+	}
+	/* read packets from the buffer */
+	size = process_packets(stream, ptr_in, n);
+	if (size < 0) return -1;
+	ptr_in += size;
+	n -= size;
+
+	/* move the incomplete packet to the beginning of buffer */
+	memmove(stream->input_buffer, ptr_in, n);
+	stream->input_size = n;
+
+	/* in live mode the post-processor must receive the data as soon as possible */
+	if (rtrace_options.live && stream->fd_out > 0 && flush_data(stream) < 0) return -1;
+	return nbytes;
+}
+
+void listener_stream_check_dump(listener_stream_t* stream)
+{
+	if (stream->dumps != rtrace_dump_requests) {
+		stream->dumps = rtrace_dump_requests;
+		if (stream->ring) dump_recorder(stream, "dump requested");
+		else if (stream->snapshots) write_snapshot(stream);
+	}
+}
+
+int listener_stream_flush(listener_stream_t* stream)
+{
+	return flush_data(stream);
+}
+
+long listener_stream_write_pending(listener_stream_t* stream)
+{
+	if (!stream->pending_size) return 0;
+	ssize_t nbytes = write(stream->fd_out, stream->pending, stream->pending_size);
+	if (nbytes < 0) {
+		if (errno == EAGAIN || errno == EINTR) return stream->pending_size;
+		msg_error("failed to write to file/post-processor pipe (%s)\n", strerror(errno));
+		stream->pending_size = 0;
+		stream->output_failed = true;
+		return -1;
+	}
+	stream->pending_size -= nbytes;
+	memmove(stream->pending, stream->pending + nbytes, stream->pending_size);
+	return stream->pending_size;
+}
+
+int listener_stream_compress(listener_stream_t* stream)
+{
+	stream->zstream = (listener_zstream_t*)malloc_a(sizeof(listener_zstream_t));
+	memset(&stream->zstream->zs, 0, sizeof(z_stream));
+	if (deflateInit2(&stream->zstream->zs, COMPRESSION_LEVEL, Z_DEFLATED, COMPRESSION_GZIP + MAX_WBITS,
+			MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+		msg_error("failed to initialize output compression\n");
+		free(stream->zstream);
+		stream->zstream = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int listener_stream_finish(listener_stream_t* stream)
+{
+	int rc = flush_data(stream) < 0 ? -1 : 0;
+	if (stream->zstream) {
+		if (stream->fd_out > 0 && !stream->output_failed && write_compressed(stream, NULL, 0, Z_FINISH) < 0) {
+			msg_error("failed to write to file (%s)\n", strerror(errno));
+			rc = -1;
+		}
+		deflateEnd(&stream->zstream->zs);
+		free(stream->zstream);
+		stream->zstream = NULL;
+	}
+	if (stream->fd_out > 0 && drain_pending(stream) < 0) rc = -1;
+	if (stream->index_fp) write_segment_index(stream);
+	return rc;
+}
+
+void listener_stream_free(listener_stream_t* stream)
+{
+	if (stream->zstream) {
+		deflateEnd(&stream->zstream->zs);
+		free(stream->zstream);
+		stream->zstream = NULL;
+	}
+	tdestroy(stream->mmaps, (void (*)(void*))rd_mmap_free);
+	stream->mmaps = NULL;
+	tdestroy(stream->allocs, alloc_free);
+	stream->allocs = NULL;
+	stream->alloc_count = 0;
+	stream->alloc_last = NULL;
+	if (stream->output_dir) free(stream->output_dir);
+	if (stream->postproc) free(stream->postproc);
+	if (stream->output_file) free(stream->output_file);
+	if (stream->state) free(stream->state);
+	if (stream->ring) free(stream->ring);
+	if (stream->pending) free(stream->pending);
+	if (stream->index_fp) fclose(stream->index_fp);
+	stream->state = NULL;
+	stream->ring = NULL;
+	stream->pending = NULL;
+	stream->pending_size = 0;
+	stream->pending_capacity = 0;
+	stream->index_fp = NULL;
+	stream->output_dir = NULL;
+	stream->postproc = NULL;
+	stream->output_file = NULL;
+}
+
+int process_data(listener_stream_t* stream)
+{
+	int n = listener_stream_read(stream);
 	if (n == 0) {
 		/* Pipe was closed before any data was written. That normally can
 		 * happen only when toggle signal was sent to a process started
@@ -335,50 +1452,31 @@ int process_data()
 		return 0;
 	}
 	if (n < 0) {
-	    msg_error("failed to read data from pipe\n");
-	    return -1;
-	}
-	offset = process_handshake(ptr_in, n);
-	if (offset <= 0) {
-		msg_error("handshaking packet processing failed\n");
+		if (errno != EPROTO) msg_error("failed to read data from pipe\n");
 		return -1;
 	}
-	n -= offset;
-	ptr_in += offset;
 
 	/* main packet reading/processing loop */
 	while (true) {
-		/* read packets from the buffer */
-		while (true) {
-			size = process_packet(ptr_in, n);
-			if (size <= 0) break;
-			ptr_in += size;
-			n -= size;
-		}
-
-		/* move the incomplete packet to the beginning of buffer */
-		memmove(buffer, ptr_in, n);
-		/* read new data chunk into buffer */
-		int nbytes = read(fd_in, buffer + n, BUFFER_SIZE);
-		if (nbytes == 0) {
+		/* the target process pid is needed to forward SIGINT */
+		if (stream->pid) rtrace_options.pid = stream->pid;
+
+		n = listener_stream_read(stream);
+		if (n == 0) {
 			break;
 		}
 		if (rtrace_stop_requests >= REQUEST_STOP) {
 			msg_warning("trace was forced to abort before all of data was retrieved.\n");
 			break;
 		}
-		if (nbytes == -1) {
+		if (n == -1) {
 			if (errno == EINTR) {
 				continue;
 			} else {
 				break;
 			}
 		}
-		n += nbytes;
-		ptr_in = buffer;
 	}
-	flush_data();
-	dlist_free(&s_mmaps, (op_unary_t)rd_mmap_free);
+	flush_data(stream);
 	return 0;
 }
-
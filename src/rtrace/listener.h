@@ -24,18 +24,219 @@
 #ifndef LISTENER_H
 #define LISTENER_H
 
-/* the output stream descriptor (pipe to post-processor or file) */
-extern int fd_in;
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "common/dlist.h"
+
+/* the read buffer size */
+#define BUFFER_SIZE			4096
 
 /* the input stream descriptor (standard input or named pipe) */
-extern int fd_out;
+extern int fd_in;
+
+/**
+ * The pre-processor data stream.
+ *
+ * Contains the processing state of a single traced process data
+ * stream - the input and output descriptors, buffers and the
+ * output settings received from the main tracing module.
+ * In daemon mode a stream is created for every connection.
+ */
+typedef struct listener_stream_t {
+	/* dlist support, used by daemon mode connection list */
+	dlist_node_t node;
+	/* the input descriptor */
+	int fd_in;
+	/* the output descriptor (pipe to post-processor or file) */
+	int fd_out;
+	/* the target process identifier */
+	int pid;
+	/* the directory for output files */
+	char* output_dir;
+	/* the post-processor options */
+	char* postproc;
+	/* the post-processor pid */
+	int pid_postproc;
+	/* the output file name */
+	char* output_file;
+	/* true if the handshake packet has been received */
+	bool handshake;
+
+	/* the handshake packet buffer */
+	char hs_buffer[256];
+	int hs_size;
+
+	/* the output buffer */
+	char output_buffer[BUFFER_SIZE * 2];
+	char* output_buffer_head;
+
+	/* the input buffer, containing incomplete packet data */
+	char input_buffer[BUFFER_SIZE * 2];
+	int input_size;
+
+	/* the remaining size of large pass-through packet being forwarded */
+	unsigned int forward_size;
+	/* true if the input is pipe and the forwarded data can be spliced */
+	bool splice;
+	/* the compressed output state, NULL if the output is not compressed */
+	struct listener_zstream_t* zstream;
+
+	/* true if the output pipe is non-blocking. The data the pipe can't accept
+	 * is kept in the pending output buffer until the pipe becomes writable */
+	bool nonblocking;
+	/* the pending output buffer */
+	char* pending;
+	size_t pending_size;
+	size_t pending_capacity;
+	/* daemon mode event loop state - the output descriptor polled for
+	 * writing (0 if none) and true if the input reading is paused */
+	int fd_out_polled;
+	bool input_paused;
+	/* true if writing into the output has failed. The buffered output data
+	 * is discarded and in daemon mode the connection is closed */
+	bool output_failed;
+
+	/* true if the output is rotated when the segment limits are reached */
+	bool rotate;
+	/* the current output segment number */
+	unsigned int segment;
+	/* the number of bytes written into the current segment */
+	unsigned long long segment_size;
+	/* the current segment start time */
+	struct timeval segment_start;
+	/* the index of the first function call in the current segment */
+	unsigned long segment_first_call;
+	/* the number of function calls received */
+	unsigned long calls;
+	/* the segment index file */
+	FILE* index_fp;
+	/* the process state packets, repeated at the beginning of every segment */
+	char* state;
+	int state_size;
+	int state_capacity;
+
+	/* the flight recorder ring buffer, NULL if the flight recorder is disabled */
+	char* ring;
+	/* the offset of the oldest packet in the ring buffer */
+	size_t ring_head;
+	/* the number of bytes stored in the ring buffer */
+	size_t ring_size;
+	/* the number of bytes of the newest packet already stored in and
+	 * still expected to be stored in the ring buffer - large packets are
+	 * received in several chunks */
+	size_t ring_partial;
+	size_t ring_left;
+	/* the number of bytes left of a packet discarded from the ring buffer */
+	size_t ring_skip;
+	/* the number of full memory map scan requests (new library packets
+	 * with "*" name). The main module requests the scan when the trace
+	 * is started and when it's stopped normally */
+	int scans;
+	/* the number of processed flight recorder dump requests */
+	int dumps;
+
+	/* the memory mapping record cache, tsearch() tree ordered by address ranges */
+	void* mmaps;
+
+	/* true if the live allocations are tracked for snapshots */
+	bool snapshots;
+	/* the live allocation records, tsearch() tree ordered by resource type and id */
+	void* allocs;
+	/* the number of live allocation records */
+	unsigned int alloc_count;
+	/* the last allocation record, receiving the following backtrace and
+	 * function argument packets */
+	struct listener_alloc_t* alloc_last;
+	/* the reference counted resource types (bit per resource type id) */
+	unsigned long long refcount_types;
+} listener_stream_t;
+
+/**
+ * Initializes data stream.
+ *
+ * The output settings are initialized from the pre-processor
+ * options and can be overridden by the output settings packet.
+ * @param[in] stream   the stream to initialize.
+ * @param[in] fd       the input descriptor.
+ * @param[in] pid      the target process identifier (0 if unknown).
+ */
+void listener_stream_init(listener_stream_t* stream, int fd, int pid);
+
+/**
+ * Reads the available data from the stream input and processes
+ * the complete packets.
+ *
+ * This function performs a single read operation, so it can be
+ * used with descriptors reported by select/poll/epoll.
+ * @param[in] stream   the stream.
+ * @return             the number of bytes read, 0 - end of stream,
+ *                     -1 - failure (errno is preserved for read failures).
+ */
+int listener_stream_read(listener_stream_t* stream);
+
+/**
+ * Writes the buffered stream data into the output.
+ *
+ * @param[in] stream   the stream.
+ * @return             the number of bytes written, -1 - failure.
+ */
+int listener_stream_flush(listener_stream_t* stream);
+
+/**
+ * Writes the pending output data into non-blocking output.
+ *
+ * @param[in] stream   the stream.
+ * @return             the number of bytes left pending, -1 - failure
+ *                     (the pending data is discarded).
+ */
+long listener_stream_write_pending(listener_stream_t* stream);
+
+/**
+ * Enables compression of the stream output.
+ *
+ * The output is written as gzip format stream, compressed
+ * block-wise as the data is flushed.
+ * @param[in] stream   the stream.
+ * @return             0 - success, -1 - failure.
+ */
+int listener_stream_compress(listener_stream_t* stream);
+
+/**
+ * Writes all buffered and pending stream data into output, completing
+ * the compressed output stream.
+ *
+ * The pending data of non-blocking output is written in blocking mode.
+ * Must be called before the output descriptor is closed.
+ * @param[in] stream   the stream.
+ * @return             0 - success, -1 - failure.
+ */
+int listener_stream_finish(listener_stream_t* stream);
+
+/**
+ * Releases the resources allocated by the stream.
+ *
+ * The output connection must be closed before.
+ * @param[in] stream   the stream.
+ */
+void listener_stream_free(listener_stream_t* stream);
+
+/**
+ * Writes the flight recorder contents or the live allocation snapshot
+ * into output if a dump has been requested with rtrace_dump_requests.
+ *
+ * @param[in] stream   the stream.
+ */
+void listener_stream_check_dump(listener_stream_t* stream);
 
 /**
  * Processes data read from the input stream.
  *
+ * @param[in] stream   the stream.
  * @return 0 - success
  */
-int process_data(void);
+int process_data(listener_stream_t* stream);
 
 
 #endif /* LISTENER_H */
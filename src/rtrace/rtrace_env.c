@@ -51,6 +51,12 @@ struct option rtrace_long_opt[] = {
 		 {"backtrace-all", 0, 0, 'A'},
 		 {"libunwind", 0, 0, 'u'},
 		 {"monitor", 1, 0, 'M'},
+		 {"daemon", 1, 0, 'D'},
+		 {"compress", 0, 0, 'z'},
+		 {"rotate", 1, 0, 'R'},
+		 {"flight-recorder", 1, 0, 'F'},
+		 {"live", 1, 0, 'w'},
+		 {"snapshots", 0, 0, 'N'},
 		 {"quiet", 0, 0, 'q'},
 		 {0, 0, 0, 0}
 };
@@ -157,6 +163,42 @@ const char *rtrace_env_opt[] = {
 		 * --monitor
 		 */
 		"SP_RTRACE_MONITOR_SIZE",
+		/**
+		 * --daemon
+		 * Specifies the sp-rtrace daemon socket. In managed mode the main
+		 * tracing module connects to the daemon instead of spawning its
+		 * own pre-processor process.
+		 */
+		"SP_RTRACE_DAEMON",
+		/**
+		 * --compress
+		 * Enables compression of the binary log files.
+		 */
+		"SP_RTRACE_COMPRESS",
+		/**
+		 * --rotate
+		 * Specifies the binary log file rotation limits.
+		 */
+		"SP_RTRACE_ROTATE",
+		/**
+		 * --flight-recorder
+		 * Specifies the flight recorder buffer size and optional heap size
+		 * limit. The trace data is kept in memory and written only when
+		 * the flight recorder is dumped.
+		 */
+		"SP_RTRACE_FLIGHT_RECORDER",
+		/**
+		 * --live
+		 * Specifies the post-processor live report interval in seconds.
+		 * The trace data is forwarded to the post-processor without delay.
+		 */
+		"SP_RTRACE_LIVE",
+		/**
+		 * --snapshots
+		 * Enables live allocation tracking, the snapshots are
+		 * requested with SIGUSR2.
+		 */
+		"SP_RTRACE_SNAPSHOTS",
 		/**
 		 * Trailing NULL
 		 */
@@ -164,36 +206,32 @@ const char *rtrace_env_opt[] = {
 };
 
 /* sp_rtrace short option list */
-const char* rtrace_short_opt = "+i:o:me:st:fb:TAP:S:Bhx:lL::FuM:q";
+const char* rtrace_short_opt = "+i:o:me:st:fb:TAP:S:Bhx:lL::F:uM:qD:zR:w:N";
 
-void rtrace_args_add_opt(rtrace_args_t* args, char opt, const char* value)
+void rtrace_args_add_opt(rtrace_args_t* args, char opt, char* value)
 {
 	args->argv[args->index++] = args->head;
 	*args->head++ = '-';
 	*args->head++ = opt;
-	if (value) {
-		int len = strlen(value);
-		memcpy(args->head, value, len);
-		args->head += len;
-	}
 	*args->head++ = '\0';
+	/* the value of an option with required argument can be passed as the
+	 * next argument, so it's referenced instead of copied */
+	if (value) args->argv[args->index++] = value;
 }
 
 int rtrace_args_scan_env(rtrace_args_t* args, const char* app)
 {
 	/* initialize args structure and store the first argument - process name */
-	args->head = args->args;
-	args->argv[0] = args->args;
+	args->head = args->opts;
+	args->argv[0] = args->head;
 	args->index = 1;
-	int len = strlen(app) + 1;
-	memcpy(args->head, app, len);
-	args->head += len;
+	args->head = stpncpy(args->head, app, PATH_MAX - 1) + 1;
 
 	/* process option list */
 	int i;
 	for (i = 0; i < MAX_OPT; i++) {
 		if (!rtrace_env_opt[i]) continue;
-		const char* env = getenv(rtrace_env_opt[i]);
+		char* env = getenv(rtrace_env_opt[i]);
 		if (env) {
 			struct option* opt = &rtrace_long_opt[i];
 			rtrace_args_add_opt(args, opt->val, opt->has_arg ? env : NULL);
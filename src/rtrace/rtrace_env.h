@@ -39,6 +39,7 @@
 
 #include <getopt.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #define OPT_ENABLE    "1"
 
@@ -51,6 +52,21 @@
 /* whether to get heap usage info (with mallinfo) */
 #define SP_RTRACE_MALLINFO    "SP_RTRACE_MALLINFO"
 
+/* whether gobject/qobject modules should report only per-class live object
+ * statistics, the value is the statistics snapshot interval in seconds */
+#define SP_RTRACE_OBJECT_SUMMARY    "SP_RTRACE_OBJECT_SUMMARY"
+
+/* whether shmsysv/shmposix modules should sample residency of the shared
+ * memory mappings, the value is the sampling interval in seconds */
+#define SP_RTRACE_SHM_SAMPLE    "SP_RTRACE_SHM_SAMPLE"
+
+/* the runtime control file, listing modules and resource types to
+ * (de)activate when the control signal is received */
+#define SP_RTRACE_CONTROL    "SP_RTRACE_CONTROL"
+
+/* the runtime control signal number (SIGUSR2 by default) */
+#define SP_RTRACE_CONTROL_SIGNAL    "SP_RTRACE_CONTROL_SIGNAL"
+
 /**
  * pre-processor(sp-rtrace) option index.
  */
@@ -74,6 +90,12 @@ enum {
 	OPT_BACKTRACE_ALL,
 	OPT_LIBUNWIND,
 	OPT_MONITOR_SIZE,
+	OPT_DAEMON,
+	OPT_COMPRESS,
+	OPT_ROTATE,
+	OPT_FLIGHT_RECORDER,
+	OPT_LIVE,
+	OPT_SNAPSHOTS,
 	MAX_OPT                      //!< MAX_OPT
 };
 
@@ -92,19 +114,24 @@ extern const char *rtrace_env_opt[];
  */
 extern const char *rtrace_short_opt;
 
-/* The maximum total size of all command line arguments */
-#define RTRACE_MAX_ARGS_SIZE        4096
+/* The maximum number of options in argument list (all pre-processor
+ * options and an extra option added by the caller) */
+#define RTRACE_MAX_ARGS_OPT         (MAX_OPT + 1)
 
 /**
  * Command line argument structure, used for execv function calls.
  *
+ * The argument list is assembled without memory allocations, so it can
+ * be used in a forked child of the traced process. The option values are
+ * passed as separate arguments referencing the original strings, so the
+ * option value length is not limited.
  */
 typedef struct rtrace_args_t {
-	/* the command line arguments separated with NUL character */
-	char args[RTRACE_MAX_ARGS_SIZE];
-	/* references of the command line arguments in args array */
-	char* argv[MAX_OPT + 1];
-	/* reference to the first free character in the args array */
+	/* the application name and option switches (-<opt>) separated with NUL character */
+	char opts[PATH_MAX + RTRACE_MAX_ARGS_OPT * 3];
+	/* the command line arguments - application name, option switches and values */
+	char* argv[RTRACE_MAX_ARGS_OPT * 2 + 2];
+	/* reference to the first free character in the opts array */
 	char* head;
 	/* number of arguments stored */
 	int index;
@@ -113,6 +140,9 @@ typedef struct rtrace_args_t {
 /**
  * Converts rtrace environment options to the pre-processor
  * command line arguments.
+ *
+ * The option values reference the environment variables, so the
+ * environment must not be changed before the argument list is used.
  * @param[in] args   the assembled argument list.
  * @param[in] app     the application name (must be the first argument).
  */
@@ -123,10 +153,12 @@ int rtrace_args_scan_env(rtrace_args_t* args, const char* app);
  *
  * @param[in] args    the argument list.
  * @param[in] opt     the option to append.
- * @param[in] value   the option value (can be NULL).
+ * @param[in] value   the value of option with required argument (can be
+ *                    NULL). The value is not copied and must stay valid
+ *                    while the list is used.
  * @return            0 - success.
  */
-void rtrace_args_add_opt(rtrace_args_t* args, char opt, const char* value);
+void rtrace_args_add_opt(rtrace_args_t* args, char opt, char* value);
 
 /**
  * Finishes argument list by appending trailing NULL.
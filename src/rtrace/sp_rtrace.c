@@ -28,6 +28,9 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <errno.h>
@@ -68,12 +71,16 @@
 /* Application exit condition, set by SIGINT */
 sig_atomic_t rtrace_stop_requests = 0;
 
+/* Flight recorder dump and snapshot requests, set by SIGUSR2 */
+sig_atomic_t rtrace_dump_requests = 0;
+
 /* rrace working mode, set by command options */
 enum {
 	MODE_UNDEFINED,
 	MODE_EXECUTE,  /* start new process tracing */
 	MODE_TOGGLE,   /* toggle tracing for existing process */
 	MODE_LISTEN,   /* listen for data from main module */
+	MODE_DAEMON,   /* serve multiple traced processes over socket */
 };
 
 
@@ -93,8 +100,16 @@ rtrace_options_t rtrace_options = {
 		.disable_packet_buffering = false,
 		.pid = 0,
 		.mode = MODE_UNDEFINED,
-		.pid_postproc = 0,
-		.output_file = NULL,
+		.daemon_socket = NULL,
+		.compress = false,
+		.rotate = NULL,
+		.rotate_size = 0,
+		.rotate_time = 0,
+		.recorder = NULL,
+		.recorder_size = 0,
+		.recorder_heap = 0,
+		.live = NULL,
+		.snapshots = false,
 		.libunwind = false,
 		.backtrace_all = false,
 		.monitor_size = NULL,
@@ -105,8 +120,9 @@ rtrace_options_t rtrace_options = {
  */
 static void display_usage(void)
 {
-	printf("\nsp-rtrace pre-processor can be used in two modes - to start a new process\n"
-	       "or to toggle tracing (enable/disable) for an already running process.\n"
+	printf("\nsp-rtrace pre-processor can be used in three modes - to start a new process,\n"
+	       "to toggle tracing (enable/disable) for an already running process or to\n"
+	       "pre-process data of multiple managed mode processes as a daemon.\n"
 	       "\n"
 	       "1. Application tracing usage:\n"
 	       "    sp-rtrace [<options>] -x <application> [<arg1> [<arg2>...]]]\n"
@@ -130,6 +146,26 @@ static void display_usage(void)
 	       "                    for stack trace unwinding\n"
 	       "  -M S1[,S2...]   - report backtraces only for allocations of specified\n"
 	       "                    size(s) S1, S2...\n"
+	       "  -z              - compress the binary log file (gzip format)\n"
+	       "  -R <limits>     - rotate the binary log file when any of the comma\n"
+	       "                    separated limits is reached - <size>[K|M|G] or\n"
+	       "                    <time>(s|m|h). The size is in megabytes by default\n"
+	       "  -F <size>[,<heap>] - keep the last <size>[K|M|G] bytes of trace data in\n"
+	       "                    memory (flight recorder) and write it only when\n"
+	       "                    SIGUSR2 is sent to the pre-processor, the target\n"
+	       "                    process terminates abnormally or the heap size\n"
+	       "                    exceeds <heap>[K|M|G]. The sizes are in megabytes\n"
+	       "                    by default\n"
+	       "  -w <seconds>    - live mode. The trace data is forwarded to the\n"
+	       "                    post-processor without delay and the post-processor\n"
+	       "                    writes a live report (largest live allocations,\n"
+	       "                    allocation rate) every <seconds>. Implies -P\n"
+	       "  -N              - track the live allocations and write them into\n"
+	       "                    a new output file (or post-processor) whenever\n"
+	       "                    SIGUSR2 is sent to the pre-processor, without\n"
+	       "                    stopping the trace\n"
+	       "  -D <socket>     - in managed mode send the trace data to the sp-rtrace\n"
+	       "                    daemon listening on <socket>\n"
 	       "  Note that options must be given before the execute (-x) switch!\n"
 	       "\n"
 	       "2. Tracing toggle usage:\n"
@@ -139,7 +175,15 @@ static void display_usage(void)
 	       "  -f              - send the toggle signal to all subprocesses recursively\n"
 	       "  -t <pid>        - pid of the process to toggle tracing for\n"
 	       "\n"
-	       "3. Common options:\n"
+	       "3. Daemon usage:\n"
+	       "    sp-rtrace [-o <outputdir>] [-P <options>] [-z] [-R <limits>] [-F <size>] [-N] -D <socket>\n"
+	       "  Accept trace data connections from managed mode processes on UNIX\n"
+	       "  socket <socket>. Every connection is written to its own output file\n"
+	       "  or post-processor. The post-processor output is buffered, so a slow\n"
+	       "  post-processor doesn't stall the other connections. Stop the daemon\n"
+	       "  with Ctrl+C.\n"
+	       "\n"
+	       "4. Common options:\n"
 	       "  -S <signal>     - tracing toggle signal\n"
 	       "  -h              - this help page\n"
 	       "  -l              - lists available tracing modules\n"
@@ -156,6 +200,9 @@ static void display_usage(void)
 	       "  and merge backtraces, see sp-rtrace-postproc manual) and store\n"
 	       "  the resulting (ASCII) trace file to the current directory:\n"
 	       "    sp-rtrace -s -e memory -P '-l -c' -o $(pwd) -x sample\n\n"
+	       "  Start sp-rtrace daemon and trace 'sample' processes with it:\n"
+	       "    sp-rtrace -D /tmp/rtrace.sock &\n"
+	       "    sp-rtrace -D /tmp/rtrace.sock -m -s -e memory -x sample\n\n"
 	       "  Toggle tracing for an already running 'sample' process:\n"
 	       "    sp-rtrace -t $(pidof sample)\n\n"
 	       "  Lists all available tracing modules:\n"
@@ -190,6 +237,15 @@ static void sigchld_handler(int sig __attribute((unused)))
 }
 #endif
 
+/**
+ * Requests flight recorder dump or live allocation snapshot.
+ * @param sig
+ */
+static void sigdump_handler(int sig __attribute((unused)))
+{
+	rtrace_dump_requests++;
+}
+
 /**
  * Updates environment variables according to the specified command line arguments.
  *
@@ -210,6 +266,12 @@ static void set_environment(void)
 	if (rtrace_options.backtrace_all) setenv(rtrace_env_opt[OPT_BACKTRACE_ALL], OPT_ENABLE, 1);
 	if (rtrace_options.libunwind) setenv(rtrace_env_opt[OPT_LIBUNWIND], OPT_ENABLE, 1);
 	if (rtrace_options.monitor_size) setenv(rtrace_env_opt[OPT_MONITOR_SIZE], rtrace_options.monitor_size, 1);
+	if (rtrace_options.daemon_socket) setenv(rtrace_env_opt[OPT_DAEMON], rtrace_options.daemon_socket, 1);
+	if (rtrace_options.compress) setenv(rtrace_env_opt[OPT_COMPRESS], OPT_ENABLE, 1);
+	if (rtrace_options.rotate) setenv(rtrace_env_opt[OPT_ROTATE], rtrace_options.rotate, 1);
+	if (rtrace_options.recorder) setenv(rtrace_env_opt[OPT_FLIGHT_RECORDER], rtrace_options.recorder, 1);
+	if (rtrace_options.live) setenv(rtrace_env_opt[OPT_LIVE], rtrace_options.live, 1);
+	if (rtrace_options.snapshots) setenv(rtrace_env_opt[OPT_SNAPSHOTS], OPT_ENABLE, 1);
 	if (getcwd(path, sizeof(path))) {
 		setenv(SP_RTRACE_START_DIR, path, 1);
 		/* force current directory for output files if no output directory is specified */
@@ -262,58 +324,115 @@ static void free_options(void)
 	if (rtrace_options.backtrace_depth) free(rtrace_options.backtrace_depth);
 	if (rtrace_options.postproc) free(rtrace_options.postproc);
 	if (rtrace_options.toggle_signal_name) free(rtrace_options.toggle_signal_name);
-	if (rtrace_options.output_file) free(rtrace_options.output_file);
+	if (rtrace_options.daemon_socket) free(rtrace_options.daemon_socket);
+	if (rtrace_options.rotate) free(rtrace_options.rotate);
+	if (rtrace_options.recorder) free(rtrace_options.recorder);
+	if (rtrace_options.live) free(rtrace_options.live);
 	if (rtrace_options.monitor_size) free(rtrace_options.monitor_size);
 }
 
+/**
+ * Creates option argument (--<name>=<value>).
+ *
+ * @param[in] name   the option name.
+ * @param[in] value  the option value.
+ * @return           the allocated argument.
+ */
+static char* create_option_arg(const char* name, const char* value)
+{
+	char* arg = (char*)malloc_a(strlen(name) + strlen(value) + 4);
+	sprintf(arg, "--%s=%s", name, value);
+	return arg;
+}
+
+/**
+ * Creates post-processor argument list.
+ *
+ * The post-processor options are split at whitespace. Single and double
+ * quotes can be used to pass arguments containing whitespace and
+ * backslash escapes the following character (except inside single
+ * quotes). The options string is modified in place.
+ * @param[in] stream  the data stream.
+ * @return            the NULL terminated argument list.
+ */
+static char** create_postproc_args(listener_stream_t* stream)
+{
+	static char postproc_path[] = SP_RTRACE_POSTPROC;
+	char* in = stream->postproc;
+	/* the post-processor name, --output-dir, --live options, the arguments
+	 * (at most one per two characters) and the trailing NULL */
+	char** argv = (char**)malloc_a((strlen(in) / 2 + 5) * sizeof(char*));
+	int argc = 0;
+
+	argv[argc++] = postproc_path;
+	/* forward --output-dir option to post-processor */
+	if (stream->output_dir) argv[argc++] = create_option_arg("output-dir", stream->output_dir);
+	/* enable post-processor live mode */
+	if (rtrace_options.live) argv[argc++] = create_option_arg("live", rtrace_options.live);
+
+	/* break argument string into separate arguments */
+	while (true) {
+		while (*in == ' ' || *in == '\t') in++;
+		if (!*in) break;
+		char* out = argv[argc++] = in;
+		char quote = '\0';
+		while (*in && (quote || (*in != ' ' && *in != '\t'))) {
+			if (quote) {
+				if (*in == quote) {
+					quote = '\0';
+					in++;
+					continue;
+				}
+				if (quote == '"' && *in == '\\' && (in[1] == '"' || in[1] == '\\')) in++;
+			}
+			else if (*in == '\'' || *in == '"') {
+				quote = *in++;
+				continue;
+			}
+			else if (*in == '\\' && in[1]) in++;
+			*out++ = *in++;
+		}
+		if (quote) msg_warning("unterminated quote in post-processor options: %s\n", argv[argc - 1]);
+		/* the argument is never longer than its source text */
+		char* next = *in ? in + 1 : in;
+		*out = '\0';
+		in = next;
+	}
+	argv[argc] = NULL;
+	return argv;
+}
+
 /**
  * Opens pipe to post-processor.
  *
  * This function starts the post-processor and returns
  * the opened pipe to it.
- * @return  the pipe descriptor.
+ * @param[in] stream  the data stream.
+ * @return  the pipe descriptor or -1 on failure.
  */
-static int open_postproc_pipe(void)
+static int open_postproc_pipe(listener_stream_t* stream)
 {
 	int fd[2];
-	if (pipe(fd) == -1) {
-		msg_error("failed to create pipe for post-processor\n");
-		exit (-1);
+	/* the descriptors must not leak into post-processors of other streams
+	 * in daemon mode, otherwise they would never receive end of input */
+	if (pipe2(fd, O_CLOEXEC) == -1) {
+		msg_error("failed to create pipe for post-processor (%s)\n", strerror(errno));
+		return -1;
 	}
-	rtrace_options.pid_postproc = fork();
-	if (rtrace_options.pid_postproc == -1) {
-		msg_error("failed to fork post-processor process\n");
-		exit (-1);
+	stream->pid_postproc = fork();
+	if (stream->pid_postproc == -1) {
+		msg_error("failed to fork post-processor process (%s)\n", strerror(errno));
+		stream->pid_postproc = 0;
+		close(fd[0]);
+		close(fd[1]);
+		return -1;
 	}
-	if (rtrace_options.pid_postproc == 0) {
+	if (stream->pid_postproc == 0) {
 		close(fd[1]);
 		dup2(fd[0], STDIN_FILENO);
 
 		/* create post-process argument list */
-		char* argv[32];
-		char argv0[] = SP_RTRACE_POSTPROC;
-		char* ptr = rtrace_options.postproc;
-		int argc = 0;
-		char output_dir[512];
-		
-		argv[argc++] = argv0;
-		/* forward --output-dir option to post-processor */
-		if (rtrace_options.output_dir) {
-			snprintf(output_dir, sizeof(output_dir), "--output-dir=%s", rtrace_options.output_dir);
-			argv[argc++] = output_dir;
-		}
-		/* break argument string into separate arguments */
-		if (*ptr) {
-			while (argc < (int)sizeof(argv) / (int)sizeof(argv[0]) - 1) {
-				argv[argc++] = ptr;
-				ptr = strchr(ptr, ' ');
-				if (!ptr) break;
-				*ptr++ = '\0';
-				while (*ptr == ' ') ptr++;
-			}
-		}
-		argv[argc] = NULL;
-
+		char** argv = create_postproc_args(stream);
 		setpgrp();
 		execv(SP_RTRACE_POSTPROC, argv);
 		msg_error("failed to execute post-processor process %s (%s)\n",
@@ -327,28 +446,30 @@ static int open_postproc_pipe(void)
 /**
  * Create and open new log file.
  *
+ * @param[in] stream  the data stream.
  * @return   the log file descriptor.
  */
-static int open_output_file(void)
+static int open_output_file(listener_stream_t* stream)
 {
 	char path[PATH_MAX];
 	const char* default_dir = ".";
 	const char* dir;
 
-	dir = rtrace_options.output_dir;
+	dir = stream->output_dir;
 	/* if (dir == NULL) dir = getenv("HOME"); */
 	if (dir == NULL || !strcmp(dir, "stdout")) dir = default_dir;
 
-	if (get_log_filename(rtrace_options.pid, dir, SP_RTRACE_BINARY_FILE_PATTERN, path, sizeof(path)) != 0) {
+	if (get_log_filename(stream->pid, dir, rtrace_options.compress ? SP_RTRACE_COMPRESSED_FILE_PATTERN :
+			SP_RTRACE_BINARY_FILE_PATTERN, path, sizeof(path)) != 0) {
 		msg_error("failed to make new log file name for directory %s\n", dir);
 		return -1;
 	}
-	int fd =  open(path, O_CREAT | O_WRONLY | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	int fd =  open(path, O_CREAT | O_WRONLY | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 	if (fd == -1) {
 		msg_error("failed to create log file %s (%s)\n", path, strerror(errno));
 		return -1;
 	}
-	rtrace_options.output_file = strdup_a(path);
+	stream->output_file = strdup_a(path);
 	return fd;
 }
 
@@ -369,37 +490,42 @@ static void create_preproc_pipe(char* pipe_path, size_t size)
 	}
 }
 
-int rtrace_connect_output(void)
+int rtrace_connect_output(listener_stream_t* stream)
 {
-	if (rtrace_options.postproc) {
+	if (stream->postproc) {
 		/* post-processor options detected. Spawn sp-rtrace-postproc process
 		 * for the sp-rtrace.
 		 */
-		fd_out = open_postproc_pipe();
+		stream->fd_out = open_postproc_pipe(stream);
+		if (stream->fd_out > 0 && stream->nonblocking) {
+			int flags = fcntl(stream->fd_out, F_GETFL);
+			if (flags != -1) fcntl(stream->fd_out, F_SETFL, flags | O_NONBLOCK);
+		}
 	}
 	else {
 		/* Create and open binary log file */
-		fd_out = open_output_file();
+		stream->fd_out = open_output_file(stream);
+		if (stream->fd_out > 0 && rtrace_options.compress) {
+			listener_stream_compress(stream);
+		}
 	}
-	return fd_out;
+	stream->output_failed = stream->fd_out <= 0;
+	return stream->fd_out;
 }
 
-/**
- * Disconnects the output data connection.
- *
- * @return
- */
-static void disconnect_output(void)
+void rtrace_disconnect_output(listener_stream_t* stream, bool wait_postproc)
 {
-	if (fd_out) {
-		close (fd_out);
-		if (rtrace_options.pid_postproc) {
+	if (stream->fd_out > 0) {
+		listener_stream_finish(stream);
+		close (stream->fd_out);
+		if (stream->pid_postproc) {
 			int status;
-			waitpid(rtrace_options.pid_postproc, &status, 0);
+			if (wait_postproc) waitpid(stream->pid_postproc, &status, 0);
 		}
 		else {
-			printf("INFO: Created binary log file %s\n", rtrace_options.output_file);
+			printf("INFO: Created binary log file %s\n", stream->output_file);
 		}
+		stream->fd_out = 0;
 	}
 }
 
@@ -476,9 +602,12 @@ static void begin_tracing(void)
 	connect_input(pipe_path);
 
 	/* start data processing */
-	int rc  = process_data();
+	listener_stream_t stream;
+	listener_stream_init(&stream, fd_in, rtrace_options.pid);
+	int rc  = process_data(&stream);
 	/* close data connection */
-	disconnect_output();
+	rtrace_disconnect_output(&stream, true);
+	listener_stream_free(&stream);
 	disconnect_input(pipe_path);
 
 	exit(rc);
@@ -743,9 +872,12 @@ static int start_process(char* app, char* args[])
 		 * connect_output();
 		 */
 
-		int rc = process_data();
+		listener_stream_t stream;
+		listener_stream_init(&stream, fd_in, rtrace_options.pid);
+		int rc = process_data(&stream);
 
-		disconnect_output();
+		rtrace_disconnect_output(&stream, true);
+		listener_stream_free(&stream);
 		disconnect_input(pipe_path);
 
 		/* Finally if the rtrace was aborted by SIGINT, forward it to the
@@ -830,13 +962,280 @@ static void enter_listen_mode(const char* pipe_path)
 
 	connect_input(pipe_path);
 
-	int rc = process_data();
+	listener_stream_t stream;
+	listener_stream_init(&stream, fd_in, rtrace_options.pid);
+	int rc = process_data(&stream);
 
 	disconnect_input(pipe_path);
-	disconnect_output();
+	rtrace_disconnect_output(&stream, true);
+	listener_stream_free(&stream);
 	exit (rc);
 }
 
+/* the maximum number of events processed by a single epoll_wait call */
+#define DAEMON_MAX_EVENTS      32
+
+/* the daemon event loop timeout (msecs) used to reap post-processors */
+#define DAEMON_POLL_TIMEOUT    1000
+
+/* the pending output size (bytes) of a connection after which
+ * the connection reading is paused until the output catches up */
+#define DAEMON_PENDING_LIMIT   (1024 * 1024)
+
+/* the daemon mode event loop descriptors */
+typedef struct {
+	/* the main event loop descriptor */
+	int fd_epoll;
+	/* the event loop descriptor of the outputs waiting to be written */
+	int fd_epoll_out;
+} daemon_loop_t;
+
+/**
+ * Creates the daemon mode listening socket.
+ *
+ * @param[in] path   the socket path.
+ * @return           the socket descriptor or -1 on failure.
+ */
+static int create_daemon_socket(const char* path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		msg_error("the socket path %s is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		msg_error("failed to create daemon socket (%s)\n", strerror(errno));
+		return -1;
+	}
+	/* remove the socket left by a previous daemon instance */
+	unlink(path);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+		msg_error("failed to bind daemon socket %s (%s)\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Closes the daemon mode connection and its output.
+ *
+ * @param[in] loop      the event loop descriptors.
+ * @param[in] stream    the connection data stream.
+ */
+static void close_daemon_stream(daemon_loop_t* loop, listener_stream_t* stream)
+{
+	epoll_ctl(loop->fd_epoll, EPOLL_CTL_DEL, stream->fd_in, NULL);
+	if (stream->fd_out_polled) epoll_ctl(loop->fd_epoll_out, EPOLL_CTL_DEL, stream->fd_out_polled, NULL);
+	close(stream->fd_in);
+	if (!stream->output_failed) listener_stream_flush(stream);
+	/* the post-processors are reaped by the event loop, so waiting
+	 * for them doesn't block the other connections */
+	rtrace_disconnect_output(stream, false);
+	listener_stream_free(stream);
+	free(stream);
+}
+
+/**
+ * Closes the daemon mode connections which outputs have failed.
+ *
+ * A failed output (for example terminated post-processor) affects
+ * only its own connection, the other connections are served as usual.
+ * @param[in] loop      the event loop descriptors.
+ * @param[in] streams   the connection list.
+ */
+static void close_failed_daemon_streams(daemon_loop_t* loop, dlist_t* streams)
+{
+	listener_stream_t* stream = (listener_stream_t*)streams->head;
+	while (stream) {
+		listener_stream_t* next = (listener_stream_t*)stream->node.next;
+		if (stream->output_failed) {
+			msg_error("closing connection of process %d after output failure\n", stream->pid);
+			dlist_remove(streams, stream);
+			close_daemon_stream(loop, stream);
+		}
+		stream = next;
+	}
+}
+
+/**
+ * Updates the daemon mode connection event registrations.
+ *
+ * The connection output is polled for writing while it has pending
+ * data, and the connection reading is paused while the pending data
+ * exceeds DAEMON_PENDING_LIMIT.
+ * @param[in] stream  the connection data stream.
+ * @param[in] loop    the event loop descriptors.
+ * @return            0.
+ */
+static long update_daemon_stream(listener_stream_t* stream, daemon_loop_t* loop)
+{
+	struct epoll_event event = {.events = EPOLLOUT, .data.ptr = stream};
+
+	if (stream->pending_size && stream->fd_out > 0) {
+		/* The output descriptor is closed (and removed from the event loop)
+		 * by output rotation and the new descriptor can get the same number,
+		 * so the registration is always checked */
+		if (epoll_ctl(loop->fd_epoll_out, EPOLL_CTL_ADD, stream->fd_out, &event) == 0 || errno == EEXIST) {
+			stream->fd_out_polled = stream->fd_out;
+		}
+	}
+	else if (stream->fd_out_polled) {
+		epoll_ctl(loop->fd_epoll_out, EPOLL_CTL_DEL, stream->fd_out_polled, NULL);
+		stream->fd_out_polled = 0;
+	}
+	bool pause = stream->pending_size > DAEMON_PENDING_LIMIT;
+	if (pause != stream->input_paused) {
+		event.events = pause ? 0 : EPOLLIN;
+		epoll_ctl(loop->fd_epoll, EPOLL_CTL_MOD, stream->fd_in, &event);
+		stream->input_paused = pause;
+	}
+	return 0;
+}
+
+/**
+ * Writes the pending output data of the daemon mode connections
+ * which outputs have become writable.
+ *
+ * @param[in] loop   the event loop descriptors.
+ */
+static void write_daemon_outputs(daemon_loop_t* loop)
+{
+	struct epoll_event events[DAEMON_MAX_EVENTS];
+	int i, n = epoll_wait(loop->fd_epoll_out, events, DAEMON_MAX_EVENTS, 0);
+	for (i = 0; i < n; i++) {
+		/* the failed output data is discarded by listener_stream_write_pending(),
+		 * the connection itself is closed by close_failed_daemon_streams() */
+		listener_stream_write_pending((listener_stream_t*)events[i].data.ptr);
+	}
+}
+
+/**
+ * Daemon mode data processing.
+ *
+ * In daemon mode a single pre-processor accepts data connections
+ * from the main tracing modules of multiple (managed mode) processes
+ * over UNIX socket. All connections are served by a single event
+ * loop and every connection data is written into its own output
+ * file or post-processor pipe.
+ *
+ * The post-processor pipes are non-blocking - the data a post-processor
+ * can't accept is kept in the connection pending output buffer, so a slow
+ * post-processor doesn't stall the other connections. However the output
+ * files, the flight recorder dumps, live allocation snapshots, output
+ * rotation and the pending data of closed connections are still written
+ * synchronously. A failed output closes only its own connection.
+ * @param[in] path   the socket path.
+ * @return           0 - success.
+ */
+static int enter_daemon_mode(const char* path)
+{
+	struct epoll_event events[DAEMON_MAX_EVENTS];
+	struct epoll_event event = {.events = EPOLLIN};
+	dlist_t streams;
+	int rc = 0;
+
+	LOG("Entering daemon mode");
+
+	/* the write errors of terminated post-processors are handled per connection */
+	struct sigaction sa = {.sa_flags = 0, .sa_handler = SIG_IGN};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGPIPE, &sa, NULL);
+
+	int fd_socket = create_daemon_socket(path);
+	if (fd_socket == -1) return -1;
+
+	daemon_loop_t loop = {
+		.fd_epoll = epoll_create1(EPOLL_CLOEXEC),
+		.fd_epoll_out = epoll_create1(EPOLL_CLOEXEC),
+	};
+	if (loop.fd_epoll == -1 || loop.fd_epoll_out == -1) {
+		msg_error("failed to create event loop (%s)\n", strerror(errno));
+		if (loop.fd_epoll != -1) close(loop.fd_epoll);
+		if (loop.fd_epoll_out != -1) close(loop.fd_epoll_out);
+		close(fd_socket);
+		unlink(path);
+		return -1;
+	}
+	int fd_epoll = loop.fd_epoll;
+	/* the listening socket is identified by NULL event data */
+	event.data.ptr = NULL;
+	epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_socket, &event);
+	/* the writable outputs are identified by the output event loop address */
+	event.data.ptr = &loop.fd_epoll_out;
+	epoll_ctl(fd_epoll, EPOLL_CTL_ADD, loop.fd_epoll_out, &event);
+	dlist_init(&streams);
+
+	fprintf(stderr, "INFO: Waiting for trace data connections on %s. Press Ctrl+C to stop.\n", path);
+
+	while (!rtrace_stop_requests) {
+		int i, n = epoll_wait(fd_epoll, events, DAEMON_MAX_EVENTS, DAEMON_POLL_TIMEOUT);
+		if (n == -1) {
+			if (errno != EINTR) {
+				msg_error("event loop failure (%s)\n", strerror(errno));
+				rc = -1;
+				break;
+			}
+			n = 0;
+		}
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL) {
+				/* accept new data connection */
+				int fd = accept4(fd_socket, NULL, NULL, SOCK_CLOEXEC);
+				if (fd == -1) {
+					msg_warning("failed to accept data connection (%s)\n", strerror(errno));
+					continue;
+				}
+				/* the target pid is set by the process info packet */
+				listener_stream_t* stream = (listener_stream_t*)dlist_create_node(sizeof(listener_stream_t));
+				listener_stream_init(stream, fd, 0);
+				stream->nonblocking = true;
+				dlist_add(&streams, stream);
+				event.data.ptr = stream;
+				epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd, &event);
+				LOG("accepted connection %d", fd);
+				continue;
+			}
+			if (events[i].data.ptr == &loop.fd_epoll_out) {
+				write_daemon_outputs(&loop);
+				continue;
+			}
+			listener_stream_t* stream = (listener_stream_t*)events[i].data.ptr;
+			int nbytes = listener_stream_read(stream);
+			if (nbytes == 0 || (nbytes == -1 && errno != EINTR)) {
+				LOG("closing connection %d (pid %d)", stream->fd_in, stream->pid);
+				dlist_remove(&streams, stream);
+				close_daemon_stream(&loop, stream);
+			}
+		}
+		/* dump the flight recorders and write the snapshots if requested */
+		dlist_foreach(&streams, (op_unary_t)listener_stream_check_dump);
+		close_failed_daemon_streams(&loop, &streams);
+		/* poll the outputs with pending data and pause the overloaded connections */
+		dlist_foreach2(&streams, (op_binary_t)update_daemon_stream, &loop);
+		/* reap terminated post-processors */
+		while (waitpid(-1, NULL, WNOHANG) > 0);
+	}
+
+	/* close the remaining connections */
+	listener_stream_t* stream;
+	while ((stream = (listener_stream_t*)streams.head) != NULL) {
+		dlist_remove(&streams, stream);
+		close_daemon_stream(&loop, stream);
+	}
+	close(loop.fd_epoll_out);
+	close(fd_epoll);
+	close(fd_socket);
+	unlink(path);
+
+	/* wait for the post-processors to finish */
+	while (wait(NULL) > 0);
+	return rc;
+}
+
 /**
  * Prints module description.
  *
@@ -940,6 +1339,87 @@ static void list_modules(void)
 	closedir(libdir);
 }
 
+/**
+ * Parses output rotation limits.
+ *
+ * The limits are separated by commas and can be either segment size
+ * <size>[K|M|G] (megabytes by default) or segment duration <time>(s|m|h).
+ * @param[in] value  the rotation limits.
+ */
+static void parse_rotate_option(const char* value)
+{
+	const char* ptr = value;
+	while (*ptr) {
+		char* end;
+		unsigned long long limit = strtoull(ptr, &end, 10);
+		if (end == ptr || limit == 0) {
+			msg_error("invalid rotation limit: %s\n", value);
+			exit (-1);
+		}
+		switch (*end) {
+			case 'K': rtrace_options.rotate_size = limit << 10; end++; break;
+			case 'G': rtrace_options.rotate_size = limit << 30; end++; break;
+			case 'M': end++;
+			/* fallthrough */
+			case '\0':
+			case ',': rtrace_options.rotate_size = limit << 20; break;
+			case 's': rtrace_options.rotate_time = limit; end++; break;
+			case 'm': rtrace_options.rotate_time = limit * 60; end++; break;
+			case 'h': rtrace_options.rotate_time = limit * 3600; end++; break;
+			default:
+				msg_error("invalid rotation limit: %s\n", value);
+				exit (-1);
+		}
+		if (*end == ',') end++;
+		else if (*end) {
+			msg_error("invalid rotation limit: %s\n", value);
+			exit (-1);
+		}
+		ptr = end;
+	}
+}
+
+/**
+ * Parses size value <size>[K|M|G], given in megabytes by default.
+ *
+ * @param[in] value  the size value.
+ * @param[out] end   the first character after the size value.
+ * @return           the size in bytes, 0 - invalid value.
+ */
+static unsigned long long parse_size(const char* value, char** end)
+{
+	unsigned long long size = strtoull(value, end, 10);
+	if (*end == value) return 0;
+	switch (**end) {
+		case 'K': (*end)++; return size << 10;
+		case 'G': (*end)++; return size << 30;
+		case 'M': (*end)++;
+		/* fallthrough */
+		default: return size << 20;
+	}
+}
+
+/**
+ * Parses flight recorder settings <size>[,<heap>].
+ *
+ * @param[in] value  the flight recorder settings.
+ */
+static void parse_recorder_option(const char* value)
+{
+	char* end;
+	rtrace_options.recorder_size = parse_size(value, &end);
+	rtrace_options.recorder_heap = 0;
+	if (*end == ',') {
+		rtrace_options.recorder_heap = parse_size(end + 1, &end);
+		if (!rtrace_options.recorder_heap) end--;
+	}
+	/* the buffer must hold at least a few input buffers of data */
+	if (*end || rtrace_options.recorder_size < BUFFER_SIZE * 16) {
+		msg_error("invalid flight recorder settings: %s\n", value);
+		exit (-1);
+	}
+}
+
 /**
  * Translates signal name (SIG???) into its value in string format.
  *
@@ -1098,12 +1578,82 @@ int main(int argc, char* argv[])
 			msg_set_verbosity(MSG_ERROR);
 			break;
 
+		case 'z':
+			rtrace_options.compress = true;
+			break;
+
+		case 'R':
+			if (rtrace_options.rotate) {
+				msg_warning("overriding previously given option: -R %s\n", rtrace_options.rotate);
+				free(rtrace_options.rotate);
+			}
+			rtrace_options.rotate = strdup_a(optarg);
+			parse_rotate_option(optarg);
+			break;
+
+		case 'F':
+			if (rtrace_options.recorder) {
+				msg_warning("overriding previously given option: -F %s\n", rtrace_options.recorder);
+				free(rtrace_options.recorder);
+			}
+			rtrace_options.recorder = strdup_a(optarg);
+			parse_recorder_option(optarg);
+			break;
+
+		case 'w':
+			if (rtrace_options.live) {
+				msg_warning("overriding previously given option: -w %s\n", rtrace_options.live);
+				free(rtrace_options.live);
+			}
+			if (atoi(optarg) <= 0) {
+				msg_error("invalid live report interval: %s\n", optarg);
+				exit (-1);
+			}
+			rtrace_options.live = strdup_a(optarg);
+			break;
+
+		case 'N':
+			rtrace_options.snapshots = true;
+			break;
+
+		case 'D':
+			if (rtrace_options.daemon_socket) {
+				msg_warning("overriding previously given option: -D %s\n", rtrace_options.daemon_socket);
+				free(rtrace_options.daemon_socket);
+			}
+			rtrace_options.daemon_socket = strdup_a(optarg);
+			rtrace_options.mode = MODE_DAEMON;
+			break;
+
 		case '?':
 			display_usage();
 			msg_error("unknown sp-rtrace option: %c\n", optopt);
 			exit (-1);
 		}
 	}
+	if (rtrace_options.live) {
+		/* live mode requires post-processor */
+		if (!rtrace_options.postproc) rtrace_options.postproc = strdup_a("");
+		if (rtrace_options.recorder) msg_warning("live mode is not supported in flight recorder mode\n");
+	}
+	if (rtrace_options.rotate && rtrace_options.postproc) {
+		msg_warning("output rotation is supported only for binary log files\n");
+	}
+	if (rtrace_options.snapshots && rtrace_options.recorder) {
+		msg_warning("live allocation snapshots are disabled in flight recorder mode\n");
+		rtrace_options.snapshots = false;
+	}
+	if (rtrace_options.recorder || rtrace_options.snapshots) {
+		if (rtrace_options.rotate && rtrace_options.recorder) {
+			msg_warning("output rotation is disabled in flight recorder mode\n");
+		}
+		/* install flight recorder dump and snapshot request handler */
+		sa.sa_handler = sigdump_handler;
+		if (sigaction(SIGUSR2, &sa, NULL) == -1) {
+			msg_error("Failed to install SIGUSR2 handler\n");
+			return -1;
+		}
+	}
 	int rc = 0;
 
 	switch (rtrace_options.mode) {
@@ -1139,6 +1689,11 @@ int main(int argc, char* argv[])
 			}
 			break;
 		}
+		case MODE_DAEMON: {
+			LOG("Switching to daemon mode");
+			rc = enter_daemon_mode(rtrace_options.daemon_socket);
+			break;
+		}
 		default: {
 			display_usage();
 			msg_error("failed to determine work mode, not enough options specified\n");
@@ -62,10 +62,26 @@ typedef struct rtrace_options_t {
 	int pid;
 	/* the pre-processor work mode */
 	int mode;
-	/* the post-processor pid */
-	int pid_postproc;
-	/* the output file name */
-	char* output_file;
+	/* the daemon mode socket path */
+	char* daemon_socket;
+	/* true if the binary log file must be compressed */
+	bool compress;
+	/* the output rotation limits */
+	char* rotate;
+	/* the output segment size limit in bytes, 0 - unlimited */
+	unsigned long long rotate_size;
+	/* the output segment time limit in seconds, 0 - unlimited */
+	unsigned int rotate_time;
+	/* the flight recorder settings */
+	char* recorder;
+	/* the flight recorder buffer size in bytes, 0 - flight recorder is disabled */
+	size_t recorder_size;
+	/* the heap size limit in bytes for dumping flight recorder, 0 - no limit */
+	unsigned long long recorder_heap;
+	/* the post-processor live report interval in seconds */
+	char* live;
+	/* true if the live allocations are tracked for snapshots */
+	bool snapshots;
 	/* true if backtraces must be reported for all functions */
 	bool backtrace_all;
 	/* true if libunwind must be used for backtrace resolving */
@@ -79,19 +95,36 @@ extern rtrace_options_t rtrace_options;
 
 extern sig_atomic_t rtrace_stop_requests;
 
+/* Flight recorder dump and snapshot requests, incremented by SIGUSR2 */
+extern sig_atomic_t rtrace_dump_requests;
+
 /* Number of stop requests before trace is aborted. Until
  * this limit is reached sp-rtrace will try to stop the tracing
  * in normal way, waiting for target process to close the data
  * connection normally */
 #define REQUEST_STOP 	 2
 
+struct listener_stream_t;
+
 /**
  * Connects output descriptor either to post-processor pipe or
  * binary log file.
  *
+ * @param[in] stream  the data stream.
  * @return  the opened output file/pipe descriptor.
  */
-int rtrace_connect_output(void);
+int rtrace_connect_output(struct listener_stream_t* stream);
+
+/**
+ * Disconnects the output data connection.
+ *
+ * @param[in] stream         the data stream.
+ * @param[in] wait_postproc  true if the post-processor termination must be
+ *                           waited. Otherwise the post-processor process
+ *                           must be reaped by the caller.
+ * @return
+ */
+void rtrace_disconnect_output(struct listener_stream_t* stream, bool wait_postproc);
 
 #endif
 
@@ -56,4 +56,10 @@
 /* the binary file pattern,  %d-%d - <pid>-<index> */
 #define SP_RTRACE_BINARY_FILE_PATTERN   "%d-%d.rtrace"
 
+/* the compressed binary file pattern,  %d-%d - <pid>-<index> */
+#define SP_RTRACE_COMPRESSED_FILE_PATTERN   "%d-%d.rtrace.gz"
+
+/* the post-processor live report file pattern,  %d-%d - <pid>-<index> */
+#define SP_RTRACE_LIVE_FILE_PATTERN   "%d-%d.rtrace.live.txt"
+
 #endif /* RTRACE_COMMON_H */
@@ -0,0 +1,440 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file hmap_test.c
+ *
+ * Test application for the open addressing hash table implementation.
+ *
+ * The benchmark test case compares the hash table performance with
+ * the bucket list based hash table (htable_t), using address keys
+ * like the resource index of the post-processor leak filter. The
+ * benchmark timings are printed when the test is started with -b option.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "rtrace_testsuite.h"
+
+#include "common/hmap.h"
+#include "common/htable.h"
+#include "common/utils.h"
+#include "library/sp_rtrace_defs.h"
+
+RT_INIT();
+
+#define HMAP_SIZE 16
+
+/* the number of records used by the benchmark */
+#define BENCH_COUNT     (1 << 19)
+
+/* the bucket list based hash table size used by the post-processor */
+#define BENCH_HTABLE_SIZE  (1 << 16)
+
+/**
+ * The test record
+ */
+typedef struct {
+	int id;
+	char* text;
+} rec_t;
+
+
+/**
+ * Frees the test record.
+ * @param rec
+ */
+static void free_rec(rec_t* rec)
+{
+	if (rec->text) free(rec->text);
+	free(rec);
+}
+
+static rec_t* new_rec(int id, const char* text)
+{
+	rec_t* rec = (rec_t*)malloc_a(sizeof(rec_t));
+	rec->id = id;
+	rec->text = strdup_a(text);
+	return rec;
+}
+
+/**
+ * Calculates hash value.
+ *
+ * Deliberately weak hash function to test the collision handling.
+ * @param rec
+ * @return
+ */
+static long calc_hash(const rec_t* rec)
+{
+	return (unsigned char)rec->text[4] % 4;
+}
+
+/**
+ * Compares two test records.
+ * @param rec1
+ * @param rec2
+ * @return
+ */
+static long compare_recs(const rec_t* rec1, const rec_t* rec2)
+{
+	return strcmp(rec1->text, rec2->text);
+}
+
+/**
+ * Verifies if the record matches specified data.
+ * @param rec
+ * @param id
+ * @param text
+ * @return
+ */
+static int verify_rec(const rec_t* rec, int id, const char* text)
+{
+	RT_ASSERT_EX(rec->id == id, "(%d ? %d)", rec->id, id);
+	RT_ASSERT_EX(!strcmp(rec->text, text), "(%s ? %s)", rec->text, text);
+	return RT_OK;
+}
+
+/**
+ * Stores records with identifiers 0..count-1 into the table.
+ * @param hm
+ * @param count
+ */
+static void store_recs(hmap_t* hm, int count)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		char buffer[10];
+		sprintf(buffer, "%05d", i);
+		hmap_store(hm, new_rec(i, buffer));
+	}
+}
+
+/**
+ * Initialization test case.
+ */
+RT_CASE(initialize)
+{
+	hmap_t table;
+	hmap_init(&table, HMAP_SIZE - 1, (op_unary_t)calc_hash, (op_binary_t)compare_recs);
+	RT_ASSERT(table.slots != NULL);
+	RT_ASSERT(table.size == HMAP_SIZE);
+	RT_ASSERT(table.count == 0);
+	RT_ASSERT(table.do_compare == (op_binary_t)compare_recs);
+	RT_ASSERT(table.do_calc_hash == (op_unary_t)calc_hash);
+	int i;
+	for (i = 0; i < HMAP_SIZE; i++) {
+		RT_ASSERT(table.slots[i].rec == NULL);
+	}
+	hmap_free(&table, (op_unary_t)free_rec);
+	return RT_OK;
+}
+
+/**
+ * Record storing test case.
+ */
+RT_CASE(store_rec)
+{
+	hmap_t table;
+	hmap_init(&table, HMAP_SIZE, (op_unary_t)calc_hash, (op_binary_t)compare_recs);
+
+	rec_t* rec = hmap_store(&table, new_rec(1, "12345"));
+	RT_ASSERT(rec == NULL);
+	RT_ASSERT(table.count == 1);
+
+	rec = hmap_store(&table, new_rec(2, "12345"));
+	RT_ASSERT(rec != NULL);
+	RT_ASSERT(verify_rec(rec, 1, "12345") == RT_OK);
+	free_rec(rec);
+	RT_ASSERT(table.count == 1);
+
+	rec_t template = {.text = "12345"};
+	rec = hmap_find(&table, &template);
+	RT_ASSERT(rec != NULL);
+	RT_ASSERT(verify_rec(rec, 2, "12345") == RT_OK);
+
+	/* the table must grow when it gets 3/4 full */
+	store_recs(&table, HMAP_SIZE * 10);
+	RT_ASSERT_EX(table.count == HMAP_SIZE * 10 + 1, "count=%d", (int)table.count);
+	RT_ASSERT_EX(table.count * 4 <= table.size * 3, "size=%d", (int)table.size);
+
+	hmap_free(&table, (op_unary_t)free_rec);
+	return RT_OK;
+}
+
+
+/**
+ * Record finding test case.
+ */
+RT_CASE(find_rec)
+{
+	hmap_t table;
+	hmap_init(&table, HMAP_SIZE, (op_unary_t)calc_hash, (op_binary_t)compare_recs);
+	store_recs(&table, HMAP_SIZE * 10);
+
+	rec_t template_in[] = {
+			{.id = 0, .text = "00000"},
+			{.id = 10, .text = "00010"},
+			{.id = 16, .text = "00016"},
+			{.id = 159, .text = "00159"},
+	};
+	rec_t template_out[] = {
+			{.id = 0, .text = "11111"},
+			{.id = 1, .text = "22222"},
+			{.id = 2, .text = "00160"},
+			{.id = 3, .text = "44444"},
+	};
+
+	int i;
+	for (i = 0; i < RT_SIZEOF(template_in); i++) {
+		rec_t* rec = hmap_find(&table, &template_in[i]);
+		RT_ASSERT_EX(rec != NULL, "text=%s", template_in[i].text);
+		RT_ASSERT_EX(verify_rec(rec, template_in[i].id, template_in[i].text) == RT_OK, "text=%s", template_in[i].text);
+	}
+	for (i = 0; i < RT_SIZEOF(template_out); i++) {
+		rec_t* rec = hmap_find(&table, &template_out[i]);
+		RT_ASSERT_EX(rec == NULL, "text=%s", template_out[i].text);
+	}
+
+	hmap_free(&table, (op_unary_t)free_rec);
+	return RT_OK;
+}
+
+/**
+ * Record removal test case.
+ */
+RT_CASE(remove_rec)
+{
+	hmap_t table;
+	hmap_init(&table, HMAP_SIZE, (op_unary_t)calc_hash, (op_binary_t)compare_recs);
+	store_recs(&table, HMAP_SIZE * 10);
+
+	int i, j;
+	/* remove every third record, so the removed records are located
+	 * in the middle of the collision chains */
+	for (i = 0; i < HMAP_SIZE * 10; i += 3) {
+		char buffer[10];
+		sprintf(buffer, "%05d", i);
+		rec_t template = {.text = buffer};
+		rec_t* rec = hmap_find(&table, &template);
+		RT_ASSERT_EX(rec != NULL, "text=%s", buffer);
+		RT_ASSERT(hmap_remove(&table, rec) == 0);
+		RT_ASSERT(hmap_remove(&table, rec) != 0);
+		free_rec(rec);
+	}
+	for (j = 0; j < HMAP_SIZE * 10; j++) {
+		char buffer[10];
+		sprintf(buffer, "%05d", j);
+		rec_t template = {.text = buffer};
+		rec_t* rec = hmap_find(&table, &template);
+		if (j % 3) {
+			RT_ASSERT_EX(rec != NULL, "text=%s", buffer);
+			RT_ASSERT(verify_rec(rec, j, buffer) == RT_OK);
+		}
+		else {
+			RT_ASSERT_EX(rec == NULL, "text=%s", buffer);
+		}
+	}
+
+	hmap_free(&table, (op_unary_t)free_rec);
+	return RT_OK;
+}
+
+/**
+ * Record id summing function for iteration tests.
+ * @param rec
+ * @return
+ */
+static long count_recs(rec_t* rec, int* counter)
+{
+	*counter += rec->id;
+	return 0;
+}
+
+/**
+ * Binary operation iterator test case.
+ */
+RT_CASE(iterate_binary)
+{
+	hmap_t table;
+	hmap_init(&table, HMAP_SIZE, (op_unary_t)calc_hash, (op_binary_t)compare_recs);
+	store_recs(&table, 100);
+
+	int counter = 0;
+	hmap_foreach2(&table, (op_binary_t)count_recs, (void*)&counter);
+	RT_ASSERT_EX(counter == 4950, "counter=%d", counter);
+
+	hmap_free(&table, (op_unary_t)free_rec);
+	return RT_OK;
+}
+
+/*
+ * Benchmark
+ */
+
+/**
+ * The bucket list hash table benchmark record.
+ */
+typedef struct {
+	htable_node_t node;
+	pointer_t addr;
+} bench_node_t;
+
+/**
+ * The open addressing hash table benchmark record.
+ */
+typedef struct {
+	pointer_t addr;
+} bench_rec_t;
+
+/**
+ * The resource address hash function used by the post-processor
+ * leak filter before the open addressing table was introduced.
+ */
+static long bench_node_hash(const bench_node_t* node)
+{
+	unsigned long hash = 0;
+	unsigned long value = node->addr;
+	while (value) {
+		hash ^= value & ((1 << 16) - 1);
+		value >>= 3;
+	}
+	return hash;
+}
+
+static long bench_node_compare(const bench_node_t* node1, const bench_node_t* node2)
+{
+	return node1->addr == node2->addr ? 0 : (node1->addr < node2->addr ? -1 : 1);
+}
+
+static long bench_rec_hash(const bench_rec_t* rec)
+{
+	return rec->addr;
+}
+
+static long bench_rec_compare(const bench_rec_t* rec1, const bench_rec_t* rec2)
+{
+	return rec1->addr == rec2->addr ? 0 : (rec1->addr < rec2->addr ? -1 : 1);
+}
+
+/**
+ * Returns the benchmark key address.
+ *
+ * Emulates heap allocation addresses - 16 byte aligned blocks of
+ * varying sizes.
+ */
+static pointer_t bench_addr(int index)
+{
+	return 0x10000000 + (pointer_t)index * 48;
+}
+
+/**
+ * Returns the current time in seconds.
+ */
+static double bench_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the benchmark results */
+static double bench_htable, bench_hmap;
+
+/**
+ * Hash table benchmark test case.
+ *
+ * Stores, looks up and removes BENCH_COUNT address keyed records
+ * with both hash table implementations.
+ */
+RT_CASE(benchmark)
+{
+	int i;
+	double start;
+
+	bench_node_t* nodes = (bench_node_t*)calloc_a(BENCH_COUNT, sizeof(bench_node_t));
+	htable_t htable;
+	start = bench_time();
+	htable_init(&htable, BENCH_HTABLE_SIZE, (op_unary_t)bench_node_hash, (op_binary_t)bench_node_compare);
+	for (i = 0; i < BENCH_COUNT; i++) {
+		nodes[i].addr = bench_addr(i);
+		htable_store(&htable, &nodes[i]);
+	}
+	for (i = 0; i < BENCH_COUNT; i++) {
+		bench_node_t template = {.node = {.bucket = NULL}, .addr = bench_addr(i)};
+		RT_ASSERT(htable_find(&htable, &template) == &nodes[i]);
+	}
+	for (i = 0; i < BENCH_COUNT; i++) {
+		htable_remove_node(&nodes[i]);
+	}
+	htable_free(&htable, NULL);
+	bench_htable = bench_time() - start;
+	free(nodes);
+
+	bench_rec_t* recs = (bench_rec_t*)calloc_a(BENCH_COUNT, sizeof(bench_rec_t));
+	hmap_t hmap;
+	start = bench_time();
+	hmap_init(&hmap, 0, (op_unary_t)bench_rec_hash, (op_binary_t)bench_rec_compare);
+	for (i = 0; i < BENCH_COUNT; i++) {
+		recs[i].addr = bench_addr(i);
+		hmap_store(&hmap, &recs[i]);
+	}
+	for (i = 0; i < BENCH_COUNT; i++) {
+		bench_rec_t template = {.addr = bench_addr(i)};
+		RT_ASSERT(hmap_find(&hmap, &template) == &recs[i]);
+	}
+	for (i = 0; i < BENCH_COUNT; i++) {
+		RT_ASSERT(hmap_remove(&hmap, &recs[i]) == 0);
+	}
+	RT_ASSERT(hmap.count == 0);
+	hmap_free(&hmap, NULL);
+	bench_hmap = bench_time() - start;
+	free(recs);
+
+	return RT_OK;
+}
+
+/**
+ *
+ * @return
+ */
+int main(int argc, char* argv[])
+{
+	RT_START("hmap");
+	RT_RUN_CASE(initialize);
+	RT_RUN_CASE(store_rec);
+	RT_RUN_CASE(find_rec);
+	RT_RUN_CASE(remove_rec);
+	RT_RUN_CASE(iterate_binary);
+	RT_RUN_CASE(benchmark);
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		printf("\t\t%d records: htable %.3fs, hmap %.3fs\n", BENCH_COUNT, bench_htable, bench_hmap);
+	}
+
+	return 0;
+
+}
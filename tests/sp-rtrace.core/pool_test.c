@@ -0,0 +1,268 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file pool_test.c
+ *
+ * Test application for the object pool and string arena implementation.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "rtrace_testsuite.h"
+
+#include "common/pool.h"
+#include "common/utils.h"
+
+RT_INIT();
+
+/* the number of objects per pool chunk */
+#define POOL_COUNT   16
+
+/* the number of strings added to the arena */
+#define STR_COUNT    20000
+
+/**
+ * The test object.
+ */
+typedef struct {
+	int id;
+	char text[12];
+} obj_t;
+
+/**
+ * Counts the pool chunks.
+ * @param chunks
+ * @return
+ */
+static int count_chunks(pool_chunk_t* chunks)
+{
+	int count = 0;
+	while (chunks) {
+		count++;
+		chunks = chunks->next;
+	}
+	return count;
+}
+
+/**
+ * Object pool initialization test case.
+ */
+RT_CASE(pool_initialize)
+{
+	pool_t pool;
+	pool_init(&pool, sizeof(obj_t), POOL_COUNT);
+	RT_ASSERT(pool.size >= sizeof(obj_t));
+	RT_ASSERT_EX(pool.size % 8 == 0, "size=%d", (int)pool.size);
+	RT_ASSERT(pool.chunk_size == pool.size * POOL_COUNT);
+	RT_ASSERT(pool.chunks == NULL);
+	RT_ASSERT(pool.free_list == NULL);
+
+	/* the object must be large enough to hold the free list link */
+	pool_t small;
+	pool_init(&small, 1, POOL_COUNT);
+	RT_ASSERT(small.size >= sizeof(void*));
+
+	pool_free(&pool);
+	pool_free(&small);
+	return RT_OK;
+}
+
+/**
+ * Object allocation test case.
+ */
+RT_CASE(pool_allocate)
+{
+	pool_t pool;
+	pool_init(&pool, sizeof(obj_t), POOL_COUNT);
+
+	obj_t* objs[POOL_COUNT * 3];
+	int i;
+	for (i = 0; i < RT_SIZEOF(objs); i++) {
+		objs[i] = (obj_t*)pool_alloc(&pool);
+		RT_ASSERT(objs[i] != NULL);
+		objs[i]->id = i;
+		sprintf(objs[i]->text, "%05d", i);
+	}
+	/* objects allocated from the same chunk are placed next to each other */
+	for (i = 1; i < POOL_COUNT; i++) {
+		RT_ASSERT_EX((char*)objs[i] - (char*)objs[i - 1] == (long)pool.size, "index=%d", i);
+	}
+	RT_ASSERT_EX(count_chunks(pool.chunks) == 3, "chunks=%d", count_chunks(pool.chunks));
+
+	/* the object data must not be overwritten by the following allocations */
+	for (i = 0; i < RT_SIZEOF(objs); i++) {
+		char buffer[12];
+		sprintf(buffer, "%05d", i);
+		RT_ASSERT_EX(objs[i]->id == i, "(%d ? %d)", objs[i]->id, i);
+		RT_ASSERT_EX(!strcmp(objs[i]->text, buffer), "(%s ? %s)", objs[i]->text, buffer);
+	}
+
+	pool_free(&pool);
+	RT_ASSERT(pool.chunks == NULL);
+	return RT_OK;
+}
+
+/**
+ * Object release and reuse test case.
+ */
+RT_CASE(pool_release)
+{
+	pool_t pool;
+	pool_init(&pool, sizeof(obj_t), POOL_COUNT);
+
+	obj_t* objs[POOL_COUNT];
+	int i;
+	for (i = 0; i < POOL_COUNT; i++) {
+		objs[i] = (obj_t*)pool_alloc(&pool);
+	}
+	pool_release(&pool, objs[3]);
+	pool_release(&pool, objs[7]);
+
+	/* the released objects are reused in reverse order */
+	RT_ASSERT(pool_alloc(&pool) == objs[7]);
+	RT_ASSERT(pool_alloc(&pool) == objs[3]);
+	RT_ASSERT(pool.free_list == NULL);
+
+	/* the chunk is full, so the next object comes from a new chunk */
+	obj_t* obj = (obj_t*)pool_alloc(&pool);
+	for (i = 0; i < POOL_COUNT; i++) {
+		RT_ASSERT(obj != objs[i]);
+	}
+	RT_ASSERT_EX(count_chunks(pool.chunks) == 2, "chunks=%d", count_chunks(pool.chunks));
+
+	pool_free(&pool);
+	return RT_OK;
+}
+
+/**
+ * String arena storing test case.
+ */
+RT_CASE(strpool_store)
+{
+	strpool_t pool;
+	strpool_init(&pool);
+
+	char* str1 = strpool_add(&pool, "malloc", 6);
+	RT_ASSERT(str1 != NULL);
+	RT_ASSERT_EX(!strcmp(str1, "malloc"), "str=%s", str1);
+
+	/* the matching string must return the stored copy */
+	char buffer[] = "malloc";
+	char* str2 = strpool_add(&pool, buffer, strlen(buffer));
+	RT_ASSERT(str2 == str1);
+	RT_ASSERT(str2 != buffer);
+
+	/* not zero terminated strings are terminated by the arena */
+	char* str3 = strpool_add(&pool, "freeXXX", 4);
+	RT_ASSERT_EX(!strcmp(str3, "free"), "str=%s", str3);
+	RT_ASSERT(strpool_add(&pool, "free", 4) == str3);
+	RT_ASSERT(str3 != str1);
+
+	/* the empty string */
+	char* str4 = strpool_add(&pool, "", 0);
+	RT_ASSERT(str4 != NULL && *str4 == '\0');
+	RT_ASSERT(strpool_add(&pool, "", 0) == str4);
+
+	strpool_free(&pool);
+	RT_ASSERT(pool.chunks == NULL);
+	return RT_OK;
+}
+
+/**
+ * String length test case.
+ *
+ * The strings are matched by their length, so the trailing padding
+ * must not be passed to the arena.
+ */
+RT_CASE(strpool_length)
+{
+	strpool_t pool;
+	strpool_init(&pool);
+
+	/* the name padded to the protocol alignment */
+	const char padded[8] = "calloc";
+	char* str1 = strpool_add(&pool, "calloc", 6);
+	char* str2 = strpool_add(&pool, padded, sizeof(padded));
+	RT_ASSERT(str1 != str2);
+	RT_ASSERT(strpool_add(&pool, padded, strnlen(padded, sizeof(padded))) == str1);
+
+	strpool_free(&pool);
+	return RT_OK;
+}
+
+/**
+ * Large string arena test case.
+ */
+RT_CASE(strpool_many)
+{
+	strpool_t pool;
+	strpool_init(&pool);
+
+	/* enough strings to fill several arena chunks and grow the index */
+	char** strs = (char**)calloc_a(STR_COUNT, sizeof(char*));
+	int i;
+	for (i = 0; i < STR_COUNT; i++) {
+		char buffer[16];
+		sprintf(buffer, "func_%05d", i);
+		strs[i] = strpool_add(&pool, buffer, strlen(buffer));
+	}
+	/* long strings are stored into separate chunks */
+	char* long_data = (char*)malloc_a(64 * 1024);
+	memset(long_data, 'x', 64 * 1024);
+	char* long_str = strpool_add(&pool, long_data, 64 * 1024);
+	RT_ASSERT(strlen(long_str) == 64 * 1024);
+	RT_ASSERT(strpool_add(&pool, long_data, 64 * 1024) == long_str);
+	free(long_data);
+
+	for (i = 0; i < STR_COUNT; i++) {
+		char buffer[16];
+		sprintf(buffer, "func_%05d", i);
+		RT_ASSERT_EX(!strcmp(strs[i], buffer), "(%s ? %s)", strs[i], buffer);
+		RT_ASSERT_EX(strpool_add(&pool, buffer, strlen(buffer)) == strs[i], "str=%s", buffer);
+	}
+	free(strs);
+
+	strpool_free(&pool);
+	return RT_OK;
+}
+
+/**
+ *
+ * @return
+ */
+int main(void)
+{
+	RT_START("pool");
+	RT_RUN_CASE(pool_initialize);
+	RT_RUN_CASE(pool_allocate);
+	RT_RUN_CASE(pool_release);
+	RT_RUN_CASE(strpool_store);
+	RT_RUN_CASE(strpool_length);
+	RT_RUN_CASE(strpool_many);
+
+	return 0;
+}
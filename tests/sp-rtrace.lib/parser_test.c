@@ -0,0 +1,209 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file parser_test.c
+ *
+ * Test application for the text trace parser.
+ *
+ * Checks that the numeric record fields are scanned like the scanf()
+ * based parser did - the out of range values are saturated - and that
+ * the malformed records are not mistaken for data records.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include "rtrace_testsuite.h"
+
+#include "library/sp_rtrace_parser.h"
+#include "library/sp_rtrace_defs.h"
+
+RT_INIT();
+
+/**
+ * Valid record parsing test case.
+ */
+RT_CASE(valid_records)
+{
+	sp_rtrace_record_t rec;
+
+	int type = sp_rtrace_parser_parse_record("12. @3 [14:54:27.465] malloc(1003) = 0x84cd008", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT(rec.call.index == 12);
+	RT_ASSERT(rec.call.context == 3);
+	RT_ASSERT(rec.call.timestamp == ((14 * 60 + 54) * 60 + 27) * 1000 + 465);
+	RT_ASSERT(!strcmp(rec.call.name, "malloc"));
+	RT_ASSERT(rec.call.type == SP_RTRACE_FTYPE_ALLOC);
+	RT_ASSERT(rec.call.res_size == 1003);
+	RT_ASSERT(rec.call.res_id == 0x84cd008);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	type = sp_rtrace_parser_parse_record("13. free(0x84cd008)", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT(rec.call.type == SP_RTRACE_FTYPE_FREE);
+	RT_ASSERT(rec.call.res_id == 0x84cd008);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	type = sp_rtrace_parser_parse_record("\t0x80485b5 (main+0x12)", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_TRACE);
+	RT_ASSERT(rec.frame.addr == 0x80485b5);
+	RT_ASSERT(!strcmp(rec.frame.name, "(main+0x12)"));
+	sp_rtrace_parser_free_record(type, &rec);
+
+	return RT_OK;
+}
+
+/**
+ * Overlong hexadecimal field test case.
+ */
+RT_CASE(overlong_hex)
+{
+	sp_rtrace_record_t rec;
+	unsigned long expected;
+
+	/* the parser must give the same result as the scanf() %lx conversion */
+	RT_ASSERT(sscanf("55c152839490CCCCC", "%lx", &expected) == 1);
+	RT_ASSERT(expected == ULONG_MAX);
+
+	int type = sp_rtrace_parser_parse_record("\t0x55c152839490CCCCC", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_TRACE);
+	RT_ASSERT_EX(rec.frame.addr == expected, "addr=%lx", rec.frame.addr);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	type = sp_rtrace_parser_parse_record("1. free(0x55c152839490CCCCC)", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT_EX(rec.call.res_id == expected, "res_id=%lx", rec.call.res_id);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	type = sp_rtrace_parser_parse_record("2. malloc(16) = 0x10000000000000000000000000000", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT_EX(rec.call.res_id == expected, "res_id=%lx", rec.call.res_id);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	/* the leading zeros don't overflow */
+	type = sp_rtrace_parser_parse_record("\t0x000000000000000000000000001234", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_TRACE);
+	RT_ASSERT_EX(rec.frame.addr == 0x1234, "addr=%lx", rec.frame.addr);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	return RT_OK;
+}
+
+/**
+ * Overlong decimal field test case.
+ */
+RT_CASE(overlong_dec)
+{
+	sp_rtrace_record_t rec;
+
+	int type = sp_rtrace_parser_parse_record("99999999999. malloc(99999999999) = 0x10", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT_EX(rec.call.index == INT_MAX, "index=%d", rec.call.index);
+	RT_ASSERT_EX(rec.call.res_size == INT_MAX, "res_size=%ld", (long)rec.call.res_size);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	type = sp_rtrace_parser_parse_record("1. malloc(-99999999999) = 0x10", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT_EX(rec.call.res_size == INT_MIN, "res_size=%ld", (long)rec.call.res_size);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	/* the limits themselves are scanned exactly */
+	type = sp_rtrace_parser_parse_record("2147483647. malloc(-2147483648) = 0x10", &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CALL);
+	RT_ASSERT_EX(rec.call.index == INT_MAX, "index=%d", rec.call.index);
+	RT_ASSERT_EX(rec.call.res_size == INT_MIN, "res_size=%ld", (long)rec.call.res_size);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	return RT_OK;
+}
+
+/**
+ * Malformed record test case.
+ *
+ * The records which can't be parsed are reported as comments.
+ */
+RT_CASE(malformed_records)
+{
+	static const char* lines[] = {
+		"\t0x",
+		"\t0xzz",
+		"\t1234",
+		"x. malloc(16) = 0x10",
+		"1 malloc(16) = 0x10",
+		"1. malloc(16 = 0x10",
+		"1. malloc(16) = 10",
+		"1. malloc(abc) = 0x10",
+		"1. free(abc)",
+		"1. free",
+	};
+	unsigned int i;
+	for (i = 0; i < RT_SIZEOF(lines); i++) {
+		sp_rtrace_record_t rec;
+		int type = sp_rtrace_parser_parse_record(lines[i], &rec);
+		RT_ASSERT_EX(type == SP_RTRACE_RECORD_COMMENT, "line='%s', type=%d", lines[i], type);
+	}
+	return RT_OK;
+}
+
+/**
+ * Record mask test case.
+ */
+RT_CASE(record_mask)
+{
+	sp_rtrace_record_t rec;
+	const char* resource = "<1> : memory (memory allocation in bytes)";
+	const char* context = "@ 1 : first context";
+
+	/* the resource registry records are filtered by the resource bit */
+	sp_rtrace_parser_set_mask(SP_RTRACE_RECORD_ALL & ~SP_RTRACE_RECORD_RESOURCE);
+	RT_ASSERT(sp_rtrace_parser_parse_record(resource, &rec) == SP_RTRACE_RECORD_NONE);
+	int type = sp_rtrace_parser_parse_record(context, &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_CONTEXT);
+	sp_rtrace_parser_free_record(type, &rec);
+
+	sp_rtrace_parser_set_mask(SP_RTRACE_RECORD_ALL & ~SP_RTRACE_RECORD_CONTEXT);
+	RT_ASSERT(sp_rtrace_parser_parse_record(context, &rec) == SP_RTRACE_RECORD_NONE);
+	type = sp_rtrace_parser_parse_record(resource, &rec);
+	RT_ASSERT(type == SP_RTRACE_RECORD_RESOURCE);
+	RT_ASSERT(rec.resource.id == 1);
+	RT_ASSERT(!strcmp(rec.resource.type, "memory"));
+	sp_rtrace_parser_free_record(type, &rec);
+
+	sp_rtrace_parser_set_mask(SP_RTRACE_RECORD_ALL);
+	return RT_OK;
+}
+
+int main(void)
+{
+	RT_START("parser");
+	RT_RUN_CASE(valid_records);
+	RT_RUN_CASE(overlong_hex);
+	RT_RUN_CASE(overlong_dec);
+	RT_RUN_CASE(malformed_records);
+	RT_RUN_CASE(record_mask);
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+/**
+ * @file resource_test.c
+ *
+ * Test application for libsp-rtrace1 custom resource API. Simulates
+ * a simple pool allocator reporting its objects as custom resource.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "library/sp_rtrace_resource.h"
+
+#define POOL_SIZE   16
+#define OBJECT_SIZE 64
+
+static char pool[POOL_SIZE][OBJECT_SIZE];
+static int pool_index = 0;
+static unsigned int res_pool = 0;
+
+static void* pool_alloc(void)
+{
+	void* ptr = pool[pool_index++];
+	sp_resource_alloc(res_pool, "pool_alloc", ptr, OBJECT_SIZE);
+	return ptr;
+}
+
+static void pool_free(void* ptr)
+{
+	sp_resource_free(res_pool, "pool_free", ptr);
+}
+
+int main()
+{
+	res_pool = sp_resource_register("pool", "pool allocator objects", 0);
+	if (res_pool == 0) return -1;
+
+	void* obj1 = pool_alloc();
+	pool_alloc();
+	pool_alloc();
+	pool_free(obj1);
+	sleep(1);
+	return 0;
+}
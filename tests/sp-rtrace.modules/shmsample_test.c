@@ -0,0 +1,57 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file shmsample_test.c
+ *
+ * Test application for shared memory segment residency sampling.
+ *
+ * Keeps a shared memory segment attached while the tracing is toggled off.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/types.h>
+
+#define SEGMENT_SIZE	(64 * 1024)
+
+int main()
+{
+	int shmid = shmget(IPC_PRIVATE, SEGMENT_SIZE, IPC_CREAT | 0600);
+	if (shmid == -1) return -1;
+
+	char* ptr = shmat(shmid, NULL, 0);
+	/* the segment is destroyed after the last detach */
+	shmctl(shmid, IPC_RMID, NULL);
+	if (ptr == (void*)-1) return -1;
+
+	memset(ptr, 1, SEGMENT_SIZE);
+	/* wait for the tracing to be toggled off */
+	sleep(4);
+
+	shmdt(ptr);
+	return 0;
+}
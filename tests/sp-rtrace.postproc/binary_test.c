@@ -0,0 +1,236 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file binary_test.c
+ *
+ * Writes binary trace data into standard output.
+ *
+ * The trace contains function calls of two resource types in several
+ * contexts, function arguments, freed allocations, repeated backtraces
+ * and backtraces deeper than the post-processor backtrace lookup buffer.
+ * It's used to compare the post-processing results of binary input with
+ * different input handling and processing options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "common/sp_rtrace_proto.h"
+#include "library/sp_rtrace_defs.h"
+
+/* the number of allocation calls */
+#define CALL_COUNT          200
+
+/* the backtrace depth of every tenth allocation, deeper than
+ * the post-processor backtrace lookup buffer */
+#define DEEP_BACKTRACE      300
+
+/* the resource type ids */
+#define RES_MEMORY          1
+#define RES_FILE            2
+
+/* the context ids */
+#define CONTEXT_FIRST       1
+#define CONTEXT_SECOND      2
+
+static char buffer[(DEEP_BACKTRACE + 16) * sizeof(pointer_t)];
+
+/* the packet start position in the buffer */
+static char* packet_start;
+
+/**
+ * Starts a new packet.
+ *
+ * @param[in] ptr    the packet start position.
+ * @param[in] type   the packet type.
+ * @return           the packet data position.
+ */
+static char* packet_init(char* ptr, unsigned int type)
+{
+	packet_start = ptr;
+	return ptr + write_dword(ptr, type) + SP_RTRACE_PROTO_LENGTH_SIZE;
+}
+
+/**
+ * Completes the started packet and writes it into standard output.
+ *
+ * @param[in] ptr   the packet end position.
+ */
+static void packet_write(char* ptr)
+{
+	write_dword(packet_start + SP_RTRACE_PROTO_TYPE_SIZE,
+			ptr - packet_start - SP_RTRACE_PROTO_TYPE_SIZE - SP_RTRACE_PROTO_LENGTH_SIZE);
+	if (write(STDOUT_FILENO, packet_start, ptr - packet_start) != ptr - packet_start) exit(-1);
+}
+
+/**
+ * Writes resource registry packet.
+ *
+ * @param[in] id     the resource type id.
+ * @param[in] type   the resource type name.
+ * @param[in] desc   the resource type description.
+ */
+static void write_resource(int id, const char* type, const char* desc)
+{
+	char* ptr = packet_init(buffer, SP_RTRACE_PROTO_RESOURCE_REGISTRY);
+	ptr += write_dword(ptr, id);
+	ptr += write_dword(ptr, 0);
+	ptr += write_string(ptr, type);
+	ptr += write_string(ptr, desc);
+	packet_write(ptr);
+}
+
+/**
+ * Writes context registry packet.
+ *
+ * @param[in] id     the context id.
+ * @param[in] name   the context name.
+ */
+static void write_context(int id, const char* name)
+{
+	char* ptr = packet_init(buffer, SP_RTRACE_PROTO_CONTEXT_REGISTRY);
+	ptr += write_dword(ptr, id);
+	ptr += write_string(ptr, name);
+	packet_write(ptr);
+}
+
+/**
+ * Writes function call packet.
+ *
+ * @param[in] res_type  the resource type id.
+ * @param[in] context   the call context.
+ * @param[in] type      the call type (SP_RTRACE_FTYPE_ALLOC/SP_RTRACE_FTYPE_FREE).
+ * @param[in] name      the function name.
+ * @param[in] size      the resource size.
+ * @param[in] id        the resource id.
+ */
+static void write_call(int res_type, int context, int type, const char* name, int size, pointer_t id)
+{
+	char* ptr = packet_init(buffer, SP_RTRACE_PROTO_FUNCTION_CALL);
+	ptr += write_dword(ptr, res_type);
+	ptr += write_dword(ptr, context);
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, type);
+	ptr += write_string(ptr, name);
+	ptr += write_dword(ptr, size);
+	ptr += write_pointer(ptr, id);
+	packet_write(ptr);
+}
+
+/**
+ * Writes function arguments packet with a single argument.
+ *
+ * @param[in] name    the argument name.
+ * @param[in] value   the argument value.
+ */
+static void write_args(const char* name, const char* value)
+{
+	char* ptr = packet_init(buffer, SP_RTRACE_PROTO_FUNCTION_ARGS);
+	ptr += write_dword(ptr, 1);
+	ptr += write_string(ptr, name);
+	ptr += write_string(ptr, value);
+	packet_write(ptr);
+}
+
+/**
+ * Writes backtrace packet.
+ *
+ * @param[in] base    the first frame address.
+ * @param[in] depth   the backtrace depth.
+ */
+static void write_backtrace(pointer_t base, int depth)
+{
+	char* ptr = packet_init(buffer, SP_RTRACE_PROTO_BACKTRACE);
+	ptr += write_dword(ptr, depth);
+	int i;
+	for (i = 0; i < depth; i++) ptr += write_pointer(ptr, base + i * 4);
+	packet_write(ptr);
+}
+
+int main(void)
+{
+	/* handshake packet */
+	char* ptr = buffer + 2;
+	struct utsname name;
+	uname(&name);
+	const char* arch = name.machine;
+	write_byte(buffer, SP_RTRACE_PROTO_HS_ID);
+	ptr += write_byte(ptr, SP_RTRACE_PROTO_VERSION_MAJOR);
+	ptr += write_byte(ptr, SP_RTRACE_PROTO_VERSION_MINOR);
+	ptr += write_byte(ptr, strlen(arch));
+	while (*arch) *ptr++ = *arch++;
+	short endian = 0x0100;
+	ptr += write_byte(ptr, *(char*)&endian);
+	ptr += write_byte(ptr, sizeof(pointer_t));
+	int size = ptr - buffer;
+	SP_RTRACE_PROTO_ALIGN_SIZE(size);
+	write_byte(buffer + 1, size - 2);
+	if (write(STDOUT_FILENO, buffer, size) != size) exit(-1);
+
+	ptr = packet_init(buffer, SP_RTRACE_PROTO_PROCESS_INFO);
+	ptr += write_dword(ptr, 1000);
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, DEEP_BACKTRACE);
+	ptr += write_string(ptr, "binary_test");
+	packet_write(ptr);
+
+	ptr = packet_init(buffer, SP_RTRACE_PROTO_MODULE_INFO);
+	ptr += write_dword(ptr, 1);
+	ptr += write_dword(ptr, 1 << 16);
+	ptr += write_string(ptr, "test");
+	packet_write(ptr);
+
+	write_resource(RES_MEMORY, "memory", "memory allocation in bytes");
+	write_resource(RES_FILE, "file", "file descriptors");
+	write_context(CONTEXT_FIRST, "first context");
+	write_context(CONTEXT_SECOND, "second context");
+
+	int i;
+	for (i = 0; i < CALL_COUNT; i++) {
+		int res_type = i % 5 == 4 ? RES_FILE : RES_MEMORY;
+		int context = i % 4;
+
+		write_call(res_type, context, SP_RTRACE_FTYPE_ALLOC, res_type == RES_MEMORY ? "malloc" : "open",
+				16 + (i % 7) * 8, 0x10000 + i * 0x100);
+		if (i % 3 == 0) write_args("flags", i % 2 ? "odd" : "even");
+		/* the deep backtraces alternate between two variants, so
+		 * both new and repeated deep backtraces are processed */
+		if (i % 10 == 9) write_backtrace(0x8000 + (i / 10 % 2) * 0x1000, DEEP_BACKTRACE);
+		else write_backtrace(0x4000 + (i % 6) * 0x100, 1 + i % 8);
+
+		/* free every second allocation made two calls earlier */
+		if (i >= 2 && i % 2 == 0) {
+			int freed = i - 2;
+			int freed_type = freed % 5 == 4 ? RES_FILE : RES_MEMORY;
+			write_call(freed_type, freed % 4, SP_RTRACE_FTYPE_FREE, freed_type == RES_MEMORY ? "free" : "close",
+					0, 0x10000 + freed * 0x100);
+			write_backtrace(0x6000 + (i % 3) * 0x100, 2);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of sp-rtrace package.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02r10-1301 USA
+ */
+
+/**
+ * @file recorder_test.c
+ *
+ * Writes binary trace data stream containing a backtrace packet larger
+ * than the flight recorder buffer into standard output.
+ *
+ * The data stream is piped into pre-processor in flight recorder mode
+ * to check that the large packet is discarded as a whole.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "common/sp_rtrace_proto.h"
+
+/* the number of frames in the large backtrace packet */
+#define LARGE_BACKTRACE_DEPTH   (64 * 1024)
+
+/* the resource type id */
+#define RES_TYPE_ID             1
+
+static char buffer[(LARGE_BACKTRACE_DEPTH + 16) * sizeof(pointer_t)];
+
+/* the packet start position in the buffer */
+static char* packet_start;
+
+/**
+ * Starts a new packet.
+ *
+ * @param[in] ptr    the packet start position.
+ * @param[in] type   the packet type.
+ * @return           the packet data position.
+ */
+static char* packet_init(char* ptr, unsigned int type)
+{
+	packet_start = ptr;
+	return ptr + write_dword(ptr, type) + SP_RTRACE_PROTO_LENGTH_SIZE;
+}
+
+/**
+ * Completes the started packet and writes it into standard output.
+ *
+ * @param[in] ptr   the packet end position.
+ */
+static void packet_write(char* ptr)
+{
+	write_dword(packet_start + SP_RTRACE_PROTO_TYPE_SIZE,
+			ptr - packet_start - SP_RTRACE_PROTO_TYPE_SIZE - SP_RTRACE_PROTO_LENGTH_SIZE);
+	if (write(STDOUT_FILENO, packet_start, ptr - packet_start) != ptr - packet_start) exit(-1);
+}
+
+/**
+ * Writes function call and backtrace packets.
+ *
+ * @param[in] index   the function call index.
+ * @param[in] name    the function name.
+ * @param[in] depth   the backtrace depth.
+ */
+static void write_call(int index, const char* name, int depth)
+{
+	char* ptr = packet_init(buffer, SP_RTRACE_PROTO_FUNCTION_CALL);
+	ptr += write_dword(ptr, RES_TYPE_ID);
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, 1);
+	ptr += write_string(ptr, name);
+	ptr += write_dword(ptr, 16);
+	ptr += write_pointer(ptr, 0x1000 + index * 0x10);
+	packet_write(ptr);
+
+	ptr = packet_init(buffer, SP_RTRACE_PROTO_BACKTRACE);
+	ptr += write_dword(ptr, depth);
+	int i;
+	for (i = 0; i < depth; i++) ptr += write_pointer(ptr, 0x2000 + i);
+	packet_write(ptr);
+}
+
+int main(void)
+{
+	/* handshake packet */
+	char* ptr = buffer + 2;
+	struct utsname name;
+	uname(&name);
+	const char* arch = name.machine;
+	write_byte(buffer, SP_RTRACE_PROTO_HS_ID);
+	ptr += write_byte(ptr, SP_RTRACE_PROTO_VERSION_MAJOR);
+	ptr += write_byte(ptr, SP_RTRACE_PROTO_VERSION_MINOR);
+	ptr += write_byte(ptr, strlen(arch));
+	while (*arch) *ptr++ = *arch++;
+	short endian = 0x0100;
+	ptr += write_byte(ptr, *(char*)&endian);
+	ptr += write_byte(ptr, sizeof(pointer_t));
+	int size = ptr - buffer;
+	SP_RTRACE_PROTO_ALIGN_SIZE(size);
+	write_byte(buffer + 1, size - 2);
+	if (write(STDOUT_FILENO, buffer, size) != size) exit(-1);
+
+	ptr = packet_init(buffer, SP_RTRACE_PROTO_PROCESS_INFO);
+	ptr += write_dword(ptr, getpid());
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, 0);
+	ptr += write_dword(ptr, LARGE_BACKTRACE_DEPTH);
+	ptr += write_string(ptr, "recorder_test");
+	packet_write(ptr);
+
+	ptr = packet_init(buffer, SP_RTRACE_PROTO_MODULE_INFO);
+	ptr += write_dword(ptr, 1);
+	ptr += write_dword(ptr, 1 << 16);
+	ptr += write_string(ptr, "test");
+	packet_write(ptr);
+
+	ptr = packet_init(buffer, SP_RTRACE_PROTO_RESOURCE_REGISTRY);
+	ptr += write_dword(ptr, RES_TYPE_ID);
+	ptr += write_dword(ptr, 0);
+	ptr += write_string(ptr, "memory");
+	ptr += write_string(ptr, "memory allocation in bytes");
+	packet_write(ptr);
+
+	write_call(1, "before", 4);
+	write_call(2, "large", LARGE_BACKTRACE_DEPTH);
+	write_call(3, "after", 4);
+	return 0;
+}